@@ -25,14 +25,15 @@
 
 #include <stdint.h>
 #include "vehicle.h"
+#include "cantxscheduler.h"
 
 
 class BMW_E39: public Vehicle
 {
 
 public:
+   ~BMW_E39() { CanTxScheduler::Remove(this); }
    void SetCanInterface(CanHardware* c);
-   void Task10Ms();
    void Task100Ms();
    void SetRevCounter(int s) { speed = s; }
    void SetTemperatureGauge(float temp);
@@ -42,11 +43,16 @@ public:
    void SetE46(bool e46) { isE46 = e46; }
 
 private:
-   void Msg316();
-   void Msg329();
-   void Msg545();
-   void Msg43F(int8_t gear);
-   void Msg43B();
+   static bool Fill316(void* context, uint8_t* bytes);
+   static bool Fill329(void* context, uint8_t* bytes);
+   static bool Fill545(void* context, uint8_t* bytes);
+   static bool Fill43B(void* context, uint8_t* bytes);
+   static bool Fill43F(void* context, uint8_t* bytes);
+   void Msg316(uint8_t* bytes);
+   static void Msg329(uint8_t* bytes);
+   static void Msg545(uint8_t* bytes);
+   static void Msg43F(uint8_t* bytes, int8_t gear);
+   static void Msg43B(uint8_t* bytes);
 
    uint16_t speed;
    bool isE46;
@@ -46,11 +46,22 @@ typedef union {
 #define dSTANDARD_CAN_MSG_ID_2_0B 1
 #define dEXTENDED_CAN_MSG_ID_2_0B 2
 
+typedef void (*CANSPI_RxHandler)(uCAN_MSG *rxMessage);
+
 void CANSPI_Initialize(void);
 void CANSPI_Sleep(void);
 void CANSPI_ENRx_IRQ(void);
 void CANSPI_CLR_IRQ(void);
 uint8_t CANSPI_Transmit(uCAN_MSG *tempCanMsg);
+uint32_t CANSPI_Get_TxDrops(void);
+uint32_t CANSPI_Get_TxQueued(void);
+uint32_t CANSPI_Get_TxHighWater(void);
+void CANSPI_RequestErrorCounters(void);
+void CANSPI_Get_ErrorCounters(uint8_t *tec, uint8_t *rec, bool *isBusOff);
+void CANSPI_SetRxHandler(CANSPI_RxHandler handler);
+void CANSPI_StartReceive(void);
+void CANSPI_ServiceReceive(void);
+uint32_t CANSPI_Get_RxOverflows(void);
 uint8_t CANSPI_receive(uCAN_MSG *tempCanMsg);
 uint8_t CANSPI_messagesInBuffer(void);
 uint8_t CANSPI_isBussOff(void);
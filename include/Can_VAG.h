@@ -28,18 +28,23 @@
 #include "stm32_can.h"
 #include "vehicle.h"
 #include "digio.h"
+#include "cantxscheduler.h"
 
 class Can_VAG: public Vehicle
 {
 public:
-   void Task10Ms();
-   void Task100Ms();
+   ~Can_VAG() { CanTxScheduler::Remove(this); }
+   void SetCanInterface(CanHardware* c);
    void SetRevCounter(int s) { rpm = s; }
    void SetTemperatureGauge(float) { } //TODO
    bool Ready();// { return true; }
    bool Start();
 
 private:
+   static bool Fill280(void* context, uint8_t* canData);
+   static bool Fill288(void* context, uint8_t* canData);
+   static bool Fill580(void* context, uint8_t* canData);
+
    uint16_t rpm;
 };
 
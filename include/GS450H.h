@@ -42,16 +42,19 @@ public:
    void SetGS300H();
    void SetGear(int16_t g) { gear = g; }
    void SetOil(int16_t o) { oil = o; }
+   static void MthReceived();
+   static void HtmSent();
 
 private:
    int16_t dc_bus_voltage, mg1_speed, mg2_speed, gear, oil;
    float temp_inv_water, temp_inv_inductor;
    bool timerIsRunning;
    int scaledTorqueTarget;
-   uint8_t VerifyMTHChecksum(uint16_t );
-   void CalcHTMChecksum(uint16_t);
+   uint8_t VerifyMTHChecksum(const uint8_t*, uint16_t);
+   void CommitHtm();
+   void ParseMth();
    void setTimerState(bool);
-   void GS450Hgear();
+   void GS450Hgear(int load);
    void GS450Houtput();
 };
 
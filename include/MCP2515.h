@@ -112,6 +112,21 @@
 #define MSG_IN_RXB1             0x02
 #define MSG_IN_BOTH_BUFFERS     0x03
 
+//Bits of the READ STATUS reply
+#define MCP2515_STAT_RX0IF      0x01
+#define MCP2515_STAT_RX1IF      0x02
+#define MCP2515_STAT_TXB0REQ    0x04
+#define MCP2515_STAT_TX0IF      0x08
+#define MCP2515_STAT_TXB1REQ    0x10
+#define MCP2515_STAT_TX1IF      0x20
+#define MCP2515_STAT_TXB2REQ    0x40
+#define MCP2515_STAT_TX2IF      0x80
+
+//Longest SPI transaction: instruction plus the 13 bytes of an RX or TX buffer
+#define MCP2515_MAX_TRANSFER    14
+//Number of transactions that can wait for the SPI, must be a power of 2
+#define MCP2515_QUEUE_SIZE      16
+
 typedef union{
     struct {
         bool RX0IF;
@@ -254,4 +269,25 @@ uint8_t MCP2515_Get_RxStatus (void);
 
 void MCP2515_Bit_Modify (uint8_t regAddress, uint8_t maskByte, uint8_t dataByte);
 
+//Asynchronous transport, transactions are clocked out by SPI2 DMA one after another.
+//The callback runs from the DMA interrupt with the bytes read during the transaction,
+//rxData[0] is the byte clocked in while the instruction went out.
+typedef void (*MCP2515_Callback)(const uint8_t *rxData, void *context);
+
+bool MCP2515_Queue(const uint8_t *txData, uint8_t length, MCP2515_Callback callback, void *context);
+bool MCP2515_Queue_Read_RxbSequence(uint8_t readRxBuffInst, MCP2515_Callback callback, void *context);
+bool MCP2515_Queue_Load_TxSequence(uint8_t loadtxBnSidhInst, const uint8_t *idReg, uint8_t dlc, const uint8_t *txData);
+bool MCP2515_Queue_Write_ByteSequence(uint8_t startAddress, uint8_t endAddress, const uint8_t *data);
+bool MCP2515_Queue_Read_Status(uint8_t statusInst, MCP2515_Callback callback, void *context);
+bool MCP2515_Queue_RequestToSend(uint8_t rtsTxBuffInst, MCP2515_Callback callback, void *context);
+bool MCP2515_Queue_Bit_Modify(uint8_t regAddress, uint8_t maskByte, uint8_t dataByte);
+void MCP2515_Transfer_Complete(void);
+void MCP2515_Use_Dma(bool enable);
+bool MCP2515_Dma_Enabled(void);
+void MCP2515_WaitIdle(void);
+uint32_t MCP2515_Get_QueueSpace(void);
+uint32_t MCP2515_Get_QueueDrops(void);
+uint32_t MCP2515_EnterCritical(void);
+void MCP2515_LeaveCritical(uint32_t mask);
+
 #endif	/* MCP2515_H */
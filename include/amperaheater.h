@@ -27,12 +27,14 @@ class AmperaHeater : public Heater
    public:
       /** Default constructor */
       AmperaHeater();
+      ~AmperaHeater();
       void SetTargetTemperature(float temp) { (void)temp; } //Not supported (yet)?
       void SetPower(uint16_t power, bool HeatReq);
 
    private:
       bool isAwake=false;
-      void SendWakeup();
+      static int WakeupStep(void* context, int step);
+      static void WakeupDone(void* context);
 };
 
 #endif // AMPERAHEATER_H
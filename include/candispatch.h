@@ -0,0 +1,100 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANDISPATCH_H
+#define CANDISPATCH_H
+
+#include <stdint.h>
+#include "canhardware.h"
+
+#ifndef MAX_USER_MESSAGES
+#define MAX_USER_MESSAGES 30
+#endif
+
+//Both CAN interfaces share the receive callback so one table covers them all
+#define MAX_DISPATCH_IDS (2 * MAX_USER_MESSAGES)
+//CAN3 on the MCP25625 has its own table, only a few drivers listen there
+#define MAX_CAN3_DISPATCH_IDS 16
+
+/* Maps every user message ID to the driver categories that registered it.
+ * The table is rebuilt from SetCanFilters(): it calls Clear(), then selects
+ * the owner before calling each driver's SetCanInterface(). Drivers register
+ * their IDs through RegisterUserMessage() below instead of directly on the
+ * CanHardware so that the receive callback only has to do one lookup.
+ * Drivers on CAN3 register through RegisterCan3Message(), those IDs go to a
+ * separate table that is only consulted for frames from the MCP25625.
+ *
+ * The receive path reads the tables from interrupts while Param::Change
+ * rebuilds them in the main loop. Each table is therefore double buffered:
+ * Clear() and AddId() write a new copy into the unused buffer and then
+ * publish it with a single store, so a reader always sees a complete table.
+ */
+class CanDispatch
+{
+public:
+   enum owners
+   {
+      OWN_SHUNT, OWN_INVERTER, OWN_VEHICLE, OWN_CHARGER, OWN_CHARGEINT,
+      OWN_BMS, OWN_DCDC, OWN_SHIFTER, OWN_OBD2,
+      OWN_LAST
+   };
+
+   enum buses
+   {
+      BUS_CAN, //CAN1 and CAN2
+      BUS_CAN3,
+      BUS_LAST
+   };
+
+   static void Clear();
+   static void SetOwner(owners o) { currentOwner = o; }
+   static owners GetOwner() { return currentOwner; }
+   static void AddId(uint32_t id, buses bus = BUS_CAN);
+   static uint16_t GetOwners(uint32_t id, buses bus = BUS_CAN);
+   static int GetNumIds(buses bus = BUS_CAN) { return tables[bus].numIds[tables[bus].front]; }
+
+   static bool RegisterUserMessage(CanHardware* can, uint32_t id)
+   {
+      AddId(id);
+      return can->RegisterUserMessage(id);
+   }
+
+   static void RegisterCan3Message(uint32_t id) { AddId(id, BUS_CAN3); }
+
+private:
+   struct Entry
+   {
+      uint32_t id;
+      uint16_t mask;
+   };
+
+   struct Table
+   {
+      Entry* entries[2]; //sorted by id
+      int numIds[2];
+      int size;
+      volatile int front; //buffer the receive path reads
+   };
+
+   static Entry canEntries[2][MAX_DISPATCH_IDS];
+   static Entry can3Entries[2][MAX_CAN3_DISPATCH_IDS];
+   static Table tables[BUS_LAST];
+   static owners currentOwner;
+};
+
+#define DISPATCH_TO(mask, o) ((mask) & (1 << CanDispatch::o))
+
+#endif // CANDISPATCH_H
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANFILTEROPT_H
+#define CANFILTEROPT_H
+
+#include <stdint.h>
+
+/* Turns the registered receive IDs of a bxCAN interface into filter banks.
+ *
+ * As long as the budget allows, every ID gets an exact list entry: 4
+ * standard or 2 extended IDs per bank. When there are too many IDs the two
+ * entries whose merged ID/mask accepts the fewest unregistered IDs are
+ * combined, which for contiguous ranges like 0x521..0x528 costs nothing
+ * extra. This repeats until the banks fit. A mask bank holds 2 standard or
+ * 1 extended ID/mask pair.
+ *
+ * The banks are kept in register format, Apply() writes them to the
+ * controller.
+ */
+class CanFilterOpt
+{
+public:
+   static const int MAX_IDS = 64;
+   static const int MAX_BANKS = 14;
+
+   enum bankTypes { LIST16, MASK16, LIST32, MASK32 };
+
+   struct Bank
+   {
+      uint8_t type;
+      uint32_t value[4]; //4 IDs, 2 ID/mask pairs, 2 IDs or 1 ID/mask pair
+   };
+
+   struct Result
+   {
+      Bank banks[MAX_BANKS];
+      int numBanks;
+      uint32_t registered; //distinct IDs requested
+      uint32_t accepted;   //IDs that pass the banks
+   };
+
+   static bool Optimise(const uint32_t* ids, int numIds, int bankBudget, Result& result);
+   static void Apply(const Result& result, int firstBank, int lastBank);
+   static uint32_t FalseAcceptPercent(const Result& result);
+   static int GetCan2StartBank();
+
+private:
+   struct Group
+   {
+      uint32_t value;
+      uint32_t mask; //1 = bit must match
+      bool ext;
+   };
+
+   static int BanksNeeded(const Group* groups, int numGroups);
+   static uint32_t Covered(const Group& g);
+   static Group Merge(const Group& a, const Group& b);
+   static void BuildBanks(const Group* groups, int numGroups, Result& result);
+};
+
+#endif // CANFILTEROPT_H
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANFRESHNESS_H
+#define CANFRESHNESS_H
+
+#include <stdint.h>
+
+/* Freshness of the periodic frames the drivers depend on. A driver declares
+ * each such ID with its nominal period through Expect() in SetCanInterface(),
+ * the receive task stamps every decoded frame with its arrival time. Per ID
+ * this keeps the time since the last frame, a histogram of how far the gaps
+ * deviate from the period and the number of frames that went missing.
+ *
+ * LinkCommand() pairs a feedback ID with the command frame it answers, the
+ * time from sending the command to receiving the next feedback frame is kept
+ * as command latency.
+ *
+ * When a command asks for a visible change, e.g. a torque step, the driver
+ * calls ExpectResponse() right after sending it and Responded() once the
+ * feedback shows the change. The time between the two, plus the time the
+ * change waited for the command to go out, is kept as response time.
+ * Responses that take longer than RESPONSE_TIMEOUT_MS are dropped.
+ *
+ * All times are in ms of the scheduler tick. Ages are taken at the last
+ * Update(), which Ms100Task calls. IDs are shared by all buses.
+ */
+class CanFreshness
+{
+public:
+   static const int MAX_IDS = 24;
+   static const int JITTER_BINS = 5; //gap off by <12.5%, <25%, <50%, <100%, more
+   static const uint32_t RESPONSE_TIMEOUT_MS = 1000;
+
+   struct Entry
+   {
+      uint32_t id;
+      uint32_t commandId; //0 when no command is linked
+      uint32_t lastMs;    //last arrival or the time it was expected from
+      uint32_t commandMs;
+      uint32_t sentMs;    //last time the linked command was sent
+      uint32_t responseStartMs;
+      uint32_t frames;
+      uint32_t missed;
+      uint16_t periodMs;
+      uint16_t maxGapMs;
+      uint16_t latencyMs; //last command to feedback time
+      uint16_t maxLatencyMs;
+      uint16_t responseMs; //last command to visible change time
+      uint16_t maxResponseMs;
+      uint16_t jitter[JITTER_BINS];
+      uint8_t owner;      //CanDispatch owner that expects it
+      bool commandPending;
+      bool responsePending;
+   };
+
+   static void Clear(uint32_t nowMs);
+   static void Expect(uint32_t id, uint16_t periodMs);
+   static void LinkCommand(uint32_t id, uint32_t commandId);
+   static void Stamp(uint32_t id, uint32_t nowMs);
+   static void CommandSent(uint32_t commandId, uint32_t nowMs);
+   static bool ExpectResponse(uint32_t id, uint32_t waitedMs);
+   static void Responded(uint32_t id);
+   static void Update(uint32_t nowMs) { updateMs = nowMs; }
+   static void ResetStats();
+   static int GetWorst();
+   //0 for frames that arrived after the last Update()
+   static uint32_t GetAge(int idx) { int32_t age = updateMs - entries[idx].lastMs; return age > 0 ? age : 0; }
+   static uint32_t GetTotalMissed();
+   static uint16_t GetMaxLatency();
+   static uint16_t GetMaxResponse();
+   static int GetNumIds() { return numIds; }
+   static const Entry& Get(int idx) { return entries[idx]; }
+
+private:
+   static Entry* Find(uint32_t id);
+
+   static Entry entries[MAX_IDS]; //sorted by id
+   static int numIds;
+   static int numLinks;
+   static uint32_t clearMs;
+   static uint32_t updateMs;
+};
+
+/* Response time of one command value and the feedback value it should move,
+ * see CanFreshness. The driver owns one and calls Step() with every new
+ * command, Tick() every 10ms, Sent() once the command frame went out and
+ * Feedback() with every decoded feedback value. A command change of at least
+ * minStep starts a measurement, which ends when the feedback has moved by
+ * minChange in the direction of the change.
+ *
+ * Sent() runs in the 10ms task and Feedback() in the receive task, so the
+ * start value and the direction share one word that is written in one go.
+ */
+class CanResponse
+{
+public:
+   CanResponse(uint32_t feedbackId, int32_t command, int16_t minStep, int16_t minChange);
+   void Step(int32_t command);
+   void Tick() { if (stepTicks >= 0 && stepTicks < 100) stepTicks++; }
+   void Sent(int32_t command, int16_t feedback);
+   void Feedback(int16_t value);
+
+private:
+   static const uint32_t UP = 1 << 16;
+   static const uint32_t DOWN = 1 << 17;
+
+   uint32_t feedbackId;
+   int32_t sentCommand;     //command of the last step that went out
+   volatile uint32_t watch; //feedback at the step in bit 0..15 plus UP or DOWN, 0 when not measuring
+   int16_t minStep;
+   int16_t minChange;
+   int8_t stepTicks;        //10ms ticks the step waited for the frame, -1 without step
+};
+
+#endif // CANFRESHNESS_H
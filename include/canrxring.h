@@ -0,0 +1,95 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANRXRING_H
+#define CANRXRING_H
+
+#include <stdint.h>
+
+//Must be a power of 2
+#define CAN_RX_RING_SIZE 32
+
+struct CanRxFrame
+{
+   uint32_t id;
+   uint32_t data[2];
+   uint32_t timestamp;
+   uint8_t dlc;
+};
+
+/* Single producer/single consumer frame queue between a CAN receive
+ * interrupt and the task that decodes the frames. Put() must only be
+ * called from the interrupt, Get() only from the task. Head and tail are
+ * each written by one side only, so no locking is needed on a single core.
+ */
+class CanRxRing
+{
+public:
+   CanRxRing() : head(0), tail(0), drops(0), highWater(0) {}
+
+   bool Put(uint32_t id, const uint32_t data[2], uint8_t dlc, uint32_t timestamp)
+   {
+      uint32_t h = head;
+      uint32_t used = h - tail;
+
+      if (used >= CAN_RX_RING_SIZE)
+      {
+         drops++;
+         return false;
+      }
+
+      CanRxFrame& f = frames[h & (CAN_RX_RING_SIZE - 1)];
+      f.id = id;
+      f.data[0] = data[0];
+      f.data[1] = data[1];
+      f.dlc = dlc;
+      f.timestamp = timestamp;
+
+      //Frame must be complete before the consumer can see it
+      __asm__ volatile("" ::: "memory");
+      head = h + 1;
+
+      if (used + 1 > highWater) highWater = used + 1;
+
+      return true;
+   }
+
+   bool Get(CanRxFrame& f)
+   {
+      uint32_t t = tail;
+
+      if (t == head) return false;
+
+      f = frames[t & (CAN_RX_RING_SIZE - 1)];
+
+      __asm__ volatile("" ::: "memory");
+      tail = t + 1;
+
+      return true;
+   }
+
+   uint32_t GetDrops() { return drops; }
+   uint32_t GetHighWater() { return highWater; }
+
+private:
+   CanRxFrame frames[CAN_RX_RING_SIZE];
+   volatile uint32_t head; //written by producer only
+   volatile uint32_t tail; //written by consumer only
+   volatile uint32_t drops;
+   volatile uint32_t highWater;
+};
+
+#endif // CANRXRING_H
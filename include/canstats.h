@@ -0,0 +1,78 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANSTATS_H
+#define CANSTATS_H
+
+#include <stdint.h>
+
+/* Traffic and error statistics of the three CAN interfaces. Frames are
+ * counted as they are received and sent, Update() turns the counts of the
+ * last interval into frame rates and an estimated bus load.
+ *
+ * Only frames that pass the hardware filters are seen on the receive side,
+ * so the load is a lower bound of the real bus load.
+ */
+class CanStats
+{
+public:
+   enum buses { BUS_CAN1, BUS_CAN2, BUS_CAN3, NUM_BUSES };
+
+   struct Bus
+   {
+      //Running totals, written by the receive/send paths
+      uint32_t rxFrames;
+      uint32_t txFrames;
+      uint32_t bytes;
+      uint32_t bits;
+      //Values of the last interval, written by Update()
+      uint32_t rxRate;   //frames per second
+      uint32_t txRate;   //frames per second
+      uint32_t byteRate; //payload bytes per second
+      uint32_t load;     //percent of the bit rate
+      uint32_t tec;
+      uint32_t rec;
+      uint32_t busOffEvents;
+      bool busOff;
+      //Totals at the last Update()
+      uint32_t lastRxFrames;
+      uint32_t lastTxFrames;
+      uint32_t lastBytes;
+      uint32_t lastBits;
+   };
+
+   static void SetBitrate(buses bus, uint32_t bitrate) { bitrates[bus] = bitrate; }
+   static void CountRx(buses bus, uint32_t id, uint8_t dlc) { stats[bus].rxFrames++; Count(bus, id, dlc); }
+   static void CountTx(buses bus, uint32_t id, uint8_t dlc) { stats[bus].txFrames++; Count(bus, id, dlc); }
+   static void SetErrors(buses bus, uint8_t tec, uint8_t rec, bool busOff, bool busOffSeen);
+   static void Update(uint32_t intervalMs);
+   static void ReadBxCanErrors(buses bus, uint32_t canBase);
+   static const Bus& Get(buses bus) { return stats[bus]; }
+   static uint32_t FrameBits(uint32_t id, uint8_t dlc);
+   static void Reset();
+
+private:
+   static void Count(buses bus, uint32_t id, uint8_t dlc)
+   {
+      stats[bus].bytes += dlc;
+      stats[bus].bits += FrameBits(id, dlc);
+   }
+
+   static Bus stats[NUM_BUSES];
+   static uint32_t bitrates[NUM_BUSES];
+};
+
+#endif // CANSTATS_H
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANTRACE_H
+#define CANTRACE_H
+
+#include <stdint.h>
+
+/* Capture of the received and sent CAN frames in a RAM ring, read out with
+ * the "trace" terminal command. Each record holds the ID, DLC, data and the
+ * time since the previous record in us, 16 bytes per frame.
+ *
+ * Up to MAX_FILTERS ID/mask filters limit what is recorded, without filters
+ * everything is. In triggered mode recording stops POST_TRIGGER frames after
+ * Trigger(), which Ms1Task calls whenever a new error is posted, so the ring
+ * holds the traffic around the error.
+ *
+ * Record() is called from the CAN interrupts as well as from the tasks.
+ */
+class CanTrace
+{
+public:
+   static const int SIZE = 128; //must be a power of 2
+   static const int POST_TRIGGER = SIZE / 2;
+   static const int MAX_FILTERS = 4;
+   static const uint32_t SENT = 0x80000000; //flag in Frame::id
+   static const int BUS_SHIFT = 29;         //bus number in bits 29..30 of Frame::id
+
+   enum modes { STOPPED, RUNNING, ARMED, TRIGGERED };
+
+   struct Frame
+   {
+      uint32_t id;
+      uint16_t deltaUs; //saturates at 65535
+      uint8_t dlc;
+      uint8_t reserved;
+      uint32_t data[2];
+   };
+
+   static void Record(int bus, bool sent, uint32_t id, const uint32_t data[2], uint8_t dlc);
+   static void Start(bool triggered);
+   static void Stop() { mode = STOPPED; }
+   static void Trigger();
+   static void CheckError(int lastError);
+   static void Clear();
+   static bool AddFilter(uint32_t id, uint32_t mask);
+   static void ClearFilters() { numFilters = 0; }
+   static modes GetMode() { return mode; }
+   static int GetCount() { return count; }
+   static const Frame& Get(int i) { return frames[(head - count + i) & (SIZE - 1)]; }
+
+private:
+   struct Filter
+   {
+      uint32_t id;
+      uint32_t mask;
+   };
+
+   static Frame frames[SIZE];
+   static Filter filters[MAX_FILTERS];
+   static int numFilters;
+   static int head;
+   static int count;
+   static int postTrigger;
+   static uint32_t lastTicks;
+   static int lastError;
+   static volatile modes mode;
+};
+
+#endif // CANTRACE_H
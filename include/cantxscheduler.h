@@ -0,0 +1,72 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANTXSCHEDULER_H
+#define CANTXSCHEDULER_H
+
+#include <stdint.h>
+#include "canhardware.h"
+
+/* Sends the periodic frames of the drivers. A driver registers each frame
+ * with its period and a fill function, Run() is called from Ms1Task and
+ * calls the fill function when the frame is due, then sends it.
+ *
+ * Every frame gets a fixed phase (offset in ms) within its period. The phase
+ * is chosen at registration so that as few frames as possible of the same
+ * interface are due in the same millisecond, instead of all 10ms frames of
+ * the inverter and the vehicle queuing up for the three TX mailboxes at once.
+ *
+ * Periods must divide CYCLE_MS or be a multiple of it. The context pointer
+ * is handed to the fill function unchanged, drivers pass "this".
+ */
+class CanTxScheduler
+{
+public:
+   static const int MAX_MESSAGES = 24;
+   static const uint32_t CYCLE_MS = 100;
+
+   //Fill in the frame data, return false to skip this period
+   typedef bool (*FillFunction)(void* context, uint8_t* data);
+
+   static bool Register(CanHardware* can, uint32_t id, uint8_t dlc, uint32_t periodMs, FillFunction fill, void* context);
+   static void Remove(void* context);
+   static void Clear();
+   static void Run();
+   static int GetPhase(uint32_t id, void* context);
+   static int GetWorstSlot(CanHardware* can);
+   static int GetWorstSlotMeasured() { return worstMeasured; }
+
+private:
+   struct Message
+   {
+      CanHardware* can;
+      FillFunction fill;
+      void* context;
+      uint32_t id;
+      uint32_t periodMs;
+      uint32_t phase;
+      uint8_t dlc;
+      volatile bool active;
+   };
+
+   static void GetSlotLoad(CanHardware* can, uint8_t load[CYCLE_MS]);
+
+   static Message messages[MAX_MESSAGES];
+   static uint32_t tick;
+   static int worstMeasured;
+};
+
+#endif // CANTXSCHEDULER_H
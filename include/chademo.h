@@ -36,12 +36,14 @@ class FCChademo: public Chargerint
       void Task200Ms();
       bool DCFCRequest(bool RunCh);
       bool ACRequest(bool RunCh){return RunCh;};
+      void SetCanInterface(CanHardware* c);
 
    protected:
 
    private:
       static void Process108Message(uint32_t data[2]);
       static void Process109Message(uint32_t data[2]);
+      static int SendStep(void* context, int step);
       static bool chargeEnabled;
       static bool parkingPosition;
       static bool fault;
@@ -0,0 +1,175 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DRIVERSLOT_H
+#define DRIVERSLOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
+
+/* Holds the active driver of one category (inverter, vehicle, charger...).
+ *
+ * In the default build every driver can be selected at run time. Only one
+ * driver of a category exists at a time: it is constructed with placement new
+ * in an arena sized for the largest driver of the list, switching destroys
+ * it and constructs the new one. Selecting the active driver again keeps its
+ * state. The arena is cleared before construction, so members a constructor
+ * leaves alone start at zero just like the static objects used to. The
+ * scheduler interrupt keeps calling the driver through the slot, so the
+ * switch runs with interrupts masked: the ISR sees either the old or the new
+ * driver, never a half built one.
+ *
+ * A fixed configuration header (make FIXED_CONFIG=fixedconfig_xxx.h) can
+ * name one concrete type per category together with the parameter value that
+ * selects it, e.g. FIXED_INVERTER GS450HClass and FIXED_INVERTER_MODE
+ * InvModes::GS450H. Then the slot always refers to that one object, the
+ * parameter is pinned to the given value, the virtual calls are
+ * resolved at compile time and the other drivers of the category are never
+ * instantiated, so --gc-sections drops them from the image.
+ *
+ * savedBytes is the RAM saved compared to one static object per driver, it
+ * is printed after linking, see DRIVER_RAM_REPORT.
+ */
+template <class T>
+struct DriverInstance
+{
+   static T instance;
+};
+
+template <class T>
+T DriverInstance<T>::instance;
+
+constexpr size_t LargestSize(size_t size) { return size; }
+
+template <class... Sizes>
+constexpr size_t LargestSize(size_t first, Sizes... rest)
+{
+   return first > LargestSize(rest...) ? first : LargestSize(rest...);
+}
+
+template <class Base, class Fixed, class Initial, class... Drivers>
+class DriverSlot
+{
+public:
+   typedef Fixed Type;
+   static const size_t savedBytes = (sizeof(Drivers) + ...) - sizeof(Fixed);
+
+   Fixed* operator->() const { return &DriverInstance<Fixed>::instance; }
+   Fixed* Get() const { return &DriverInstance<Fixed>::instance; }
+
+   template <class T> bool Is() const { return std::is_same<T, Fixed>::value; }
+
+   template <class T> void Select() {}
+
+   //Only the fixed driver is instantiated, the setup of the others is discarded
+   template <class T, class Setup> void Select(Setup setup)
+   {
+      if constexpr (std::is_same<T, Fixed>::value) setup(DriverInstance<T>::instance);
+   }
+};
+
+template <class Base, class Initial, class... Drivers>
+class DriverSlot<Base, void, Initial, Drivers...>
+{
+public:
+   typedef Base Type;
+   static const size_t arenaSize = LargestSize(sizeof(Drivers)...);
+   static const size_t savedBytes = (sizeof(Drivers) + ...) - arenaSize;
+
+   DriverSlot() : selected(0), destroy(0) { Select<Initial>(); }
+
+   Base* operator->() const { return selected; }
+   Base* Get() const { return selected; }
+
+   template <class T> bool Is() const { return destroy == &Destroy<T>; }
+
+   template <class T> void Select()
+   {
+      static_assert((std::is_same<T, Drivers>::value || ...), "Driver missing from the slot's list");
+
+      if (Is<T>()) return;
+
+#ifdef STM32F1
+      uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+      if (destroy != 0) destroy(selected);
+
+      memset(arena, 0, sizeof(arena));
+      selected = new (arena) T();
+      destroy = &Destroy<T>;
+
+#ifdef STM32F1
+      cm_mask_interrupts(irqMask);
+#endif
+   }
+
+   //Select and apply variant settings, e.g. Select<GS450HClass>([](auto& inv) { inv.SetPrius(); });
+   template <class T, class Setup> void Select(Setup setup)
+   {
+      Select<T>();
+      setup(*static_cast<T*>(selected));
+   }
+
+private:
+   template <class T> static void Destroy(Base* driver) { static_cast<T*>(driver)->~T(); }
+
+   alignas(Drivers...) uint8_t arena[arenaSize];
+   Base* selected;
+   void (*destroy)(Base*);
+};
+
+//Publishes the saved RAM of a slot as absolute symbol driverRamSaved_<name>,
+//only emits a symbol and no code. Must be used inside a function.
+#define DRIVER_RAM_REPORT(name, slot) \
+   asm(".global driverRamSaved_" #name "\n.equ driverRamSaved_" #name ", %c0" :: "i"(decltype(slot)::savedBytes))
+
+#ifdef FIXED_CONFIG
+#include FIXED_CONFIG
+#endif
+
+#ifndef FIXED_INVERTER
+#define FIXED_INVERTER void
+#endif
+#ifndef FIXED_VEHICLE
+#define FIXED_VEHICLE void
+#endif
+#ifndef FIXED_CHARGER
+#define FIXED_CHARGER void
+#endif
+#ifndef FIXED_CHARGEINT
+#define FIXED_CHARGEINT void
+#endif
+#ifndef FIXED_HEATER
+#define FIXED_HEATER void
+#endif
+#ifndef FIXED_BMS
+#define FIXED_BMS void
+#endif
+#ifndef FIXED_DCDC
+#define FIXED_DCDC void
+#endif
+#ifndef FIXED_SHIFTER
+#define FIXED_SHIFTER void
+#endif
+
+#endif // DRIVERSLOT_H
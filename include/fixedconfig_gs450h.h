@@ -0,0 +1,44 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FIXEDCONFIG_GS450H_H
+#define FIXEDCONFIG_GS450H_H
+
+/* Example fixed driver set: GS450H in a BMW E65 with Leaf PDM charging and
+ * SimpBMS. Build with make clean all FIXED_CONFIG=fixedconfig_gs450h.h
+ *
+ * Every category needs the driver type and the parameter value that selects
+ * it. Categories that are left out stay selectable at run time.
+ */
+
+#define FIXED_INVERTER        GS450HClass
+#define FIXED_INVERTER_MODE   InvModes::GS450H
+#define FIXED_VEHICLE         BMW_E65
+#define FIXED_VEHICLE_MODE    vehicles::vBMW_E65
+#define FIXED_CHARGER         NissanPDM
+#define FIXED_CHARGER_MODE    ChargeModes::Leaf_PDM
+#define FIXED_CHARGEINT       notused
+#define FIXED_CHARGEINT_MODE  ChargeInterfaces::Unused
+#define FIXED_HEATER          noHeater
+#define FIXED_HEATER_MODE     HeatType::Noheater
+#define FIXED_BMS             SimpBMS
+#define FIXED_BMS_MODE        BMSModes::BMSModeSimpBMS
+#define FIXED_DCDC            DCDC
+#define FIXED_DCDC_MODE       DCDCModes::NoDCDC
+#define FIXED_SHIFTER         Shifter
+#define FIXED_SHIFTER_MODE    ShifterModes::NoShifter
+
+#endif // FIXEDCONFIG_GS450H_H
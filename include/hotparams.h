@@ -0,0 +1,74 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HOTPARAMS_H
+#define HOTPARAMS_H
+
+#include <stdint.h>
+#include "my_fp.h"
+
+/* Copy of the parameters the 10ms path reads over and over. Refresh() takes
+ * the run time values at the start of Ms10Task, RefreshConfig() takes the
+ * user settings and is called from Param::Change.
+ *
+ * Only values that nothing writes before they are read within the tick are
+ * kept here, e.g. udc and speed are written after the throttle and torque
+ * calculation. pot and pot2 are updated by the throttle itself and are
+ * still read from Param. Values in s32fp stay unconverted so the fixed point
+ * throttle can use them without a float round trip.
+ */
+class HotParams
+{
+public:
+   static void Refresh();
+   static void RefreshConfig();
+
+   //Run time values, taken at the start of Ms10Task
+   static int opmode;
+   static int dir;
+   static int speed;
+   static s32fp udc;
+   static s32fp idc;
+   static s32fp tmphs;
+   static s32fp tmpm;
+   static int cruisespeed;
+   static int canctr;
+   static bool dinBrake;
+   static bool dinForward;
+   static bool dinReverse;
+
+   //User settings, taken in Param::Change
+   static int inverter;
+   static int reversemotor;
+   static int inverterCan;
+   static int shuntCan;
+   static int shuntType;
+   static int potmin;
+   static int potmode;
+   static int motActive;
+   static int throtramprpm;
+   static s32fp throtramp;
+   static s32fp tmphsmax;
+   static s32fp tmpmmax;
+   static float udcsw;
+   static float udclim;
+   static float regenBrakeLight;
+   static s32fp shiftCut;
+   static int shiftDelay; //in 10ms steps
+   static int outlanderPeriod; //torque frame period in 10ms steps
+};
+
+#endif // HOTPARAMS_H
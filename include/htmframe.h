@@ -0,0 +1,61 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HTMFRAME_H
+#define HTMFRAME_H
+
+#include <stdint.h>
+
+/* HTM frame (VCU to Toyota hybrid inverter) under construction. The frame
+ * ends with the 16 bit sum of all bytes before it. Only a few fields change
+ * between exchanges, so the sum is kept up to date by the difference of each
+ * byte written instead of being summed over the whole frame every time.
+ *
+ * All writes must go through the setters and stay below GetLength() - 2.
+ */
+class HtmFrame
+{
+public:
+   static const int MAX_LENGTH = 105;
+
+   HtmFrame() : len(0), sum(0) {}
+   void Load(const uint8_t* init, uint16_t length);
+   void Set(uint16_t idx, uint8_t value) { sum += value - data[idx]; data[idx] = value; }
+   //Little endian, as most fields of the frame
+   void SetWord(uint16_t idx, int16_t value) { Set(idx, value & 0xFF); Set(idx + 1, (value >> 8) & 0xFF); }
+   //High byte first
+   void SetWordSwapped(uint16_t idx, int16_t value) { Set(idx, (value >> 8) & 0xFF); Set(idx + 1, value & 0xFF); }
+   uint8_t Get(uint16_t idx) const { return data[idx]; }
+   uint16_t GetLength() const { return len; }
+   uint16_t GetChecksum() const { return sum; }
+   const uint8_t* Finish();
+
+   static uint16_t Checksum(const uint8_t* frame, uint16_t length);
+
+private:
+   uint8_t data[MAX_LENGTH];
+   uint16_t len;
+   uint16_t sum;
+};
+
+//Frames for the inverter start up and the initial contents of the running frames
+extern const uint8_t htm_data_setup[100];
+extern const uint8_t htm_data_default[100];
+extern const uint8_t htm_data_GS300H[105];
+extern const uint8_t htm_data_init[7][100];
+extern const uint8_t htm_data_Init_GS300H[6][105];
+
+#endif // HTMFRAME_H
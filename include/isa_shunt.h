@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include "my_fp.h"
 #include "canhardware.h"
+#include "sequencer.h"
 
 class ISA
 {
@@ -22,8 +23,8 @@ class ISA
 
 public:
     static void RegisterCanMessages(CanHardware* can);
-    static void initialize(CanHardware* can);
-    static void initCurrent(CanHardware* can);
+    static void initialize(CanHardware* can, Sequencer::DoneCallback done = 0);
+    static void initCurrent(CanHardware* can, Sequencer::DoneCallback done = 0);
     static void sendSTORE(CanHardware* can);
     static void STOP(CanHardware* can);
     static void START(CanHardware* can);
@@ -24,13 +24,13 @@
 #include <stdint.h>
 #include "my_fp.h"
 #include "inverter.h"
+#include "cantxscheduler.h"
 
 class LeafINV: public Inverter
 {
 public:
+   ~LeafINV() { CanTxScheduler::Remove(this); }
    void DecodeCAN(int id, uint32_t data[2]);
-   void Task10Ms();
-   void Task100Ms();
    static bool ControlCharge(bool RunCh);
    void SetTorque(float torque);
    float GetMotorTemperature() { return motor_temp; }
@@ -43,6 +43,15 @@ public:
 private:
    static void nissan_crc(uint8_t *data, uint8_t polynomial);
    static int8_t fahrenheit_to_celsius(uint16_t fahrenheit);
+   static bool Fill11A(void* context, uint8_t* bytes);
+   static bool Fill1D4(void* context, uint8_t* bytes);
+   static bool Fill1DB(void* context, uint8_t* bytes);
+   static bool Fill50B(void* context, uint8_t* bytes);
+   static bool Fill1DC(void* context, uint8_t* bytes);
+   static bool Fill1F2(void* context, uint8_t* bytes);
+   static bool Fill55B(void* context, uint8_t* bytes);
+   static bool Fill59E(void* context, uint8_t* bytes);
+   static bool Fill5BC(void* context, uint8_t* bytes);
    uint32_t lastRecv;
    int16_t speed;
    int16_t inv_temp;
@@ -21,6 +21,7 @@
 #define OUTLANDERINVERTER_H
 
 #include <inverter.h>
+#include "canfreshness.h"
 
 class OutlanderInverter : public Inverter
 {
@@ -46,6 +47,8 @@ private:
    bool error;
    uint16_t voltage;
    uint32_t final_torque_request;
+   uint32_t torqueFrame[2]; //0x287 as built by SetTorque()
+   CanResponse response;    //torque step to speed change
 };
 
 #endif // OUTLANDERINVERTER_H
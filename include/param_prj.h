@@ -25,7 +25,7 @@
    2. Temporary parameters (id = 0)
    3. Display values
  */
-//Next param id (increase when adding new parameter!): 131
+//Next param id (increase when adding new parameter!): 142
 /*              category     name         unit       min     max     default id */
 #define PARAM_LIST \
     PARAM_ENTRY(CAT_SETUP,     Inverter,     INVMODES, 0,      8,      0,      5  ) \
@@ -75,6 +75,11 @@
     PARAM_ENTRY(CAT_THROTTLE,  throtrpmfilt,   "rpm/10ms",  0.1,    200,    15,    131 ) \
     PARAM_ENTRY(CAT_LEXUS,     Gear,        LOWHIGH,   0,      2,      0,      27 ) \
     PARAM_ENTRY(CAT_LEXUS,     OilPump,     "%",       0,      100,    50,     28 ) \
+    PARAM_ENTRY(CAT_LEXUS,     shiftup,     "rpm",     1000,   10000,  7000,   136 ) \
+    PARAM_ENTRY(CAT_LEXUS,     shiftupfull, "rpm",     1000,   10000,  7000,   137 ) \
+    PARAM_ENTRY(CAT_LEXUS,     shifthyst,   "rpm",     100,    9000,   5000,   138 ) \
+    PARAM_ENTRY(CAT_LEXUS,     shiftcut,    "%/10ms",  1,      100,    100,    139 ) \
+    PARAM_ENTRY(CAT_LEXUS,     shiftdelay,  "ms",      10,     200,    40,     140 ) \
     PARAM_ENTRY(CAT_CRUISE,    cruisestep,  "rpm",     1,      1000,   200,    29 ) \
     PARAM_ENTRY(CAT_CRUISE,    cruiseramp,  "rpm/100ms",1,     1000,   20,     30 ) \
     PARAM_ENTRY(CAT_CRUISE,    regenlevel,  "",        0,      3,      2,      31 ) \
@@ -82,6 +87,7 @@
     PARAM_ENTRY(CAT_CONTACT,   cruiselight, ONOFF,     0,      1,      0,      33 ) \
     PARAM_ENTRY(CAT_CONTACT,   errlights,   ERRLIGHTS, 0,      255,    0,      34 ) \
     PARAM_ENTRY(CAT_COMM,      CAN3Speed,   CAN3Spd,   0,      2,      0,      77 ) \
+    PARAM_ENTRY(CAT_COMM,      outlrate,    OUTLRATES, 0,      2,      2,      141 ) \
     PARAM_ENTRY(CAT_CHARGER,   BattCap,     "kWh",     0.1,    250,    22,     38 ) \
     PARAM_ENTRY(CAT_CHARGER,   Voltspnt,    "V",       0,      1000,   395,    40 ) \
     PARAM_ENTRY(CAT_CHARGER,   Pwrspnt,     "W",       0,      12000,  1500,   41 ) \
@@ -137,6 +143,10 @@
     PARAM_ENTRY(CAT_PWM,       Tim3_1_OC,   "",        1,      100000, 3600,   102 ) \
     PARAM_ENTRY(CAT_PWM,       Tim3_2_OC,   "",        1,      100000, 3600,   103 ) \
     PARAM_ENTRY(CAT_PWM,       Tim3_3_OC,   "",        1,      100000, 3600,   104 ) \
+    PARAM_ENTRY(CAT_SCHED,     SchedMode,   SCHEDMODES, 0,     2,      1,      132 ) \
+    PARAM_ENTRY(CAT_SCHED,     Ms10Phase,   "ms",      0,      9,      0,      133 ) \
+    PARAM_ENTRY(CAT_SCHED,     Ms100Phase,  "ms",      0,      99,     3,      134 ) \
+    PARAM_ENTRY(CAT_SCHED,     Ms200Phase,  "ms",      0,      199,    7,      135 ) \
     VALUE_ENTRY(version,       VERSTR,              2000 ) \
     VALUE_ENTRY(opmode,        OPMODES,             2002 ) \
     VALUE_ENTRY(chgtyp,        CHGTYPS,             2003 ) \
@@ -175,11 +185,11 @@
     VALUE_ENTRY(cruisespeed,   "rpm",               2033 ) \
     VALUE_ENTRY(cruisestt,     CRUISESTATES,        2034 ) \
     VALUE_ENTRY(din_cruise,    ONOFF,               2035 ) \
-    VALUE_ENTRY(din_start,     ONOFF,               2036 )  // 启动开关，开/关型信号
-    VALUE_ENTRY(din_brake,     ONOFF,               2037 )  // 刹车开关，开/关型信号
-    VALUE_ENTRY(din_forward,   ONOFF,               2038 )  // 前进挡信号，开/关型信号
-    VALUE_ENTRY(din_reverse,   ONOFF,               2039 )  // 倒车挡信号，开/关型信号
-    VALUE_ENTRY(din_bms,       ONOFF,               2040 )  // BMS信号，开/关型信号
+    VALUE_ENTRY(din_start,     ONOFF,               2036 ) /* 启动开关，开/关型信号 */ \
+    VALUE_ENTRY(din_brake,     ONOFF,               2037 ) /* 刹车开关，开/关型信号 */ \
+    VALUE_ENTRY(din_forward,   ONOFF,               2038 ) /* 前进挡信号，开/关型信号 */ \
+    VALUE_ENTRY(din_reverse,   ONOFF,               2039 ) /* 倒车挡信号，开/关型信号 */ \
+    VALUE_ENTRY(din_bms,       ONOFF,               2040 ) /* BMS信号，开/关型信号 */ \
     VALUE_ENTRY(din_12Vgp,     ONOFF,               2071 ) \
     VALUE_ENTRY(handbrk,       ONOFF,               2041 ) \
     VALUE_ENTRY(Gear1,         ONOFF,               2042 ) \
@@ -222,8 +232,67 @@
     VALUE_ENTRY(tmpheater,     "°C",                2096 ) \
     VALUE_ENTRY(udcheater,     "V",                 2097 ) \
     VALUE_ENTRY(powerheater,   "W",                 2098 ) \
-
-//Next value Id: 2099
+    VALUE_ENTRY(can1rxhwm,     "dig",               2099 ) \
+    VALUE_ENTRY(can2rxhwm,     "dig",               2100 ) \
+    VALUE_ENTRY(can1rxdrop,    "dig",               2101 ) \
+    VALUE_ENTRY(can2rxdrop,    "dig",               2102 ) \
+    VALUE_ENTRY(t1msavg,       "us",                2103 ) \
+    VALUE_ENTRY(t1msmax,       "us",                2104 ) \
+    VALUE_ENTRY(t10msavg,      "us",                2105 ) \
+    VALUE_ENTRY(t10msmax,      "us",                2106 ) \
+    VALUE_ENTRY(t100msavg,     "us",                2107 ) \
+    VALUE_ENTRY(t100msmax,     "us",                2108 ) \
+    VALUE_ENTRY(t200msavg,     "us",                2109 ) \
+    VALUE_ENTRY(t200msmax,     "us",                2110 ) \
+    VALUE_ENTRY(taskovr,       "dig",               2111 ) \
+    VALUE_ENTRY(tickmaxsync,   "us",                2112 ) \
+    VALUE_ENTRY(tickmaxstag,   "us",                2113 ) \
+    VALUE_ENTRY(seqstepmax,    "us",                2114 ) \
+    VALUE_ENTRY(can3rxhwm,     "dig",               2115 ) \
+    VALUE_ENTRY(can3rxdrop,    "dig",               2116 ) \
+    VALUE_ENTRY(can3rxovr,     "dig",               2117 ) \
+    VALUE_ENTRY(can3txq,       "dig",               2118 ) \
+    VALUE_ENTRY(can3txhwm,     "dig",               2119 ) \
+    VALUE_ENTRY(can3txdrop,    "dig",               2120 ) \
+    VALUE_ENTRY(can1rxfps,     "Hz",                2121 ) \
+    VALUE_ENTRY(can1txfps,     "Hz",                2122 ) \
+    VALUE_ENTRY(can1bps,       "B/s",               2123 ) \
+    VALUE_ENTRY(can1load,      "%",                 2124 ) \
+    VALUE_ENTRY(can1tec,       "dig",               2125 ) \
+    VALUE_ENTRY(can1rec,       "dig",               2126 ) \
+    VALUE_ENTRY(can1boff,      "dig",               2127 ) \
+    VALUE_ENTRY(can2rxfps,     "Hz",                2128 ) \
+    VALUE_ENTRY(can2txfps,     "Hz",                2129 ) \
+    VALUE_ENTRY(can2bps,       "B/s",               2130 ) \
+    VALUE_ENTRY(can2load,      "%",                 2131 ) \
+    VALUE_ENTRY(can2tec,       "dig",               2132 ) \
+    VALUE_ENTRY(can2rec,       "dig",               2133 ) \
+    VALUE_ENTRY(can2boff,      "dig",               2134 ) \
+    VALUE_ENTRY(can3rxfps,     "Hz",                2135 ) \
+    VALUE_ENTRY(can3txfps,     "Hz",                2136 ) \
+    VALUE_ENTRY(can3bps,       "B/s",               2137 ) \
+    VALUE_ENTRY(can3load,      "%",                 2138 ) \
+    VALUE_ENTRY(can3tec,       "dig",               2139 ) \
+    VALUE_ENTRY(can3rec,       "dig",               2140 ) \
+    VALUE_ENTRY(can3boff,      "dig",               2141 ) \
+    VALUE_ENTRY(can1txslot,    "dig",               2142 ) \
+    VALUE_ENTRY(can2txslot,    "dig",               2143 ) \
+    VALUE_ENTRY(txslotmax,     "dig",               2144 ) \
+    VALUE_ENTRY(can1fbanks,    "dig",               2145 ) \
+    VALUE_ENTRY(can1ffa,       "%",                 2146 ) \
+    VALUE_ENTRY(can2fbanks,    "dig",               2147 ) \
+    VALUE_ENTRY(can2ffa,       "%",                 2148 ) \
+    VALUE_ENTRY(rxworstid,     "dig",               2149 ) \
+    VALUE_ENTRY(rxworstage,    "ms",                2150 ) \
+    VALUE_ENTRY(rxmissed,      "dig",               2151 ) \
+    VALUE_ENTRY(rxlatency,     "ms",                2152 ) \
+    VALUE_ENTRY(htmrate,       "Hz",                2153 ) \
+    VALUE_ENTRY(mthcserr,      "%",                 2154 ) \
+    VALUE_ENTRY(shifts,        "",                  2155 ) \
+    VALUE_ENTRY(shiftms,       "ms",                2156 ) \
+    VALUE_ENTRY(rxresponse,    "ms",                2157 ) \
+
+//Next value Id: 2158
 
 
 
@@ -250,6 +319,7 @@
 #define CCS_STATUS   "0=NotRdy, 1=ready, 2=SWoff, 3=interruption, 4=Prech, 5=insulmon, 6=estop, 7=malfunction, 15=invalid"
 #define DIRS         "-1=Reverse, 0=Neutral, 1=Drive, 2=Park"
 #define ONOFF        "0=Off, 1=On, 2=na"
+#define OUTLRATES    "0=10ms, 1=20ms, 2=50ms"
 #define LOWHIGH      "0=LOW, 1=HIGH, 2=AUTO"
 #define OKERR        "0=Error, 1=Ok, 2=na"
 #define CANSPEEDS    "0=125k, 1=250k, 2=500k, 3=800k, 4=1M"
@@ -265,6 +335,7 @@
 #define CHGINT       "0=Unused, 1=i3LIM, 2=Chademo, 3=CPC"
 #define CAN3Spd      "0=k33.3, 1=k500. 2=k100"
 #define TRNMODES     "0=Manual, 1=Auto"
+#define SCHEDMODES   "0=Sync, 1=Staggered, 2=Compare"
 #define CAN_DEV      "0=CAN1, 1=CAN2"
 #define CAT_THROTTLE "Throttle"
 #define CAT_POWER    "Power Limit"
@@ -282,6 +353,7 @@
 #define CAT_SHUNT    "ISA Shunt Control"
 #define CAT_IOPINS   "General Purpose I/O"
 #define CAT_PWM      "PWM Control"
+#define CAT_SCHED    "Task Scheduler"
 #define MotorsAct    "0=Mg1and2, 1=Mg1, 2=Mg2"
 
 #define CAN_PERIOD_100MS    0
@@ -384,6 +456,13 @@ enum ShifterModes
 
 };
 
+enum SchedModes
+{
+    SCHED_SYNC = 0,
+    SCHED_STAGGERED = 1,
+    SCHED_COMPARE = 2
+};
+
 enum ChargeControl
 {
     Enable = 0,
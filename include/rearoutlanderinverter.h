@@ -21,6 +21,7 @@
 #define REAROUTLANDERINVERTER_H
 
 #include <inverter.h>
+#include "canfreshness.h"
 
 class RearOutlanderInverter : public Inverter
 {
@@ -46,6 +47,8 @@ private:
    int16_t motor_temp;
    bool error;
    uint32_t final_torque_request;
+   uint32_t torqueFrame[2]; //0x287 as built by SetTorque()
+   CanResponse response;    //torque step to speed change
    static float temp_1, temp_2;
 
    static void handle289(uint32_t data[2]);
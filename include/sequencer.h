@@ -0,0 +1,60 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include <stdint.h>
+
+/* Runs multi-step command sequences such as sensor configuration or bus
+ * wakeups without busy waiting. A sequence is a step function that is called
+ * with the step number 0, 1, 2... and returns the number of milliseconds to
+ * wait before the next step, or Sequencer::DONE after the last one. Run() is
+ * called from Ms1Task and executes at most one step of every sequence, so the
+ * scheduler is never blocked for longer than a single step takes.
+ *
+ * The context pointer is handed to the step function and the completion
+ * callback unchanged, drivers pass "this" or the CAN interface.
+ */
+class Sequencer
+{
+public:
+   static const int DONE = -1;
+   static const int MAX_SEQUENCES = 4;
+
+   typedef int (*StepFunction)(void* context, int step);
+   typedef void (*DoneCallback)(void* context);
+
+   static bool Start(StepFunction stepFunction, void* context = 0, DoneCallback done = 0);
+   static bool IsRunning(StepFunction stepFunction, void* context = 0);
+   static void Cancel(StepFunction stepFunction, void* context = 0);
+   static void Run();
+
+private:
+   struct Sequence
+   {
+      StepFunction stepFunction;
+      DoneCallback done;
+      void* context;
+      int step;
+      uint32_t waitMs;
+      volatile bool active;
+   };
+
+   static Sequence sequences[MAX_SEQUENCES];
+};
+
+#endif // SEQUENCER_H
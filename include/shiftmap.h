@@ -0,0 +1,45 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SHIFTMAP_H
+#define SHIFTMAP_H
+
+#include <stdint.h>
+
+/* Automatic shift map of the two speed GS450H transmission. The upshift
+ * speed is interpolated between a no load and a full load setting, the
+ * downshift speed lies a hysteresis band below it. Configure() works both
+ * out for every load step once, when the parameters change, so Select()
+ * only indexes a table and compares.
+ */
+class ShiftMap
+{
+public:
+   static const int LOAD_STEPS = 11; //0, 10 .. 100% load
+   enum gears { LOW = 0, HIGH = 1 };
+
+   static void Configure(int upNoLoad, int upFullLoad, int hysteresis);
+   //Gear for the current motor speed and load, negative load counts as none
+   static uint8_t Select(uint8_t gear, int speed, int loadPercent);
+   static int GetUpshift(int step) { return upshift[step]; }
+   static int GetDownshift(int step) { return downshift[step]; }
+
+private:
+   static int16_t upshift[LOAD_STEPS];
+   static int16_t downshift[LOAD_STEPS];
+};
+
+#endif // SHIFTMAP_H
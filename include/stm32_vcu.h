@@ -47,11 +47,12 @@
 #include "outlanderinverter.h"
 #include "Can_VAG.h"
 #include "GS450H.h"
-#include "throttle.h"
+#include "throttlefp.h"
 #include "utils.h"
 #include "teslaCharger.h"
 #include "i3LIM.h"
 #include "CANSPI.h"
+#include "MCP2515.h"
 #include "chademo.h"
 #include "heater.h"
 #include "amperaheater.h"
@@ -90,6 +91,18 @@
 #include "ElconCharger.h"
 #include "rearoutlanderinverter.h"
 #include "NoVehicle.h"
+#include "candispatch.h"
+#include "canrxring.h"
+#include "taskprofiler.h"
+#include "driverslot.h"
+#include "hotparams.h"
+#include "sequencer.h"
+#include "canstats.h"
+#include "cantxscheduler.h"
+#include "canfilteropt.h"
+#include "cantrace.h"
+#include "canfreshness.h"
+#include "shiftmap.h"
 
 #define PRECHARGE_TIMEOUT 5  //5s
 
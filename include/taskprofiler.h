@@ -0,0 +1,79 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TASKPROFILER_H
+#define TASKPROFILER_H
+
+#include <stdint.h>
+
+/* Execution time statistics of the scheduler tasks and of the driver calls
+ * made from them. Times are taken from the DWT cycle counter on target and
+ * from a monotonic clock in host builds.
+ */
+class TaskProfiler
+{
+public:
+   enum sections
+   {
+      MS1, MS10, MS100, MS200,
+      CANRX, THROTTLE, CANMAP,
+      INV_1MS, INV_10MS, INV_100MS, INV_TORQUE,
+      VEH_1MS, VEH_10MS, VEH_100MS, VEH_200MS,
+      CHG_1MS, CHG_10MS, CHG_100MS, CHG_200MS,
+      CHGINT_1MS, CHGINT_10MS, CHGINT_100MS, CHGINT_200MS,
+      BMS_100MS,
+      DCDC_1MS, DCDC_10MS, DCDC_100MS,
+      SHIFT_1MS, SHIFT_10MS, SHIFT_100MS,
+      SEQ_STEP, CANTX,
+      LAST
+   };
+
+   struct Stats
+   {
+      uint32_t min;
+      uint32_t max;
+      uint32_t last;
+      uint32_t count;
+      uint32_t overruns;
+      uint64_t sum;
+   };
+
+   static void Init();
+   static void Reset();
+   static uint32_t GetTicks();
+   static uint32_t Start() { return GetTicks(); }
+   static void Stop(sections s, uint32_t start);
+   static const Stats& GetStats(sections s) { return stats[s]; }
+   static const char* GetName(sections s) { return names[s]; }
+   static uint32_t ToMicroseconds(uint32_t ticks);
+   static uint32_t GetMeanUs(sections s);
+   static uint32_t GetTotalOverruns();
+
+private:
+   static Stats stats[LAST];
+   static const char* const names[LAST];
+   static const uint16_t budgetMs[LAST];
+};
+
+//Measure a single statement, e.g. PROFILE(INV_10MS, selectedInverter->Task10Ms());
+#define PROFILE(section, call) \
+   do { \
+      uint32_t _profStart = TaskProfiler::Start(); \
+      call; \
+      TaskProfiler::Stop(TaskProfiler::section, _profStart); \
+   } while (0)
+
+#endif // TASKPROFILER_H
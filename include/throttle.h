@@ -55,6 +55,7 @@ public:
     static float idleThrotLim;
     static float regenRamp;
     static float throttleRamp;
+    static float throttleRampMax;
     static int bmslimhigh;
     static int bmslimlow;
     static int accelmax;
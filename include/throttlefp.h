@@ -0,0 +1,109 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THROTTLEFP_H
+#define THROTTLEFP_H
+
+#include <stdint.h>
+#include "my_fp.h"
+#include "throttle.h"
+
+/* Throttle values in fixed point with 16 fractional bits. s32fp only has 5,
+ * that is too coarse for ramp rates of 0.1%/10ms. The range of +-32767 covers
+ * percentages, voltages, currents and rpm, products are done in 64 bit which
+ * is a single SMULL on the Cortex-M3. Conversion to int truncates towards
+ * zero like the float to int conversion does.
+ */
+#define THR_FRAC            16
+typedef int32_t thrfp;
+
+#define THR_FROMINT(a)      ((thrfp)((a) * (1 << THR_FRAC)))
+#define THR_FROMFLT(a)      ((thrfp)((a) * (1 << THR_FRAC)))
+#define THR_FROMFP(a)       ((thrfp)((a) * (1 << (THR_FRAC - FRAC_DIGITS))))
+#define THR_TOINT(a)        ((a) / (1 << THR_FRAC))
+#define THR_TOFP(a)         ((s32fp)((a) / (1 << (THR_FRAC - FRAC_DIGITS))))
+#define THR_TOFLOAT(a)      ((float)(a) / (1 << THR_FRAC))
+#define THR_MUL(a, b)       ((thrfp)(((int64_t)(a) * (b)) >> THR_FRAC))
+#define THR_DIV(a, b)       ((thrfp)(((int64_t)(a) << THR_FRAC) / (b)))
+
+/* Fixed point version of Throttle for the soft-float Cortex-M3, built with
+ * make THROTTLE_FIXED=1. Same functions and parameters as Throttle, the pedal
+ * calibration Throttle::potmin/potmax is shared. Results stay within one step
+ * of the float version's 0.1% output quantisation, see test_throttle.cpp.
+ */
+class ThrottleFP
+{
+public:
+    static bool CheckAndLimitRange(int* potval, int potIdx) { return Throttle::CheckAndLimitRange(potval, potIdx); }
+    static thrfp NormalizeThrottle(int potval, int potIdx);
+    static thrfp CalcThrottle(int potval, int potIdx, bool brkpedal);
+    static thrfp CalcIdleSpeed(int speed);
+    static thrfp CalcCruiseSpeed(int speed);
+    static bool TemperatureDerate(thrfp tmp, thrfp tmpMax, thrfp& finalSpnt);
+    static void UdcLimitCommand(thrfp& finalSpnt, thrfp udc);
+    static void IdcLimitCommand(thrfp& finalSpnt, thrfp idc);
+    static void SpeedLimitCommand(thrfp& finalSpnt, int speed);
+    static thrfp RampThrottle(thrfp finalSpnt);
+    static thrfp regenRpm;
+    static thrfp regenmax;
+    static thrfp regenBrake;
+    static thrfp brkcruise;
+    static thrfp throtmax;
+    static thrfp throtmaxRev;
+    static thrfp throtmin;
+    static thrfp throtdead;
+    static int idleSpeed;
+    static int cruiseSpeed;
+    static thrfp speedkp;
+    static int speedflt;
+    static thrfp idleThrotLim;
+    static thrfp regenRamp;
+    static thrfp throttleRamp;
+    static thrfp throttleRampMax;
+    static thrfp udcmin;
+    static thrfp udcmax;
+    static thrfp idcmin;
+    static thrfp idcmax;
+    static int speedLimit;
+    static thrfp regenendRpm;
+    static thrfp ThrotRpmFilt;
+
+private:
+    static int speedFiltered;
+    static thrfp AveragePos(thrfp Pos);
+};
+
+//Pipeline run by utils::ProcessThrottle and its parameter conversion
+#ifdef THROTTLE_FIXED
+typedef ThrottleFP ThrottleCalc;
+typedef thrfp throtval;
+#define THROTVAL(a)         THR_FROMFLT(a)
+#define THROTPARAM(p)       THR_FROMFP(Param::Get(p))
+#define THROTFP(v)          THR_FROMFP(v)
+#define THROTSETPARAM(p, v) Param::SetFixed(p, THR_TOFP(v))
+#define THROTFLOAT(v)       THR_TOFLOAT(v)
+#else
+typedef Throttle ThrottleCalc;
+typedef float throtval;
+#define THROTVAL(a)         ((float)(a))
+#define THROTPARAM(p)       Param::GetFloat(p)
+#define THROTFP(v)          FP_TOFLOAT(v)
+#define THROTSETPARAM(p, v) Param::SetFloat(p, v)
+#define THROTFLOAT(v)       (v)
+#endif
+
+#endif // THROTTLEFP_H
@@ -20,7 +20,6 @@
 namespace utils
 {
     int32_t change(int32_t, int32_t, int32_t, int32_t, int32_t);
-    float GetUserThrottleCommand(CanHardware*);
     float ProcessThrottle(int);
     float ProcessUdc(int);
     void CalcSOC();
@@ -14,6 +14,7 @@
  */
 
 #include "BMW_E31.h"         // 包含 BMW_E31 类的声明
+#include "candispatch.h"
 #include "hwinit.h"          // 硬件初始化相关
 #include <libopencm3/stm32/timer.h> // STM32 定时器相关函数
 #include <libopencm3/stm32/gpio.h>  // STM32 GPIO 相关函数
@@ -36,7 +37,7 @@ void BMW_E31::SetCanInterface(CanHardware* c)
     // 注意：这会导致 E31 与 GS450H 不能同时使用此功能
     timerIsRunning = false;    // 定时器状态标记，初始未启动
 
-    can->RegisterUserMessage(0x153); // 注册 CAN ID 0x153 的消息（ASC消息），待确认具体含义
+    CanDispatch::RegisterUserMessage(can, 0x153); // 注册 CAN ID 0x153 的消息（ASC消息），待确认具体含义
 }
 
 // 设置转速表的转速值，单位是转/分（RPM）
@@ -17,9 +17,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "BMW_E39.h"
+#include "candispatch.h"
 #include "stm32_can.h"
 #include "utils.h"
 #include "digio.h"
+#include "cantxscheduler.h"
 
 static uint8_t counter_329 = 0;
 static uint8_t ABSMsg = 0;
@@ -28,20 +30,6 @@ static uint16_t tempValue = 0;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void BMW_E39::Task10Ms()
-{
-    if(SendCAN == true)
-    {
-        Msg316();
-        Msg329();
-        Msg545();
-        Msg43B();
-
-        if (Param::GetBool(Param::Transmission))
-            Msg43F(Param::GetInt(Param::dir));
-    }
-}
-
 void BMW_E39::Task100Ms()
 {
     if(AbsCANalive == true || DigIo::t15_digi.Get())//check if 100ms if ABS can frame 0x1F3 has been recieved to say CAN is on
@@ -59,8 +47,51 @@ void BMW_E39::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x153);//E39/E46 ASC1 message
-    can->RegisterUserMessage(0x1F3);//E39/E46 ASC3 message
+    CanDispatch::RegisterUserMessage(can, 0x153);//E39/E46 ASC1 message
+    CanDispatch::RegisterUserMessage(can, 0x1F3);//E39/E46 ASC3 message
+
+    //10ms frames, sent by CanTxScheduler while the ABS is alive
+    CanTxScheduler::Register(can, 0x316, 8, 10, Fill316, this);
+    CanTxScheduler::Register(can, 0x329, 8, 10, Fill329, this);
+    CanTxScheduler::Register(can, 0x545, 8, 10, Fill545, this);
+    CanTxScheduler::Register(can, 0x43B, 3, 10, Fill43B, this);
+    CanTxScheduler::Register(can, 0x43F, 8, 10, Fill43F, this);
+}
+
+bool BMW_E39::Fill316(void* context, uint8_t* bytes)
+{
+    BMW_E39* e39 = (BMW_E39*)context;
+    if (!e39->SendCAN) return false;
+    e39->Msg316(bytes);
+    return true;
+}
+
+bool BMW_E39::Fill329(void* context, uint8_t* bytes)
+{
+    if (!((BMW_E39*)context)->SendCAN) return false;
+    Msg329(bytes);
+    return true;
+}
+
+bool BMW_E39::Fill545(void* context, uint8_t* bytes)
+{
+    if (!((BMW_E39*)context)->SendCAN) return false;
+    Msg545(bytes);
+    return true;
+}
+
+bool BMW_E39::Fill43B(void* context, uint8_t* bytes)
+{
+    if (!((BMW_E39*)context)->SendCAN) return false;
+    Msg43B(bytes);
+    return true;
+}
+
+bool BMW_E39::Fill43F(void* context, uint8_t* bytes)
+{
+    if (!((BMW_E39*)context)->SendCAN || !Param::GetBool(Param::Transmission)) return false;
+    Msg43F(bytes, Param::GetInt(Param::dir));
+    return true;
 }
 
 void BMW_E39::SetTemperatureGauge(float temp)
@@ -81,7 +112,7 @@ bool BMW_E39::Start()
 //Based on an MS43 DME
 
 //////////////////////DME Messages //////////////////////////////////////////////////////////
-void BMW_E39::Msg316()  //DME1
+void BMW_E39::Msg316(uint8_t* bytes)  //DME1
 {
     uint16_t speed_input = speed;
     // Limit tachometer range from 750 RPMs - 7000 RPMs at max.
@@ -117,9 +148,6 @@ void BMW_E39::Msg316()  //DME1
     uint8_t canRPMlo = ((speed_input * rpm_to_can_mult) / rpm_to_can_div) & 0xFF;
     uint8_t canRPMhi = ((speed_input * rpm_to_can_mult) / rpm_to_can_div) >> 8;
 
-    // Declare data frame array.
-    uint8_t bytes[8];
-
     // Byte 0 - Status - 0x01 is Terminal 15 Status, 0x04 is Traction Control OK
     bytes[0]=0x05;
     // Byte 1 - Torque with all interventions
@@ -136,13 +164,12 @@ void BMW_E39::Msg316()  //DME1
     // Byte 7 - Torque with internal interventions only
     bytes[7]=0x00;
 
-    can->Send(0x316, bytes, 8); //Send on CAN2
 }
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void BMW_E39::Msg329()   //DME2
+void BMW_E39::Msg329(uint8_t* bytes)   //DME2
 {
     //********************temp sense  *******************************
     //  tempValue=analogRead(tempIN); //read Analog pin voltage
@@ -198,9 +225,6 @@ void BMW_E39::Msg329()   //DME2
 //Byte 7 - unused
 
 
-    // Declare data frame array.
-    uint8_t bytes[8];
-
     // Byte 0 - Bits 6-7 Multiplexer ID, Bits 0-5 Data
     bytes[0]=ABSMsg;  //needs to cycle 11,86,d9
     // Byte 1 - Coolant Temperature
@@ -227,23 +251,16 @@ void BMW_E39::Msg329()   //DME2
     if(counter_329==0) ABSMsg=0x11;
     if(counter_329==8) ABSMsg=0x86;
     if(counter_329==15) ABSMsg=0xd9;
-
-    can->Send(0x329, bytes, 8); //Send on CAN2
 }
 
-void BMW_E39::Msg43B()  //EGS1
+void BMW_E39::Msg43B(uint8_t* bytes)  //EGS1
 {
-
-    uint8_t bytes[3];
-
     bytes[0]=0x46;
     bytes[1]=0x00;
     bytes[2]=0x00;
-
-    can->Send(0x43B, (uint32_t*)bytes,3);
 }
 
-void BMW_E39::Msg545()  //DME4
+void BMW_E39::Msg545(uint8_t* bytes)  //DME4
 {
     // int z = 0x60; // + y;  higher value lower MPG
 
@@ -287,8 +304,6 @@ void BMW_E39::Msg545()  //DME4
     Consumption++;  //just inc this as a test
     //MSG 0x545
     //Can bus data packet values to be sent
-    uint8_t bytes[8];
-
     // Byte 0 - 2 Check Engine, 8 Cruise Enabled , 0x10 EML, 0x40 Gas Cap
     bytes[0]=0x00;
     // Byte 1 - Fuel consumption LSB
@@ -305,14 +320,11 @@ void BMW_E39::Msg545()  //DME4
     bytes[6]=0x00;
     // Byte 7 - 0x80 Oil Pressure (Red Oil light), Idle set speed
     bytes[7]=0x18;
-
-    can->Send(0x545, bytes, 8); //Send on CAN2
 }
 
-void BMW_E39::Msg43F(int8_t gear)
+void BMW_E39::Msg43F(uint8_t* bytes, int8_t gear)
 {
     //Can bus data packet values to be sent
-    uint8_t bytes[8];
     // Source: https://www.bimmerforums.com/forum/showthread.php?1887229-E46-Can-bus-project&p=30055342#post30055342
     // byte 0 = 0x81 //doesn't do anything to the ike
     bytes[0] = 0x81;
@@ -365,8 +377,6 @@ void BMW_E39::Msg43F(int8_t gear)
 
     // byte 7 = 0x00 //doesn't do anything to the ike
     bytes[7] = 0xFF;
-
-    can->Send(0x43F, bytes, 8);
 }
 
 void BMW_E39::DecodeCAN(int id, uint32_t* data)
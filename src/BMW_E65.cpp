@@ -1,4 +1,5 @@
 #include <BMW_E65.h>
+#include "candispatch.h"
 #include "stm32_can.h"
 #include "params.h"
 
@@ -21,9 +22,9 @@ void BMW_E65::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x130);//E65 CAS
-    can->RegisterUserMessage(0x192);//E65 Shifter
-    can->RegisterUserMessage(0x480);//Network Management
+    CanDispatch::RegisterUserMessage(can, 0x130);//E65 CAS
+    CanDispatch::RegisterUserMessage(can, 0x192);//E65 Shifter
+    CanDispatch::RegisterUserMessage(can, 0x480);//Network Management
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////Handle incomming pt can messages from the car here
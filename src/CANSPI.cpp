@@ -24,6 +24,9 @@
 #include "CANSPI.h"
 #include "MCP2515.h"
 #include "params.h"
+#include "canstats.h"
+#include "cantrace.h"
+#include <string.h>
 
 /**
     Local Function Prototypes
@@ -32,6 +35,15 @@ uint32_t convertReg2ExtendedCANid(uint8_t tempRXBn_EIDH, uint8_t tempRXBn_EIDL,
 uint32_t convertReg2StandardCANid(uint8_t tempRXBn_SIDH, uint8_t tempRXBn_SIDL) ;
 void convertCANid2Reg(uint32_t tempPassedInID, uint8_t canIdType, id_reg_t *passedIdReg);
 
+static void convertRxReg2Msg(const uint8_t *rxReg, uCAN_MSG *tempCanMsg);
+static void txRefill(void);
+static void txDone(const uint8_t *rxData, void *context);
+static void irqStatusRead(const uint8_t *rxData, void *context);
+static void rxBufferRead(const uint8_t *rxData, void *context);
+static void eflgRead(const uint8_t *rxData, void *context);
+static void errorCountersRead(const uint8_t *rxData, void *context);
+static void errorFlagsRead(const uint8_t *rxData, void *context);
+
 /**
     Local Variables
 */
@@ -39,20 +51,49 @@ ctrl_status_t ctrlStatus;
 ctrl_error_status_t errorStatus;
 id_reg_t idReg;
 
+#define TX_QUEUE_SIZE 16
+#define TX_BUFFERS    3
+
+//Frame waiting in software, already converted to the TXBnSIDH..TXBnD7 layout
+typedef struct {
+   uint32_t priority; //arbitration order, lower wins
+   uint32_t seq;      //keeps frames of equal priority in order
+   uint32_t id;
+   uint8_t idReg[4];
+   uint8_t dlc;
+   uint8_t data[8];
+   bool used;
+} tx_entry_t;
+
+static tx_entry_t txQueue[TX_QUEUE_SIZE];
+static uint32_t txQueued = 0;
+static uint32_t txSeq = 0;
+static uint8_t txBusy = 0;                   //TX buffers loaded and not yet reported done by TXnIF
+static uint32_t txBufferPriority[TX_BUFFERS]; //priority of the frame in each busy buffer
+static uint32_t txBufferSeq[TX_BUFFERS];
+static uint8_t txBufferTxp[TX_BUFFERS];
+static uint32_t txDrops = 0;
+static uint32_t txHighWater = 0;
+static CANSPI_RxHandler rxHandler = 0;
+static volatile bool rxRestart = false;
+static uint32_t rxOverflows = 0;
+static uint8_t errorCounters[2]; //TEC, REC
+static bool busOff = false;
+
 /**
  CAN SPI APIs
 */
 
 void CANSPI_ENRx_IRQ(void)
 {
-   MCP2515_Bit_Modify(MCP2515_CANINTF, 0x43, 0x00);        //clear irqs
-   MCP2515_Bit_Modify(MCP2515_CANINTE, 0x43, 0x43);        //Enable Receive and wake interrupts
+   MCP2515_Bit_Modify(MCP2515_CANINTF, 0x5F, 0x00);        //clear irqs
+   MCP2515_Bit_Modify(MCP2515_CANINTE, 0x5F, 0x5F);        //Enable Receive, transmit and wake interrupts
 
 }
 //test
 void CANSPI_CLR_IRQ(void)
 {
-   MCP2515_Bit_Modify(MCP2515_CANINTF, 0x43, 0x00);        //clear irqs
+   MCP2515_Bit_Modify(MCP2515_CANINTF, 0x5F, 0x00);        //clear irqs
 
 }
 
@@ -127,6 +168,12 @@ void CANSPI_Initialize(void)
    RXF5reg.RXF5EID8 = 0x00;
    RXF5reg.RXF5EID0 = 0x00;
 
+   //Start over with an empty software TX queue
+   for (uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+      txQueue[i].used = false;
+   txQueued = 0;
+   txBusy = 0;
+
    MCP2515_Initialize();
    MCP2515_SetTo_ConfigMode();
 
@@ -146,6 +193,7 @@ if(Param::GetInt(Param::CAN3Speed)==1)
       MCP2515_Write_Byte(MCP2515_CNF1, 0x40);//500kbps at 16HMz xtal.
       MCP2515_Write_Byte(MCP2515_CNF2, 0xe5);
       MCP2515_Write_Byte(MCP2515_CNF3, 0x83);
+      CanStats::SetBitrate(CanStats::BUS_CAN3, 500000);
 }
 
 if(Param::GetInt(Param::CAN3Speed)==2)
@@ -153,6 +201,7 @@ if(Param::GetInt(Param::CAN3Speed)==2)
    MCP2515_Write_Byte(MCP2515_CNF1, 0x03);//100kbps at 16HMz xtal.
    MCP2515_Write_Byte(MCP2515_CNF2, 0xFA);
    MCP2515_Write_Byte(MCP2515_CNF3, 0x87);
+   CanStats::SetBitrate(CanStats::BUS_CAN3, 100000);
 }
 
 if(Param::GetInt(Param::CAN3Speed)==0)
@@ -160,52 +209,285 @@ if(Param::GetInt(Param::CAN3Speed)==0)
    MCP2515_Write_Byte(MCP2515_CNF1, 0x4E);//33kbps at 16HMz xtal.
    MCP2515_Write_Byte(MCP2515_CNF2, 0xe5);
    MCP2515_Write_Byte(MCP2515_CNF3, 0x83);
+   CanStats::SetBitrate(CanStats::BUS_CAN3, 33333);
 }
 
 
    MCP2515_SetTo_NormalMode();
 }
 
+//True if frame a goes out before frame b
+static bool Before(uint32_t prioA, uint32_t seqA, uint32_t prioB, uint32_t seqB)
+{
+   return prioA < prioB || (prioA == prioB && (int32_t)(seqA - seqB) < 0);
+}
+
+/* Queue a frame for transmission. Frames wait in a software queue ordered by
+ * CAN arbitration priority and are moved into the three TX buffers as these
+ * become free, which is reported by the TXnIF interrupts. When the queue is
+ * full the frame with the lowest priority is dropped, which may be this one.
+ */
 uint8_t CANSPI_Transmit(uCAN_MSG *tempCanMsg)
 {
-   uint8_t returnValue = 0;
+   id_reg_t reg;
+   uint32_t id = tempCanMsg->frame.id;
+   uint32_t priority;
+   tx_entry_t *entry = 0;
+
+   //Standard frames win against extended ones with the same 11 bit base ID
+   if (tempCanMsg->frame.idType == dEXTENDED_CAN_MSG_ID_2_0B)
+      priority = ((id >> 18) << 19) | (1 << 18) | (id & 0x3FFFF);
+   else
+      priority = (id & 0x7FF) << 19;
 
-   idReg.tempSIDH = 0;
-   idReg.tempSIDL = 0;
-   idReg.tempEID8 = 0;
-   idReg.tempEID0 = 0;
+   convertCANid2Reg(id, tempCanMsg->frame.idType, &reg);
 
-   ctrlStatus.ctrl_status = MCP2515_Read_Status();
+   uint32_t mask = MCP2515_EnterCritical();
 
-   if (ctrlStatus.ctrl.TXB0REQ ==0)
+   for (uint32_t i = 0; i < TX_QUEUE_SIZE && entry == 0; i++)
    {
-      convertCANid2Reg(tempCanMsg->frame.id, tempCanMsg->frame.idType, &idReg);
+      if (!txQueue[i].used) entry = &txQueue[i];
+   }
 
-      MCP2515_Load_TxSequence(MCP2515_LOAD_TXB0SIDH, &(idReg.tempSIDH), tempCanMsg->frame.dlc, &(tempCanMsg->frame.data0));
-      MCP2515_RequestToSend(MCP2515_RTS_TX0);
+   if (entry == 0)
+   {
+      tx_entry_t *lowest = &txQueue[0];
 
-      returnValue = 1;
+      for (uint32_t i = 1; i < TX_QUEUE_SIZE; i++)
+      {
+         if (txQueue[i].priority >= lowest->priority) lowest = &txQueue[i];
+      }
+
+      txDrops++;
+      if (priority >= lowest->priority)
+      {
+         MCP2515_LeaveCritical(mask);
+         return 0;
+      }
+      entry = lowest;
+      txQueued--;
    }
-   else if (ctrlStatus.ctrl.TXB1REQ ==0)
+
+   entry->priority = priority;
+   entry->seq = txSeq++;
+   entry->id = id;
+   entry->idReg[0] = reg.tempSIDH;
+   entry->idReg[1] = reg.tempSIDL;
+   entry->idReg[2] = reg.tempEID8;
+   entry->idReg[3] = reg.tempEID0;
+   entry->dlc = tempCanMsg->frame.dlc;
+   for (uint8_t i = 0; i < 8; i++)
+      entry->data[i] = (&tempCanMsg->frame.data0)[i];
+   entry->used = true;
+   txQueued++;
+   if (txQueued > txHighWater) txHighWater = txQueued;
+
+   txRefill();
+   MCP2515_LeaveCritical(mask);
+   return 1;
+}
+
+/* Moves queued frames into free TX buffers, highest priority first. The TXP
+ * bits of all loaded buffers are then set according to the rank of their
+ * frame, so the controller also sends them in ID order. A buffer whose rank
+ * did not change keeps its TXP and is not touched.
+ * Must be called with interrupts masked.
+ */
+static void txRefill(void)
+{
+   static const uint8_t ctrlReg[TX_BUFFERS] = { MCP2515_TXB0CTRL, MCP2515_TXB1CTRL, MCP2515_TXB2CTRL };
+   static const uint8_t loadInst[TX_BUFFERS] = { MCP2515_LOAD_TXB0SIDH, MCP2515_LOAD_TXB1SIDH, MCP2515_LOAD_TXB2SIDH };
+   static const uint8_t rtsInst[TX_BUFFERS] = { MCP2515_RTS_TX0, MCP2515_RTS_TX1, MCP2515_RTS_TX2 };
+
+   for (uint32_t n = 0; n < TX_BUFFERS && txQueued > 0; n++)
    {
-      convertCANid2Reg(tempCanMsg->frame.id, tempCanMsg->frame.idType, &idReg);
+      if (txBusy & (1 << n)) continue;
+      //Load, RTS and up to three TXP updates. Otherwise try again on the next TXnIF or transmit call
+      if (MCP2515_Get_QueueSpace() < 2 + TX_BUFFERS) return;
 
-      MCP2515_Load_TxSequence(MCP2515_LOAD_TXB1SIDH, &(idReg.tempSIDH), tempCanMsg->frame.dlc, &(tempCanMsg->frame.data0));
-      MCP2515_RequestToSend(MCP2515_RTS_TX1);
+      tx_entry_t *next = 0;
 
-      returnValue = 1;
+      for (uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+      {
+         tx_entry_t *e = &txQueue[i];
+
+         if (e->used && (next == 0 || Before(e->priority, e->seq, next->priority, next->seq)))
+            next = e;
+      }
+
+      txBusy |= 1 << n;
+      txBufferPriority[n] = next->priority;
+      txBufferSeq[n] = next->seq;
+
+      for (uint32_t b = 0; b < TX_BUFFERS; b++)
+      {
+         if (!(txBusy & (1 << b))) continue;
+
+         uint8_t txp = 3;
+         for (uint32_t o = 0; o < TX_BUFFERS; o++)
+         {
+            if ((txBusy & (1 << o)) && Before(txBufferPriority[o], txBufferSeq[o], txBufferPriority[b], txBufferSeq[b]))
+               txp--;
+         }
+
+         if (b == n || txp != txBufferTxp[b])
+            MCP2515_Queue_Bit_Modify(ctrlReg[b], 0x03, txp);
+         txBufferTxp[b] = txp;
+      }
+
+      MCP2515_Queue_Load_TxSequence(loadInst[n], next->idReg, next->dlc, next->data);
+      MCP2515_Queue_RequestToSend(rtsInst[n], 0, 0);
+      CanStats::CountTx(CanStats::BUS_CAN3, next->id, next->dlc);
+
+      uint32_t traceData[2];
+      memcpy(traceData, next->data, sizeof(traceData));
+      CanTrace::Record(2, true, next->id, traceData, next->dlc);
+
+      next->used = false;
+      txQueued--;
    }
-   else if (ctrlStatus.ctrl.TXB2REQ ==0)
-   {
-      convertCANid2Reg(tempCanMsg->frame.id, tempCanMsg->frame.idType, &idReg);
+}
 
-      MCP2515_Load_TxSequence(MCP2515_LOAD_TXB2SIDH, &(idReg.tempSIDH), tempCanMsg->frame.dlc, &(tempCanMsg->frame.data0));
-      MCP2515_RequestToSend(MCP2515_RTS_TX2);
+//The TXnIF flags in context have been cleared, the buffers can take new frames
+static void txDone(const uint8_t *rxData, void *context)
+{
+   uint8_t done = (uintptr_t)context;
 
-      returnValue = 1;
+   (void)rxData;
+   uint32_t mask = MCP2515_EnterCritical();
+   txBusy &= ~done;
+   txRefill();
+   MCP2515_LeaveCritical(mask);
+}
+
+uint32_t CANSPI_Get_TxQueued(void)
+{
+   return txQueued;
+}
+
+uint32_t CANSPI_Get_TxHighWater(void)
+{
+   return txHighWater;
+}
+
+uint32_t CANSPI_Get_TxDrops(void)
+{
+   return txDrops;
+}
+
+void CANSPI_SetRxHandler(CANSPI_RxHandler handler)
+{
+   rxHandler = handler;
+}
+
+/* Called from the MCP2515 interrupt. Drains both RX buffers via DMA and hands
+ * every frame to the RX handler from the DMA interrupt, and frees the TX
+ * buffers whose frame has gone out. The status is read again after each pass,
+ * the interrupt line only goes high again (and can produce the next falling
+ * edge) once all flags are cleared.
+ */
+void CANSPI_StartReceive(void)
+{
+   rxRestart = !MCP2515_Queue_Read_Status(MCP2515_READ_STATUS, irqStatusRead, 0);
+}
+
+//Called from Ms1Task, restarts draining if the transaction queue was full when the interrupt came
+void CANSPI_ServiceReceive(void)
+{
+   if (rxRestart) CANSPI_StartReceive();
+}
+
+static void irqStatusRead(const uint8_t *rxData, void *context)
+{
+   uint8_t status = rxData[1];
+   uint8_t txDoneBits = 0;
+   bool queued = true;
+
+   (void)context;
+
+   if (status & MCP2515_STAT_RX0IF)
+      queued &= MCP2515_Queue_Read_RxbSequence(MCP2515_READ_RXB0SIDH, rxBufferRead, 0);
+   if (status & MCP2515_STAT_RX1IF)
+      queued &= MCP2515_Queue_Read_RxbSequence(MCP2515_READ_RXB1SIDH, rxBufferRead, 0);
+
+   if (status & MCP2515_STAT_TX0IF) txDoneBits |= 1;
+   if (status & MCP2515_STAT_TX1IF) txDoneBits |= 2;
+   if (status & MCP2515_STAT_TX2IF) txDoneBits |= 4;
+
+   if (txDoneBits)
+   {
+      //CANINTF has TX0IF..TX2IF at bit 2..4
+      uint8_t clear[4] = { MCP2515_BIT_MOD, MCP2515_CANINTF, (uint8_t)(txDoneBits << 2), 0x00 };
+      queued &= MCP2515_Queue(clear, sizeof(clear), txDone, (void*)(uintptr_t)txDoneBits);
    }
 
-   return (returnValue);
+   if (status & (MCP2515_STAT_RX0IF | MCP2515_STAT_RX1IF | MCP2515_STAT_TX0IF | MCP2515_STAT_TX1IF | MCP2515_STAT_TX2IF))
+   {
+      //Reading a buffer clears its RXnIF, look again for flags that were set meanwhile
+      queued &= MCP2515_Queue_Read_Status(MCP2515_READ_STATUS, irqStatusRead, 0);
+   }
+   else
+   {
+      uint8_t readEflg[3] = { MCP2515_READ, MCP2515_EFLG, 0 };
+      queued &= MCP2515_Queue(readEflg, sizeof(readEflg), eflgRead, 0);
+      queued &= MCP2515_Queue_Bit_Modify(MCP2515_CANINTF, 0x40, 0x00);  //clear wake irq
+   }
+   rxRestart = !queued;
+}
+
+static void rxBufferRead(const uint8_t *rxData, void *context)
+{
+   uCAN_MSG msg;
+
+   (void)context;
+   convertRxReg2Msg(&rxData[1], &msg);
+   if (rxHandler) rxHandler(&msg);
+}
+
+//A frame arrived while the buffer was still full
+static void eflgRead(const uint8_t *rxData, void *context)
+{
+   uint8_t eflg = rxData[2];
+
+   (void)context;
+   if (eflg & 0x40) rxOverflows++; //RX0OVR
+   if (eflg & 0x80) rxOverflows++; //RX1OVR
+   if (eflg & 0xC0) MCP2515_Queue_Bit_Modify(MCP2515_EFLG, 0xC0, 0x00);
+}
+
+uint32_t CANSPI_Get_RxOverflows(void)
+{
+   return rxOverflows;
+}
+
+//Reads TEC, REC and EFLG in the background, the result is available on the next call
+void CANSPI_RequestErrorCounters(void)
+{
+   uint8_t readCounters[4] = { MCP2515_READ, MCP2515_TEC, 0, 0 };
+   uint8_t readEflg[3] = { MCP2515_READ, MCP2515_EFLG, 0 };
+
+   MCP2515_Queue(readCounters, sizeof(readCounters), errorCountersRead, 0);
+   MCP2515_Queue(readEflg, sizeof(readEflg), errorFlagsRead, 0);
+}
+
+void CANSPI_Get_ErrorCounters(uint8_t *tec, uint8_t *rec, bool *isBusOff)
+{
+   *tec = errorCounters[0];
+   *rec = errorCounters[1];
+   *isBusOff = busOff;
+}
+
+static void errorCountersRead(const uint8_t *rxData, void *context)
+{
+   (void)context;
+   errorCounters[0] = rxData[2];
+   errorCounters[1] = rxData[3];
+}
+
+static void errorFlagsRead(const uint8_t *rxData, void *context)
+{
+   (void)context;
+   busOff = (rxData[2] & 0x20) != 0; //TXBO
 }
 
 uint8_t CANSPI_receive(uCAN_MSG *tempCanMsg)
@@ -229,32 +511,44 @@ uint8_t CANSPI_receive(uCAN_MSG *tempCanMsg)
          MCP2515_Read_RxbSequence(MCP2515_READ_RXB1SIDH, sizeof(rxReg.rx_reg_array), rxReg.rx_reg_array);
       }
 
-      if (rxStatus.ctrlRx.msgType == dEXTENDED_CAN_MSG_ID_2_0B)
-      {
-         tempCanMsg->frame.idType = (uint8_t) dEXTENDED_CAN_MSG_ID_2_0B;
-         tempCanMsg->frame.id = convertReg2ExtendedCANid(rxReg.RxReg.RXBnEID8, rxReg.RxReg.RXBnEID0, rxReg.RxReg.RXBnSIDH, rxReg.RxReg.RXBnSIDL);
-      }
-      else
-      {
-         tempCanMsg->frame.idType = (uint8_t) dSTANDARD_CAN_MSG_ID_2_0B;
-         tempCanMsg->frame.id = convertReg2StandardCANid(rxReg.RxReg.RXBnSIDH, rxReg.RxReg.RXBnSIDL);
-      }
-
-      tempCanMsg->frame.dlc   = rxReg.RxReg.RXBnDLC;
-      tempCanMsg->frame.data0 = rxReg.RxReg.RXBnD0;
-      tempCanMsg->frame.data1 = rxReg.RxReg.RXBnD1;
-      tempCanMsg->frame.data2 = rxReg.RxReg.RXBnD2;
-      tempCanMsg->frame.data3 = rxReg.RxReg.RXBnD3;
-      tempCanMsg->frame.data4 = rxReg.RxReg.RXBnD4;
-      tempCanMsg->frame.data5 = rxReg.RxReg.RXBnD5;
-      tempCanMsg->frame.data6 = rxReg.RxReg.RXBnD6;
-      tempCanMsg->frame.data7 = rxReg.RxReg.RXBnD7;
+      convertRxReg2Msg(rxReg.rx_reg_array, tempCanMsg);
 
       returnValue = 1;
    }
    return (returnValue);
 }
 
+//rxReg = the 13 bytes from RXBnSIDH to RXBnD7
+static void convertRxReg2Msg(const uint8_t *rxReg, uCAN_MSG *tempCanMsg)
+{
+   rx_reg_t reg;
+
+   for (uint8_t i = 0; i < sizeof(reg.rx_reg_array); i++)
+      reg.rx_reg_array[i] = rxReg[i];
+
+   //RX STATUS only tells the ID type of RXB0 when both are full, take the IDE bit of the buffer itself
+   if (reg.RxReg.RXBnSIDL & 0x08)
+   {
+      tempCanMsg->frame.idType = (uint8_t) dEXTENDED_CAN_MSG_ID_2_0B;
+      tempCanMsg->frame.id = convertReg2ExtendedCANid(reg.RxReg.RXBnEID8, reg.RxReg.RXBnEID0, reg.RxReg.RXBnSIDH, reg.RxReg.RXBnSIDL);
+   }
+   else
+   {
+      tempCanMsg->frame.idType = (uint8_t) dSTANDARD_CAN_MSG_ID_2_0B;
+      tempCanMsg->frame.id = convertReg2StandardCANid(reg.RxReg.RXBnSIDH, reg.RxReg.RXBnSIDL);
+   }
+
+   tempCanMsg->frame.dlc   = reg.RxReg.RXBnDLC;
+   tempCanMsg->frame.data0 = reg.RxReg.RXBnD0;
+   tempCanMsg->frame.data1 = reg.RxReg.RXBnD1;
+   tempCanMsg->frame.data2 = reg.RxReg.RXBnD2;
+   tempCanMsg->frame.data3 = reg.RxReg.RXBnD3;
+   tempCanMsg->frame.data4 = reg.RxReg.RXBnD4;
+   tempCanMsg->frame.data5 = reg.RxReg.RXBnD5;
+   tempCanMsg->frame.data6 = reg.RxReg.RXBnD6;
+   tempCanMsg->frame.data7 = reg.RxReg.RXBnD7;
+}
+
 uint8_t CANSPI_messagesInBuffer(void)
 {
    uint8_t messageCount = 0;
@@ -1,4 +1,5 @@
 #include <CPC.h>
+#include "candispatch.h"
 static uint8_t ChargePort_IsoStop = 0;
 static uint16_t ChargePort_ACLimit = 0;
 static uint8_t ChargePort_Status = 0;
@@ -29,7 +30,7 @@ void CPCClass::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x357);
+    CanDispatch::RegisterUserMessage(can, 0x357);
 }
 
 void CPCClass::DecodeCAN(int id, uint32_t* data)
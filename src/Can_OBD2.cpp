@@ -18,6 +18,7 @@
  */
 
 #include "Can_OBD2.h"
+#include "candispatch.h"
 #include "stm32_can.h"
 #include "params.h"
 
@@ -39,6 +40,9 @@ dir,dir,0x2a07e8,LOOKUP(SIGNED(D)/32::-1='Reverse':0='Neutral':1='Forward'),-1,1
 tmphs,tmphs,0x2a07ec,((BIT(A:7) * -256*256*256*256) + (A*256*256*256) + (B*256*256) + (C*256) + D)/32,0,100,C,,,,1,0
 tmpm,tmpm,0x2a07ed,((BIT(A:7) * -256*256*256*256) + (A*256*256*256) + (B*256*256) + (C*256) + D)/32,0,100,C,,,,1,0
 idc,idc,0x2a07dc,((BIT(A:7) * -256*256*256*256) + (A*256*256*256) + (B*256*256) + (C*256) + D)/32,-200,200,A,,,,1,0
+can1load,can1load,0x2a084c,((A*256*256*256) + (B*256*256) + (C*256) + D)/32,0,100,%,,,,1,0
+can2load,can2load,0x2a0853,((A*256*256*256) + (B*256*256) + (C*256) + D)/32,0,100,%,,,,1,0
+can3load,can3load,0x2a085a,((A*256*256*256) + (B*256*256) + (C*256) + D)/32,0,100,%,,,,1,0
 
 */
 
@@ -72,7 +76,7 @@ void Can_OBD2::SetCanInterface(CanHardware *c)
 {
   can = c;
 
-   can->RegisterUserMessage(0x7DF);
+   CanDispatch::RegisterUserMessage(can, 0x7DF);
 }
 
 void Can_OBD2::DecodeCAN(int id, uint32_t data[2])
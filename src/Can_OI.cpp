@@ -15,6 +15,9 @@
  */
 
 #include "Can_OI.h"
+#include "candispatch.h"
+#include "canfreshness.h"
+#include "hotparams.h"
 #include "my_fp.h"
 #include "my_math.h"
 #include "stm32_can.h"
@@ -40,10 +43,14 @@ void Can_OI::SetCanInterface(CanHardware* c)
    can = c;
 
    // 注册不同的消息ID，这些消息包含电机转速、电压、温度和工作模式
-   can->RegisterUserMessage(0x190); // 电机转速消息，ID为0x190，解码位400
-   can->RegisterUserMessage(0x19A); // 温度消息，ID为0x19A，解码位410
-   can->RegisterUserMessage(0x1A4); // 电压消息，ID为0x1A4，解码位420
-   can->RegisterUserMessage(0x1AE); // 工作模式消息，ID为0x1AE，解码位430
+   CanDispatch::RegisterUserMessage(can, 0x190); // 电机转速消息，ID为0x190，解码位400
+   CanDispatch::RegisterUserMessage(can, 0x19A); // 温度消息，ID为0x19A，解码位410
+   CanDispatch::RegisterUserMessage(can, 0x1A4); // 电压消息，ID为0x1A4，解码位420
+   CanDispatch::RegisterUserMessage(can, 0x1AE); // 工作模式消息，ID为0x1AE，解码位430
+   //Default canperiod of the OpenInverter firmware
+   CanFreshness::Expect(0x190, 100);
+   CanFreshness::Expect(0x1A4, 100);
+   CanFreshness::LinkCommand(0x190, 0x3F);
 }
 
 // 解码接收到的CAN消息，根据ID解析不同数据
@@ -88,14 +95,14 @@ void Can_OI::SetTorque(float torquePercent)
    Param::SetInt(Param::torque, final_torque_request);
 
    // 读取当前操作模式
-   int opmode = Param::GetInt(Param::opmode);
+   int opmode = HotParams::opmode;
 
    uint8_t tempIO = 0; // 用于存放方向和状态的IO位
 
    // 只有在运行模式下，才发送前进和倒退方向信息
-   if (Param::GetBool(Param::din_forward) && opmode == MOD_RUN) tempIO += 8;
-   if (Param::GetBool(Param::din_reverse) && opmode == MOD_RUN) tempIO += 16;
-   if (Param::GetBool(Param::din_brake)) tempIO += 4;
+   if (HotParams::dinForward && opmode == MOD_RUN) tempIO += 8;
+   if (HotParams::dinReverse && opmode == MOD_RUN) tempIO += 16;
+   if (HotParams::dinBrake) tempIO += 4;
    // if(Param::GetBool(Param::din_start)) tempIO+=2; // 启动信号，暂时注释
 
    // 进入运行模式时，启动信号保持3秒
@@ -116,8 +123,8 @@ void Can_OI::SetTorque(float torquePercent)
    uint32_t pot = Param::GetInt(Param::pot) & 0xFFF;       // 油门信号，占12位
    uint32_t pot2 = Param::GetInt(Param::pot2) & 0xFFF;     // 第二油门信号，占12位
    uint32_t canio = tempIO & 0x3F;                         // IO信号占6位
-   uint32_t ctr = Param::GetInt(Param::canctr) & 0x3;      // 计数器，占2位
-   uint32_t cruise = Param::GetInt(Param::cruisespeed) & 0x3FFF; // 巡航速度，占14位
+   uint32_t ctr = HotParams::canctr & 0x3;      // 计数器，占2位
+   uint32_t cruise = HotParams::cruisespeed & 0x3FFF; // 巡航速度，占14位
    uint32_t regen = 0x00;                                  // 再生制动，目前为0
 
    // 组合数据位，符合CAN协议要求
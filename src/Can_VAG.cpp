@@ -18,8 +18,18 @@
  */
 #include "Can_VAG.h"
 #include "params.h"
+#include "cantxscheduler.h"
 
-void Can_VAG::Task100Ms()
+void Can_VAG::SetCanInterface(CanHardware* c)
+{
+   can = c;
+
+   CanTxScheduler::Register(can, 0x280, 8, 10, Fill280, this);
+   CanTxScheduler::Register(can, 0x288, 8, 10, Fill288, this);
+   CanTxScheduler::Register(can, 0x580, 8, 100, Fill580, this);
+}
+
+bool Can_VAG::Fill580(void*, uint8_t* canData)
 {
    static int seqCtr = 0;
    static uint8_t ctr = 0;
@@ -30,28 +40,35 @@ void Can_VAG::Task100Ms()
    const uint8_t seq4[] = { 0x0c, 0x48, 0xa7, 0x48 };
    const uint8_t seq5[] = { 0x46, 0x90, 0x28, 0x90 };
 
-   uint8_t canData[8] = { (uint8_t)(0x80 | ctr), 0, 0, seq1[seqCtr], seq2[seqCtr], seq3[seqCtr], seq4[seqCtr], seq5[seqCtr] };
-
-   can->Send(0x580, canData,8); //Send on CAN2
+   canData[0] = 0x80 | ctr;
+   canData[3] = seq1[seqCtr];
+   canData[4] = seq2[seqCtr];
+   canData[5] = seq3[seqCtr];
+   canData[6] = seq4[seqCtr];
+   canData[7] = seq5[seqCtr];
    seqCtr = (seqCtr + 1) & 0x3;
    ctr = (ctr + 1) & 0xF;
+   return true;
 }
 
-void Can_VAG::Task10Ms()
+bool Can_VAG::Fill280(void* context, uint8_t* canData)
 {
+   Can_VAG* vag = (Can_VAG*)context;
+   uint16_t rpm = vag->rpm;
+
    rpm = (rpm < 750) ? 750 : rpm;
    rpm = (rpm > 7000) ? 7000 : rpm;
 
-   uint8_t byte3 = ((rpm * 4) >> 8) & 0xFF;
-   uint8_t byte4 = (rpm * 4) & 0xFF;
-   uint8_t canData[8] = { 0, 0, 0, byte3, byte4, 0, 0, 0 };
-   can->Send(0x280, canData, 8); //Send on CAN2
+   canData[3] = ((rpm * 4) >> 8) & 0xFF;
+   canData[4] = (rpm * 4) & 0xFF;
+   return true;
+}
 
-   //contains temperature, traction control light was on without the message, content doesnt
-   //seem to matter.
-   canData[3] = 0;
-   canData[4] = 0;
-   can->Send(0x288, canData, 8); //Send on CAN2
+//contains temperature, traction control light was on without the message, content doesnt
+//seem to matter.
+bool Can_VAG::Fill288(void*, uint8_t*)
+{
+   return true;
 }
 
 bool Can_VAG::Start()
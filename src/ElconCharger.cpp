@@ -1,4 +1,5 @@
 #include <ElconCharger.h>
+#include "candispatch.h"
 
 static bool ChRun=false;
 static uint16_t HVvolts=0;
@@ -14,7 +15,7 @@ void ElconCharger::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x18FF50E5);
+    CanDispatch::RegisterUserMessage(can, 0x18FF50E5);
 
 }
 
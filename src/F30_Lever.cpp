@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "F30_Lever.h"
+#include "candispatch.h"
 
 #define Off 0x00
 #define Park 0x20
@@ -86,9 +87,9 @@ remainder = remainder^final;
  void F30_Lever::SetCanInterface(CanHardware* c)
 {
    can = c;
-   can->RegisterUserMessage(0x55E);//GWS Hearbeat msg
-   can->RegisterUserMessage(0x65E);//GWS Diag msg
-   can->RegisterUserMessage(0x197);//GWS status msg. Contains info on buttons pressed and lever location.
+   CanDispatch::RegisterUserMessage(can, 0x55E);//GWS Hearbeat msg
+   CanDispatch::RegisterUserMessage(can, 0x65E);//GWS Diag msg
+   CanDispatch::RegisterUserMessage(can, 0x197);//GWS status msg. Contains info on buttons pressed and lever location.
    CRC8_begin();//use this function to init the crc generator.
 }
 
@@ -1,10 +1,17 @@
+#include <string.h>
 #include "GS450H.h"
+#include "htmframe.h"
+#include "shiftmap.h"
 #include "hwinit.h"
 #include "temp_meas.h"
 #include <libopencm3/stm32/timer.h>
 #include "anain.h"
 #include "my_math.h"
 #include "utils.h"
+#include "hotparams.h"
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
 
 #define  LOW_Gear  0
 #define  HIGH_Gear  1
@@ -25,84 +32,72 @@ static uint8_t GearSW;
 static int16_t mg1_torque, mg2_torque, speedSum;
 static bool statusInv=0;
 static bool TorqueCut, ShiftInit = 0;
-static int8_t TorqueShiftRamp = 0;
+static s32fp TorqueShiftRamp = 0; //percent of the requested torque let through while shifting
 static uint16_t Lexus_Oil2=0;
 static uint8_t speedSum2;
 static uint8_t gearAct, gearReq, gearStep=0;
+static uint16_t shiftCount, shiftTicks;
 
-static void dma_read(uint8_t *data, int size);
-static void dma_write(uint8_t *data, int size);
+static void dma_read(int size);
+static void dma_write(const uint8_t *data, int size);
 
 //80 bytes out and 100 bytes back in (with offset of 8 bytes.
-static uint8_t mth_data[140];
-static uint8_t htm_data_setup[100]= {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,25,0,0,0,0,0,0,0,128,0,0,0,128,0,0,0,37,1};
-static uint8_t htm_data[105]= {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,0,0,0,0,0,0,0,0,0};
-static uint8_t htm_data_GS300H[105]= {0,14,0,2,0,0,0,0,0,0,0,0,0,23,0,97,0,0,0,0,0,0,0,248,254,8,1,0,0,0,0,0,0,22,0,0,0,0,0,23,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,23,0,75,22,47,250,137,14,0,0,23,0,0,0,0,201,0,218,0,16,0,0,0,29,0,0,0,0,0,0
-                                     };
-#if 0
-// Not currently used
-static uint8_t htm_data_setup_auris[100]= {0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x19, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5F, 0x01};
-#endif
-
-uint8_t htm_data_init[7][100]=
-{
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,4,0,25,0,0,0,0,0,0,0,0,0,0,136,0,0,0,160,0,0,0,0,0,0,0,95,1},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,4,0,25,0,0,0,0,0,0,0,0,0,0,136,0,0,0,160,0,0,0,0,0,0,0,95,1},
-    {0,30,0,0,0,0,0,18,0,154,250,0,0,0,0,97,4,0,0,0,0,0,173,255,82,0,0,0,0,0,0,0,16,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,4,75,25,60,246,52,8,0,0,0,0,0,0,138,0,0,0,168,0,0,0,1,0,0,0,72,7},
-    {0,30,0,0,0,0,0,18,0,154,250,0,0,0,0,97,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,4,75,25,60,246,52,8,0,0,0,0,0,0,138,0,0,0,168,0,0,0,2,0,0,0,75,5},
-    {0,30,0,0,0,0,0,18,0,154,250,0,0,0,0,97,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,4,75,25,60,246,52,8,0,0,0,0,0,0,138,0,0,0,168,0,0,0,2,0,0,0,75,5},
-    {0,30,0,0,0,0,0,18,0,154,250,0,0,255,0,97,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,0,255,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,255,4,73,25,60,246,52,8,0,0,255,0,0,0,138,0,0,0,168,0,0,0,3,0,0,0,70,9},
-    {0,30,0,2,0,0,0,18,0,154,250,0,0,16,0,97,0,0,0,0,0,0,200,249,56,6,165,0,136,0,63,0,16,0,0,0,63,0,16,0,3,128,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,16,0,75,12,45,248,21,6,0,0,16,0,0,0,202,0,211,0,16,0,0,0,134,16,0,0,130,10}
-};
-
-uint8_t  htm_data_Init_GS300H[6][105]=
-{
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,0,25,0,0,0,0,0,0,0,0,0,0,0,136,0,0,0,160,0,0,0,0,0,0,0,0,95,1},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,0,25,0,0,0,0,0,0,0,0,0,0,0,136,0,0,0,160,0,0,0,0,0,0,0,0,95,1},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,97,4,0,0,0,0,0,0,173,255,82,0,0,0,0,0,0,0,22,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,75,25,212,254,210,15,0,0,0,0,0,0,0,137,0,0,0,168,0,0,0,1,0,0,0,0,220,6},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,97,4,0,0,0,0,0,0,173,255,82,0,0,0,0,0,0,0,22,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,75,25,212,254,210,15,0,0,0,0,0,0,0,137,0,0,0,168,0,0,0,1,0,0,0,0,220,6},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,97,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,22,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,75,25,212,254,190,15,0,0,0,0,0,0,0,137,0,0,0,168,0,0,0,2,0,0,0,0,203,4},
-    {0,14,0,0,0,0,0,0,0,0,0,0,0,0,0,97,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,22,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,0,0,0,0,0,4,75,25,212,254,190,15,0,0,0,0,0,0,0,137,0,0,0,168,0,0,0,2,0,0,0,0,203,4}
-};
+//MTH frames are received alternately into both buffers. The DMA interrupt hands
+//over the completed one, it is parsed in place while the next one is received.
+static uint8_t mth_buffers[2][140];
+static const uint8_t* volatile mth_data = mth_buffers[0]; //last completed frame
+static const uint8_t* volatile mthTarget = mth_buffers[1]; //buffer the DMA is writing to
+static volatile bool mthReady = false;
+static uint16_t mthLength;
+static bool mthValid = false;                    //valid frame since the last check
+//HTM frames are built in htm and committed to the idle buffer, so the DMA never sends a half updated frame
+static uint8_t htm_buffers[2][105];
+static uint8_t htmFront = 0;                     //buffer to send next
+static const uint8_t* htmSending;                //frame the DMA is sending while htmBusy
+static volatile bool htmBusy = false;
+//Link statistics, published once per second
+static uint16_t exchanges, checksumErrors, statTicks;
+static HtmFrame htm;
 
 void GS450HClass::SetTorque(float torquePercent)
 {
-    uint8_t MotorActive = Param::GetInt(Param::MotActive);
+    uint8_t MotorActive = HotParams::motActive;
     if(DriveType == GS450H)
     {
-        GS450Hgear();//check if we need to shift - can modify torque limits so needs to ran before calculating requests
+        int torque = torquePercent * 35; //-3500 to 3500
+
+        GS450Hgear(torque / 35);//check if we need to shift - can modify torque limits so needs to ran before calculating requests
 
         if(!TorqueCut)//Cut torque only when shifting for now
         {
-            torquePercent = TorqueShiftRamp * torquePercent *0.01; //multiply by the torque ramp for when shifting
-            scaledTorqueTarget = (torquePercent * 3500) / 100.0f;
+            scaledTorqueTarget = torque * TorqueShiftRamp / FP_FROMINT(100); //multiply by the torque ramp for when shifting
             mg2_torque = this->scaledTorqueTarget;
             mg1_torque = ((mg2_torque*5)/4);
 
             if(ShiftInit == true && TorqueShiftRamp > 0)
             {
-                TorqueShiftRamp -= (5*Param::GetFloat(Param::throtramp)); //ramp down 5 x throtramp
+                TorqueShiftRamp -= HotParams::shiftCut; //ramp down
                 if(TorqueShiftRamp < 0)
                 {
                     TorqueShiftRamp = 0; //if we go below 0 force it to zero to signify finishing ramp down
                 }
             }
 
-            if(TorqueShiftRamp < 100 && ShiftInit == false)//ramp torque back in after shifting - Note this also runs on first power on so theoretically reduced throttle on start
+            if(TorqueShiftRamp < FP_FROMINT(100) && ShiftInit == false)//ramp torque back in after shifting - Note this also runs on first power on so theoretically reduced throttle on start
             {
-                TorqueShiftRamp += Param::GetFloat(Param::throtramp);//ramp back in 5% every time this is ran, every 10ms - Increased from 10.
-                if(TorqueShiftRamp > 100)
+                TorqueShiftRamp += HotParams::throtramp;//ramp back in by throtramp every time this is ran, every 10ms
+                if(TorqueShiftRamp > FP_FROMINT(100))
                 {
-                    TorqueShiftRamp = 100; //keep it limited to 100
+                    TorqueShiftRamp = FP_FROMINT(100); //keep it limited to 100
                 }
             }
 
             if (gear == 0)//!!!Low gear
             {
-                if(torquePercent < 0)
+                if(scaledTorqueTarget < 0)
                 {
-                    mg2_torque *= 0.5;
-                    mg1_torque *= 0.5;
+                    mg2_torque /= 2;
+                    mg1_torque /= 2;
                 }
             }
         }
@@ -197,47 +192,58 @@ float GS450HClass::GetMotorTemperature()
 // 100 ms code
 void GS450HClass::Task100Ms()
 {
+    //Link statistics of the last second
+    if (++statTicks >= 10)
+    {
+        uint16_t frames = exchanges + checksumErrors;
+
+        Param::SetInt(Param::htmrate, exchanges);
+        Param::SetInt(Param::mthcserr, frames > 0 ? checksumErrors * 100 / frames : 0);
+        exchanges = 0;
+        checksumErrors = 0;
+        statTicks = 0;
+    }
+
     if(DriveType == GS450H)
     {
         GS450Houtput();
     }
 }
 
-void GS450HClass::GS450Hgear()//!!! should be ran every 10ms - ran before calculating torque request
+void GS450HClass::GS450Hgear(int load)//!!! should be ran every 10ms - ran before calculating torque request
 {
     //Param::SetInt(Param::InvStat, GS450HClass::statusFB()); //update inverter status on web interface
     gear=(Param::GetInt(Param::Gear));
 
-    if(gear == 2)//!!!Auto Shifting using code from AK - Always start in low gear when powered on
+    if(gear == 2)//!!!Auto Shifting from the shift map, see shiftmap.h - Always start in low gear when powered on
     {
-        if(gearAct == 0 && mg2_speed > 7000) //Shift up when in low gear and mg2 is over 7000rpm
-        {
-            gearReq = 1;//request high gear
-        }
-        else if(gearAct == 1 && mg2_speed < 2000 ) //Shift down when in high gear and mg2 is under 8000rpm
-        {
-            gearReq = 0;//request high gear
-        }
+        uint8_t target = ShiftMap::Select(gearAct, mg2_speed, load);
+
+        if(target != gearAct) gearReq = target; //a started shift is finished even if the speed drops back
 
         if(gearAct != gearReq)//check if we need to shift gears
         {
             //TorqueCut = true; //Cut Torque to motor
             //TorqueShiftRamp = 0; //Zero torque Limiter
+            if(!ShiftInit) shiftTicks = 0;
             ShiftInit = true;
+            shiftTicks++;
             if(TorqueShiftRamp == 0)
             {
                 gearStep++;//increase gearStep by 1 adds 10ms delay before shifting
             }
-            if(gearStep == 4)//wait some cycles before changing
+            if(gearStep == HotParams::shiftDelay)//wait some cycles before changing
             {
                 gear = gearReq; //change the outputs
             }
-            else if(gearStep == 5)
+            else if(gearStep > HotParams::shiftDelay)
             {
                 gearAct = gearReq; //we have now shifted gear
                 gearStep = 0; //reset shift loop
                 //TorqueCut = false;//allow torque again
                 ShiftInit = false; //Allow troque ramping we are done shifting
+                Param::SetInt(Param::shifts, ++shiftCount);
+                Param::SetInt(Param::shiftms, shiftTicks * 10); //from the torque cut to the new gear
             }
         }
         else//no shifting needed so gear should be gearAct
@@ -291,6 +297,20 @@ void GS450HClass::GS450Houtput()//!!! should be ran every 10ms
 //Dilbert's code here
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 
+//Called from Param::Change() in the main loop, Task1Ms must not write the frame while it is copied and summed
+static void LoadHtm(const uint8_t* init, uint16_t length)
+{
+#ifdef STM32F1
+    uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+    htm.Load(init, length);
+
+#ifdef STM32F1
+    cm_mask_interrupts(irqMask);
+#endif
+}
+
 void GS450HClass::SetPrius()
 {
     setTimerState(true);//start toyota timers
@@ -299,6 +319,7 @@ void GS450HClass::SetPrius()
         htm_state = 5;
         inv_status = 0;//must be 0 for prius
     }
+    LoadHtm(htm_data_default, 100);
     DriveType = PRIUS;
 }
 
@@ -310,6 +331,7 @@ void GS450HClass::SetGS450H()
         htm_state = 0;
         inv_status = 1;//must be 1 for gs450h
     }
+    LoadHtm(htm_data_default, 80);
     DriveType = GS450H;
 }
 
@@ -322,41 +344,97 @@ void GS450HClass::SetGS300H()
 
     }
     inv_status = 0;//must be 0 for gs300h
-    for(int i=0; i<105; i++)htm_data[i] = htm_data_GS300H[i];
+    LoadHtm(htm_data_GS300H, 105);
     DriveType = IS300H;
 }
 
-uint8_t GS450HClass::VerifyMTHChecksum(uint16_t len)
+//All bytes of an MTH frame are new, so it is summed as a whole
+uint8_t GS450HClass::VerifyMTHChecksum(const uint8_t* data, uint16_t len)
 {
+    if(HtmFrame::Checksum(data, len)==(data[len-2]|(data[len-1]<<8))) return 1;
+    else return 0;
+}
 
-    uint16_t mth_checksum=0;
+//Completes the frame with its checksum and hands it to the DMA side
+void GS450HClass::CommitHtm()
+{
+    uint16_t len = htm.GetLength();
+    const uint8_t* frame = htm.Finish();
 
-    for(int i=0; i<(len-2); i++)
-        mth_checksum+=mth_data[i];
+    //A frame that is still being sent keeps its buffer, the other one becomes the next
+    uint8_t back = htmBusy && htmSending == htm_buffers[htmFront] ? htmFront ^ 1 : htmFront;
+    memcpy(htm_buffers[back], frame, len);
+    htmFront = back;
+}
 
+//Called from the USART2 RX DMA interrupt once a whole MTH frame is in
+void GS450HClass::MthReceived()
+{
+    //A reception restarted since the frame came in has cleared the flag, then there is nothing to hand over
+    if (!dma_get_interrupt_flag(DMA1, DMA_CHANNEL6, DMA_TCIF)) return;
 
-    if(mth_checksum==(mth_data[len-2]|(mth_data[len-1]<<8))) return 1;
-    else return 0;
+    dma_clear_interrupt_flags(DMA1, DMA_CHANNEL6, DMA_TCIF);
+    mth_data = mthTarget;
+    mthReady = true;
+}
 
+//Called from the USART2 TX DMA interrupt
+void GS450HClass::HtmSent()
+{
+    dma_clear_interrupt_flags(DMA1, DMA_CHANNEL7, DMA_TCIF);
+    htmBusy = false;
 }
 
-void GS450HClass::CalcHTMChecksum(uint16_t len)
+//Decodes the frame that just came in, the layout depends on the inverter
+void GS450HClass::ParseMth()
 {
-    uint16_t htm_checksum=0;
+    mthReady = false;
 
-    for(int i=0; i<(len-2); i++)htm_checksum+=htm_data[i];
-    htm_data[len-2]=htm_checksum&0xFF;
-    htm_data[len-1]=htm_checksum>>8;
+    if (!VerifyMTHChecksum(mth_data, mthLength))
+    {
+        checksumErrors++;
+        return;
+    }
+
+    exchanges++;
+    mthValid = true;
+
+    if (DriveType == IS300H)
+    {
+        dc_bus_voltage=(((mth_data[117]|mth_data[118]<<8))/2);
+        temp_inv_water=int8_t(mth_data[20]);
+        temp_inv_inductor=(mth_data[25]|mth_data[26]<<8);
+        mg1_speed=mth_data[10]|mth_data[11]<<8;
+        mg2_speed=mth_data[43]|mth_data[44]<<8;
+    }
+    else if (DriveType == PRIUS)
+    {
+        dc_bus_voltage=(((mth_data[100]|mth_data[101]<<8)-5)/2);
+        temp_inv_water=int8_t(mth_data[20]);//from 300h
+        temp_inv_inductor=(mth_data[86]|mth_data[87]<<8);
+        mg1_speed=mth_data[6]|mth_data[7]<<8;
+        mg2_speed=mth_data[38]|mth_data[39]<<8;
+    }
+    else
+    {
+        dc_bus_voltage=(((mth_data[82]|mth_data[83]<<8)-5)/2);
+        temp_inv_water=(mth_data[42]|mth_data[43]<<8);
+        temp_inv_inductor=(mth_data[86]|mth_data[87]<<8);
+        mg1_speed=mth_data[6]|mth_data[7]<<8;
+        mg2_speed=mth_data[31]|mth_data[32]<<8;
+    }
 }
 
 
 void GS450HClass::Task1Ms()
 {
+    //Parse as soon as a frame is complete, a late one is no longer lost at the check below
+    if (mthReady) ParseMth();
 
     switch(htm_state)
     {
     case 0:
-        dma_read(mth_data,100);//read in mth data via dma. Probably need some kind of check dma complete flag here
+        dma_read(100);//read in mth data via dma
         DigIo::req_out.Clear(); //HAL_GPIO_WritePin(HTM_SYNC_GPIO_Port, HTM_SYNC_Pin, 0);
         htm_state++;
         break;
@@ -365,10 +443,9 @@ void GS450HClass::Task1Ms()
 
         if(inv_status==0)
         {
-            if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL7, DMA_TCIF))// if the transfer complete flag is set then send another packet
+            if (!htmBusy)// if the last transfer has completed then send another packet
             {
-                dma_clear_interrupt_flags(DMA1, DMA_CHANNEL7, DMA_TCIF);//clear the flag.
-                dma_write(htm_data,80); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
+                dma_write(htm_buffers[htmFront],80); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
             }
 
         }
@@ -384,24 +461,9 @@ void GS450HClass::Task1Ms()
         htm_state++;
         break;
     case 3:
-        if(VerifyMTHChecksum(100)==0 || dma_get_interrupt_flag(DMA1, DMA_CHANNEL6, DMA_TCIF)==0)
-        {
-            statusInv=0;
-        }
-        else
-        {
-            //exchange data and prepare next HTM frame
-            dma_clear_interrupt_flags(DMA1, DMA_CHANNEL6, DMA_TCIF);
-            statusInv=1;
-            dc_bus_voltage=(((mth_data[82]|mth_data[83]<<8)-5)/2);
-            temp_inv_water=(mth_data[42]|mth_data[43]<<8);
-            temp_inv_inductor=(mth_data[86]|mth_data[87]<<8);
-            mg1_speed=mth_data[6]|mth_data[7]<<8;
-            mg2_speed=mth_data[31]|mth_data[32]<<8;
-        }
-
-        mth_data[98]=0;
-        mth_data[99]=0;
+        //Inverter is ok if a valid frame came in since the last check
+        statusInv=mthValid;
+        mthValid=false;
 
         htm_state++;
         break;
@@ -413,39 +475,21 @@ void GS450HClass::Task1Ms()
         speedSum=mg2_speed+mg1_speed;
         speedSum/=113;
         speedSum2=speedSum;
-        htm_data[0]=speedSum2;
-        htm_data[75]=(mg1_torque*4) & 0xFF;
-        htm_data[76]=((mg1_torque*4)>>8) & 0xFF;
+        htm.Set(0, speedSum2);
+        htm.SetWord(75, mg1_torque*4);
 
         //mg1
-        htm_data[5]=(-mg1_torque) & 0xFF;  //negative is forward
-        htm_data[6]=((-mg1_torque) >> 8);
-        htm_data[11]=htm_data[5];
-        htm_data[12]=htm_data[6];
+        htm.SetWord(5, -mg1_torque);  //negative is forward
+        htm.SetWord(11, -mg1_torque);
 
         //mg2
-        htm_data[26]=(mg2_torque) & 0xFF; //positive is forward
-        htm_data[27]=((mg2_torque)>>8) & 0xFF;
-        htm_data[32]=htm_data[26];
-        htm_data[33]=htm_data[27];
-
-        htm_data[63]=(-5000)&0xFF;  // regen ability of battery
-        htm_data[64]=((-5000)>>8);
-
-        htm_data[65]=(27500)&0xFF;  // discharge ability of battery
-        htm_data[66]=((27500)>>8);
+        htm.SetWord(26, mg2_torque); //positive is forward
+        htm.SetWord(32, mg2_torque);
 
-        //!!moved to checksum function.
-        /*
-        htm_checksum=0;
+        htm.SetWord(63, -5000);  // regen ability of battery
+        htm.SetWord(65, 27500);  // discharge ability of battery
 
-        for (int i = 0; i < 78; i++)
-            htm_checksum += htm_data[i];
-
-        htm_data[78]=htm_checksum&0xFF;
-        htm_data[79]=htm_checksum>>8;
-        */
-        CalcHTMChecksum(80);
+        CommitHtm();
 
         if(counter>100)
         {
@@ -462,7 +506,7 @@ void GS450HClass::Task1Ms()
 
     /***** Demo code for Gen3 Prius/Auris direct communications! */
     case 5:
-        dma_read(mth_data,120);//read in mth data via dma. Probably need some kind of check dma complete flag here
+        dma_read(120);//read in mth data via dma
         DigIo::req_out.Clear(); //HAL_GPIO_WritePin(HTM_SYNC_GPIO_Port, HTM_SYNC_Pin, 0);
         htm_state++;
         break;
@@ -471,10 +515,9 @@ void GS450HClass::Task1Ms()
 
         if(inv_status>5)
         {
-            if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL7, DMA_TCIF))// if the transfer complete flag is set then send another packet
+            if (!htmBusy)// if the last transfer has completed then send another packet
             {
-                dma_clear_interrupt_flags(DMA1, DMA_CHANNEL7, DMA_TCIF);//clear the flag.
-                dma_write(htm_data,100); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
+                dma_write(htm_buffers[htmFront],100); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
             }
         }
         else
@@ -493,26 +536,8 @@ void GS450HClass::Task1Ms()
         htm_state++;
         break;
     case 8:
-        if(VerifyMTHChecksum(120)==0 || dma_get_interrupt_flag(DMA1, DMA_CHANNEL6, DMA_TCIF)==0)
-        {
-
-            statusInv=0;
-        }
-        else
-        {
-
-            //exchange data and prepare next HTM frame
-            dma_clear_interrupt_flags(DMA1, DMA_CHANNEL6, DMA_TCIF);
-            statusInv=1;
-            dc_bus_voltage=(((mth_data[100]|mth_data[101]<<8)-5)/2);
-            temp_inv_water=int8_t(mth_data[20]);//from 300h
-            temp_inv_inductor=(mth_data[86]|mth_data[87]<<8);
-            mg1_speed=mth_data[6]|mth_data[7]<<8;
-            mg2_speed=mth_data[38]|mth_data[39]<<8;
-        }
-
-        mth_data[98]=0;
-        mth_data[99]=0;
+        statusInv=mthValid;
+        mthValid=false;
 
         htm_state++;
         break;
@@ -524,57 +549,46 @@ void GS450HClass::Task1Ms()
         speedSum/=113;
         //Possibly not needed
         //uint8_t speedSum2=speedSum;
-        //htm_data[0]=speedSum2;
+        //htm.Set(0, speedSum2);
 
         //these bytes are used, and seem to be MG1 for startup, but can't work out the relatino to the
         //bytes earlier in the stream, possibly the byte order has been flipped on these 2 bytes
         //could be a software bug ?
-        htm_data[76]=(mg1_torque*4) & 0xFF;
-        htm_data[75]=((mg1_torque*4)>>8) & 0xFF;
+        htm.SetWordSwapped(75, mg1_torque*4);
 
         //mg1
-        htm_data[5]=(mg1_torque)&0xFF;  //negative is forward
-        htm_data[6]=((mg1_torque)>>8);
-        htm_data[11]=htm_data[5];
-        htm_data[12]=htm_data[6];
+        htm.SetWord(5, mg1_torque);  //negative is forward
+        htm.SetWord(11, mg1_torque);
 
         //mg2 the MG2 values are now beside each other!
-        htm_data[30]=(mg2_torque) & 0xFF; //positive is forward
-        htm_data[31]=((mg2_torque)>>8) & 0xFF;
+        htm.SetWord(30, mg2_torque); //positive is forward
 
         if(scaledTorqueTarget > 0)
         {
             //forward direction these bytes should match
-            htm_data[26]=htm_data[30];
-            htm_data[27]=htm_data[31];
-            htm_data[28]=(mg2_torque/2) & 0xFF; //positive is forward
-            htm_data[29]=((mg2_torque/2)>>8) & 0xFF;
+            htm.SetWord(26, mg2_torque);
+            htm.SetWord(28, mg2_torque/2); //positive is forward
         }
 
         if(scaledTorqueTarget < 0)
         {
             //reverse direction these bytes should match
-            htm_data[28]=htm_data[30];
-            htm_data[29]=htm_data[31];
-            htm_data[26]=(mg2_torque/2) & 0xFF; //positive is forward
-            htm_data[27]=((mg2_torque/2)>>8) & 0xFF;
+            htm.SetWord(28, mg2_torque);
+            htm.SetWord(26, mg2_torque/2); //positive is forward
         }
 
         //Battery Limits
 
-        htm_data[85]=(-5000)&0xFF;  // regen ability of battery
-        htm_data[86]=((-5000)>>8);
-
-        htm_data[87]=(-10000)&0xFF;  // discharge ability of battery
-        htm_data[88]=((-10000)>>8);
+        htm.SetWord(85, -5000);  // regen ability of battery
+        htm.SetWord(87, -10000);  // discharge ability of battery
 
         //checksum
         if(++frame_count & 0x01)
         {
-            htm_data[94]++;
+            htm.Set(94, htm.Get(94) + 1);
         }
 
-        CalcHTMChecksum(100);
+        CommitHtm();
 
         htm_state=5;
         break;
@@ -583,7 +597,7 @@ void GS450HClass::Task1Ms()
     /***** Code for Lexus GS300H */
     case 10:
         if (Param::GetInt(Param::opmode) != MOD_RUN) inv_status = 0;
-        dma_read(mth_data,140);//read in mth data via dma.
+        dma_read(140);//read in mth data via dma.
         DigIo::req_out.Clear(); //HAL_GPIO_WritePin(HTM_SYNC_GPIO_Port, HTM_SYNC_Pin, 0);
         htm_state++;
         break;
@@ -591,15 +605,15 @@ void GS450HClass::Task1Ms()
         DigIo::req_out.Set();  //HAL_GPIO_WritePin(HTM_SYNC_GPIO_Port, HTM_SYNC_Pin, 1);
         if(inv_status>6)
         {
-            if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL7, DMA_TCIF))// if the transfer complete flag is set then send another packet
+            if (!htmBusy)// if the last transfer has completed then send another packet
             {
-                dma_clear_interrupt_flags(DMA1, DMA_CHANNEL7, DMA_TCIF);//clear the flag.
-                dma_write(htm_data,105); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
+                dma_write(htm_buffers[htmFront],105); //HAL_UART_Transmit_IT(&huart2, htm_data, 80);
             }
         }
         else
         {
-            dma_write(&htm_data_Init_GS300H[ inv_status ][0],105); //HAL_UART_Transmit_IT(&huart2, htm_data_setup, 80);
+            //7 start up frames but only 6 rows, the last one goes out twice
+            dma_write(&htm_data_Init_GS300H[ MIN(inv_status, 5) ][0],105); //HAL_UART_Transmit_IT(&huart2, htm_data_setup, 80);
 
             inv_status++;
 
@@ -610,27 +624,9 @@ void GS450HClass::Task1Ms()
         htm_state++;
         break;
     case 13:
-        if(VerifyMTHChecksum(140)==0 || dma_get_interrupt_flag(DMA1, DMA_CHANNEL6, DMA_TCIF)==0)
-        {
-
-            statusInv=0;
-            inv_status=0;
-        }
-        else
-        {
-
-            //exchange data and prepare next HTM frame
-            dma_clear_interrupt_flags(DMA1, DMA_CHANNEL6, DMA_TCIF);
-            statusInv=1;
-            dc_bus_voltage=(((mth_data[117]|mth_data[118]<<8))/2);
-            temp_inv_water=int8_t(mth_data[20]);
-            temp_inv_inductor=(mth_data[25]|mth_data[26]<<8);
-            mg1_speed=mth_data[10]|mth_data[11]<<8;
-            mg2_speed=mth_data[43]|mth_data[44]<<8;
-        }
-
-        // mth_data[98]=0;
-        // mth_data[99]=0;
+        statusInv=mthValid;
+        if(!mthValid) inv_status=0;
+        mthValid=false;
 
         htm_state++;
         break;
@@ -642,25 +638,19 @@ void GS450HClass::Task1Ms()
         speedSum/=113;
 
         //mg1
-        htm_data[5]=(mg1_torque*-1)&0xFF;  //negative is forward
-        htm_data[6]=((mg1_torque*-1)>>8);
-        htm_data[11]=htm_data[5];
-        htm_data[12]=htm_data[6];
+        htm.SetWord(5, mg1_torque*-1);  //negative is forward
+        htm.SetWord(11, mg1_torque*-1);
 
         //mg2
-        htm_data[31]=(mg2_torque)&0xFF; //positive is forward
-        htm_data[32]=((mg2_torque)>>8);
-        htm_data[37]=htm_data[26];
-        htm_data[38]=htm_data[27];
+        htm.SetWord(31, mg2_torque); //positive is forward
+        htm.Set(37, htm.Get(26));
+        htm.Set(38, htm.Get(27));
 
         //Battery Limits
 
-        htm_data[79]=(-5000)&0xFF;  // regen ability of battery
-        htm_data[80]=((-5000)>>8);
-
-        htm_data[81]=(10000)&0xFF;  // discharge ability of battery
-        htm_data[82]=((10000)>>8);
-        CalcHTMChecksum(105);
+        htm.SetWord(79, -5000);  // regen ability of battery
+        htm.SetWord(81, 10000);  // discharge ability of battery
+        CommitHtm();
 
         htm_state=10;
         break;
@@ -698,7 +688,7 @@ int GS450HClass::GetInverterState()
 //Usart 2 DMA Transmitt and Receive Section
 //////////////////////////////////////////////////////////////////////////
 
-static void dma_write(uint8_t *data, int size)
+static void dma_write(const uint8_t *data, int size)
 {
     /*
      * Using channel 7 for USART2_TX
@@ -715,30 +705,48 @@ static void dma_write(uint8_t *data, int size)
     dma_set_peripheral_size(DMA1, DMA_CHANNEL7, DMA_CCR_PSIZE_8BIT);
     dma_set_memory_size(DMA1, DMA_CHANNEL7, DMA_CCR_MSIZE_8BIT);
     dma_set_priority(DMA1, DMA_CHANNEL7, DMA_CCR_PL_MEDIUM);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL7);
 
+    htmSending = data;
+    htmBusy = true;
     dma_enable_channel(DMA1, DMA_CHANNEL7);
 
     usart_enable_tx_dma(USART2);
 }
 
-static void dma_read(uint8_t *data, int size)
+//Receives into the buffer that is not handed over to ParseMth()
+static void dma_read(int size)
 {
     /*
      * Using channel 6 for USART2_RX
      */
 
+#ifdef STM32F1
+    uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+    //Hand over a frame whose interrupt is still pending, the reset below clears its flag
+    GS450HClass::MthReceived();
+    mthTarget = mth_data == mth_buffers[0] ? mth_buffers[1] : mth_buffers[0];
+
     /* Reset DMA channel*/
     dma_channel_reset(DMA1, DMA_CHANNEL6);
 
+#ifdef STM32F1
+    cm_mask_interrupts(irqMask);
+#endif
+
     dma_set_peripheral_address(DMA1, DMA_CHANNEL6, (uint32_t)&USART2_DR);
-    dma_set_memory_address(DMA1, DMA_CHANNEL6, (uint32_t)data);
+    dma_set_memory_address(DMA1, DMA_CHANNEL6, (uint32_t)mthTarget);
     dma_set_number_of_data(DMA1, DMA_CHANNEL6, size);
     dma_set_read_from_peripheral(DMA1, DMA_CHANNEL6);
     dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL6);
     dma_set_peripheral_size(DMA1, DMA_CHANNEL6, DMA_CCR_PSIZE_8BIT);
     dma_set_memory_size(DMA1, DMA_CHANNEL6, DMA_CCR_MSIZE_8BIT);
     dma_set_priority(DMA1, DMA_CHANNEL6, DMA_CCR_PL_LOW);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL6);
 
+    mthLength = size;
     dma_enable_channel(DMA1, DMA_CHANNEL6);
 
     usart_enable_rx_dma(USART2);
@@ -12,6 +12,7 @@
  */
 
 #include "JLR_G1.h"   // 引入JLR_G1类的头文件
+#include "candispatch.h"
 
 // 换挡杆各档位定义
 #define JLR_Park 0       // P档（停车档）
@@ -47,7 +48,7 @@ uint8_t byte5S[16] = {0xE2, 0x7F, 0xC5, 0x58, 0xAC, 0x31, 0x8B, 0x16, 0x7E, 0xE3
 void JLR_G1::SetCanInterface(CanHardware* c)
 {
     can = c;
-    can->RegisterUserMessage(0x312); // 注册JLR Gen 1换挡杆报文ID
+    CanDispatch::RegisterUserMessage(can, 0x312); // 注册JLR Gen 1换挡杆报文ID
 }
 
 
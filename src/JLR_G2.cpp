@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "JLR_G2.h"
+#include "candispatch.h"
 
 uint8_t DirJLRG2 = 0;
 
@@ -54,7 +55,7 @@ char byte5SG2[16] = {0xE2, 0x7F, 0xC5, 0x58, 0xAC, 0x31, 0x8B, 0x16, 0x7E, 0xE3,
 void JLR_G2::SetCanInterface(CanHardware* c)
 {
     can = c;
-    can->RegisterUserMessage(0x0E0);//JLR Gen 2 Gearshifter bytessage
+    CanDispatch::RegisterUserMessage(can, 0x0E0);//JLR Gen 2 Gearshifter bytessage
 }
 
 
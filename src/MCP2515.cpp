@@ -25,18 +25,44 @@
 //#include "spi1_master.h"
 //#include "spi1_types.h"
 #include "MCP2515.h"
+#include <libopencm3/stm32/dma.h>
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
 //#include "pin_manager.h"
 
-//Defines for chip select
-#define MCP2515_CS_HIGH()   DigIo::mcp_cs.Set();;
-#define MCP2515_CS_LOW()    DigIo::mcp_cs.Clear();;
+//Defines for chip select. The blocking functions claim the bus once queued DMA transactions
+//have finished, so that a transaction queued from an interrupt waits until they release it
+#define MCP2515_CS_HIGH()   do { DigIo::mcp_cs.Set(); ReleaseBus(); } while (0)
+#define MCP2515_CS_LOW()    do { ClaimBus(); DigIo::mcp_cs.Clear(); } while (0)
 #define SPI_CAN                 SPI2
 #define SPI_TIMEOUT             10
+#define SPI_DMA_RX              DMA_CHANNEL4
+#define SPI_DMA_TX              DMA_CHANNEL5
 
 //Static variables
 static uint8_t readDummy;
 static uint8_t writeDummy = 0x00;
 
+struct spi_transfer_t
+{
+   uint8_t txData[MCP2515_MAX_TRANSFER];
+   uint8_t length;
+   MCP2515_Callback callback;
+   void *context;
+};
+
+static spi_transfer_t transferQueue[MCP2515_QUEUE_SIZE];
+static uint8_t rxBuffer[MCP2515_MAX_TRANSFER];
+static volatile uint32_t queueHead = 0;
+static volatile uint32_t queueTail = 0;
+static volatile bool transferActive = false;
+static bool useDma = false;
+static uint32_t queueDrops = 0;
+
+static void ClaimBus(void);
+static void ReleaseBus(void);
+
 //Set CAN controller to config mode
 void MCP2515_Initialize(void)
 {
@@ -245,3 +271,296 @@ void MCP2515_Bit_Modify (uint8_t regAddress, uint8_t maskByte, uint8_t dataByte)
    readDummy = spi_xfer(SPI2,dataByte);
    MCP2515_CS_HIGH();
 }
+
+/**
+ Asynchronous transport
+
+ Queued transactions are clocked out by DMA1 channel 5 while channel 4 collects
+ the reply. Only one transaction is on the bus at a time, the next one is
+ started from the transfer complete interrupt after the callback has run.
+ Callbacks may queue further transactions but must not call the blocking
+ functions above.
+
+ USART1 is wired to the same two DMA channels. While it is used for LIN the
+ transactions are clocked out directly from StartNext(), as on the host.
+*/
+
+uint32_t MCP2515_EnterCritical(void)
+{
+#ifdef STM32F1
+   return cm_mask_interrupts(1);
+#else
+   return 0;
+#endif
+}
+
+void MCP2515_LeaveCritical(uint32_t mask)
+{
+#ifdef STM32F1
+   cm_mask_interrupts(mask);
+#else
+   (void)mask;
+#endif
+}
+
+#define EnterCritical MCP2515_EnterCritical
+#define LeaveCritical MCP2515_LeaveCritical
+
+#ifdef STM32F1
+static void StartDma(const spi_transfer_t *t)
+{
+   dma_channel_reset(DMA1, SPI_DMA_RX);
+   dma_set_peripheral_address(DMA1, SPI_DMA_RX, (uint32_t)&SPI_DR(SPI_CAN));
+   dma_set_memory_address(DMA1, SPI_DMA_RX, (uint32_t)rxBuffer);
+   dma_set_number_of_data(DMA1, SPI_DMA_RX, t->length);
+   dma_set_read_from_peripheral(DMA1, SPI_DMA_RX);
+   dma_enable_memory_increment_mode(DMA1, SPI_DMA_RX);
+   dma_set_peripheral_size(DMA1, SPI_DMA_RX, DMA_CCR_PSIZE_8BIT);
+   dma_set_memory_size(DMA1, SPI_DMA_RX, DMA_CCR_MSIZE_8BIT);
+   dma_set_priority(DMA1, SPI_DMA_RX, DMA_CCR_PL_HIGH);
+   dma_enable_transfer_complete_interrupt(DMA1, SPI_DMA_RX);
+
+   dma_channel_reset(DMA1, SPI_DMA_TX);
+   dma_set_peripheral_address(DMA1, SPI_DMA_TX, (uint32_t)&SPI_DR(SPI_CAN));
+   dma_set_memory_address(DMA1, SPI_DMA_TX, (uint32_t)t->txData);
+   dma_set_number_of_data(DMA1, SPI_DMA_TX, t->length);
+   dma_set_read_from_memory(DMA1, SPI_DMA_TX);
+   dma_enable_memory_increment_mode(DMA1, SPI_DMA_TX);
+   dma_set_peripheral_size(DMA1, SPI_DMA_TX, DMA_CCR_PSIZE_8BIT);
+   dma_set_memory_size(DMA1, SPI_DMA_TX, DMA_CCR_MSIZE_8BIT);
+   dma_set_priority(DMA1, SPI_DMA_TX, DMA_CCR_PL_MEDIUM);
+
+   DigIo::mcp_cs.Clear();
+   dma_enable_channel(DMA1, SPI_DMA_RX);
+   dma_enable_channel(DMA1, SPI_DMA_TX);
+   spi_enable_rx_dma(SPI_CAN);
+   spi_enable_tx_dma(SPI_CAN); //Transfer starts here
+}
+#endif
+
+//Starts the oldest queued transaction unless one is already running
+static void StartNext(void)
+{
+   uint32_t mask = EnterCritical();
+
+   if (transferActive || queueHead == queueTail)
+   {
+      LeaveCritical(mask);
+      return;
+   }
+
+   transferActive = true;
+   LeaveCritical(mask);
+
+#ifdef STM32F1
+   if (useDma)
+   {
+      StartDma(&transferQueue[queueTail & (MCP2515_QUEUE_SIZE - 1)]);
+      return;
+   }
+#endif
+
+   //No DMA, clock the whole queue out right here
+   while (queueHead != queueTail)
+   {
+      const spi_transfer_t *t = &transferQueue[queueTail & (MCP2515_QUEUE_SIZE - 1)];
+
+      DigIo::mcp_cs.Clear();
+      for (uint8_t i = 0; i < t->length; i++)
+         rxBuffer[i] = spi_xfer(SPI_CAN, t->txData[i]);
+      DigIo::mcp_cs.Set();
+
+      MCP2515_Callback callback = t->callback;
+      void *context = t->context;
+      queueTail = queueTail + 1;
+
+      if (callback) callback(rxBuffer, context);
+   }
+   transferActive = false;
+}
+
+//Called from dma1_channel4_isr once the last byte of a transaction has been received
+void MCP2515_Transfer_Complete(void)
+{
+#ifdef STM32F1
+   //Without DMA the channels belong to USART1 and its flags are none of our business
+   if (!useDma) return;
+   if (!dma_get_interrupt_flag(DMA1, SPI_DMA_RX, DMA_TCIF)) return;
+
+   dma_clear_interrupt_flags(DMA1, SPI_DMA_RX, DMA_TCIF);
+   spi_disable_tx_dma(SPI_CAN);
+   spi_disable_rx_dma(SPI_CAN);
+   dma_disable_channel(DMA1, SPI_DMA_TX);
+   dma_disable_channel(DMA1, SPI_DMA_RX);
+   DigIo::mcp_cs.Set();
+
+   const spi_transfer_t *t = &transferQueue[queueTail & (MCP2515_QUEUE_SIZE - 1)];
+   MCP2515_Callback callback = t->callback;
+   void *context = t->context;
+   queueTail = queueTail + 1;
+
+   //Still marked active so that transactions queued by the callback don't overwrite rxBuffer
+   if (callback) callback(rxBuffer, context);
+
+   transferActive = false;
+   StartNext();
+#endif
+}
+
+//Select DMA or direct transfers, the caller must free or claim DMA1 channel 4 and 5
+void MCP2515_Use_Dma(bool enable)
+{
+   MCP2515_WaitIdle();
+#ifdef STM32F1
+   useDma = enable;
+#else
+   (void)enable; //Host builds have no DMA
+#endif
+}
+
+bool MCP2515_Dma_Enabled(void)
+{
+   return useDma;
+}
+
+//Blocks until all queued transactions are done, must not be called from a callback
+void MCP2515_WaitIdle(void)
+{
+   while (transferActive || queueHead != queueTail)
+   {
+      if (useDma)
+      {
+         uint32_t mask = EnterCritical();
+         //Complete the transfer here in case we have preempted the DMA interrupt
+         MCP2515_Transfer_Complete();
+         LeaveCritical(mask);
+      }
+      StartNext();
+   }
+}
+
+//Marks the bus active for a blocking transaction, StartNext() then leaves it alone
+static void ClaimBus(void)
+{
+   for (;;)
+   {
+      MCP2515_WaitIdle();
+
+      uint32_t mask = EnterCritical();
+
+      //An interrupt may have queued a transaction since WaitIdle() returned
+      if (!transferActive && queueHead == queueTail)
+      {
+         transferActive = true;
+         LeaveCritical(mask);
+         return;
+      }
+      LeaveCritical(mask);
+   }
+}
+
+//Ends a blocking transaction and starts what was queued meanwhile
+static void ReleaseBus(void)
+{
+   transferActive = false;
+   StartNext();
+}
+
+//Queue a raw transaction of up to MCP2515_MAX_TRANSFER bytes
+bool MCP2515_Queue(const uint8_t *txData, uint8_t length, MCP2515_Callback callback, void *context)
+{
+   if (length == 0 || length > MCP2515_MAX_TRANSFER) return false;
+
+   uint32_t mask = EnterCritical();
+
+   if ((queueHead - queueTail) >= MCP2515_QUEUE_SIZE)
+   {
+      queueDrops++;
+      LeaveCritical(mask);
+      return false;
+   }
+
+   spi_transfer_t *t = &transferQueue[queueHead & (MCP2515_QUEUE_SIZE - 1)];
+
+   for (uint8_t i = 0; i < length; i++)
+      t->txData[i] = txData[i];
+   t->length = length;
+   t->callback = callback;
+   t->context = context;
+   queueHead = queueHead + 1;
+
+   LeaveCritical(mask);
+
+   StartNext();
+   return true;
+}
+
+//Read all 13 bytes of an RX buffer, the callback gets them at rxData[1]
+bool MCP2515_Queue_Read_RxbSequence(uint8_t readRxBuffInst, MCP2515_Callback callback, void *context)
+{
+   uint8_t txData[MCP2515_MAX_TRANSFER] = { readRxBuffInst };
+
+   return MCP2515_Queue(txData, MCP2515_MAX_TRANSFER, callback, context);
+}
+
+bool MCP2515_Queue_Load_TxSequence(uint8_t loadtxBnSidhInst, const uint8_t *idReg, uint8_t dlc, const uint8_t *txData)
+{
+   uint8_t data[MCP2515_MAX_TRANSFER];
+
+   data[0] = loadtxBnSidhInst;
+   for (uint8_t i = 0; i < 4; i++)
+      data[1 + i] = idReg[i];
+   data[5] = dlc;
+   for (uint8_t i = 0; i < 8; i++)
+      data[6 + i] = txData[i];
+
+   return MCP2515_Queue(data, sizeof(data), 0, 0);
+}
+
+bool MCP2515_Queue_Write_ByteSequence(uint8_t startAddress, uint8_t endAddress, const uint8_t *data)
+{
+   uint8_t txData[MCP2515_MAX_TRANSFER];
+   uint8_t length = 2;
+
+   txData[0] = MCP2515_WRITE;
+   txData[1] = startAddress;
+   do
+   {
+      if (length >= MCP2515_MAX_TRANSFER) return false;
+      txData[length++] = *(data++);
+   }
+   while(startAddress++ != endAddress);
+
+   return MCP2515_Queue(txData, length, 0, 0);
+}
+
+//READ STATUS or RX STATUS, the status byte is passed to the callback at rxData[1]
+bool MCP2515_Queue_Read_Status(uint8_t statusInst, MCP2515_Callback callback, void *context)
+{
+   uint8_t txData[2] = { statusInst, 0 };
+
+   return MCP2515_Queue(txData, sizeof(txData), callback, context);
+}
+
+bool MCP2515_Queue_RequestToSend(uint8_t rtsTxBuffInst, MCP2515_Callback callback, void *context)
+{
+   return MCP2515_Queue(&rtsTxBuffInst, 1, callback, context);
+}
+
+bool MCP2515_Queue_Bit_Modify(uint8_t regAddress, uint8_t maskByte, uint8_t dataByte)
+{
+   uint8_t txData[4] = { MCP2515_BIT_MOD, regAddress, maskByte, dataByte };
+
+   return MCP2515_Queue(txData, sizeof(txData), 0, 0);
+}
+
+//Number of transactions that can still be queued
+uint32_t MCP2515_Get_QueueSpace(void)
+{
+   return MCP2515_QUEUE_SIZE - (queueHead - queueTail);
+}
+
+uint32_t MCP2515_Get_QueueDrops(void)
+{
+   return queueDrops;
+}
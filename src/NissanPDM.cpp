@@ -20,6 +20,7 @@
  */
 
 #include "NissanPDM.h"
+#include "candispatch.h"
 #include "my_fp.h"
 #include "my_math.h"
 #include "stm32_can.h"
@@ -84,8 +85,8 @@ QC CAN----------------------PDM EV CAN
 void NissanPDM::SetCanInterface(CanHardware* c)
 {
    can = c;
-   can->RegisterUserMessage(0x679);//Leaf obc msg
-   can->RegisterUserMessage(0x390);//Leaf obc msg
+   CanDispatch::RegisterUserMessage(can, 0x679);//Leaf obc msg
+   CanDispatch::RegisterUserMessage(can, 0x390);//Leaf obc msg
 }
 
 void NissanPDM::DecodeCAN(int id, uint32_t data[2])
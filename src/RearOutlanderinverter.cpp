@@ -18,10 +18,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "rearoutlanderinverter.h"
+#include "candispatch.h"
+#include "canfreshness.h"
+#include "hotparams.h"
 #include "my_math.h"
 #include "params.h"
 
 RearOutlanderInverter::RearOutlanderInverter()
+    : response(0x289, 10000, 40, 10) //torque steps of 2%, speed changes of 10rpm
 {
     //ctor
 }
@@ -30,9 +34,12 @@ void RearOutlanderInverter::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x289);//Outlander Inv Msg
-    can->RegisterUserMessage(0x299);//Outlander Inv Msg
-    can->RegisterUserMessage(0x733);//Outlander Inv Msg
+    CanDispatch::RegisterUserMessage(can, 0x289);//Outlander Inv Msg
+    CanDispatch::RegisterUserMessage(can, 0x299);//Outlander Inv Msg
+    CanDispatch::RegisterUserMessage(can, 0x733);//Outlander Inv Msg
+    CanFreshness::Expect(0x289, 10);
+    CanFreshness::Expect(0x733, 100);
+    CanFreshness::LinkCommand(0x289, 0x287);
 }
 
 void RearOutlanderInverter::DecodeCAN(int id, uint32_t data[2])
@@ -45,6 +52,7 @@ void RearOutlanderInverter::DecodeCAN(int id, uint32_t data[2])
         //voltage = ((data[1] & 0xFF) << 8) | ((data[1] >> 8) & 0xFF);
         speed = (bytes[2] * 256 | bytes[3]) - 20000;
         voltage = (bytes[4] * 256) + bytes[5];
+        response.Feedback(speed);
         break;
     case 0x299:
         //motor_temp = bytes[0] -40;
@@ -61,7 +69,7 @@ void RearOutlanderInverter::DecodeCAN(int id, uint32_t data[2])
 void RearOutlanderInverter::SetTorque(float torquePercent)
 {
 
-    if(Param::GetInt(Param::reversemotor) == 0)
+    if(HotParams::reversemotor == 0)
     {
 
         final_torque_request = 10000 + (torquePercent * 20); //!! Moved into parameter *-1 reverses torque direction
@@ -71,24 +79,27 @@ void RearOutlanderInverter::SetTorque(float torquePercent)
         final_torque_request = 10000 - (torquePercent * 20);
     }
 
+    torqueFrame[0] = (final_torque_request & 0xff)<<24 | (final_torque_request & 0xff00)<<8; // swap high and low bytes and shift 16 bit left
+    // enable inverter. Byte 6 0x0 to disable inverter, 0x3 for drive ( torque > 0 )
+    torqueFrame[1] = (final_torque_request == 10000 ? 0x00 : 0x03)<<16;
+
+    response.Step(final_torque_request);
+
     Param::SetInt(Param::torque,final_torque_request);//post processed final torque value sent to inv to web interface
 }
 
 void RearOutlanderInverter::Task10Ms()
 {
     run10ms++;
+    response.Tick();
 
-    //Run every 50 ms
-    if (run10ms == 5)
+    //Run every 10, 20 or 50 ms as set by outlrate
+    if (run10ms >= HotParams::outlanderPeriod)
     {
-        uint32_t data[2];
         run10ms = 0;
 
-        data[0] = (final_torque_request & 0xff)<<24 | (final_torque_request & 0xff00)<<8; // swap high and low bytes and shift 16 bit left
-        // enable inverter. Byte 6 0x0 to disable inverter, 0x3 for drive ( torque > 0 )
-        data[1] = (final_torque_request == 10000 ? 0x00 : 0x03)<<16;
-
-        can->Send(0x287, data, 8);
+        can->Send(0x287, torqueFrame, 8);
+        response.Sent(final_torque_request, speed);
     }
 }
 
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <TeslaDCDC.h>
+#include "candispatch.h"
 /* This is an interface for The Tesla GEN2 DCDC converter
  * https://openinverter.org/wiki/Tesla_Model_S/X_DC/DC_Converter
  */
@@ -24,7 +25,7 @@
  void TeslaDCDC::SetCanInterface(CanHardware* c)
 {
    can = c;
-   can->RegisterUserMessage(0x210);
+   CanDispatch::RegisterUserMessage(can, 0x210);
 }
 
 // Process voltage , current and temperature message from the Model s/x DCDC converter.
@@ -82,6 +82,7 @@ return tmp;
 #include "CANSPI.h"
 #include "digio.h"
 #include "utils.h"
+#include "sequencer.h"
 
 static uCAN_MSG txMessage_Ampera;
 static uint8_t ampera_msg_cnt=0;
@@ -91,6 +92,11 @@ AmperaHeater::AmperaHeater()
    //ctor
 }
 
+AmperaHeater::~AmperaHeater()
+{
+   Sequencer::Cancel(WakeupStep, this);
+}
+
 void AmperaHeater::SetPower(uint16_t power, bool heatReq)
 {
    if(power==0) isAwake = false;//if we are disabled do nothing but set isAwake to false for next wakeup ...
@@ -100,8 +106,9 @@ void AmperaHeater::SetPower(uint16_t power, bool heatReq)
 
    if (!isAwake)
    {
-      SendWakeup();
-      isAwake = true;
+      //Keep quiet until the wakeup sequence has put the transceiver back into normal mode
+      Sequencer::Start(WakeupStep, this, WakeupDone);
+      return;
    }
 
    switch(ampera_msg_cnt)
@@ -223,38 +230,44 @@ void AmperaHeater::SetPower(uint16_t power, bool heatReq)
 }
 }
 
-#define FLASH_DELAY 9000
-static void delay(void)
-{
-   int i;
-   for (i = 0; i < FLASH_DELAY; i++)       /* Wait a bit. */
-      __asm__("nop");
-}
-
 /*
  * Wake up all SW-CAN devices by switching the transceiver to HV mode and
  * sending the command 0x100 and switching the HV mode off again.
+ * Runs from the sequencer with 1ms between the steps.
  */
-void AmperaHeater::SendWakeup()
+int AmperaHeater::WakeupStep(void* context, int step)
+{
+   (void)context;
+
+   switch (step)
+   {
+   case 0:
+      DigIo::sw_mode0.Clear();
+      DigIo::sw_mode1.Set();  // set HV mode
+      return 1;
+   case 1:
+      // 0x100, False, 0, 00,00,00,00,00,00,00,00
+      txMessage_Ampera.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
+      txMessage_Ampera.frame.id = 0x100;
+      txMessage_Ampera.frame.dlc = 8;
+      txMessage_Ampera.frame.data0 = 0x00;
+      txMessage_Ampera.frame.data1 = 0x00;
+      txMessage_Ampera.frame.data2 = 0x00;
+      txMessage_Ampera.frame.data3 = 0x00;
+      txMessage_Ampera.frame.data4 = 0x00;
+      txMessage_Ampera.frame.data5 = 0x00;
+      txMessage_Ampera.frame.data6 = 0x00;
+      txMessage_Ampera.frame.data7 = 0x00;
+      CANSPI_Transmit(&txMessage_Ampera);
+      return 1;
+   default:
+      DigIo::sw_mode0.Set();
+      DigIo::sw_mode1.Set();  // set normal mode
+      return Sequencer::DONE;
+   }
+}
+
+void AmperaHeater::WakeupDone(void* context)
 {
-   DigIo::sw_mode0.Clear();
-   DigIo::sw_mode1.Set();  // set HV mode
-   delay();
-   // 0x100, False, 0, 00,00,00,00,00,00,00,00
-   txMessage_Ampera.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
-   txMessage_Ampera.frame.id = 0x100;
-   txMessage_Ampera.frame.dlc = 8;
-   txMessage_Ampera.frame.data0 = 0x00;
-   txMessage_Ampera.frame.data1 = 0x00;
-   txMessage_Ampera.frame.data2 = 0x00;
-   txMessage_Ampera.frame.data3 = 0x00;
-   txMessage_Ampera.frame.data4 = 0x00;
-   txMessage_Ampera.frame.data5 = 0x00;
-   txMessage_Ampera.frame.data6 = 0x00;
-   txMessage_Ampera.frame.data7 = 0x00;
-   CANSPI_Transmit(&txMessage_Ampera);
-   //may need delay here
-   delay();
-   DigIo::sw_mode0.Set();
-   DigIo::sw_mode1.Set();  // set normal mode
+   ((AmperaHeater*)context)->isAwake = true;
 }
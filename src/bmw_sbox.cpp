@@ -26,6 +26,7 @@
 
 
 #include <bmw_sbox.h>
+#include "candispatch.h"
 
 int32_t SBOX::Amperes;
 int32_t SBOX::Ah;
@@ -89,9 +90,9 @@ uint8_t BMW_crc8(const uint8_t * data, const uint16_t size)
 
 void SBOX::RegisterCanMessages(CanHardware* can)
 {
-   can->RegisterUserMessage(0x200);//SBOX MSG
-   can->RegisterUserMessage(0x210);//SBOX MSG
-   can->RegisterUserMessage(0x220);//SBOX MSG
+   CanDispatch::RegisterUserMessage(can, 0x200);//SBOX MSG
+   CanDispatch::RegisterUserMessage(can, 0x210);//SBOX MSG
+   CanDispatch::RegisterUserMessage(can, 0x220);//SBOX MSG
 
 }
 
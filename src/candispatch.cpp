@@ -0,0 +1,101 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "candispatch.h"
+
+CanDispatch::Entry CanDispatch::canEntries[2][MAX_DISPATCH_IDS];
+CanDispatch::Entry CanDispatch::can3Entries[2][MAX_CAN3_DISPATCH_IDS];
+CanDispatch::Table CanDispatch::tables[BUS_LAST] =
+{
+   { { canEntries[0], canEntries[1] }, { 0, 0 }, MAX_DISPATCH_IDS, 0 },
+   { { can3Entries[0], can3Entries[1] }, { 0, 0 }, MAX_CAN3_DISPATCH_IDS, 0 }
+};
+CanDispatch::owners CanDispatch::currentOwner = CanDispatch::OWN_INVERTER;
+
+void CanDispatch::Clear()
+{
+   for (int i = 0; i < BUS_LAST; i++)
+   {
+      int back = !tables[i].front;
+
+      tables[i].numIds[back] = 0;
+      __asm__ volatile("" ::: "memory");
+      tables[i].front = back;
+   }
+}
+
+void CanDispatch::AddId(uint32_t id, buses bus)
+{
+   Table& t = tables[bus];
+   int front = t.front;
+   int back = !front;
+   const Entry* src = t.entries[front];
+   Entry* dst = t.entries[back];
+   int numIds = t.numIds[front];
+   int pos = 0;
+
+   while (pos < numIds && src[pos].id < id) pos++;
+
+   bool known = pos < numIds && src[pos].id == id;
+
+   if (!known && numIds >= t.size) return; //CanHardware will refuse it as well
+
+   //Registration is rare, so copying the table keeps the published one untouched
+   for (int i = 0; i < pos; i++)
+      dst[i] = src[i];
+
+   if (known)
+   {
+      for (int i = pos; i < numIds; i++)
+         dst[i] = src[i];
+      dst[pos].mask |= 1 << currentOwner;
+   }
+   else
+   {
+      for (int i = numIds; i > pos; i--)
+         dst[i] = src[i - 1];
+      dst[pos].id = id;
+      dst[pos].mask = 1 << currentOwner;
+      numIds++;
+   }
+
+   t.numIds[back] = numIds;
+   //Table must be complete before the receive path can see it
+   __asm__ volatile("" ::: "memory");
+   t.front = back;
+}
+
+uint16_t CanDispatch::GetOwners(uint32_t id, buses bus)
+{
+   int front = tables[bus].front;
+   const Entry* table = tables[bus].entries[front];
+   int low = 0;
+   int high = tables[bus].numIds[front] - 1;
+
+   while (low <= high)
+   {
+      int mid = (low + high) / 2;
+
+      if (table[mid].id == id)
+         return table[mid].mask;
+      else if (table[mid].id < id)
+         low = mid + 1;
+      else
+         high = mid - 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "canfilteropt.h"
+#ifdef STM32F1
+#include <libopencm3/stm32/can.h>
+#endif
+
+#define STD_MASK 0x7FF
+#define EXT_MASK 0x1FFFFFFF
+
+/** Compute the filter banks for a set of IDs, IDs above 0x7FF are extended.
+ * @return false if the IDs can't be placed, i.e. bankBudget is below 2
+ */
+bool CanFilterOpt::Optimise(const uint32_t* ids, int numIds, int bankBudget, Result& result)
+{
+   Group groups[MAX_IDS];
+   int numGroups = 0;
+
+   if (bankBudget > MAX_BANKS) bankBudget = MAX_BANKS;
+
+   //Exact entries, duplicates removed
+   for (int i = 0; i < numIds && numGroups < MAX_IDS; i++)
+   {
+      bool ext = ids[i] > STD_MASK;
+      bool known = false;
+
+      for (int j = 0; j < numGroups && !known; j++)
+         known = groups[j].value == ids[i] && groups[j].ext == ext;
+
+      if (!known)
+      {
+         groups[numGroups].value = ids[i];
+         groups[numGroups].mask = ext ? EXT_MASK : STD_MASK;
+         groups[numGroups].ext = ext;
+         numGroups++;
+      }
+   }
+
+   result.registered = numGroups;
+
+   while (BanksNeeded(groups, numGroups) > bankBudget)
+   {
+      int bestA = -1, bestB = -1;
+      uint32_t bestCost = 0xFFFFFFFF;
+
+      for (int a = 0; a < numGroups; a++)
+      {
+         for (int b = a + 1; b < numGroups; b++)
+         {
+            if (groups[a].ext != groups[b].ext) continue;
+
+            //IDs the merged entry accepts on top of the two, overlapping entries cost nothing
+            uint32_t merged = Covered(Merge(groups[a], groups[b]));
+            uint32_t both = Covered(groups[a]) + Covered(groups[b]);
+            uint32_t cost = merged > both ? merged - both : 0;
+
+            if (cost < bestCost)
+            {
+               bestCost = cost;
+               bestA = a;
+               bestB = b;
+            }
+         }
+      }
+
+      if (bestA < 0) return false;
+
+      Group merged = Merge(groups[bestA], groups[bestB]);
+      int kept = 0;
+
+      groups[bestA] = merged;
+
+      //Drop the partner and everything else the merged entry accepts anyway
+      for (int i = 0; i < numGroups; i++)
+      {
+         const Group& g = groups[i];
+         bool inside = i != bestA && g.ext == merged.ext &&
+                       (g.mask & merged.mask) == merged.mask && (g.value & merged.mask) == merged.value;
+
+         if (!inside) groups[kept++] = g;
+      }
+      numGroups = kept;
+   }
+
+   BuildBanks(groups, numGroups, result);
+   return true;
+}
+
+//Unregistered IDs that pass the filters, in percent of all IDs that pass
+uint32_t CanFilterOpt::FalseAcceptPercent(const Result& result)
+{
+   if (result.accepted == 0) return 0;
+   return (result.accepted - result.registered) * 100 / result.accepted;
+}
+
+/** Write the banks to the filter banks firstBank..lastBank, unused ones are disabled.
+ * The banks alternate between FIFO 0 and 1 like the libopeninv driver does.
+ */
+void CanFilterOpt::Apply(const Result& result, int firstBank, int lastBank)
+{
+#ifdef STM32F1
+   for (int nr = firstBank; nr <= lastBank; nr++)
+   {
+      int i = nr - firstBank;
+      uint32_t fifo = nr & 1;
+
+      if (i >= result.numBanks)
+      {
+         can_filter_init(nr, false, false, 0, 0, fifo, false);
+         continue;
+      }
+
+      const uint32_t* v = result.banks[i].value;
+
+      switch (result.banks[i].type)
+      {
+      case LIST16:
+         can_filter_id_list_16bit_init(nr, v[0], v[1], v[2], v[3], fifo, true);
+         break;
+      case MASK16:
+         can_filter_id_mask_16bit_init(nr, v[0], v[1], v[2], v[3], fifo, true);
+         break;
+      case LIST32:
+         can_filter_id_list_32bit_init(nr, v[0], v[1], fifo, true);
+         break;
+      case MASK32:
+         can_filter_id_mask_32bit_init(nr, v[0], v[1], fifo, true);
+         break;
+      }
+   }
+#else
+   (void)result;
+   (void)firstBank;
+   (void)lastBank;
+#endif
+}
+
+//CAN1 owns the banks below this one, CAN2 the others up to 27
+int CanFilterOpt::GetCan2StartBank()
+{
+#ifdef STM32F1
+   return (CAN_FMR(CAN1) >> 8) & 0x3F;
+#else
+   return 14;
+#endif
+}
+
+int CanFilterOpt::BanksNeeded(const Group* groups, int numGroups)
+{
+   int stdExact = 0, stdMasked = 0, extExact = 0, extMasked = 0;
+
+   for (int i = 0; i < numGroups; i++)
+   {
+      const Group& g = groups[i];
+
+      if (g.ext)
+         g.mask == EXT_MASK ? extExact++ : extMasked++;
+      else
+         g.mask == STD_MASK ? stdExact++ : stdMasked++;
+   }
+
+   return (stdExact + 3) / 4 + (stdMasked + 1) / 2 + (extExact + 1) / 2 + extMasked;
+}
+
+//Number of IDs accepted by a group
+uint32_t CanFilterOpt::Covered(const Group& g)
+{
+   int freeBits = (g.ext ? 29 : 11) - __builtin_popcount(g.mask);
+   return 1u << freeBits;
+}
+
+//Smallest group that accepts the IDs of both
+CanFilterOpt::Group CanFilterOpt::Merge(const Group& a, const Group& b)
+{
+   Group m;
+
+   m.ext = a.ext;
+   m.mask = a.mask & b.mask & ~(a.value ^ b.value);
+   m.value = a.value & m.mask;
+   return m;
+}
+
+/* Register layout, 16 bit: STID[10:0] RTR IDE EXID[17:15], 32 bit: STID[10:0]
+ * EXID[17:0] IDE RTR 0. RTR and IDE are always compared, so a standard entry
+ * never accepts extended or remote frames and vice versa. Unused list slots
+ * repeat the first ID of the bank.
+ */
+void CanFilterOpt::BuildBanks(const Group* groups, int numGroups, Result& result)
+{
+   int slot[4] = { 0, 0, 0, 0 };
+   int current[4] = { -1, -1, -1, -1 };
+   static const int slotsPerBank[4] = { 4, 2, 2, 1 };
+
+   result.numBanks = 0;
+   result.accepted = 0;
+
+   for (int i = 0; i < numGroups; i++)
+   {
+      const Group& g = groups[i];
+      bool exact = g.mask == (g.ext ? EXT_MASK : STD_MASK);
+      int type = g.ext ? (exact ? LIST32 : MASK32) : (exact ? LIST16 : MASK16);
+
+      result.accepted += Covered(g);
+
+      if (current[type] < 0 || slot[type] == slotsPerBank[type])
+      {
+         current[type] = result.numBanks++;
+         slot[type] = 0;
+         result.banks[current[type]].type = type;
+      }
+
+      uint32_t* v = result.banks[current[type]].value;
+      int s = slot[type]++;
+
+      switch (type)
+      {
+      case LIST16:
+         v[s] = g.value << 5;
+         for (int j = s + 1; j < 4; j++) v[j] = v[0];
+         break;
+      case MASK16:
+         v[2 * s] = g.value << 5;
+         v[2 * s + 1] = (g.mask << 5) | 0x18;
+         if (s == 0) { v[2] = v[0]; v[3] = v[1]; }
+         break;
+      case LIST32:
+         v[s] = (g.value << 3) | 0x4;
+         if (s == 0) v[1] = v[0];
+         break;
+      case MASK32:
+         v[0] = (g.value << 3) | 0x4;
+         v[1] = (g.mask << 3) | 0x6;
+         break;
+      }
+   }
+}
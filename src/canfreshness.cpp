@@ -0,0 +1,292 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "canfreshness.h"
+#include "candispatch.h"
+#include "my_math.h"
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
+
+CanFreshness::Entry CanFreshness::entries[MAX_IDS];
+int CanFreshness::numIds;
+int CanFreshness::numLinks;
+uint32_t CanFreshness::clearMs;
+uint32_t CanFreshness::updateMs;
+
+//Called before the drivers declare their IDs, IDs that never arrive age from nowMs
+void CanFreshness::Clear(uint32_t nowMs)
+{
+   numIds = 0;
+   numLinks = 0;
+   clearMs = nowMs;
+   updateMs = nowMs;
+}
+
+void CanFreshness::Expect(uint32_t id, uint16_t periodMs)
+{
+   int pos = 0;
+
+   if (periodMs == 0 || Find(id) != 0 || numIds >= MAX_IDS) return;
+
+   while (pos < numIds && entries[pos].id < id) pos++;
+
+   for (int i = numIds; i > pos; i--)
+      entries[i] = entries[i - 1];
+
+   memset(&entries[pos], 0, sizeof(Entry));
+   entries[pos].id = id;
+   entries[pos].periodMs = periodMs;
+   entries[pos].lastMs = clearMs;
+   entries[pos].owner = CanDispatch::GetOwner();
+   numIds++;
+}
+
+//id must have been declared with Expect() before
+void CanFreshness::LinkCommand(uint32_t id, uint32_t commandId)
+{
+   Entry* e = Find(id);
+
+   if (e != 0 && e->commandId == 0)
+   {
+      e->commandId = commandId;
+      numLinks++;
+   }
+}
+
+void CanFreshness::Stamp(uint32_t id, uint32_t nowMs)
+{
+   Entry* e = Find(id);
+
+   if (e == 0) return;
+
+   if (e->frames > 0)
+   {
+      uint32_t gap = nowMs - e->lastMs;
+      uint32_t period = e->periodMs;
+      uint32_t deviation = gap > period ? gap - period : period - gap;
+      uint32_t eighths = deviation * 8 / period;
+      int bin = eighths < 1 ? 0 : eighths < 2 ? 1 : eighths < 4 ? 2 : eighths < 8 ? 3 : 4;
+
+      if (e->jitter[bin] < 0xFFFF) e->jitter[bin]++;
+      if (gap > e->maxGapMs) e->maxGapMs = gap > 0xFFFF ? 0xFFFF : gap;
+      //A gap of 1.5 periods or more means at least one frame was lost
+      if (gap * 2 >= period * 3) e->missed += (gap + period / 2) / period - 1;
+   }
+
+   if (e->commandPending)
+   {
+      uint32_t latency = nowMs - e->commandMs;
+
+      e->latencyMs = latency > 0xFFFF ? 0xFFFF : latency;
+      if (e->latencyMs > e->maxLatencyMs) e->maxLatencyMs = e->latencyMs;
+      e->commandPending = false;
+   }
+
+   e->frames++;
+   e->lastMs = nowMs;
+}
+
+//Starts a latency measurement on every ID linked to commandId that isn't measuring yet
+void CanFreshness::CommandSent(uint32_t commandId, uint32_t nowMs)
+{
+   if (numLinks == 0) return;
+
+   for (int i = 0; i < numIds; i++)
+   {
+      Entry& e = entries[i];
+
+      if (e.commandId != commandId) continue;
+
+      e.sentMs = nowMs;
+
+      if (!e.commandPending)
+      {
+         e.commandMs = nowMs;
+         e.commandPending = true;
+      }
+   }
+}
+
+//Starts a response measurement waitedMs before the last command linked to id.
+//Returns false when id has no command or the previous response is still awaited
+bool CanFreshness::ExpectResponse(uint32_t id, uint32_t waitedMs)
+{
+   Entry* e = Find(id);
+
+   if (e == 0 || e->commandId == 0) return false;
+   if (e->responsePending && e->sentMs - e->responseStartMs < RESPONSE_TIMEOUT_MS) return false;
+
+   e->responseStartMs = e->sentMs - waitedMs;
+   e->responsePending = true;
+   return true;
+}
+
+//Ends the response measurement at the last arrival of id
+void CanFreshness::Responded(uint32_t id)
+{
+   Entry* e = Find(id);
+
+   if (e == 0 || !e->responsePending) return;
+
+   uint32_t response = e->lastMs - e->responseStartMs;
+
+   e->responsePending = false;
+   if (response >= RESPONSE_TIMEOUT_MS) return;
+
+   e->responseMs = response;
+   if (e->responseMs > e->maxResponseMs) e->maxResponseMs = e->responseMs;
+}
+
+//Keeps the declarations and arrival times, clears the histograms and counters
+void CanFreshness::ResetStats()
+{
+   for (int i = 0; i < numIds; i++)
+   {
+      Entry& e = entries[i];
+
+      memset(e.jitter, 0, sizeof(e.jitter));
+      e.missed = 0;
+      e.maxGapMs = 0;
+      e.maxLatencyMs = 0;
+      e.maxResponseMs = 0;
+      if (e.frames == 0) e.lastMs = updateMs;
+   }
+}
+
+//Index of the ID that is most overdue relative to its period, -1 without IDs
+int CanFreshness::GetWorst()
+{
+   int worst = -1;
+   uint32_t worstPeriods = 0;
+
+   for (int i = 0; i < numIds; i++)
+   {
+      //In 1/16 periods so that IDs with different periods compare
+      uint32_t periods = GetAge(i) * 16 / entries[i].periodMs;
+
+      if (worst < 0 || periods > worstPeriods)
+      {
+         worst = i;
+         worstPeriods = periods;
+      }
+   }
+   return worst;
+}
+
+uint32_t CanFreshness::GetTotalMissed()
+{
+   uint32_t missed = 0;
+
+   for (int i = 0; i < numIds; i++)
+      missed += entries[i].missed;
+
+   return missed;
+}
+
+uint16_t CanFreshness::GetMaxLatency()
+{
+   uint16_t latency = 0;
+
+   for (int i = 0; i < numIds; i++)
+      if (entries[i].maxLatencyMs > latency) latency = entries[i].maxLatencyMs;
+
+   return latency;
+}
+
+uint16_t CanFreshness::GetMaxResponse()
+{
+   uint16_t response = 0;
+
+   for (int i = 0; i < numIds; i++)
+      if (entries[i].maxResponseMs > response) response = entries[i].maxResponseMs;
+
+   return response;
+}
+
+CanFreshness::Entry* CanFreshness::Find(uint32_t id)
+{
+   int low = 0;
+   int high = numIds - 1;
+
+   while (low <= high)
+   {
+      int mid = (low + high) / 2;
+
+      if (entries[mid].id == id)
+         return &entries[mid];
+      else if (entries[mid].id < id)
+         low = mid + 1;
+      else
+         high = mid - 1;
+   }
+
+   return 0;
+}
+
+CanResponse::CanResponse(uint32_t id, int32_t command, int16_t step, int16_t change)
+   : feedbackId(id), sentCommand(command), watch(0), minStep(step), minChange(change), stepTicks(-1)
+{
+}
+
+//A large enough change waits for the next command frame, Tick() counts how long
+void CanResponse::Step(int32_t command)
+{
+   int32_t step = command - sentCommand;
+
+   if (stepTicks < 0 && ABS(step) >= minStep) stepTicks = 0;
+}
+
+void CanResponse::Sent(int32_t command, int16_t feedback)
+{
+   int32_t step = command - sentCommand;
+
+   if (stepTicks < 0) return;
+
+   sentCommand = command;
+
+   if (step != 0 && CanFreshness::ExpectResponse(feedbackId, stepTicks * 10))
+      watch = (uint16_t)feedback | (step > 0 ? UP : DOWN);
+   stepTicks = -1;
+}
+
+void CanResponse::Feedback(int16_t value)
+{
+   uint32_t w = watch;
+
+   if (w == 0) return;
+
+   int32_t change = value - (int16_t)(w & 0xFFFF);
+
+   if (w & DOWN) change = -change;
+   if (change < minChange) return;
+
+#ifdef STM32F1
+   uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+   //Unless Sent() has started the next measurement meanwhile
+   if (watch == w)
+   {
+      CanFreshness::Responded(feedbackId);
+      watch = 0;
+   }
+
+#ifdef STM32F1
+   cm_mask_interrupts(irqMask);
+#endif
+}
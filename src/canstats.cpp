@@ -0,0 +1,97 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "canstats.h"
+#ifdef STM32F1
+#include <libopencm3/stm32/can.h>
+#endif
+
+CanStats::Bus CanStats::stats[NUM_BUSES];
+uint32_t CanStats::bitrates[NUM_BUSES] = { 500000, 500000, 500000 };
+
+/* Length of a data frame on the wire including the interframe space, with
+ * the worst case number of stuff bits. Identifiers above 0x7FF are sent as
+ * extended frames, like the drivers do.
+ */
+uint32_t CanStats::FrameBits(uint32_t id, uint8_t dlc)
+{
+   uint32_t payload = 8 * (dlc > 8 ? 8 : dlc);
+   //SOF to the end of the CRC is subject to bit stuffing, CRC delimiter, ACK, EOF and IFS are not
+   uint32_t stuffed = (id > 0x7FF ? 54 : 34) + payload;
+
+   return stuffed + (stuffed - 1) / 4 + 13;
+}
+
+void CanStats::SetErrors(buses bus, uint8_t tec, uint8_t rec, bool busOff, bool busOffSeen)
+{
+   Bus& s = stats[bus];
+
+   //Count a new event when we see the transition or the controller reports one we missed
+   if (!s.busOff && (busOff || busOffSeen))
+      s.busOffEvents++;
+
+   s.tec = tec;
+   s.rec = rec;
+   s.busOff = busOff;
+}
+
+//Called every intervalMs from Ms100Task
+void CanStats::Update(uint32_t intervalMs)
+{
+   for (int i = 0; i < NUM_BUSES; i++)
+   {
+      Bus& s = stats[i];
+      uint32_t rxFrames = s.rxFrames, txFrames = s.txFrames, bytes = s.bytes, bits = s.bits;
+
+      s.rxRate = (rxFrames - s.lastRxFrames) * 1000 / intervalMs;
+      s.txRate = (txFrames - s.lastTxFrames) * 1000 / intervalMs;
+      s.byteRate = (bytes - s.lastBytes) * 1000 / intervalMs;
+      //bits * 100% / (bitrate * intervalMs / 1000)
+      uint32_t available = bitrates[i] / 10 * intervalMs / 100;
+      s.load = available > 0 ? (bits - s.lastBits) * 100 / available : 0;
+
+      s.lastRxFrames = rxFrames;
+      s.lastTxFrames = txFrames;
+      s.lastBytes = bytes;
+      s.lastBits = bits;
+   }
+}
+
+/* Reads the error counters of a bxCAN controller. The bus off interrupt flag
+ * is latched in ERRI without enabling the interrupt in the NVIC, so a bus off
+ * that has already been recovered from between two calls is counted as well.
+ */
+void CanStats::ReadBxCanErrors(buses bus, uint32_t canBase)
+{
+#ifdef STM32F1
+   uint32_t esr = CAN_ESR(canBase);
+   bool seen = (CAN_MSR(canBase) & CAN_MSR_ERRI) != 0;
+
+   CAN_IER(canBase) |= CAN_IER_ERRIE | CAN_IER_BOFIE;
+   if (seen) CAN_MSR(canBase) = CAN_MSR_ERRI; //write 1 to clear
+
+   SetErrors(bus, (esr >> 16) & 0xFF, esr >> 24, (esr & CAN_ESR_BOFF) != 0, seen);
+#else
+   (void)bus;
+   (void)canBase;
+#endif
+}
+
+void CanStats::Reset()
+{
+   for (int i = 0; i < NUM_BUSES; i++)
+      stats[i] = Bus();
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cantrace.h"
+#include "taskprofiler.h"
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
+
+CanTrace::Frame CanTrace::frames[SIZE];
+CanTrace::Filter CanTrace::filters[MAX_FILTERS];
+int CanTrace::numFilters;
+int CanTrace::head;
+int CanTrace::count;
+int CanTrace::postTrigger;
+uint32_t CanTrace::lastTicks;
+int CanTrace::lastError;
+volatile CanTrace::modes CanTrace::mode = CanTrace::STOPPED;
+
+//bus is 0..2 for CAN1..CAN3
+void CanTrace::Record(int bus, bool sent, uint32_t id, const uint32_t data[2], uint8_t dlc)
+{
+   if (mode == STOPPED) return;
+
+   bool pass = numFilters == 0;
+
+   for (int i = 0; i < numFilters && !pass; i++)
+      pass = (id & filters[i].mask) == filters[i].id;
+
+   if (!pass) return;
+
+#ifdef STM32F1
+   uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+   //Checked again, we may have been interrupted by the frame that completed a trigger
+   if (mode != STOPPED)
+   {
+      uint32_t now = TaskProfiler::GetTicks();
+      uint32_t us = TaskProfiler::ToMicroseconds(now - lastTicks);
+      Frame& f = frames[head];
+
+      f.id = id | (bus << BUS_SHIFT) | (sent ? SENT : 0);
+      f.deltaUs = us > 0xFFFF ? 0xFFFF : us;
+      f.dlc = dlc;
+      f.data[0] = data[0];
+      f.data[1] = data[1];
+
+      lastTicks = now;
+      head = (head + 1) & (SIZE - 1);
+      if (count < SIZE) count++;
+
+      if (mode == TRIGGERED && --postTrigger <= 0) mode = STOPPED;
+   }
+
+#ifdef STM32F1
+   cm_mask_interrupts(irqMask);
+#endif
+}
+
+//Starts a new capture, triggered captures stop POST_TRIGGER frames after the trigger
+void CanTrace::Start(bool triggered)
+{
+   mode = STOPPED;
+   Clear();
+   mode = triggered ? ARMED : RUNNING;
+}
+
+void CanTrace::Trigger()
+{
+   if (mode == ARMED)
+   {
+      postTrigger = POST_TRIGGER;
+      mode = TRIGGERED;
+   }
+}
+
+//Called from Ms1Task with ErrorMessage::GetLastError(), triggers when it changes
+void CanTrace::CheckError(int error)
+{
+   if (error != lastError)
+   {
+      lastError = error;
+      Trigger();
+   }
+}
+
+void CanTrace::Clear()
+{
+   count = 0;
+   lastTicks = TaskProfiler::GetTicks();
+}
+
+//Record only IDs for which (id & mask) == (filterId & mask), IDs are compared without the flags
+bool CanTrace::AddFilter(uint32_t id, uint32_t mask)
+{
+   if (numFilters >= MAX_FILTERS) return false;
+
+   filters[numFilters].id = id & mask;
+   filters[numFilters].mask = mask;
+   numFilters++;
+   return true;
+}
@@ -0,0 +1,175 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cantxscheduler.h"
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
+
+CanTxScheduler::Message CanTxScheduler::messages[MAX_MESSAGES];
+uint32_t CanTxScheduler::tick;
+int CanTxScheduler::worstMeasured;
+
+/** Add a periodic frame, it is first sent on the next occurrence of its phase.
+ * @return false if the period doesn't fit the cycle or all slots are taken
+ */
+bool CanTxScheduler::Register(CanHardware* can, uint32_t id, uint8_t dlc, uint32_t periodMs, FillFunction fill, void* context)
+{
+   uint8_t load[CYCLE_MS];
+   uint32_t phases = periodMs < CYCLE_MS ? periodMs : CYCLE_MS;
+   uint32_t bestPhase = 0, bestMax = 0xFF, bestSum = 0xFFFF;
+
+   if (periodMs == 0 || (periodMs < CYCLE_MS && CYCLE_MS % periodMs) || (periodMs > CYCLE_MS && periodMs % CYCLE_MS))
+      return false;
+
+   GetSlotLoad(can, load);
+
+   //Pick the phase whose fullest slot is the emptiest, on a tie the one with the least frames overall
+   for (uint32_t phase = 0; phase < phases; phase++)
+   {
+      uint32_t max = 0, sum = 0;
+
+      for (uint32_t slot = phase; slot < CYCLE_MS; slot += phases)
+      {
+         if (load[slot] > max) max = load[slot];
+         sum += load[slot];
+      }
+
+      if (max < bestMax || (max == bestMax && sum < bestSum))
+      {
+         bestPhase = phase;
+         bestMax = max;
+         bestSum = sum;
+      }
+   }
+
+   bool registered = false;
+
+   //Drivers register from the main loop and from the timer tasks, claim the slot in one go
+#ifdef STM32F1
+   uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+   for (int i = 0; i < MAX_MESSAGES && !registered; i++)
+   {
+      Message& msg = messages[i];
+
+      if (!msg.active)
+      {
+         msg.can = can;
+         msg.fill = fill;
+         msg.context = context;
+         msg.id = id;
+         msg.dlc = dlc;
+         msg.periodMs = periodMs;
+         msg.phase = bestPhase;
+         msg.active = true;
+         registered = true;
+      }
+   }
+
+#ifdef STM32F1
+   cm_mask_interrupts(irqMask);
+#endif
+
+   return registered;
+}
+
+//Removes all frames of a driver, called from its destructor
+void CanTxScheduler::Remove(void* context)
+{
+   for (int i = 0; i < MAX_MESSAGES; i++)
+   {
+      if (messages[i].context == context) messages[i].active = false;
+   }
+}
+
+//Called before the drivers register their frames again in SetCanFilters()
+void CanTxScheduler::Clear()
+{
+   for (int i = 0; i < MAX_MESSAGES; i++)
+      messages[i].active = false;
+}
+
+//Called from Ms1Task
+void CanTxScheduler::Run()
+{
+   uint32_t now = tick++;
+   int sent = 0;
+
+   for (int i = 0; i < MAX_MESSAGES; i++)
+   {
+      Message& msg = messages[i];
+
+      if (!msg.active || (now % msg.periodMs) != msg.phase) continue;
+
+      uint32_t data[2] = { 0, 0 };
+
+      if (msg.fill(msg.context, (uint8_t*)data))
+      {
+         msg.can->Send(msg.id, data, msg.dlc);
+         sent++;
+      }
+   }
+
+   if (sent > worstMeasured) worstMeasured = sent;
+}
+
+//@return the phase of a registered frame or -1
+int CanTxScheduler::GetPhase(uint32_t id, void* context)
+{
+   for (int i = 0; i < MAX_MESSAGES; i++)
+   {
+      const Message& msg = messages[i];
+      if (msg.active && msg.id == id && msg.context == context) return msg.phase;
+   }
+   return -1;
+}
+
+//Highest number of frames that can be due in the same ms on one interface
+int CanTxScheduler::GetWorstSlot(CanHardware* can)
+{
+   uint8_t load[CYCLE_MS];
+   int worst = 0;
+
+   GetSlotLoad(can, load);
+
+   for (uint32_t slot = 0; slot < CYCLE_MS; slot++)
+   {
+      if (load[slot] > worst) worst = load[slot];
+   }
+   return worst;
+}
+
+//Frames due in each ms of a cycle, frames with a period above CYCLE_MS count in every cycle
+void CanTxScheduler::GetSlotLoad(CanHardware* can, uint8_t load[CYCLE_MS])
+{
+   for (uint32_t slot = 0; slot < CYCLE_MS; slot++)
+      load[slot] = 0;
+
+   for (int i = 0; i < MAX_MESSAGES; i++)
+   {
+      const Message& msg = messages[i];
+
+      if (!msg.active || msg.can != can) continue;
+
+      uint32_t step = msg.periodMs < CYCLE_MS ? msg.periodMs : CYCLE_MS;
+
+      for (uint32_t slot = msg.phase; slot < CYCLE_MS; slot += step)
+         load[slot]++;
+   }
+}
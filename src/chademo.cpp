@@ -17,6 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "chademo.h"
+#include "sequencer.h"
+#include "candispatch.h"
 
 
 bool FCChademo::chargeEnabled = false;
@@ -39,12 +41,13 @@ static uint32_t chademoStartTime = 0;
 
 uCAN_MSG txMessage;
 
-#define FLASH_DELAY 8000
-static void delay(void)
+
+//The charger talks on CAN3, the CAN interface is unused
+void FCChademo::SetCanInterface(CanHardware* c)
 {
-   int i;
-   for (i = 0; i < FLASH_DELAY; i++)       /* Wait a bit. */
-      __asm__("nop");
+   can = c;
+   CanDispatch::RegisterCan3Message(0x108);
+   CanDispatch::RegisterCan3Message(0x109);
 }
 
 void FCChademo::DecodeCAN(int id, uint32_t data[2])
@@ -113,68 +116,81 @@ void FCChademo::CheckSensorDeviation(uint16_t internalVoltage)
 }
 
 void FCChademo::Task100Ms()//sends chademo messages every 100ms
+{
+   Sequencer::Start(SendStep); //0x100, 0x101 and 0x102 go out 1ms apart
+}
+
+int FCChademo::SendStep(void* context, int step)
 {
    uint32_t data[2];
    bool curSensFault = curTimeout > 10;
    bool vtgSensFault = vtgTimeout > 50;
 
-   //Capacity fixed to 200 - so SoC resolution is 0.5
-   data[0] = 0;
-   data[1] = (targetBatteryVoltage + 40) | 200 << 16;
-
-   txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
-   txMessage.frame.id = 0x100;
-   txMessage.frame.dlc = 8;
-   txMessage.frame.data0 = (data[0] & 0xFF);
-   txMessage.frame.data1 = (data[0]>>8 & 0xFF);
-   txMessage.frame.data2 = (data[0]>>16 & 0xFF);
-   txMessage.frame.data3 = (data[0]>>24 & 0xFF);
-   txMessage.frame.data4 = (data[1] & 0xFF);
-   txMessage.frame.data5 = (data[1]>>8 & 0xFF);
-   txMessage.frame.data6 = (data[1]>>16 & 0xFF);
-   txMessage.frame.data7 = (data[1]>>24 & 0xFF);
-   CANSPI_Transmit(&txMessage);
-   delay();
-
-   data[0] = 0x00FEFF00;
-   data[1] = 0;
-
-   txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
-   txMessage.frame.id = 0x101;
-   txMessage.frame.dlc = 8;
-   txMessage.frame.data0 = (data[0] & 0xFF);
-   txMessage.frame.data1 = (data[0]>>8 & 0xFF);
-   txMessage.frame.data2 = (data[0]>>16 & 0xFF);
-   txMessage.frame.data3 = (data[0]>>24 & 0xFF);
-   txMessage.frame.data4 = (data[1] & 0xFF);
-   txMessage.frame.data5 = (data[1]>>8 & 0xFF);
-   txMessage.frame.data6 = (data[1]>>16 & 0xFF);
-   txMessage.frame.data7 = (data[1]>>24 & 0xFF);
-   CANSPI_Transmit(&txMessage);
-   delay();
-
-
-   data[0] = 1 | ((uint32_t)targetBatteryVoltage << 8) | ((uint32_t)rampedCurReq << 24);
-   data[1] = (uint32_t)curSensFault << 2 |
-             (uint32_t)vtgSensFault << 4 |
-             (uint32_t)chargeEnabled << 8 |
-             (uint32_t)parkingPosition << 9 |
-             (uint32_t)fault << 10 |
-             (uint32_t)contactorOpen << 11 |
-             (uint32_t)soc << 16;
-
-   txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
-   txMessage.frame.id = 0x102;
-   txMessage.frame.dlc = 8;
-   txMessage.frame.data0 = (data[0] & 0xFF);
-   txMessage.frame.data1 = (data[0]>>8 & 0xFF);
-   txMessage.frame.data2 = (data[0]>>16 & 0xFF);
-   txMessage.frame.data3 = (data[0]>>24 & 0xFF);
-   txMessage.frame.data4 = (data[1] & 0xFF);
-   txMessage.frame.data5 = (data[1]>>8 & 0xFF);
-   txMessage.frame.data6 = (data[1]>>16 & 0xFF);
-   txMessage.frame.data7 = (data[1]>>24 & 0xFF);
-   CANSPI_Transmit(&txMessage);
+   (void)context;
+
+   switch (step)
+   {
+   case 0:
+      //Capacity fixed to 200 - so SoC resolution is 0.5
+      data[0] = 0;
+      data[1] = (targetBatteryVoltage + 40) | 200 << 16;
+
+      txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
+      txMessage.frame.id = 0x100;
+      txMessage.frame.dlc = 8;
+      txMessage.frame.data0 = (data[0] & 0xFF);
+      txMessage.frame.data1 = (data[0]>>8 & 0xFF);
+      txMessage.frame.data2 = (data[0]>>16 & 0xFF);
+      txMessage.frame.data3 = (data[0]>>24 & 0xFF);
+      txMessage.frame.data4 = (data[1] & 0xFF);
+      txMessage.frame.data5 = (data[1]>>8 & 0xFF);
+      txMessage.frame.data6 = (data[1]>>16 & 0xFF);
+      txMessage.frame.data7 = (data[1]>>24 & 0xFF);
+      CANSPI_Transmit(&txMessage);
+      return 1;
+
+   case 1:
+      data[0] = 0x00FEFF00;
+      data[1] = 0;
+
+      txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
+      txMessage.frame.id = 0x101;
+      txMessage.frame.dlc = 8;
+      txMessage.frame.data0 = (data[0] & 0xFF);
+      txMessage.frame.data1 = (data[0]>>8 & 0xFF);
+      txMessage.frame.data2 = (data[0]>>16 & 0xFF);
+      txMessage.frame.data3 = (data[0]>>24 & 0xFF);
+      txMessage.frame.data4 = (data[1] & 0xFF);
+      txMessage.frame.data5 = (data[1]>>8 & 0xFF);
+      txMessage.frame.data6 = (data[1]>>16 & 0xFF);
+      txMessage.frame.data7 = (data[1]>>24 & 0xFF);
+      CANSPI_Transmit(&txMessage);
+      return 1;
+
+   default:
+      data[0] = 1 | ((uint32_t)targetBatteryVoltage << 8) | ((uint32_t)rampedCurReq << 24);
+      data[1] = (uint32_t)curSensFault << 2 |
+                (uint32_t)vtgSensFault << 4 |
+                (uint32_t)chargeEnabled << 8 |
+                (uint32_t)parkingPosition << 9 |
+                (uint32_t)fault << 10 |
+                (uint32_t)contactorOpen << 11 |
+                (uint32_t)soc << 16;
+
+      txMessage.frame.idType = dSTANDARD_CAN_MSG_ID_2_0B;
+      txMessage.frame.id = 0x102;
+      txMessage.frame.dlc = 8;
+      txMessage.frame.data0 = (data[0] & 0xFF);
+      txMessage.frame.data1 = (data[0]>>8 & 0xFF);
+      txMessage.frame.data2 = (data[0]>>16 & 0xFF);
+      txMessage.frame.data3 = (data[0]>>24 & 0xFF);
+      txMessage.frame.data4 = (data[1] & 0xFF);
+      txMessage.frame.data5 = (data[1]>>8 & 0xFF);
+      txMessage.frame.data6 = (data[1]>>16 & 0xFF);
+      txMessage.frame.data7 = (data[1]>>24 & 0xFF);
+      CANSPI_Transmit(&txMessage);
+      return Sequencer::DONE;
+   }
 }
 
 
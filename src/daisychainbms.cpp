@@ -31,8 +31,11 @@
 void DaisychainBMS::SetCanInterface(CanHardware* c)
 {
    can = c;
-   can->RegisterUserMessage(0x4f1); // Primary BMS
-   can->RegisterUserMessage(0x4f5); // Secondary BMS
+   CanDispatch::RegisterUserMessage(can, 0x4f1); // Primary BMS
+   CanDispatch::RegisterUserMessage(can, 0x4f5); // Secondary BMS
+   CanFreshness::Expect(0x4f1, 100);
+   if (Param::GetInt(Param::BMS_Mode) == BMSModes::BMSModeDaisychainDualBMS)
+      CanFreshness::Expect(0x4f5, 100);
 }
 
 bool DaisychainBMS::BMSDataValid() {
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hotparams.h"
+#include "params.h"
+
+int HotParams::opmode;
+int HotParams::dir;
+int HotParams::speed;
+s32fp HotParams::udc;
+s32fp HotParams::idc;
+s32fp HotParams::tmphs;
+s32fp HotParams::tmpm;
+int HotParams::cruisespeed;
+int HotParams::canctr;
+bool HotParams::dinBrake;
+bool HotParams::dinForward;
+bool HotParams::dinReverse;
+
+int HotParams::inverter;
+int HotParams::reversemotor;
+int HotParams::inverterCan;
+int HotParams::shuntCan;
+int HotParams::shuntType;
+int HotParams::potmin;
+int HotParams::potmode;
+int HotParams::motActive;
+int HotParams::throtramprpm;
+s32fp HotParams::throtramp;
+s32fp HotParams::tmphsmax;
+s32fp HotParams::tmpmmax;
+float HotParams::udcsw;
+float HotParams::udclim;
+float HotParams::regenBrakeLight;
+s32fp HotParams::shiftCut;
+int HotParams::shiftDelay;
+int HotParams::outlanderPeriod;
+
+void HotParams::Refresh()
+{
+   opmode = Param::GetInt(Param::opmode);
+   dir = Param::GetInt(Param::dir);
+   speed = Param::GetInt(Param::speed);
+   udc = Param::Get(Param::udc);
+   idc = Param::Get(Param::idc);
+   tmphs = Param::Get(Param::tmphs);
+   tmpm = Param::Get(Param::tmpm);
+   cruisespeed = Param::GetInt(Param::cruisespeed);
+   canctr = Param::GetInt(Param::canctr);
+   dinBrake = Param::GetBool(Param::din_brake);
+   dinForward = Param::GetBool(Param::din_forward);
+   dinReverse = Param::GetBool(Param::din_reverse);
+}
+
+void HotParams::RefreshConfig()
+{
+   static const int outlanderPeriods[] = { 1, 2, 5 }; //outlrate 10, 20, 50ms
+
+   inverter = Param::GetInt(Param::Inverter);
+   reversemotor = Param::GetInt(Param::reversemotor);
+   inverterCan = Param::GetInt(Param::InverterCan);
+   shuntCan = Param::GetInt(Param::ShuntCan);
+   shuntType = Param::GetInt(Param::Type);
+   potmin = Param::GetInt(Param::potmin);
+   potmode = Param::GetInt(Param::potmode);
+   motActive = Param::GetInt(Param::MotActive);
+   throtramprpm = Param::GetInt(Param::throtramprpm);
+   throtramp = Param::Get(Param::throtramp);
+   tmphsmax = Param::Get(Param::tmphsmax);
+   tmpmmax = Param::Get(Param::tmpmmax);
+   udcsw = Param::GetFloat(Param::udcsw);
+   udclim = Param::GetFloat(Param::udclim);
+   regenBrakeLight = Param::GetFloat(Param::RegenBrakeLight);
+   shiftCut = Param::Get(Param::shiftcut);
+   shiftDelay = Param::GetInt(Param::shiftdelay) / 10;
+   outlanderPeriod = outlanderPeriods[Param::GetInt(Param::outlrate)];
+}
@@ -61,7 +61,7 @@ void clock_setup(void)
    rcc_periph_clock_enable(RCC_TIM2); //GS450H 500khz usart clock
    rcc_periph_clock_enable(RCC_TIM3); //PWM outputs
    rcc_periph_clock_enable(RCC_TIM4); //Scheduler
-   rcc_periph_clock_enable(RCC_DMA1);  //ADC, and UARTS
+   rcc_periph_clock_enable(RCC_DMA1);  //ADC, UARTS and SPI2
    // rcc_periph_clock_enable(RCC_DMA2);
    rcc_periph_clock_enable(RCC_ADC1);
    rcc_periph_clock_enable(RCC_CRC);
@@ -76,7 +76,8 @@ void clock_setup(void)
 void spi2_setup()   //spi 2 used for CAN3
 {
 
-   spi_init_master(SPI2, SPI_CR1_BAUDRATE_FPCLK_DIV_32, SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE,
+   //36MHz / 4 = 9MHz, the MCP2515 takes up to 10MHz
+   spi_init_master(SPI2, SPI_CR1_BAUDRATE_FPCLK_DIV_4, SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE,
                    SPI_CR1_CPHA_CLK_TRANSITION_1, SPI_CR1_DFF_8BIT, SPI_CR1_MSBFIRST);
    spi_set_standard_mode(SPI2,0);//set mode 0
 
@@ -144,6 +145,9 @@ void nvic_setup(void)
    nvic_enable_irq(NVIC_USB_HP_CAN_TX_IRQ); //CAN TX
    nvic_set_priority(NVIC_USB_HP_CAN_TX_IRQ, 0xe << 4); //second lowest priority
 
+   nvic_enable_irq(NVIC_DMA1_CHANNEL4_IRQ);
+   nvic_set_priority(NVIC_DMA1_CHANNEL4_IRQ, 0x10);//spi2_RX, MCP2515 transaction done
+
    /* Enable MCP2526 IRQ on PE15 */
    nvic_enable_irq(NVIC_EXTI15_10_IRQ);
    exti_enable_request(EXTI15);
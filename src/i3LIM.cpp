@@ -1,4 +1,5 @@
 #include <i3LIM.h>
+#include "candispatch.h"
 
 enum class ChargeStatus : uint8_t
 {
@@ -76,11 +77,11 @@ void i3LIMClass::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x3B4);
-    can->RegisterUserMessage(0x272);
-    can->RegisterUserMessage(0x29E);
-    can->RegisterUserMessage(0x2B2);
-    can->RegisterUserMessage(0x2EF);
+    CanDispatch::RegisterUserMessage(can, 0x3B4);
+    CanDispatch::RegisterUserMessage(can, 0x272);
+    CanDispatch::RegisterUserMessage(can, 0x29E);
+    CanDispatch::RegisterUserMessage(can, 0x2B2);
+    CanDispatch::RegisterUserMessage(can, 0x2EF);
 }
 
 void i3LIMClass::DecodeCAN(int id, uint32_t* data)
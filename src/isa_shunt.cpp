@@ -9,10 +9,12 @@
 
 
 #include <isa_shunt.h>
+#include "candispatch.h"
 #include "my_fp.h"
 #include "my_math.h"
 #include "stm32_can.h"
 #include "params.h"
+#include "sequencer.h"
 
 uint16_t  framecount=0;
 bool firstframe=true;
@@ -29,13 +31,7 @@ int32_t ISA::Temperature;
 
 
 
-#define FLASH_DELAY 8000000
-static void delay(void) //delay used for isa setup fumction. probably much better ways but its used only once.......
-{
-   int i;
-   for (i = 0; i < FLASH_DELAY; i++)       /* Wait a bit. */
-      __asm__("nop");
-}
+#define SETUP_DELAY_MS 500 //pause after each setup command, the old spin loop took about as long
 
 void ISA::DecodeCAN(int id, uint32_t data[2])
 {
@@ -70,43 +66,94 @@ void ISA::DecodeCAN(int id, uint32_t data[2])
 
 void ISA::RegisterCanMessages(CanHardware* can)
 {
-   can->RegisterUserMessage(0x521);//ISA MSG
-   can->RegisterUserMessage(0x522);//ISA MSG
-   can->RegisterUserMessage(0x523);//ISA MSG
-   can->RegisterUserMessage(0x524);//ISA MSG
-   can->RegisterUserMessage(0x525);//ISA MSG
-   can->RegisterUserMessage(0x526);//ISA MSG
-   can->RegisterUserMessage(0x527);//ISA MSG
-   can->RegisterUserMessage(0x528);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x521);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x522);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x523);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x524);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x525);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x526);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x527);//ISA MSG
+   CanDispatch::RegisterUserMessage(can, 0x528);//ISA MSG
 }
 
-void ISA::initialize(CanHardware* can)
+//Setup runs from the sequencer, one command every SETUP_DELAY_MS
+static int InitializeStep(void* context, int step)
 {
+   CanHardware* can = (CanHardware*)context;
    uint8_t bytes[8];
 
-   firstframe=false;
-   STOP(can);
-   delay();
-   for(int i=0; i<9; i++)
+   if (step == 0)
+   {
+      ISA::STOP(can);
+   }
+   else if (step <= 18)
+   {
+      if (step & 1)
+      {
+         bytes[0]=(0x20+(step-1)/2);
+         bytes[1]=0x42;
+         bytes[2]=0x00;
+         bytes[3]=0x64;
+         bytes[4]=0x00;
+         bytes[5]=0x00;
+         bytes[6]=0x00;
+         bytes[7]=0x00;
+
+         can->Send(0x411, (uint32_t*)bytes, 8);
+      }
+      else
+      {
+         ISA::sendSTORE(can);
+      }
+   }
+   else if (step == 19)
+   {
+      ISA::START(can);
+   }
+   else
    {
-      bytes[0]=(0x20+i);
+      return Sequencer::DONE;
+   }
+   return SETUP_DELAY_MS;
+}
+
+static int InitCurrentStep(void* context, int step)
+{
+   CanHardware* can = (CanHardware*)context;
+   uint8_t bytes[8];
+
+   switch (step)
+   {
+   case 0:
+      ISA::STOP(can);
+      break;
+   case 1:
+      bytes[0]=0x21;
       bytes[1]=0x42;
-      bytes[2]=0x00;
-      bytes[3]=0x64;
+      bytes[2]=0x01;
+      bytes[3]=0x61;
       bytes[4]=0x00;
       bytes[5]=0x00;
       bytes[6]=0x00;
       bytes[7]=0x00;
 
-      can->Send(0x411, (uint32_t*)bytes, 8);
-      delay();
-
-      sendSTORE(can);
-      delay();
+      can->Send(0x411, (uint32_t*)bytes,8);
+      break;
+   case 2:
+      ISA::sendSTORE(can);
+      ISA::START(can);
+      break;
+   default:
+      return Sequencer::DONE;
    }
-   START(can);
-   delay();
+   return SETUP_DELAY_MS;
+}
 
+//Starts the setup sequence, done is called once the sensor has been restarted
+void ISA::initialize(CanHardware* can, Sequencer::DoneCallback done)
+{
+   firstframe=false;
+   Sequencer::Start(InitializeStep, can, done);
 }
 
 void ISA::STOP(CanHardware* can)
@@ -200,27 +247,9 @@ void ISA::deFAULT(CanHardware* can)
 }
 
 
-void ISA::initCurrent(CanHardware* can)
+void ISA::initCurrent(CanHardware* can, Sequencer::DoneCallback done)
 {
-   uint8_t bytes[8];
-   STOP(can);
-   delay();
-   bytes[0]=0x21;
-   bytes[1]=0x42;
-   bytes[2]=0x01;
-   bytes[3]=0x61;
-   bytes[4]=0x00;
-   bytes[5]=0x00;
-   bytes[6]=0x00;
-   bytes[7]=0x00;
-
-   can->Send(0x411, (uint32_t*)bytes,8);
-
-   delay();
-   sendSTORE(can);
-   START(can);
-   delay();
-
+   Sequencer::Start(InitCurrentStep, can, done);
 }
 
 /********* Private functions *******/
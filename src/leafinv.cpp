@@ -20,11 +20,14 @@
  */
 
 #include "leafinv.h"
+#include "candispatch.h"
 #include "my_fp.h"
 #include "my_math.h"
 #include "stm32_can.h"
 #include "params.h"
 #include "utils.h"
+#include "cantxscheduler.h"
+#include "canfreshness.h"
 
 static uint16_t Vbatt=0;
 static uint16_t VbattSP=0;
@@ -63,10 +66,24 @@ void LeafINV::SetCanInterface(CanHardware* c)
 {
     can = c;
 
-    can->RegisterUserMessage(0x1DA);//Leaf inv msg
-    can->RegisterUserMessage(0x55A);//Leaf inv msg
-    can->RegisterUserMessage(0x679);//Leaf obc msg
-    can->RegisterUserMessage(0x390);//Leaf obc msg
+    CanDispatch::RegisterUserMessage(can, 0x1DA);//Leaf inv msg
+    CanDispatch::RegisterUserMessage(can, 0x55A);//Leaf inv msg
+    CanDispatch::RegisterUserMessage(can, 0x679);//Leaf obc msg
+    CanDispatch::RegisterUserMessage(can, 0x390);//Leaf obc msg
+    CanFreshness::Expect(0x1DA, 10);
+    CanFreshness::Expect(0x55A, 100);
+    CanFreshness::LinkCommand(0x1DA, 0x1D4); //speed feedback to torque command
+
+    CanTxScheduler::Register(can, 0x11A, 8, 10, Fill11A, this);
+    CanTxScheduler::Register(can, 0x1D4, 8, 10, Fill1D4, this);
+    CanTxScheduler::Register(can, 0x1DB, 8, 10, Fill1DB, this);
+    CanTxScheduler::Register(can, 0x50B, 7, 10, Fill50B, this); //0x50B is DLC 7
+    CanTxScheduler::Register(can, 0x1DC, 8, 10, Fill1DC, this);
+    CanTxScheduler::Register(can, 0x1F2, 8, 10, Fill1F2, this);
+    //MSGS for charging with pdm
+    CanTxScheduler::Register(can, 0x55B, 8, 100, Fill55B, this);
+    CanTxScheduler::Register(can, 0x59E, 8, 100, Fill59E, this);
+    CanTxScheduler::Register(can, 0x5BC, 8, 100, Fill5BC, this);
 }
 
 void LeafINV::DecodeCAN(int id, uint32_t data[2])
@@ -139,11 +156,13 @@ void LeafINV::SetTorque(float torquePercent)
     Param::SetInt(Param::torque,final_torque_request);//post processed final torque value sent to inv to web interface
 }
 
-void LeafINV::Task10Ms()
+//The periodic frames are sent by CanTxScheduler, each on its own phase
+
+bool LeafINV::Fill11A(void*, uint8_t* bytes)
 {
-    int opmode = Param::GetInt(Param::opmode);
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false; //the 10ms frames are only sent in run mode
 
-    uint8_t bytes[8];
+    int opmode = Param::GetInt(Param::opmode);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Messaage 0x11A
@@ -210,8 +229,15 @@ void LeafINV::Task10Ms()
 
 
 
-    can->Send(0x11A, (uint32_t*)bytes, 8);
+    return true;
+}
 
+bool LeafINV::Fill1D4(void* context, uint8_t* bytes)
+{
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false;
+
+    LeafINV* inv = (LeafINV*)context;
+    int opmode = Param::GetInt(Param::opmode);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x1D4: Target Motor Torque
@@ -232,14 +258,14 @@ void LeafINV::Task10Ms()
     // override any torque commands if not in run mode.
     if (opmode != MOD_RUN)
     {
-        final_torque_request = 0;
+        inv->final_torque_request = 0;
     }
 
     // Requested torque (signed 12-bit value + always 0x0 in low nibble)
-    if(final_torque_request >= -2048 && final_torque_request <= 2047)
+    if(inv->final_torque_request >= -2048 && inv->final_torque_request <= 2047)
     {
-        bytes[2] = ((final_torque_request < 0) ? 0x80 : 0) |((final_torque_request >> 4) & 0x7f);
-        bytes[3] = (final_torque_request << 4) & 0xf0;
+        bytes[2] = ((inv->final_torque_request < 0) ? 0x80 : 0) |((inv->final_torque_request >> 4) & 0x7f);
+        bytes[3] = (inv->final_torque_request << 4) & 0xf0;
     }
     else
     {
@@ -355,8 +381,12 @@ void LeafINV::Task10Ms()
     // Extra CRC
     nissan_crc(bytes, 0x85);
 
-    can->Send(0x1D4, (uint32_t*)bytes, 8);//send on can1
+    return true;
+}
 
+bool LeafINV::Fill1DB(void*, uint8_t* bytes)
+{
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false;
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x1DB
@@ -391,7 +421,12 @@ void LeafINV::Task10Ms()
     counter_1db++;
     if(counter_1db >= 4) counter_1db = 0;
 
-    can->Send(0x1DB, (uint32_t*)bytes, 8);
+    return true;
+}
+
+bool LeafINV::Fill50B(void*, uint8_t* bytes)
+{
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false;
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x50B
@@ -412,9 +447,12 @@ void LeafINV::Task10Ms()
     bytes[5] = 0x00;
     bytes[6] = 0x00;
 
-    //possible problem here as 0x50B is DLC 7....
-    can->Send(0x50B, (uint32_t*)bytes, 7);
+    return true;
+}
 
+bool LeafINV::Fill1DC(void*, uint8_t* bytes)
+{
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false;
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x1DC:
@@ -436,7 +474,14 @@ void LeafINV::Task10Ms()
     if (counter_1dc >= 4)
         counter_1dc = 0;
 
-    can->Send(0x1DC, (uint32_t*)bytes, 8);
+    return true;
+}
+
+bool LeafINV::Fill1F2(void*, uint8_t* bytes)
+{
+    if (Param::GetInt(Param::opmode) != MOD_RUN) return false;
+
+    int opmode = Param::GetInt(Param::opmode);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x1F2: Charge Power and DC/DC Converter Control
@@ -495,15 +540,11 @@ void LeafINV::Task10Ms()
         counter_1f2 = 0;
     }
 
-    can->Send(0x1F2, (uint32_t*)bytes, 8);
+    return true;
 }
 
-void LeafINV::Task100Ms()
+bool LeafINV::Fill55B(void*, uint8_t* bytes)
 {
-
-    // MSGS for charging with pdm
-    uint8_t bytes[8];
-
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x55B:
 
@@ -520,8 +561,11 @@ void LeafINV::Task100Ms()
     counter_55b++;
     if(counter_55b >= 4) counter_55b = 0;
 
-    can->Send(0x55b, (uint32_t*)bytes, 8);
+    return true;
+}
 
+bool LeafINV::Fill59E(void*, uint8_t* bytes)
+{
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x59E:
 
@@ -534,8 +578,11 @@ void LeafINV::Task100Ms()
     bytes[6] = 0x00;
     bytes[7] = 0x00;
 
-    can->Send(0x59e, (uint32_t*)bytes, 8);
+    return true;
+}
 
+bool LeafINV::Fill5BC(void*, uint8_t* bytes)
+{
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // CAN Message 0x5BC:
 
@@ -549,7 +596,7 @@ void LeafINV::Task100Ms()
     bytes[6] = 0x00;
     bytes[7] = 0x32;
 
-    can->Send(0x5bc, (uint32_t*)bytes, 8);
+    return true;
 }
 
 
@@ -23,6 +23,7 @@
 
 
 #include <outlanderCharger.h>
+#include "candispatch.h"
 
 uint8_t outlanderCharger::chgStatus;
 uint8_t outlanderCharger::evseDuty;
@@ -89,9 +90,9 @@ bool outlanderCharger::ControlCharge(bool RunCh, bool ACReq)
 void outlanderCharger::SetCanInterface(CanHardware* c)
 {
    can = c;
-   can->RegisterUserMessage(0x377);//dc_dc status
-   can->RegisterUserMessage(0x389);//charger status
-   can->RegisterUserMessage(0x38A);//charger status 2
+   CanDispatch::RegisterUserMessage(can, 0x377);//dc_dc status
+   CanDispatch::RegisterUserMessage(can, 0x389);//charger status
+   CanDispatch::RegisterUserMessage(can, 0x38A);//charger status 2
 }
 
 void outlanderCharger::DecodeCAN(int id, uint32_t data[2])
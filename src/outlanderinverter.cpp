@@ -18,10 +18,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "outlanderinverter.h"
+#include "candispatch.h"
+#include "canfreshness.h"
+#include "hotparams.h"
 #include "my_math.h"
 #include "params.h"
 
 OutlanderInverter::OutlanderInverter()
+   : response(0x289, 10000, 40, 10) //torque steps of 2%, speed changes of 10rpm
 {
    //ctor
 }
@@ -30,9 +34,12 @@ void OutlanderInverter::SetCanInterface(CanHardware* c)
 {
    can = c;
 
-   can->RegisterUserMessage(0x289);//Outlander Inv Msg
-   can->RegisterUserMessage(0x299);//Outlander Inv Msg
-   can->RegisterUserMessage(0x733);//Outlander Inv Msg
+   CanDispatch::RegisterUserMessage(can, 0x289);//Outlander Inv Msg
+   CanDispatch::RegisterUserMessage(can, 0x299);//Outlander Inv Msg
+   CanDispatch::RegisterUserMessage(can, 0x733);//Outlander Inv Msg
+   CanFreshness::Expect(0x289, 10);
+   CanFreshness::Expect(0x733, 100);
+   CanFreshness::LinkCommand(0x289, 0x287);
 }
 
 void OutlanderInverter::DecodeCAN(int id, uint32_t data[2])
@@ -42,6 +49,7 @@ void OutlanderInverter::DecodeCAN(int id, uint32_t data[2])
    case 0x289:
       speed = (data[0] >> 16) - 20000;
       voltage = data[1] & 0xFFFF;
+      response.Feedback(speed);
       break;
    case 0x299:
       inv_temp = MAX((data[1] & 0xFF), ((data[0] >> 8) & 0xFF)) - 40;
@@ -56,23 +64,26 @@ void OutlanderInverter::SetTorque(float torquePercent)
 {
    final_torque_request = (torquePercent * 2000) / 100.0f + 10000;
 
+   torqueFrame[0] = final_torque_request << 16;
+   torqueFrame[1] = 0;
+
+   response.Step(final_torque_request);
+
    Param::SetInt(Param::torque,final_torque_request);//post processed final torque value sent to inv to web interface
 }
 
 void OutlanderInverter::Task10Ms()
 {
    run10ms++;
+   response.Tick();
 
-   //Run every 50 ms
-   if (run10ms == 5)
+   //Run every 10, 20 or 50 ms as set by outlrate
+   if (run10ms >= HotParams::outlanderPeriod)
    {
-      uint32_t data[2];
       run10ms = 0;
 
-      data[0] = final_torque_request << 16;
-      data[1] = 0;
-
-      can->Send(0x287, data, 8);
+      can->Send(0x287, torqueFrame, 8);
+      response.Sent(final_torque_request, speed);
    }
 }
 
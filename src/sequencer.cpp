@@ -0,0 +1,108 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sequencer.h"
+#include "taskprofiler.h"
+#ifdef STM32F1
+#include <libopencm3/cm3/cortex.h>
+#endif
+
+Sequencer::Sequence Sequencer::sequences[MAX_SEQUENCES];
+
+/** Queue a sequence, its first step runs on the next 1ms tick.
+ * @return false if the same sequence is already running or all slots are taken
+ */
+bool Sequencer::Start(StepFunction stepFunction, void* context, DoneCallback done)
+{
+   bool started = false;
+
+   //Both the main loop and the timer tasks start sequences, claim the slot in one go
+#ifdef STM32F1
+   uint32_t irqMask = cm_mask_interrupts(1);
+#endif
+
+   if (!IsRunning(stepFunction, context))
+   {
+      for (int i = 0; i < MAX_SEQUENCES && !started; i++)
+      {
+         Sequence& seq = sequences[i];
+
+         if (!seq.active)
+         {
+            seq.stepFunction = stepFunction;
+            seq.context = context;
+            seq.done = done;
+            seq.step = 0;
+            seq.waitMs = 0;
+            seq.active = true;
+            started = true;
+         }
+      }
+   }
+
+#ifdef STM32F1
+   cm_mask_interrupts(irqMask);
+#endif
+
+   return started;
+}
+
+bool Sequencer::IsRunning(StepFunction stepFunction, void* context)
+{
+   for (int i = 0; i < MAX_SEQUENCES; i++)
+   {
+      const Sequence& seq = sequences[i];
+      if (seq.active && seq.stepFunction == stepFunction && seq.context == context) return true;
+   }
+   return false;
+}
+
+//Stops a sequence without calling its completion callback
+void Sequencer::Cancel(StepFunction stepFunction, void* context)
+{
+   for (int i = 0; i < MAX_SEQUENCES; i++)
+   {
+      Sequence& seq = sequences[i];
+      if (seq.active && seq.stepFunction == stepFunction && seq.context == context) seq.active = false;
+   }
+}
+
+//Called from Ms1Task, a wait of 0 or 1 both continue on the next tick
+void Sequencer::Run()
+{
+   for (int i = 0; i < MAX_SEQUENCES; i++)
+   {
+      Sequence& seq = sequences[i];
+
+      if (!seq.active) continue;
+      if (seq.waitMs > 0 && --seq.waitMs > 0) continue;
+
+      //The longest step is the longest the scheduler gets blocked by a sequence
+      int wait;
+      PROFILE(SEQ_STEP, wait = seq.stepFunction(seq.context, seq.step++));
+
+      if (wait == DONE)
+      {
+         seq.active = false;
+         if (seq.done) seq.done(seq.context);
+      }
+      else
+      {
+         seq.waitMs = wait;
+      }
+   }
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shiftmap.h"
+
+int16_t ShiftMap::upshift[LOAD_STEPS];
+int16_t ShiftMap::downshift[LOAD_STEPS];
+
+void ShiftMap::Configure(int upNoLoad, int upFullLoad, int hysteresis)
+{
+   for (int step = 0; step < LOAD_STEPS; step++)
+   {
+      int up = upNoLoad + (upFullLoad - upNoLoad) * step / (LOAD_STEPS - 1);
+      int down = up - hysteresis;
+
+      upshift[step] = up;
+      downshift[step] = down > 0 ? down : 0;
+   }
+}
+
+uint8_t ShiftMap::Select(uint8_t gear, int speed, int loadPercent)
+{
+   int step = (loadPercent + 5) / 10;
+
+   if (step < 0) step = 0;
+   if (step >= LOAD_STEPS) step = LOAD_STEPS - 1;
+
+   if (gear == LOW && speed > upshift[step]) return HIGH;
+   if (gear == HIGH && speed < downshift[step]) return LOW;
+   return gear;
+}
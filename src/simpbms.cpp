@@ -12,9 +12,11 @@ void SimpBMS::SetCanInterface(CanHardware* c)
 {
    can = c;
    // 注册CAN消息ID 0x373，用于电压和温度数据
-   can->RegisterUserMessage(0x373);
+   CanDispatch::RegisterUserMessage(can, 0x373);
    // 注册CAN消息ID 0x351，用于充电电流限制数据
-   can->RegisterUserMessage(0x351);
+   CanDispatch::RegisterUserMessage(can, 0x351);
+   CanFreshness::Expect(0x373, 1000);
+   CanFreshness::Expect(0x351, 1000);
 }
 
 // 判断BMS数据是否有效（即是否收到BMS数据且未超时）
@@ -54,60 +54,42 @@ alarm=0;			// != 0 when alarm is pending
 static uint8_t rlyDly=25;
 
 // Instantiate Classes
-static BMW_E31 e31Vehicle;
-static BMW_E65 e65Vehicle;
-static BMW_E39 e39Vehicle;
-static Can_VAG vagVehicle;
-static SubaruVehicle subaruVehicle;
-static GS450HClass gs450Inverter;
-static LeafINV leafInv;
-static NissanPDM chargerPDM;
-static teslaCharger ChargerTesla;
-static ElconCharger ChargerElcon;
-static notused UnUsed;
-static noCharger nochg;
-static extCharger chgdigi;
-static amperaCharger ampChg;
-static outlanderCharger outChg;
-static FCChademo chademoFC;
-static i3LIMClass LIMFC;
-static CPCClass CPCcan;
-static Can_OI openInv;
-static NoInverterClass NoInverter;
-static OutlanderInverter outlanderInv;
-static noHeater Heaternone;
-static AmperaHeater amperaHeater;
-static no_Lever NoGearLever;
-static F30_Lever F30GearLever;
-static JLR_G1 JLRG1shift;
-static JLR_G2 JLRG2shift;
-static vwHeater heaterVW;
-static NoVehicle VehicleNone;
-static Inverter* selectedInverter = &openInv;
-static Vehicle* selectedVehicle = &VehicleNone;
-static Heater* selectedHeater = &Heaternone;
-static Chargerhw* selectedCharger = &chargerPDM;
-static Chargerint* selectedChargeInt = &UnUsed;
-static Shifter* selectedShifter = &NoGearLever;
-static BMS BMSnone;
-static SimpBMS BMSsimp;
-static DaisychainBMS BMSdaisychain;
-static DCDC DCDCnone;
-static TeslaDCDC DCDCTesla;
-static BMS* selectedBMS = &BMSnone;
-static DCDC* selectedDCDC = &DCDCnone;
+// Only the selected driver of each category exists, see driverslot.h
+static DriverSlot<Inverter, FIXED_INVERTER, Can_OI,
+       NoInverterClass, LeafINV, GS450HClass, OutlanderInverter, Can_OI, RearOutlanderInverter> selectedInverter;
+static DriverSlot<Vehicle, FIXED_VEHICLE, NoVehicle,
+       NoVehicle, BMW_E39, BMW_E65, Can_VAG, SubaruVehicle, BMW_E31> selectedVehicle;
+static DriverSlot<Heater, FIXED_HEATER, noHeater,
+       noHeater, AmperaHeater, vwHeater> selectedHeater;
+static DriverSlot<Chargerhw, FIXED_CHARGER, NissanPDM,
+       noCharger, extCharger, amperaCharger, NissanPDM, teslaCharger, outlanderCharger, ElconCharger> selectedCharger;
+static DriverSlot<Chargerint, FIXED_CHARGEINT, notused,
+       notused, FCChademo, i3LIMClass, CPCClass> selectedChargeInt;
+static DriverSlot<Shifter, FIXED_SHIFTER, no_Lever,
+       no_Lever, Shifter, F30_Lever, JLR_G1, JLR_G2> selectedShifter;
+static DriverSlot<BMS, FIXED_BMS, BMS,
+       BMS, SimpBMS, DaisychainBMS> selectedBMS;
+static DriverSlot<DCDC, FIXED_DCDC, DCDC,
+       DCDC, TeslaDCDC> selectedDCDC;
 static Can_OBD2 canOBD2;
-static Shifter shifterNone;
-static RearOutlanderInverter rearoutlanderInv;
 static LinBus* lin;
+static CanRxRing canRxRing[3]; //CAN1, CAN2 and CAN3, filled by the receive interrupts, drained in Ms1Task
+static CanFilterOpt::Result canFilters[2]; //filter banks of CAN1 and CAN2 as set by VcuCan
+static volatile uint32_t msTicks = 0;
+static int schedMode = SCHED_STAGGERED;
+static uint16_t ms10Phase, ms100Phase, ms200Phase;
+static uint32_t worstTick[2]; //Longest tick without [0] and with [1] phase offsets
+
+#define CAN_RX_BUDGET 10 //Maximum number of frames decoded per 1ms tick
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 static void Ms200Task(void)
 {
+    uint32_t taskStart = TaskProfiler::Start();
     int opmode = Param::GetInt(Param::opmode);
 
-    selectedVehicle->Task200Ms();
-    if(opmode==MOD_CHARGE) selectedCharger->Task200Ms();
+    PROFILE(VEH_200MS, selectedVehicle->Task200Ms());
+    if(opmode==MOD_CHARGE) PROFILE(CHG_200MS, selectedCharger->Task200Ms());
 
     Param::SetInt(Param::Day,days);
     Param::SetInt(Param::Hour,hours);
@@ -180,11 +162,11 @@ static void Ms200Task(void)
     }
 
     //in chademo , we do not want to run the 200ms task unless in dc charge mode
-    if(targetChgint == ChargeInterfaces::Chademo && chargeModeDC) selectedChargeInt->Task200Ms();
+    if(targetChgint == ChargeInterfaces::Chademo && chargeModeDC) PROFILE(CHGINT_200MS, selectedChargeInt->Task200Ms());
     //In case of the LIM we want to send it all the time if lim in use
-    if((targetChgint == ChargeInterfaces::i3LIM) || (targetChgint == ChargeInterfaces::Unused) || (targetChgint == ChargeInterfaces::CPC)) selectedChargeInt->Task200Ms();
+    if((targetChgint == ChargeInterfaces::i3LIM) || (targetChgint == ChargeInterfaces::Unused) || (targetChgint == ChargeInterfaces::CPC)) PROFILE(CHGINT_200MS, selectedChargeInt->Task200Ms());
     //and just to be thorough ...
-    if(targetChgint == ChargeInterfaces::Unused) selectedChargeInt->Task200Ms();
+    if(targetChgint == ChargeInterfaces::Unused) PROFILE(CHGINT_200MS, selectedChargeInt->Task200Ms());
 
 
 
@@ -257,18 +239,103 @@ static void Ms200Task(void)
         IOMatrix::GetPin(IOMatrix::BRAKEVACPUMP)->Clear();
     }
 
+    TaskProfiler::Stop(TaskProfiler::MS200, taskStart);
+}
+
+static void PublishTaskTimes()
+{
+    Param::SetInt(Param::t1msavg, TaskProfiler::GetMeanUs(TaskProfiler::MS1));
+    Param::SetInt(Param::t1msmax, TaskProfiler::ToMicroseconds(TaskProfiler::GetStats(TaskProfiler::MS1).max));
+    Param::SetInt(Param::t10msavg, TaskProfiler::GetMeanUs(TaskProfiler::MS10));
+    Param::SetInt(Param::t10msmax, TaskProfiler::ToMicroseconds(TaskProfiler::GetStats(TaskProfiler::MS10).max));
+    Param::SetInt(Param::t100msavg, TaskProfiler::GetMeanUs(TaskProfiler::MS100));
+    Param::SetInt(Param::t100msmax, TaskProfiler::ToMicroseconds(TaskProfiler::GetStats(TaskProfiler::MS100).max));
+    Param::SetInt(Param::t200msavg, TaskProfiler::GetMeanUs(TaskProfiler::MS200));
+    Param::SetInt(Param::t200msmax, TaskProfiler::ToMicroseconds(TaskProfiler::GetStats(TaskProfiler::MS200).max));
+    Param::SetInt(Param::taskovr, TaskProfiler::GetTotalOverruns());
+    Param::SetInt(Param::tickmaxsync, TaskProfiler::ToMicroseconds(worstTick[0]));
+    Param::SetInt(Param::tickmaxstag, TaskProfiler::ToMicroseconds(worstTick[1]));
+    Param::SetInt(Param::seqstepmax, TaskProfiler::ToMicroseconds(TaskProfiler::GetStats(TaskProfiler::SEQ_STEP).max));
+}
 
+//The ID that is most overdue relative to its period and how long it has been silent
+static void PublishCanFreshness()
+{
+    CanFreshness::Update(msTicks);
+    int worst = CanFreshness::GetWorst();
+
+    Param::SetInt(Param::rxworstid, worst < 0 ? 0 : CanFreshness::Get(worst).id);
+    Param::SetInt(Param::rxworstage, worst < 0 ? 0 : CanFreshness::GetAge(worst));
+    Param::SetInt(Param::rxmissed, CanFreshness::GetTotalMissed());
+    Param::SetInt(Param::rxlatency, CanFreshness::GetMaxLatency());
+    Param::SetInt(Param::rxresponse, CanFreshness::GetMaxResponse());
+}
+
+static const Param::PARAM_NUM canStatParams[CanStats::NUM_BUSES][7] =
+{
+    { Param::can1rxfps, Param::can1txfps, Param::can1bps, Param::can1load, Param::can1tec, Param::can1rec, Param::can1boff },
+    { Param::can2rxfps, Param::can2txfps, Param::can2bps, Param::can2load, Param::can2tec, Param::can2rec, Param::can2boff },
+    { Param::can3rxfps, Param::can3txfps, Param::can3bps, Param::can3load, Param::can3tec, Param::can3rec, Param::can3boff },
+};
+
+static void PublishCanStats()
+{
+    uint8_t tec, rec;
+    bool busOff;
+
+    CanStats::ReadBxCanErrors(CanStats::BUS_CAN1, CAN1);
+    CanStats::ReadBxCanErrors(CanStats::BUS_CAN2, CAN2);
+    //Result of the request made 100ms ago
+    CANSPI_Get_ErrorCounters(&tec, &rec, &busOff);
+    CanStats::SetErrors(CanStats::BUS_CAN3, tec, rec, busOff, false);
+    CANSPI_RequestErrorCounters();
+    CanStats::Update(100);
+
+    for (int i = 0; i < CanStats::NUM_BUSES; i++)
+    {
+        const CanStats::Bus& s = CanStats::Get((CanStats::buses)i);
+        const Param::PARAM_NUM* p = canStatParams[i];
+
+        Param::SetInt(p[0], s.rxRate);
+        Param::SetInt(p[1], s.txRate);
+        Param::SetInt(p[2], s.byteRate);
+        Param::SetInt(p[3], s.load);
+        Param::SetInt(p[4], s.tec);
+        Param::SetInt(p[5], s.rec);
+        Param::SetInt(p[6], s.busOffEvents);
+    }
 }
 
 static void Ms100Task(void)
 {
+    uint32_t taskStart = TaskProfiler::Start();
     DigIo::led_out.Toggle();
     iwdg_reset();
     float cpuLoad = scheduler->GetCpuLoad() / 10.0f;
     Param::SetFloat(Param::cpuload, cpuLoad);
+    PublishTaskTimes();
+    Param::SetInt(Param::can1rxhwm, canRxRing[0].GetHighWater());
+    Param::SetInt(Param::can2rxhwm, canRxRing[1].GetHighWater());
+    Param::SetInt(Param::can1rxdrop, canRxRing[0].GetDrops());
+    Param::SetInt(Param::can2rxdrop, canRxRing[1].GetDrops());
+    Param::SetInt(Param::can3rxhwm, canRxRing[2].GetHighWater());
+    Param::SetInt(Param::can3rxdrop, canRxRing[2].GetDrops());
+    Param::SetInt(Param::can3rxovr, CANSPI_Get_RxOverflows());
+    Param::SetInt(Param::can3txq, CANSPI_Get_TxQueued());
+    Param::SetInt(Param::can3txhwm, CANSPI_Get_TxHighWater());
+    Param::SetInt(Param::can3txdrop, CANSPI_Get_TxDrops());
+    PublishCanStats();
+    Param::SetInt(Param::can1txslot, CanTxScheduler::GetWorstSlot(canInterface[0]));
+    Param::SetInt(Param::can2txslot, CanTxScheduler::GetWorstSlot(canInterface[1]));
+    Param::SetInt(Param::txslotmax, CanTxScheduler::GetWorstSlotMeasured());
+    Param::SetInt(Param::can1fbanks, canFilters[0].numBanks);
+    Param::SetInt(Param::can1ffa, CanFilterOpt::FalseAcceptPercent(canFilters[0]));
+    Param::SetInt(Param::can2fbanks, canFilters[1].numBanks);
+    Param::SetInt(Param::can2ffa, CanFilterOpt::FalseAcceptPercent(canFilters[1]));
+    PublishCanFreshness();
     Param::SetInt(Param::lasterr, ErrorMessage::GetLastError());
     int opmode = Param::GetInt(Param::opmode);
-    utils::SelectDirection(selectedVehicle, selectedShifter);
+    utils::SelectDirection(selectedVehicle.Get(), selectedShifter.Get());
     utils::CalcSOC();
 
     Param::SetInt(Param::cruisestt, selectedVehicle->GetCruiseState());
@@ -277,25 +344,25 @@ static void Ms100Task(void)
     utils::ProcessCruiseControlButtons();
 
     // 调用选中的逆变器模块的100毫秒任务函数，处理逆变器相关的周期性工作
-    selectedInverter->Task100Ms();
+    PROFILE(INV_100MS, selectedInverter->Task100Ms());
 
     // 调用选中的车辆模块的100毫秒任务函数，处理车辆相关的周期性工作
-    selectedVehicle->Task100Ms();
+    PROFILE(VEH_100MS, selectedVehicle->Task100Ms());
 
     // 调用选中的充电器模块的100毫秒任务函数，处理充电器相关的周期性工作
-    selectedCharger->Task100Ms();
+    PROFILE(CHG_100MS, selectedCharger->Task100Ms());
 
     // 调用选中的电池管理系统(BMS)模块的100毫秒任务函数，处理BMS相关的周期性工作
-    selectedBMS->Task100Ms();
+    PROFILE(BMS_100MS, selectedBMS->Task100Ms());
 
     // 调用选中的直流-直流变换器模块的100毫秒任务函数，处理DCDC相关的周期性工作
-    selectedDCDC->Task100Ms();
+    PROFILE(DCDC_100MS, selectedDCDC->Task100Ms());
 
     // 调用选中的换挡器模块的100毫秒任务函数，处理换挡器相关的周期性工作
-    selectedShifter->Task100Ms();
+    PROFILE(SHIFT_100MS, selectedShifter->Task100Ms());
 
     // 通过 canMap 发送所有已准备好的 CAN 数据包，实现数据的传输
-    canMap->SendAll();
+    PROFILE(CANMAP, canMap->SendAll());
 
 
 
@@ -328,7 +395,7 @@ static void Ms100Task(void)
     int32_t IsaTemp=ISA::Temperature;
     Param::SetInt(Param::tmpaux,IsaTemp);
 
-    if(targetChgint == ChargeInterfaces::i3LIM || chargeModeDC) selectedChargeInt->Task100Ms();// send the 100ms task request for the lim all the time and for others if in DC charge mode
+    if(targetChgint == ChargeInterfaces::i3LIM || chargeModeDC) PROFILE(CHGINT_100MS, selectedChargeInt->Task100Ms());// send the 100ms task request for the lim all the time and for others if in DC charge mode
 
     if(selectedChargeInt->DCFCRequest(RunChg))//Request to run dc fast charge
     {
@@ -349,6 +416,8 @@ static void Ms100Task(void)
     }
 
     Param::SetInt(Param::HeatReq,IOMatrix::GetPin(IOMatrix::HEATREQ)->Get());
+
+    TaskProfiler::Stop(TaskProfiler::MS100, taskStart);
 }
 
 static void ControlCabHeater(int opmode)
@@ -371,31 +440,34 @@ static void ControlCabHeater(int opmode)
 static void Ms10Task(void)
 {
     static uint32_t vehicleStartTime = 0;
+    uint32_t taskStart = TaskProfiler::Start();
 
-    int16_t previousSpeed=Param::GetInt(Param::speed);
+    HotParams::Refresh();
+
+    int16_t previousSpeed=HotParams::speed;
     int16_t speed = 0;
     float torquePercent;
-    int opmode = Param::GetInt(Param::opmode);
+    int opmode = HotParams::opmode;
     int stt = STAT_NONE;
-    int requestedDirection = Param::GetInt(Param::dir);
+    int requestedDirection = HotParams::dir;
     int rollingDirection = 0;
 
     ErrorMessage::SetTime(rtc_get_counter_val());
 
-    selectedChargeInt->Task10Ms();
+    PROFILE(CHGINT_10MS, selectedChargeInt->Task10Ms());
 
-    if (Param::GetInt(Param::opmode) == MOD_RUN)
+    if (opmode == MOD_RUN)
     {
-        torquePercent = utils::ProcessThrottle(ABS(previousSpeed)); //run the throttle reading and checks and then generate Potnom
+        PROFILE(THROTTLE, torquePercent = utils::ProcessThrottle(ABS(previousSpeed))); //run the throttle reading and checks and then generate Potnom
 
 
         //When requesting regen we need to be careful. If the car is not rolling
         //in the same direction as the selected gear, we will actually accelerate!
         //Exclude openinverter here because that has its own regen logic
 
-        if (torquePercent < 0 && Param::GetInt(Param::Inverter) != InvModes::OpenI)
+        if (torquePercent < 0 && HotParams::inverter != InvModes::OpenI)
         {
-            if(Param::GetInt(Param::reversemotor) == 0)
+            if(HotParams::reversemotor == 0)
             {
                 rollingDirection = previousSpeed >= 0 ? 1 : -1;
             }
@@ -413,7 +485,7 @@ static void Ms10Task(void)
 
         torquePercent *= requestedDirection; //torque requests invert when reverse direction is selected
 
-        selectedInverter->Task10Ms();
+        PROFILE(INV_10MS, selectedInverter->Task10Ms());
     }
     else
     {
@@ -422,10 +494,10 @@ static void Ms10Task(void)
     }
 
 
-    selectedInverter->SetTorque(torquePercent);
+    PROFILE(INV_TORQUE, selectedInverter->SetTorque(torquePercent));
 
     //Brake light based on regen being below the set threshold
-    if(torquePercent < Param::GetFloat(Param::RegenBrakeLight))
+    if(torquePercent < HotParams::regenBrakeLight)
     {
         //enable Brake Light Ouput
         IOMatrix::GetPin(IOMatrix::BRAKELIGHT)->Set();
@@ -439,23 +511,23 @@ static void Ms10Task(void)
     speed = selectedInverter->GetMotorSpeed();//set motor rpm on interface
 
     Param::SetInt(Param::speed, speed);
-    utils::GetDigInputs(canInterface[Param::GetInt(Param::InverterCan)]);
+    utils::GetDigInputs(canInterface[HotParams::inverterCan]);
 
     selectedVehicle->SetRevCounter(ABS(speed)); //ABS allowed here to keep number from rolling over.
-    selectedVehicle->SetTemperatureGauge(Param::GetFloat(Param::tmphs));
-    selectedVehicle->Task10Ms();
-    selectedDCDC->Task10Ms();
-    selectedShifter->Task10Ms();
-    if(opmode==MOD_CHARGE) selectedCharger->Task10Ms();
-    if(opmode==MOD_RUN) Param::SetInt(Param::canctr, (Param::GetInt(Param::canctr) + 1) & 0xF);//Update the OI can counter in RUN mode only
+    selectedVehicle->SetTemperatureGauge(FP_TOFLOAT(HotParams::tmphs));
+    PROFILE(VEH_10MS, selectedVehicle->Task10Ms());
+    PROFILE(DCDC_10MS, selectedDCDC->Task10Ms());
+    PROFILE(SHIFT_10MS, selectedShifter->Task10Ms());
+    if(opmode==MOD_CHARGE) PROFILE(CHG_10MS, selectedCharger->Task10Ms());
+    if(opmode==MOD_RUN) Param::SetInt(Param::canctr, (HotParams::canctr + 1) & 0xF);//Update the OI can counter in RUN mode only
 
     //////////////////////////////////////////////////
     //            MODE CONTROL SECTION              //
     //////////////////////////////////////////////////
     float udc = utils::ProcessUdc(speed);
-    stt |= Param::GetInt(Param::pot) <= Param::GetInt(Param::potmin) ? STAT_NONE : STAT_POTPRESSED;
-    stt |= udc >= Param::GetFloat(Param::udcsw) ? STAT_NONE : STAT_UDCBELOWUDCSW;
-    stt |= udc < Param::GetFloat(Param::udclim) ? STAT_NONE : STAT_UDCLIM;
+    stt |= Param::GetInt(Param::pot) <= HotParams::potmin ? STAT_NONE : STAT_POTPRESSED;
+    stt |= udc >= HotParams::udcsw ? STAT_NONE : STAT_UDCBELOWUDCSW;
+    stt |= udc < HotParams::udclim ? STAT_NONE : STAT_UDCLIM;
     Param::SetInt(Param::status, stt);
 
     switch (opmode)
@@ -494,7 +566,7 @@ static void Ms10Task(void)
     case MOD_PRECHARGE:
         if (!chargeMode)
         {
-            if(selectedInverter != &openInv)DigIo::inv_out.Set();//inverter power on but not if we are in charge mode and not if OI
+            if(!selectedInverter.Is<Can_OI>())DigIo::inv_out.Set();//inverter power on but not if we are in charge mode and not if OI
         }
         IOMatrix::GetPin(IOMatrix::NEGCONTACTOR)->Set();
         IOMatrix::GetPin(IOMatrix::COOLANTPUMP)->Set();
@@ -517,7 +589,7 @@ static void Ms10Task(void)
         }
         if(initbyCharge && !chargeMode) opmode = MOD_OFF;// These two statements catch a precharge hang from either start mode or run mode.
         if(initbyStart && !selectedVehicle->Ready()) opmode = MOD_OFF;
-        if (udc < (Param::GetInt(Param::udcsw)) && rtc_get_counter_val() > (vehicleStartTime + PRECHARGE_TIMEOUT))
+        if (udc < (int)HotParams::udcsw && rtc_get_counter_val() > (vehicleStartTime + PRECHARGE_TIMEOUT))
         {
             DigIo::prec_out.Clear();
             ErrorMessage::Post(ERR_PRECHARGE);
@@ -559,20 +631,75 @@ static void Ms10Task(void)
     }
 
     ControlCabHeater(opmode);
-    if (Param::GetInt(Param::Type) == 1)  SBOX::ControlContactors(opmode,canInterface[Param::GetInt(Param::ShuntCan)]);//BMW contactor box
-    if (Param::GetInt(Param::Type) == 2)  VWBOX::ControlContactors(opmode,canInterface[Param::GetInt(Param::ShuntCan)]);//VW contactor box
+    if (HotParams::shuntType == 1)  SBOX::ControlContactors(opmode,canInterface[HotParams::shuntCan]);//BMW contactor box
+    if (HotParams::shuntType == 2)  VWBOX::ControlContactors(opmode,canInterface[HotParams::shuntCan]);//VW contactor box
 
+    TaskProfiler::Stop(TaskProfiler::MS10, taskStart);
+}
+
+static void DecodeCanFrame(uint32_t id, uint32_t data[2], CanDispatch::buses bus);
+
+static void ProcessCanRx()
+{
+    CanRxFrame frame;
+    int budget = CAN_RX_BUDGET;
+    bool pending = true;
+
+    //Take turns between the interfaces so a busy bus can't starve the other one.
+    //Whatever exceeds the budget stays queued for the next tick.
+    while (pending && budget > 0)
+    {
+        pending = false;
 
+        for (int i = 0; i < 3 && budget > 0; i++)
+        {
+            if (canRxRing[i].Get(frame))
+            {
+                CanStats::CountRx((CanStats::buses)i, frame.id, frame.dlc);
+                CanFreshness::Stamp(frame.id, frame.timestamp);
+                DecodeCanFrame(frame.id, frame.data, i < 2 ? CanDispatch::BUS_CAN : CanDispatch::BUS_CAN3);
+                budget--;
+                pending = true;
+            }
+        }
+    }
 }
 
 static void Ms1Task(void)
 {
-    selectedInverter->Task1Ms();
-    selectedVehicle->Task1Ms();
-    selectedCharger->Task1Ms();
-    selectedChargeInt->Task1Ms();
-    selectedShifter->Task1Ms();
-    selectedDCDC->Task1Ms();
+    uint32_t taskStart = TaskProfiler::Start();
+    CANSPI_ServiceReceive();
+    CanTrace::CheckError(ErrorMessage::GetLastError());
+    PROFILE(CANRX, ProcessCanRx());
+    PROFILE(CANTX, CanTxScheduler::Run());
+    PROFILE(INV_1MS, selectedInverter->Task1Ms());
+    PROFILE(VEH_1MS, selectedVehicle->Task1Ms());
+    PROFILE(CHG_1MS, selectedCharger->Task1Ms());
+    PROFILE(CHGINT_1MS, selectedChargeInt->Task1Ms());
+    PROFILE(SHIFT_1MS, selectedShifter->Task1Ms());
+    PROFILE(DCDC_1MS, selectedDCDC->Task1Ms());
+    Sequencer::Run();
+    TaskProfiler::Stop(TaskProfiler::MS1, taskStart);
+}
+
+//Runs every 1ms and starts the slower tasks on their own phase slot so that
+//Ms10Task, Ms100Task and Ms200Task and their CAN transmissions don't pile up
+//on the same tick. In compare mode the offsets are switched on and off every
+//10s so that the worst tick length of both variants can be read back.
+static void SchedulerTick(void)
+{
+    uint32_t tickStart = TaskProfiler::Start();
+    uint32_t tick = msTicks++;
+    bool staggered = schedMode == SCHED_STAGGERED || (schedMode == SCHED_COMPARE && ((tick / 10000) & 1));
+
+    Ms1Task();
+
+    if ((tick % 10) == (staggered ? ms10Phase : 0u)) Ms10Task();
+    if ((tick % 100) == (staggered ? ms100Phase : 0u)) Ms100Task();
+    if ((tick % 200) == (staggered ? ms200Phase : 0u)) Ms200Task();
+
+    uint32_t tickLength = TaskProfiler::GetTicks() - tickStart;
+    if (tickLength > worstTick[staggered]) worstTick[staggered] = tickLength;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -582,31 +709,28 @@ static void UpdateInv()
     switch (Param::GetInt(Param::Inverter))
     {
     case InvModes::NoInv:
-        selectedInverter = &NoInverter;
+        selectedInverter.Select<NoInverterClass>();
         break;
     case InvModes::Leaf_Gen1:
-        selectedInverter = &leafInv;
+        selectedInverter.Select<LeafINV>();
         break;
     case InvModes::GS450H:
-        selectedInverter = &gs450Inverter;
-        gs450Inverter.SetGS450H();
+        selectedInverter.Select<GS450HClass>([](auto& inv) { inv.SetGS450H(); });
         break;
     case InvModes::GS300H:
-        selectedInverter = &gs450Inverter;
-        gs450Inverter.SetGS300H();
+        selectedInverter.Select<GS450HClass>([](auto& inv) { inv.SetGS300H(); });
         break;
     case InvModes::Prius_Gen3:
-        selectedInverter = &gs450Inverter;
-        gs450Inverter.SetPrius();
+        selectedInverter.Select<GS450HClass>([](auto& inv) { inv.SetPrius(); });
         break;
     case InvModes::Outlander:
-        selectedInverter = &outlanderInv;
+        selectedInverter.Select<OutlanderInverter>();
         break;
     case InvModes::OpenI:
-        selectedInverter = &openInv;
+        selectedInverter.Select<Can_OI>();
         break;
     case InvModes::RearOutlander:
-        selectedInverter = &rearoutlanderInv;
+        selectedInverter.Select<RearOutlanderInverter>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -619,27 +743,25 @@ static void UpdateVehicle()
     switch (Param::GetInt(Param::Vehicle))
     {
     case vehicles::None:
-        selectedVehicle = &VehicleNone;
+        selectedVehicle.Select<NoVehicle>();
         break;
     case vehicles::vBMW_E39:
-        selectedVehicle = &e39Vehicle;
-        e39Vehicle.SetE46(false);
+        selectedVehicle.Select<BMW_E39>([](auto& veh) { veh.SetE46(false); });
         break;
     case vehicles::vBMW_E46:
-        selectedVehicle = &e39Vehicle;
-        e39Vehicle.SetE46(true);
+        selectedVehicle.Select<BMW_E39>([](auto& veh) { veh.SetE46(true); });
         break;
     case vehicles::vBMW_E65:
-        selectedVehicle = &e65Vehicle;
+        selectedVehicle.Select<BMW_E65>();
         break;
     case vehicles::vVAG:
-        selectedVehicle = &vagVehicle;
+        selectedVehicle.Select<Can_VAG>();
         break;
     case vehicles::vSUBARU:
-        selectedVehicle = &subaruVehicle;
+        selectedVehicle.Select<SubaruVehicle>();
         break;
     case vehicles::vBMW_E31:
-        selectedVehicle = &e31Vehicle;
+        selectedVehicle.Select<BMW_E31>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -654,25 +776,25 @@ static void UpdateCharger()
     {
     case ChargeModes::Off:
         chargeMode = false;
-        selectedCharger = &nochg;
+        selectedCharger.Select<noCharger>();
         break;
     case ChargeModes::EXT_DIGI:
-        selectedCharger = &chgdigi;
+        selectedCharger.Select<extCharger>();
         break;
     case ChargeModes::Volt_Ampera:
-        selectedCharger = &ampChg;
+        selectedCharger.Select<amperaCharger>();
         break;
     case ChargeModes::Leaf_PDM:
-        selectedCharger = &chargerPDM;
+        selectedCharger.Select<NissanPDM>();
         break;
     case ChargeModes::TeslaOI:
-        selectedCharger = &ChargerTesla;
+        selectedCharger.Select<teslaCharger>();
         break;
     case ChargeModes::Out_lander:
-        selectedCharger = &outChg;
+        selectedCharger.Select<outlanderCharger>();
         break;
     case ChargeModes::Elcon:
-        selectedCharger = &ChargerElcon;
+        selectedCharger.Select<ElconCharger>();
         break;
 
     }
@@ -687,16 +809,16 @@ static void UpdateChargeInt()
     switch (Param::GetInt(Param::interface))
     {
     case ChargeInterfaces::Unused:
-        selectedChargeInt = &UnUsed;
+        selectedChargeInt.Select<notused>();
         break;
     case ChargeInterfaces::Chademo:
-        selectedChargeInt = &chademoFC;
+        selectedChargeInt.Select<FCChademo>();
         break;
     case ChargeInterfaces::i3LIM:
-        selectedChargeInt = &LIMFC;
+        selectedChargeInt.Select<i3LIMClass>();
         break;
     case ChargeInterfaces::CPC:
-        selectedChargeInt = &CPCcan;
+        selectedChargeInt.Select<CPCClass>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -706,18 +828,32 @@ static void UpdateChargeInt()
 
 static void UpdateHeater()
 {
+    //SPI2 (CAN3) and USART1 (LIN) share DMA1 channel 4 and 5
+    bool linActive = Param::GetInt(Param::Heater) == HeatType::VW;
+
     selectedHeater->DeInit();
+    if (linActive && MCP2515_Dma_Enabled())
+    {
+        MCP2515_Use_Dma(false);
+        new (lin) LinBus(USART1, 19200); //Set the channels up for LIN again
+    }
+    else if (!linActive)
+    {
+        usart_disable_tx_dma(USART1);
+        usart_disable_rx_dma(USART1);
+        MCP2515_Use_Dma(true);
+    }
+
     switch (Param::GetInt(Param::Heater))
     {
     case HeatType::Noheater:
-        selectedHeater = &Heaternone;
+        selectedHeater.Select<noHeater>();
         break;
     case HeatType::AmpHeater:
-        selectedHeater = &amperaHeater;
+        selectedHeater.Select<AmperaHeater>();
         break;
     case HeatType::VW:
-        selectedHeater = &heaterVW;
-        heaterVW.SetLinInterface(lin);
+        selectedHeater.Select<vwHeater>([](auto& heater) { heater.SetLinInterface(lin); });
     }
     //This will call SetCanFilters() via the Clear Callback
     canInterface[0]->ClearUserMessages();
@@ -730,15 +866,15 @@ static void UpdateBMS()
     switch (Param::GetInt(Param::BMS_Mode))
     {
     case BMSModes::BMSModeSimpBMS:
-        selectedBMS = &BMSsimp;
+        selectedBMS.Select<SimpBMS>();
         break;
     case BMSModes::BMSModeDaisychainSingleBMS:
     case BMSModes::BMSModeDaisychainDualBMS:
-        selectedBMS = &BMSdaisychain;
+        selectedBMS.Select<DaisychainBMS>();
         break;
     default:
         // Default to no BMS
-        selectedBMS = &BMSnone;
+        selectedBMS.Select<BMS>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -752,16 +888,16 @@ static void UpdateDCDC()
     switch (Param::GetInt(Param::DCdc_Type))
     {
     case DCDCModes::NoDCDC:
-        selectedDCDC = &DCDCnone;
+        selectedDCDC.Select<DCDC>();
         break;
 
     case DCDCModes::TeslaG2:
-        selectedDCDC = &DCDCTesla;
+        selectedDCDC.Select<TeslaDCDC>();
         break;
 
     default:
         // Default to no DCDC
-        selectedDCDC = &DCDCnone;
+        selectedDCDC.Select<DCDC>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -776,24 +912,24 @@ static void UpdateShifter()
     switch (Param::GetInt(Param::GearLvr))
     {
     case ShifterModes::NoShifter:
-        selectedShifter = &shifterNone;
+        selectedShifter.Select<Shifter>();
         break;
 
     case ShifterModes::BMWF30:
-        selectedShifter = &F30GearLever;
+        selectedShifter.Select<F30_Lever>();
         break;
 
     case ShifterModes::JLRG1:
-        selectedShifter = &JLRG1shift;
+        selectedShifter.Select<JLR_G1>();
         break;
 
     case ShifterModes::JLRG2:
-        selectedShifter = &JLRG2shift;
+        selectedShifter.Select<JLR_G2>();
         break;
 
     default:
         // Default to no shifter
-        selectedShifter = &shifterNone;
+        selectedShifter.Select<Shifter>();
         break;
     }
     //This will call SetCanFilters() via the Clear Callback
@@ -815,15 +951,28 @@ static void SetCanFilters()
     CanHardware* obd2_can = canInterface[Param::GetInt(Param::OBD2Can)];
     CanHardware* dcdc_can = canInterface[Param::GetInt(Param::DCDCCan)];
 
+    //Rebuild the receive dispatch table, each driver's IDs are tagged with its owner
+    CanDispatch::Clear();
+    CanTxScheduler::Clear();
+    CanFreshness::Clear(msTicks);
+    CanDispatch::SetOwner(CanDispatch::OWN_INVERTER);
     selectedInverter->SetCanInterface(inverter_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_VEHICLE);
     selectedVehicle->SetCanInterface(vehicle_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_CHARGER);
     selectedCharger->SetCanInterface(charger_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_CHARGEINT);
     selectedChargeInt->SetCanInterface(lim_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_BMS);
     selectedBMS->SetCanInterface(bms_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_DCDC);
     selectedDCDC->SetCanInterface(dcdc_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_SHIFTER);
     selectedShifter->SetCanInterface(vehicle_can);
+    CanDispatch::SetOwner(CanDispatch::OWN_OBD2);
     canOBD2.SetCanInterface(obd2_can);
 
+    CanDispatch::SetOwner(CanDispatch::OWN_SHUNT);
     if (Param::GetInt(Param::Type) == 0)  ISA::RegisterCanMessages(shunt_can);//select isa shunt
     if (Param::GetInt(Param::Type) == 1)  SBOX::RegisterCanMessages(shunt_can);//select bmw sbox
     if (Param::GetInt(Param::Type) == 2)  VWBOX::RegisterCanMessages(shunt_can);//select vw sbox
@@ -833,8 +982,39 @@ static void SetCanFilters()
 
 }
 
+//In a fixed configuration build the driver parameters can't select anything else
+static void PinFixedDrivers()
+{
+#ifdef FIXED_INVERTER_MODE
+    Param::SetInt(Param::Inverter, FIXED_INVERTER_MODE);
+#endif
+#ifdef FIXED_VEHICLE_MODE
+    Param::SetInt(Param::Vehicle, FIXED_VEHICLE_MODE);
+#endif
+#ifdef FIXED_CHARGER_MODE
+    Param::SetInt(Param::chargemodes, FIXED_CHARGER_MODE);
+#endif
+#ifdef FIXED_CHARGEINT_MODE
+    Param::SetInt(Param::interface, FIXED_CHARGEINT_MODE);
+#endif
+#ifdef FIXED_HEATER_MODE
+    Param::SetInt(Param::Heater, FIXED_HEATER_MODE);
+#endif
+#ifdef FIXED_BMS_MODE
+    Param::SetInt(Param::BMS_Mode, FIXED_BMS_MODE);
+#endif
+#ifdef FIXED_DCDC_MODE
+    Param::SetInt(Param::DCdc_Type, FIXED_DCDC_MODE);
+#endif
+#ifdef FIXED_SHIFTER_MODE
+    Param::SetInt(Param::GearLvr, FIXED_SHIFTER_MODE);
+#endif
+}
+
 void Param::Change(Param::PARAM_NUM paramNum)
 {
+    PinFixedDrivers();
+
     // This function is called when the user changes a parameter
     switch (paramNum)
     {
@@ -884,6 +1064,10 @@ void Param::Change(Param::PARAM_NUM paramNum)
     case Param::PWM3Func:
         tim3_setup();
         break;
+    case Param::SchedMode:
+        worstTick[0] = 0;
+        worstTick[1] = 0;
+        break;
     default:
         break;
     }
@@ -900,33 +1084,40 @@ void Param::Change(Param::PARAM_NUM paramNum)
         }
     }
 
+    schedMode = Param::GetInt(Param::SchedMode);
+    ms10Phase = Param::GetInt(Param::Ms10Phase);
+    ms100Phase = Param::GetInt(Param::Ms100Phase);
+    ms200Phase = Param::GetInt(Param::Ms200Phase);
+
     Throttle::potmin[0] = Param::GetInt(Param::potmin);
     Throttle::potmax[0] = Param::GetInt(Param::potmax);
     Throttle::potmin[1] = Param::GetInt(Param::pot2min);
     Throttle::potmax[1] = Param::GetInt(Param::pot2max);
-    Throttle::regenRpm = Param::GetFloat(Param::regenrpm);
-    Throttle::regenendRpm = Param::GetFloat(Param::regenendrpm);
-    Throttle::ThrotRpmFilt = Param::GetFloat(Param::throtrpmfilt);
-    if (Throttle::regenRpm < Throttle::regenendRpm)
+    ThrottleCalc::regenRpm = THROTPARAM(Param::regenrpm);
+    ThrottleCalc::regenendRpm = THROTPARAM(Param::regenendrpm);
+    ThrottleCalc::ThrotRpmFilt = THROTPARAM(Param::throtrpmfilt);
+    if (ThrottleCalc::regenRpm < ThrottleCalc::regenendRpm)
     {
-        Throttle::regenRpm = 1500;
-        Throttle::regenendRpm = 100;
+        ThrottleCalc::regenRpm = THROTVAL(1500);
+        ThrottleCalc::regenendRpm = THROTVAL(100);
         Param::SetFloat(Param::regenrpm, 1500);
         Param::SetFloat(Param::regenendrpm, 100);
     }
-    Throttle::regenmax = Param::GetFloat(Param::regenmax);
-    Throttle::throtmax = Param::GetFloat(Param::throtmax);
-    Throttle::throtmin = Param::GetFloat(Param::throtmin);
-    Throttle::throtdead = Param::GetFloat(Param::throtdead);
-    Throttle::idcmin = Param::GetFloat(Param::idcmin);
-    Throttle::idcmax = Param::GetFloat(Param::idcmax);
-    Throttle::udcmin = Param::GetFloat(Param::udcmin);
-    Throttle::udcmax = Param::GetFloat(Param::udclim);
-    Throttle::speedLimit = Param::GetInt(Param::revlim);
-    Throttle::regenRamp = Param::GetFloat(Param::regenramp);
-    Throttle::throttleRamp = Param::GetFloat(Param::throtramp);
-    Throttle::throtmaxRev = Param::GetFloat(throtmaxRev);
-    Throttle::regenBrake = Param::GetFloat(Param::regenBrake);
+    ThrottleCalc::regenmax = THROTPARAM(Param::regenmax);
+    ThrottleCalc::throtmax = THROTPARAM(Param::throtmax);
+    ThrottleCalc::throtmin = THROTPARAM(Param::throtmin);
+    ThrottleCalc::throtdead = THROTPARAM(Param::throtdead);
+    ThrottleCalc::idcmin = THROTPARAM(Param::idcmin);
+    ThrottleCalc::idcmax = THROTPARAM(Param::idcmax);
+    ThrottleCalc::udcmin = THROTPARAM(Param::udcmin);
+    ThrottleCalc::udcmax = THROTPARAM(Param::udclim);
+    ThrottleCalc::speedLimit = Param::GetInt(Param::revlim);
+    ThrottleCalc::regenRamp = THROTPARAM(Param::regenramp);
+    ThrottleCalc::throttleRamp = THROTPARAM(Param::throtramp);
+    ThrottleCalc::throttleRampMax = THROTVAL(Param::GetAttrib(Param::throtramp)->max);
+    ThrottleCalc::throtmaxRev = THROTPARAM(Param::throtmaxRev);
+    ThrottleCalc::regenBrake = THROTPARAM(Param::regenBrake);
+    ShiftMap::Configure(Param::GetInt(Param::shiftup), Param::GetInt(Param::shiftupfull), Param::GetInt(Param::shifthyst));
 
     targetCharger=static_cast<ChargeModes>(Param::GetInt(Param::chargemodes));//get charger setting from menu
     targetChgint=static_cast<ChargeInterfaces>(Param::GetInt(Param::interface));//get interface setting from menu
@@ -944,31 +1135,79 @@ void Param::Change(Param::PARAM_NUM paramNum)
     ChgTicks = (GetInt(Param::Chg_Dur)*300);//number of 200ms ticks that equates to charge timer in minutes
     IOMatrix::AssignFromParams();
     IOMatrix::AssignFromParamsAnalogue();
+    HotParams::RefreshConfig();
 }
 
 
-static bool CanCallback(uint32_t id, uint32_t data[2], uint8_t dlc) //This is where we go when a defined CAN message is received.
+static void DecodeCanFrame(uint32_t id, uint32_t data[2], CanDispatch::buses bus) //This is where we go when a defined CAN message is dequeued.
 {
-    dlc = dlc;
-    switch (id)
-    {
-    case 0x7DF:
-        canOBD2.DecodeCAN(id,data);
-        break;
+    //Only hand the frame to the drivers that registered its ID in SetCanFilters()
+    uint16_t owners = CanDispatch::GetOwners(id, bus);
 
-    default:
+    if (owners == 0) return;
+
+    if (DISPATCH_TO(owners, OWN_OBD2)) canOBD2.DecodeCAN(id,data);
+    if (DISPATCH_TO(owners, OWN_SHUNT))
+    {
         if (Param::GetInt(Param::Type) == 0)  ISA::DecodeCAN(id, data);
         if (Param::GetInt(Param::Type) == 1)  SBOX::DecodeCAN(id, data);
         if (Param::GetInt(Param::Type) == 2)  VWBOX::DecodeCAN(id, data);
-        selectedInverter->DecodeCAN(id, data);
-        selectedVehicle->DecodeCAN(id, data);
-        selectedCharger->DecodeCAN(id, data);
-        selectedChargeInt->DecodeCAN(id, data);
-        selectedBMS->DecodeCAN(id, (uint8_t*)data);
-        selectedDCDC->DecodeCAN(id, (uint8_t*)data);
-        selectedShifter->DecodeCAN(id,data);
-        break;
     }
+    if (DISPATCH_TO(owners, OWN_INVERTER)) selectedInverter->DecodeCAN(id, data);
+    if (DISPATCH_TO(owners, OWN_VEHICLE)) selectedVehicle->DecodeCAN(id, data);
+    if (DISPATCH_TO(owners, OWN_CHARGER)) selectedCharger->DecodeCAN(id, data);
+    if (DISPATCH_TO(owners, OWN_CHARGEINT)) selectedChargeInt->DecodeCAN(id, data);
+    if (DISPATCH_TO(owners, OWN_BMS)) selectedBMS->DecodeCAN(id, (uint8_t*)data);
+    if (DISPATCH_TO(owners, OWN_DCDC)) selectedDCDC->DecodeCAN(id, (uint8_t*)data);
+    if (DISPATCH_TO(owners, OWN_SHIFTER)) selectedShifter->DecodeCAN(id,data);
+}
+
+//bxCAN driver that counts the sent frames for CanStats and packs the receive
+//IDs into as few filter banks as possible
+class VcuCan : public Stm32Can
+{
+public:
+    VcuCan(uint32_t baseAddr, enum baudrates baudrate, CanStats::buses b, bool remap = false)
+        : Stm32Can(baseAddr, baudrate, remap), bus(b) { ConfigureFilters(); }
+
+    void Send(uint32_t canId, uint32_t data[2], uint8_t len)
+    {
+        CanStats::CountTx(bus, canId, len);
+        CanTrace::Record(bus, true, canId, data, len);
+        CanFreshness::CommandSent(canId, msTicks);
+        Stm32Can::Send(canId, data, len);
+    }
+    using CanHardware::Send;
+
+private:
+    //Called by CanHardware whenever the user messages change
+    void ConfigureFilters()
+    {
+        int can2Start = CanFilterOpt::GetCan2StartBank();
+        int first = bus == CanStats::BUS_CAN1 ? 0 : can2Start;
+        int last = bus == CanStats::BUS_CAN1 ? can2Start - 1 : 27;
+        CanFilterOpt::Result& filters = canFilters[bus];
+
+        if (CanFilterOpt::Optimise(userIds, nextUserMessageIndex, last - first + 1, filters))
+            CanFilterOpt::Apply(filters, first, last);
+    }
+
+    CanStats::buses bus;
+};
+
+//Called from the CAN receive interrupts, only queue the frame here and decode it in Ms1Task.
+//Frames no driver registered (CanMap, SDO) are left to the other callbacks and use no ring slot.
+static bool CanCallback1(uint32_t id, uint32_t data[2], uint8_t dlc)
+{
+    CanTrace::Record(0, false, id, data, dlc);
+    if (CanDispatch::GetOwners(id) != 0) canRxRing[0].Put(id, data, dlc, msTicks);
+    return false;
+}
+
+static bool CanCallback2(uint32_t id, uint32_t data[2], uint8_t dlc)
+{
+    CanTrace::Record(1, false, id, data, dlc);
+    if (CanDispatch::GetOwners(id) != 0) canRxRing[1].Put(id, data, dlc, msTicks);
     return false;
 }
 
@@ -988,20 +1227,36 @@ extern "C" void tim4_isr(void)
 }
 
 
-extern "C" void exti15_10_isr(void)    //CAN3 MCP25625 interruppt
+//Called from the SPI2 DMA interrupt once a CAN3 frame has been read from the MCP25625
+static void Can3Received(uCAN_MSG* rxMessage)
 {
-    uCAN_MSG rxMessage;
     uint32_t canData[2];
-    if(CANSPI_receive(&rxMessage))
-    {
-        canData[0]=(rxMessage.frame.data0 | rxMessage.frame.data1<<8 | rxMessage.frame.data2<<16 | rxMessage.frame.data3<<24);
-        canData[1]=(rxMessage.frame.data4 | rxMessage.frame.data5<<8 | rxMessage.frame.data6<<16 | rxMessage.frame.data7<<24);
-    }
-    //can cast this to uint32_t[2]. dont be an idiot! * pointer
-    CANSPI_CLR_IRQ();   //Clear Rx irqs in mcp25625
+
+    canData[0]=(rxMessage->frame.data0 | rxMessage->frame.data1<<8 | rxMessage->frame.data2<<16 | rxMessage->frame.data3<<24);
+    canData[1]=(rxMessage->frame.data4 | rxMessage->frame.data5<<8 | rxMessage->frame.data6<<16 | rxMessage->frame.data7<<24);
+    canRxRing[2].Put(rxMessage->frame.id, canData, rxMessage->frame.dlc, msTicks);
+    CanTrace::Record(2, false, rxMessage->frame.id, canData, rxMessage->frame.dlc);
+}
+
+extern "C" void exti15_10_isr(void)    //CAN3 MCP25625 interruppt
+{
     exti_reset_request(EXTI15); // clear irq
-    if((rxMessage.frame.id==0x108)||(rxMessage.frame.id==0x109)) selectedChargeInt->DecodeCAN(rxMessage.frame.id, canData);
+    CANSPI_StartReceive(); //Frame is read by DMA, the MCP25625 irqs are cleared once it's in
+}
+
+extern "C" void dma1_channel4_isr(void)    //SPI2 RX, MCP25625 transaction done
+{
+    MCP2515_Transfer_Complete();
+}
 
+extern "C" void dma1_channel6_isr(void)    //USART2 RX, Toyota MTH frame received
+{
+    GS450HClass::MthReceived();
+}
+
+extern "C" void dma1_channel7_isr(void)    //USART2 TX, Toyota HTM frame sent
+{
+    GS450HClass::HtmSent();
 }
 
 extern "C" void rtc_isr(void)
@@ -1046,9 +1301,10 @@ extern "C" int main(void)
 
     Terminal t(USART3, TermCmds);
 //   FunctionPointerCallback canCb(CanCallback, SetCanFilters);
-    Stm32Can c(CAN1, CanHardware::Baud500);
-    Stm32Can c2(CAN2, CanHardware::Baud500, true);
-    FunctionPointerCallback cb(CanCallback, SetCanFilters);
+    VcuCan c(CAN1, CanHardware::Baud500, CanStats::BUS_CAN1);
+    VcuCan c2(CAN2, CanHardware::Baud500, CanStats::BUS_CAN2, true);
+    FunctionPointerCallback cb(CanCallback1, SetCanFilters);
+    FunctionPointerCallback cb2(CanCallback2, SetCanFilters);
     Stm32Can *CanMapDev = &c;
     if (Param::GetInt(Param::CanMapCan) == 0)
     {
@@ -1067,7 +1323,7 @@ extern "C" int main(void)
     canInterface[0] = &c;
     canInterface[1] = &c2;
     c.AddCallback(&cb);
-    c2.AddCallback(&cb);
+    c2.AddCallback(&cb2);
     TerminalCommands::SetCanMap(&cm);
     canMap = &cm;
 
@@ -1076,6 +1332,7 @@ extern "C" int main(void)
     canOBD2.SetCanInterface(canInterface[Param::GetInt(Param::OBD2Can)]);
 
     CANSPI_Initialize();// init the MCP25625 on CAN3
+    CANSPI_SetRxHandler(Can3Received);
     CANSPI_ENRx_IRQ();  //init CAN3 Rx IRQ
 
     LinBus l(USART1, 19200);
@@ -1090,13 +1347,21 @@ extern "C" int main(void)
     UpdateDCDC();
     UpdateShifter();
 
+    //RAM saved by the driver slots, printed after linking
+    DRIVER_RAM_REPORT(inverter, selectedInverter);
+    DRIVER_RAM_REPORT(vehicle, selectedVehicle);
+    DRIVER_RAM_REPORT(heater, selectedHeater);
+    DRIVER_RAM_REPORT(charger, selectedCharger);
+    DRIVER_RAM_REPORT(chargeint, selectedChargeInt);
+    DRIVER_RAM_REPORT(shifter, selectedShifter);
+    DRIVER_RAM_REPORT(bms, selectedBMS);
+    DRIVER_RAM_REPORT(dcdc, selectedDCDC);
+
     Stm32Scheduler s(TIM4); //We never exit main so it's ok to put it on stack
     scheduler = &s;
+    TaskProfiler::Init();
 
-    s.AddTask(Ms1Task, 1);
-    s.AddTask(Ms10Task, 10);
-    s.AddTask(Ms100Task, 100);
-    s.AddTask(Ms200Task, 200);
+    s.AddTask(SchedulerTick, 1); //Starts Ms1Task..Ms200Task with their phase offsets
 
     if(Param::GetInt(Param::IsaInit)==1) ISA::initialize(shunt_can);//only call this once if a new sensor is fitted.
 
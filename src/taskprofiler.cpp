@@ -0,0 +1,116 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "taskprofiler.h"
+
+#ifdef STM32F1
+#include <libopencm3/cm3/dwt.h>
+#define TICKS_PER_US 72 //Core clock 72 MHz
+#else
+#include <chrono>
+#define TICKS_PER_US 1000 //Host clock counts nanoseconds
+#endif
+
+TaskProfiler::Stats TaskProfiler::stats[LAST];
+
+const char* const TaskProfiler::names[LAST] =
+{
+   "Ms1Task", "Ms10Task", "Ms100Task", "Ms200Task",
+   "CanRx", "Throttle", "CanMap",
+   "Inv1Ms", "Inv10Ms", "Inv100Ms", "InvTorque",
+   "Veh1Ms", "Veh10Ms", "Veh100Ms", "Veh200Ms",
+   "Chg1Ms", "Chg10Ms", "Chg100Ms", "Chg200Ms",
+   "ChgInt1Ms", "ChgInt10Ms", "ChgInt100Ms", "ChgInt200Ms",
+   "Bms100Ms",
+   "Dcdc1Ms", "Dcdc10Ms", "Dcdc100Ms",
+   "Shift1Ms", "Shift10Ms", "Shift100Ms",
+   "SeqStep", "CanTx"
+};
+
+//A section overruns when it takes longer than the period of the task it runs in
+const uint16_t TaskProfiler::budgetMs[LAST] =
+{
+   1, 10, 100, 200,
+   1, 10, 100,
+   1, 10, 100, 10,
+   1, 10, 100, 200,
+   1, 10, 100, 200,
+   1, 10, 100, 200,
+   100,
+   1, 10, 100,
+   1, 10, 100,
+   1, 1
+};
+
+void TaskProfiler::Init()
+{
+#ifdef STM32F1
+   dwt_enable_cycle_counter();
+#endif
+   Reset();
+}
+
+void TaskProfiler::Reset()
+{
+   for (int i = 0; i < LAST; i++)
+   {
+      stats[i].min = 0xFFFFFFFF;
+      stats[i].max = 0;
+      stats[i].last = 0;
+      stats[i].count = 0;
+      stats[i].overruns = 0;
+      stats[i].sum = 0;
+   }
+}
+
+uint32_t TaskProfiler::GetTicks()
+{
+#ifdef STM32F1
+   return dwt_read_cycle_counter();
+#else
+   return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void TaskProfiler::Stop(sections s, uint32_t start)
+{
+   uint32_t ticks = GetTicks() - start; //unsigned difference survives the counter wrapping
+   Stats& st = stats[s];
+
+   st.last = ticks;
+   st.sum += ticks;
+   st.count++;
+   if (ticks < st.min) st.min = ticks;
+   if (ticks > st.max) st.max = ticks;
+   if (ticks > (uint32_t)budgetMs[s] * 1000 * TICKS_PER_US) st.overruns++;
+}
+
+uint32_t TaskProfiler::ToMicroseconds(uint32_t ticks)
+{
+   return ticks / TICKS_PER_US;
+}
+
+uint32_t TaskProfiler::GetMeanUs(sections s)
+{
+   if (stats[s].count == 0) return 0;
+   return (uint32_t)(stats[s].sum / stats[s].count / TICKS_PER_US);
+}
+
+uint32_t TaskProfiler::GetTotalOverruns()
+{
+   return stats[MS1].overruns + stats[MS10].overruns + stats[MS100].overruns + stats[MS200].overruns;
+}
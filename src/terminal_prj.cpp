@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <libopencm3/cm3/scb.h>
 #include <libopencm3/stm32/usart.h>
 #include "hwdefs.h"
@@ -29,6 +30,9 @@
 #include "errormessage.h"
 #include "stm32_can.h"
 #include "terminalcommands.h"
+#include "taskprofiler.h"
+#include "cantrace.h"
+#include "canfreshness.h"
 
 static void LoadDefaults(Terminal* t, char *arg);
 static void GetAll(Terminal* t, char *arg);
@@ -36,6 +40,9 @@ static void PrintList(Terminal* t, char *arg);
 static void PrintAtr(Terminal* t, char *arg);
 static void PrintSerial(Terminal* t, char *arg);
 static void PrintErrors(Terminal* t, char *arg);
+static void PrintProfile(Terminal* t, char *arg);
+static void CanTraceCmd(Terminal* t, char *arg);
+static void PrintFreshness(Terminal* t, char *arg);
 
 extern const TERM_CMD TermCmds[] =
 {
@@ -54,6 +61,9 @@ extern const TERM_CMD TermCmds[] =
    { "serial", PrintSerial },
    { "errors", PrintErrors },
    { "reset", TerminalCommands::Reset },
+   { "prof", PrintProfile },
+   { "trace", CanTraceCmd },
+   { "fresh", PrintFreshness },
    { NULL, NULL }
 };
 
@@ -129,3 +139,196 @@ static void PrintSerial(Terminal* t, char *arg)
    arg = arg;
    fprintf(t, "%X%X%X\r\n", DESIG_UNIQUE_ID2, DESIG_UNIQUE_ID1, DESIG_UNIQUE_ID0);
 }
+
+//"prof" prints the task and driver execution times, "prof reset" clears them
+static void PrintProfile(Terminal* t, char *arg)
+{
+   arg = my_trim(arg);
+
+   if (my_strcmp(arg, "reset") == 0)
+   {
+      TaskProfiler::Reset();
+      fprintf(t, "Profile cleared\r\n");
+      return;
+   }
+
+   fprintf(t, "Section\t\tmin\tmax\tmean\tlast [us]\tcount\toverruns\r\n");
+
+   for (int i = 0; i < TaskProfiler::LAST; i++)
+   {
+      TaskProfiler::sections s = (TaskProfiler::sections)i;
+      const TaskProfiler::Stats& st = TaskProfiler::GetStats(s);
+
+      if (st.count == 0) continue;
+
+      fprintf(t, "%s\t\t%d\t%d\t%d\t%d\t\t%d\t%d\r\n", TaskProfiler::GetName(s),
+              TaskProfiler::ToMicroseconds(st.min), TaskProfiler::ToMicroseconds(st.max),
+              TaskProfiler::GetMeanUs(s), TaskProfiler::ToMicroseconds(st.last),
+              st.count, st.overruns);
+   }
+}
+
+//Writes value as digits hex digits (base 16) or decimal digits (base 10) and returns the end
+static char* PutDigits(char* p, uint32_t value, int digits, int base)
+{
+   for (int i = digits - 1; i >= 0; i--, value /= base)
+      p[i] = "0123456789ABCDEF"[value % base];
+   return p + digits;
+}
+
+//Parses a hex number and moves arg behind it
+static uint32_t ParseHex(char*& arg)
+{
+   uint32_t value = 0;
+
+   while (*arg == ' ') arg++;
+
+   for (;; arg++)
+   {
+      char c = *arg;
+
+      if (c >= '0' && c <= '9') value = (value << 4) | (c - '0');
+      else if (c >= 'a' && c <= 'f') value = (value << 4) | (c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F') value = (value << 4) | (c - 'A' + 10);
+      else break;
+   }
+   return value;
+}
+
+/* "trace start" records all frames, "trace arm" stops POST_TRIGGER frames after
+ * the next error, "trace stop" stops. "trace filter <id> <mask>" (hex) adds a
+ * filter, "trace filter clear" removes them.
+ * "trace" prints the capture in candump log format, e.g. "(0.001250) can1 1DA#0102..."
+ * with sent frames marked " T", "trace hex" prints the raw 16 byte records.
+ * Printing stops a running capture so the ring doesn't change underneath.
+ */
+static void CanTraceCmd(Terminal* t, char *arg)
+{
+   arg = my_trim(arg);
+
+   if (my_strcmp(arg, "start") == 0 || my_strcmp(arg, "arm") == 0)
+   {
+      CanTrace::Start(arg[0] == 'a');
+      fprintf(t, "Trace started\r\n");
+      return;
+   }
+   if (my_strcmp(arg, "stop") == 0)
+   {
+      CanTrace::Stop();
+      fprintf(t, "Trace stopped, %d frames\r\n", CanTrace::GetCount());
+      return;
+   }
+   if (my_strcmp(arg, "filter clear") == 0)
+   {
+      CanTrace::ClearFilters();
+      fprintf(t, "Filters cleared\r\n");
+      return;
+   }
+   if (strncmp(arg, "filter", 6) == 0 && (arg[6] == ' ' || arg[6] == 0))
+   {
+      arg = my_trim(arg + 6);
+      if (*arg == 0)
+      {
+         fprintf(t, "Usage: trace filter <id> [<mask>]\r\n");
+         return;
+      }
+      uint32_t id = ParseHex(arg);
+      uint32_t mask = ParseHex(arg);
+
+      if (CanTrace::AddFilter(id, mask == 0 ? 0x1FFFFFFF : mask))
+         fprintf(t, "Filter added\r\n");
+      else
+         fprintf(t, "No more filters\r\n");
+      return;
+   }
+
+   bool hex = my_strcmp(arg, "hex") == 0;
+   uint32_t sec = 0, us = 0;
+
+   if (!hex && arg[0] != 0)
+   {
+      fprintf(t, "Unknown trace command %s\r\n", arg);
+      return;
+   }
+
+   CanTrace::Stop();
+
+   for (int i = 0; i < CanTrace::GetCount(); i++)
+   {
+      const CanTrace::Frame& f = CanTrace::Get(i);
+      char line[56];
+      char* p = line;
+
+      if (hex)
+      {
+         const uint8_t* bytes = (const uint8_t*)&f;
+
+         for (uint32_t j = 0; j < sizeof(f); j++)
+            p = PutDigits(p, bytes[j], 2, 16);
+      }
+      else
+      {
+         uint32_t id = f.id & 0x1FFFFFFF;
+         const uint8_t* data = (const uint8_t*)f.data;
+
+         us += f.deltaUs;
+         sec += us / 1000000;
+         us %= 1000000;
+
+         *p++ = '(';
+         p = PutDigits(p, sec, 5, 10);
+         *p++ = '.';
+         p = PutDigits(p, us, 6, 10);
+         *p++ = ')';
+         *p++ = ' ';
+         *p++ = 'c'; *p++ = 'a'; *p++ = 'n';
+         *p++ = '1' + ((f.id >> CanTrace::BUS_SHIFT) & 3);
+         *p++ = ' ';
+         p = PutDigits(p, id, id > 0x7FF ? 8 : 3, 16);
+         *p++ = '#';
+         for (int j = 0; j < f.dlc && j < 8; j++)
+            p = PutDigits(p, data[j], 2, 16);
+         if (f.id & CanTrace::SENT) { *p++ = ' '; *p++ = 'T'; }
+      }
+      *p = 0;
+      fprintf(t, "%s\r\n", line);
+   }
+}
+
+/* One line per expected receive ID, the most overdue one is marked with '*'.
+ * age and period in ms, jitter counts the gaps that were off the period by
+ * <12.5%, <25%, <50%, <100% and more, lat is the command to feedback time.
+ * "fresh reset" clears the counters.
+ */
+static void PrintFreshness(Terminal* t, char *arg)
+{
+   static const char* owners[] = { "shunt", "inv", "veh", "chg", "chgint", "bms", "dcdc", "shift", "obd2" };
+   arg = my_trim(arg);
+
+   if (my_strcmp(arg, "reset") == 0)
+   {
+      CanFreshness::ResetStats();
+      fprintf(t, "Freshness counters cleared\r\n");
+      return;
+   }
+
+   int worst = CanFreshness::GetWorst();
+
+   fprintf(t, "ID\towner\tperiod\tage\tframes\tmissed\tmaxgap\tjitter\t\t\tlat\tmaxlat\tresp\tmaxresp\r\n");
+
+   for (int i = 0; i < CanFreshness::GetNumIds(); i++)
+   {
+      const CanFreshness::Entry& e = CanFreshness::Get(i);
+      char id[10];
+      char* p = PutDigits(id, e.id, e.id > 0x7FF ? 8 : 3, 16);
+
+      *p++ = i == worst ? '*' : ' ';
+      *p = 0;
+
+      fprintf(t, "%s\t%s\t%d\t%d\t%d\t%d\t%d\t%d/%d/%d/%d/%d\t%d\t%d\t%d\t%d\r\n", id,
+              e.owner < sizeof(owners) / sizeof(owners[0]) ? owners[e.owner] : "?",
+              e.periodMs, CanFreshness::GetAge(i), e.frames, e.missed, e.maxGapMs,
+              e.jitter[0], e.jitter[1], e.jitter[2], e.jitter[3], e.jitter[4],
+              e.latencyMs, e.maxLatencyMs, e.responseMs, e.maxResponseMs);
+   }
+}
@@ -1,4 +1,5 @@
 #include <teslaCharger.h>
+#include "candispatch.h"
 
 static bool HVreq=false;
 static bool ChRun=false;
@@ -14,7 +15,7 @@ void teslaCharger::SetCanInterface(CanHardware* c)
 {
    can = c;
 
-   can->RegisterUserMessage(0x108);
+   CanDispatch::RegisterUserMessage(can, 0x108);
 
 }
 
@@ -44,6 +44,7 @@ float Throttle::throtmin;
 float Throttle::throtdead;
 float Throttle::regenRamp;
 float Throttle::throttleRamp;
+float Throttle::throttleRampMax;
 int Throttle::bmslimhigh;
 int Throttle::bmslimlow;
 float Throttle::udcmin;
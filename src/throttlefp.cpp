@@ -0,0 +1,349 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "throttlefp.h"
+#include "my_math.h"
+
+//Keeps rpm and current products inside the +-32767 range of thrfp
+#define SPEED_RANGE 30000
+#define IDCERR_RANGE 1000
+
+thrfp ThrottleFP::regenRpm;
+thrfp ThrottleFP::regenendRpm;
+thrfp ThrottleFP::regenmax;
+thrfp ThrottleFP::regenBrake;
+thrfp ThrottleFP::brkcruise;
+int ThrottleFP::idleSpeed;
+int ThrottleFP::cruiseSpeed;
+thrfp ThrottleFP::speedkp;
+int ThrottleFP::speedflt;
+int ThrottleFP::speedFiltered;
+thrfp ThrottleFP::idleThrotLim;
+thrfp ThrottleFP::throtmax;
+thrfp ThrottleFP::throtmaxRev;
+thrfp ThrottleFP::throtmin;
+thrfp ThrottleFP::throtdead;
+thrfp ThrottleFP::regenRamp;
+thrfp ThrottleFP::throttleRamp;
+thrfp ThrottleFP::throttleRampMax;
+thrfp ThrottleFP::udcmin;
+thrfp ThrottleFP::udcmax;
+thrfp ThrottleFP::idcmin;
+thrfp ThrottleFP::idcmax;
+int ThrottleFP::speedLimit;
+thrfp ThrottleFP::ThrotRpmFilt;
+
+// internal variables, reused every time the functions are called
+static thrfp throttleRamped = 0;
+static thrfp SpeedFiltered = 0;
+
+static thrfp regenlim = 0;
+
+//Scale of the deadzone mapping, only recalculated when throtdead changes
+static thrfp deadzoneGain = THR_FROMINT(1);
+static thrfp deadzoneGainOf = 0;
+
+#define PedalPosArrLen 50
+static thrfp PedalPosTot = 0;
+static thrfp PedalPosArr[PedalPosArrLen];
+static uint8_t PedalPosIdx = 0;
+
+/**
+ * @brief Normalize the throttle input value to the min-max scale.
+ *
+ * Integer quotient and remainder are scaled separately, so two 32 bit
+ * divisions suffice for full precision.
+ *
+ * @param potval Throttle input value, range is [potmin[potIdx], potmax[potIdx]], not checked!
+ * @param potIdx Index of the throttle input, should be [0, 1].
+ * @return Normalized throttle value output with range [0, 100] with correct input.
+ */
+thrfp ThrottleFP::NormalizeThrottle(int potval, int potIdx)
+{
+    if(potIdx < 0 || potIdx > 1)
+        return 0;
+
+    int range = Throttle::potmax[potIdx] - Throttle::potmin[potIdx];
+
+    if(range == 0)
+        return 0;
+
+    int num = 100 * (potval - Throttle::potmin[potIdx]);
+
+    return THR_FROMINT(num / range) + THR_FROMINT(num % range) / range;
+}
+
+/**
+ * @brief Calculate a throttle percentage from the potval input, see Throttle::CalcThrottle
+ *
+ * utils::change() works on integers, the float version truncates its inputs
+ * and so does this one.
+ */
+thrfp ThrottleFP::CalcThrottle(int potval, int potIdx, bool brkpedal)
+{
+    int speed = Param::GetInt(Param::speed);
+    int dir = Param::GetInt(Param::dir);
+    thrfp potnom = 0;
+
+    if(speed< 0)//make sure speed is not negative
+    {
+        speed *= -1;
+    }
+
+    speed = MIN(speed, SPEED_RANGE);
+
+    //limiting speed change rate
+    thrfp speedfp = THR_FROMINT(speed);
+
+    if(ABS(speedfp-SpeedFiltered)>ThrotRpmFilt)
+    {
+        if(speedfp > SpeedFiltered)
+        {
+            SpeedFiltered +=  ThrotRpmFilt;
+        }
+        else
+        {
+            SpeedFiltered -=  ThrotRpmFilt;
+        }
+    }
+    else
+    {
+        SpeedFiltered = speedfp;
+    }
+
+    speed = THR_TOINT(SpeedFiltered);
+
+    if(dir == 0)//neutral no torque command
+    {
+        return 0;
+    }
+
+    if (brkpedal)
+    {
+        if(speed < 100)
+        {
+            return 0;
+        }
+        else if (THR_FROMINT(speed) < regenRpm)
+        {
+            //taper regen according to speed
+            return THR_FROMINT(utils::change(speed, THR_TOINT(regenendRpm), THR_TOINT(regenRpm), 0, THR_TOINT(regenBrake)));
+        }
+        else
+        {
+            return regenBrake;
+        }
+    }
+
+    potnom = NormalizeThrottle(potval, potIdx);
+
+    // Apply the deadzone parameter, mapping [throtdead, 100] to [0, 100]
+    if(potnom < throtdead)
+    {
+        potnom = 0;
+    }
+    else
+    {
+        if (deadzoneGainOf != throtdead)
+        {
+            deadzoneGain = THR_DIV(THR_FROMINT(100), THR_FROMINT(100) - throtdead);
+            deadzoneGainOf = throtdead;
+        }
+        potnom = THR_MUL(potnom - throtdead, deadzoneGain);
+    }
+
+    thrfp TempAvgPos = AveragePos(potnom); //rolling average pedal position over the last 50 measurements
+    thrfp PedalChange = potnom - TempAvgPos;
+
+    if(PedalChange >= -THR_FROMINT(1) && PedalChange <= THR_FROMINT(1))//pedal not changed
+    {
+        potnom = TempAvgPos; //use the averaged pedal
+    }
+
+    if(speed < 100)//No regen under 100 rpm
+    {
+        regenlim = 0;
+    }
+    else if(THR_FROMINT(speed) < regenRpm)
+    {
+        //taper regen according to speed
+        regenlim = THR_FROMINT(utils::change(speed, THR_TOINT(regenendRpm), THR_TOINT(regenRpm), 0, THR_TOINT(regenmax)));
+    }
+    else
+    {
+        regenlim = regenmax;
+    }
+
+    //Map in 0.1% steps like the float version
+    thrfp potmax = dir == 1 ? throtmax : throtmaxRev;
+    int32_t permille = utils::change(THR_TOINT(potnom), 0, 100, THR_TOINT(regenlim * 10), THR_TOINT(potmax * 10));
+
+    return THR_FROMINT(permille) / 10;
+}
+
+/**
+ * @brief Apply the throttle ramping parameters for ramping up and down.
+ *
+ * @param potnom Normalized throttle command in percent, range [-100, 100].
+ * @return Ramped throttle command in percent, range [-100, 100].
+ */
+thrfp ThrottleFP::RampThrottle(thrfp potnom)
+{
+    potnom = MIN(potnom, throtmax);
+    potnom = MAX(potnom, throtmin);
+
+    if (potnom >= throttleRamped) // higher throttle command than currently applied
+    {
+        if(potnom > 0)
+        {
+            throttleRamped = RAMPUP(throttleRamped, potnom, throttleRamp);
+        }
+        else
+        {
+            throttleRamped = RAMPUP(throttleRamped, potnom, regenRamp);
+        }
+        potnom = throttleRamped;
+    }
+    else // lower throttle command than currently applied
+    {
+        if(potnom >= 0)
+        {
+            throttleRamped = potnom; //No ramping from high throttle to low throttle
+        }
+        else
+        {
+            if(throttleRamped > 0)
+            {
+                throttleRamped = 0;
+            }
+            throttleRamped = RAMPDOWN(throttleRamped, potnom, regenRamp);
+            potnom = throttleRamped;
+        }
+    }
+
+    return potnom;
+}
+
+thrfp ThrottleFP::CalcIdleSpeed(int speed)
+{
+    int speederr = idleSpeed - speed;
+    speederr = MAX(-SPEED_RANGE, MIN(SPEED_RANGE, speederr));
+    return MIN(idleThrotLim, THR_MUL(speedkp, THR_FROMINT(speederr)));
+}
+
+thrfp ThrottleFP::CalcCruiseSpeed(int speed)
+{
+    speedFiltered = IIRFILTER(speedFiltered, speed, speedflt);
+    int speederr = cruiseSpeed - speedFiltered;
+    speederr = MAX(-SPEED_RANGE, MIN(SPEED_RANGE, speederr));
+
+    thrfp potnom = THR_MUL(speedkp, THR_FROMINT(speederr));
+    potnom = MIN(THR_FROMINT(100), potnom);
+    potnom = MAX(brkcruise, potnom);
+
+    return potnom;
+}
+
+bool ThrottleFP::TemperatureDerate(thrfp temp, thrfp tempMax, thrfp& finalSpnt)
+{
+    thrfp limit = 0;
+
+    if (temp <= tempMax)
+        limit = THR_FROMINT(100);
+    else if (temp < (tempMax + THR_FROMINT(2)))
+        limit = THR_FROMINT(50);
+
+    if (finalSpnt >= 0)
+        finalSpnt = MIN(finalSpnt, limit);
+    else
+        finalSpnt = MAX(finalSpnt, -limit);
+
+    return limit < THR_FROMINT(100);
+}
+
+void ThrottleFP::UdcLimitCommand(thrfp& finalSpnt, thrfp udc)
+{
+    if(udcmin>0)    //ignore if set to zero. useful for bench testing without isa shunt
+    {
+        if (finalSpnt >= 0)
+        {
+            thrfp res = (udc - udcmin) * 5;
+            res = MAX(0, res);
+            finalSpnt = MIN(finalSpnt, res);
+        }
+        else
+        {
+            thrfp res = (udc - udcmax) * 7 / 2;
+            res = MIN(0, res);
+            finalSpnt = MAX(finalSpnt, res);
+        }
+    }
+}
+
+void ThrottleFP::IdcLimitCommand(thrfp& finalSpnt, thrfp idc)
+{
+    static thrfp idcFiltered = 0;
+
+    idcFiltered = IIRFILTERF(idcFiltered, idc, 4);
+
+    if (finalSpnt >= 0)
+    {
+        thrfp idcerr = MIN(idcmax - idcFiltered, THR_FROMINT(IDCERR_RANGE));
+        thrfp res = idcerr * 10;
+
+        res = MAX(0, res);
+        finalSpnt = MIN(res, finalSpnt);
+    }
+    else
+    {
+        thrfp idcerr = MAX(idcmin - idcFiltered, -THR_FROMINT(IDCERR_RANGE));
+        thrfp res = idcerr * 10;
+
+        res = MIN(0, res);
+        finalSpnt = MAX(res, finalSpnt);
+    }
+}
+
+void ThrottleFP::SpeedLimitCommand(thrfp& finalSpnt, int speed)
+{
+    static int speedFiltered = 0;
+
+    speedFiltered = IIRFILTER(speedFiltered, speed, 4);
+
+    if (finalSpnt > 0)
+    {
+        int speederr = speedLimit - speedFiltered;
+        int res = speederr / 4;
+
+        res = MAX(0, res);
+        finalSpnt = MIN(THR_FROMINT(res), finalSpnt);
+    }
+}
+
+thrfp ThrottleFP::AveragePos(thrfp Pos)
+{
+    PedalPosIdx++; //next average arrray positon
+    if(PedalPosIdx >= PedalPosArrLen)
+    {
+        PedalPosIdx = 0;
+    }
+    PedalPosTot -= PedalPosArr[PedalPosIdx];
+    PedalPosTot += Pos;
+    PedalPosArr[PedalPosIdx] = Pos;
+
+    return PedalPosTot / PedalPosArrLen;
+}
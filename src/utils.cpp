@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "throttlefp.h"
+#include "hotparams.h"
 
 namespace utils
 {
@@ -55,21 +57,21 @@ void GetDigInputs(CanHardware* can)
  *  - ERR_THROTTLE12DIFF: Throttle input difference between 1 and 2 out of range
  *  - ERR_THROTTLEMODE: Illegal Throttle Mode used
  *
- * @return float Throttle percentage in the range of [-100.0, 100.0]
+ * @return Throttle percentage in the range of [-100.0, 100.0]
  */
-float GetUserThrottleCommand()
+throtval GetUserThrottleCommand()
 {
-    bool brake = Param::GetBool(Param::din_brake);
-    int potmode = Param::GetInt(Param::potmode);
-    int direction = Param::GetInt(Param::dir);
+    bool brake = HotParams::dinBrake;
+    int potmode = HotParams::potmode;
+    int direction = HotParams::dir;
 
     int pot1val = AnaIn::throttle1.Get();
     int pot2val = AnaIn::throttle2.Get();
     Param::SetInt(Param::pot, pot1val);
     Param::SetInt(Param::pot2, pot2val);
 
-    bool inRange1 = Throttle::CheckAndLimitRange(&pot1val, 0);
-    bool inRange2 = Throttle::CheckAndLimitRange(&pot2val, 1);
+    bool inRange1 = ThrottleCalc::CheckAndLimitRange(&pot1val, 0);
+    bool inRange2 = ThrottleCalc::CheckAndLimitRange(&pot2val, 1);
     int useChannel = 0; // default case: use Throttle 1
 
     // check the throttle values for plausibility
@@ -80,7 +82,7 @@ float GetUserThrottleCommand()
             //DigIo::err_out.Set();
             utils::PostErrorIfRunning(ERR_THROTTLE1);
             Param::SetInt(Param::potnom, 0);
-            return 0.0;
+            return 0;
         }
 
         useChannel = 0;
@@ -93,10 +95,10 @@ float GetUserThrottleCommand()
         {
             // These are only temporary values, because they can change
             // if the "limp mode" is activated.
-            float pot1nomTmp = Throttle::NormalizeThrottle(pot1val, 0);
-            float pot2nomTmp = Throttle::NormalizeThrottle(pot2val, 1);
+            throtval pot1nomTmp = ThrottleCalc::NormalizeThrottle(pot1val, 0);
+            throtval pot2nomTmp = ThrottleCalc::NormalizeThrottle(pot2val, 1);
 
-            if(ABS(pot2nomTmp - pot1nomTmp) > 10.0f)
+            if(ABS(pot2nomTmp - pot1nomTmp) > THROTVAL(10))
             {
                 utils::PostErrorIfRunning(ERR_THROTTLE12DIFF);
 
@@ -105,14 +107,14 @@ float GetUserThrottleCommand()
                 // to 50%
                 if(pot1nomTmp < pot2nomTmp)
                 {
-                    if(pot1nomTmp > 50.0f)
+                    if(pot1nomTmp > THROTVAL(50))
                         pot1val = Throttle::potmax[0] / 2;
 
                     useChannel = 0;
                 }
                 else
                 {
-                    if(pot2nomTmp > 50.0f)
+                    if(pot2nomTmp > THROTVAL(50))
                         pot2val = Throttle::potmax[1] / 2;
 
                     useChannel = 1;
@@ -135,31 +137,31 @@ float GetUserThrottleCommand()
         {
             utils::PostErrorIfRunning(ERR_THROTTLE12);
 
-            return 0.0;
+            return 0;
         }
     }
     else // (yet) unknown throttle mode
     {
         utils::PostErrorIfRunning(ERR_THROTTLEMODE);
 
-        return 0.0;
+        return 0;
     }
 
     // don't return a throttle value if we are in neutral
     // TODO: the direction for FORWARD/NEUTRAL/REVERSE needs an enum in param_prj.h as well
     if (direction == 0)
-        return 0.0;
+        return 0;
 
     if (direction == 2)//No throttle val if in PARK also.
-        return 0.0;
+        return 0;
 
     // calculate the throttle depending on the channel we've decided to use
     if (useChannel == 0)
-        return Throttle::CalcThrottle(pot1val, 0, brake);
+        return ThrottleCalc::CalcThrottle(pot1val, 0, brake);
     else if(useChannel == 1)
-        return Throttle::CalcThrottle(pot2val, 1, brake);
+        return ThrottleCalc::CalcThrottle(pot2val, 1, brake);
     else
-        return 0.0;
+        return 0;
 }
 
 
@@ -349,56 +351,56 @@ float ProcessUdc(int motorSpeed)
 
 float ProcessThrottle(int speed)
 {
-    float finalSpnt;
+    throtval finalSpnt;
 
-    if (speed < Param::GetInt(Param::throtramprpm))
+    if (speed < HotParams::throtramprpm)
     {
-        Throttle::throttleRamp = Param::GetFloat(Param::throtramp);
+        ThrottleCalc::throttleRamp = THROTFP(HotParams::throtramp);
     }
 
     else
     {
-        Throttle::throttleRamp = Param::GetAttrib(Param::throtramp)->max;
+        ThrottleCalc::throttleRamp = ThrottleCalc::throttleRampMax;
     }
 
     finalSpnt = utils::GetUserThrottleCommand();
 
-    if (Param::Get(Param::cruisespeed) > 0)
+    if (HotParams::cruisespeed > 0)
     {
-        Throttle::brkcruise = 0;
-        Throttle::speedflt = 5;
-        Throttle::speedkp = 0.25f;
-        Throttle::cruiseSpeed = Param::GetInt(Param::cruisespeed);
-        float cruiseThrottle = Throttle::CalcCruiseSpeed(ABS(Param::GetInt(Param::speed)));
+        ThrottleCalc::brkcruise = 0;
+        ThrottleCalc::speedflt = 5;
+        ThrottleCalc::speedkp = THROTVAL(0.25f);
+        ThrottleCalc::cruiseSpeed = HotParams::cruisespeed;
+        throtval cruiseThrottle = ThrottleCalc::CalcCruiseSpeed(ABS(HotParams::speed));
         finalSpnt = MAX(cruiseThrottle, finalSpnt);
     }
 
-    finalSpnt = Throttle::RampThrottle(finalSpnt);
+    finalSpnt = ThrottleCalc::RampThrottle(finalSpnt);
 
 
-    Throttle::UdcLimitCommand(finalSpnt,Param::GetFloat(Param::udc));
-    Throttle::IdcLimitCommand(finalSpnt, ABS(Param::GetFloat(Param::idc)));
-    Throttle::SpeedLimitCommand(finalSpnt, ABS(speed));
+    ThrottleCalc::UdcLimitCommand(finalSpnt, THROTFP(HotParams::udc));
+    ThrottleCalc::IdcLimitCommand(finalSpnt, THROTFP(ABS(HotParams::idc)));
+    ThrottleCalc::SpeedLimitCommand(finalSpnt, ABS(speed));
 
-    if (Throttle::TemperatureDerate(Param::Get(Param::tmphs), Param::Get(Param::tmphsmax), finalSpnt))
+    if (ThrottleCalc::TemperatureDerate(THROTFP(HotParams::tmphs), THROTFP(HotParams::tmphsmax), finalSpnt))
     {
         ErrorMessage::Post(ERR_TMPHSMAX);
     }
 
-    if (Throttle::TemperatureDerate(Param::Get(Param::tmpm), Param::Get(Param::tmpmmax), finalSpnt))
+    if (ThrottleCalc::TemperatureDerate(THROTFP(HotParams::tmpm), THROTFP(HotParams::tmpmmax), finalSpnt))
     {
         ErrorMessage::Post(ERR_TMPMMAX);
     }
 
     // make sure the torque percentage is NEVER out of range
-    if (finalSpnt < -100.0f)
-        finalSpnt = -100.0f;
-    else if (finalSpnt > 100.0f)
-        finalSpnt = 100.0f;
+    if (finalSpnt < THROTVAL(-100))
+        finalSpnt = THROTVAL(-100);
+    else if (finalSpnt > THROTVAL(100))
+        finalSpnt = THROTVAL(100);
 
-    Param::SetFloat(Param::potnom, finalSpnt);
+    THROTSETPARAM(Param::potnom, finalSpnt);
 
-    return finalSpnt;
+    return THROTFLOAT(finalSpnt);
 }
 
 
@@ -26,6 +26,7 @@
 
 
 #include <vag_sbox.h>
+#include "candispatch.h"
 
 int16_t VWBOX::Amperes;
 int32_t VWBOX::Ah;
@@ -44,7 +45,7 @@ int16_t q12;
 
 void VWBOX::RegisterCanMessages(CanHardware* can)
 {
-   can->RegisterUserMessage(0x0BB);//VWBOX MSG
+   CanDispatch::RegisterUserMessage(can, 0x0BB);//VWBOX MSG
 
 
 }
@@ -0,0 +1,443 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Feeds CAN logs into the DecodeCAN() of the drivers on the host. Every
+ * driver gets its own simulated interface, registers its IDs there and then
+ * only sees the frames it registered, like on target. Time follows the log,
+ * so timeouts based on the RTC behave as in the car.
+ *
+ * Reads candump logs ("candump -L", "candump -ta" and the output of the
+ * "trace" terminal command, frames the VCU sent are skipped) and Vector ASC.
+ * The bus a frame came from is ignored, every driver sees every bus.
+ *
+ * With -p the listed parameters are printed as CSV on stdout every interval
+ * of log time. The frame counts and the host time per decode call of each
+ * driver go to stderr at the end. With -x the exit code is 2 if a frame was
+ * not registered by any driver or a selected driver decoded no frame.
+ *
+ * Usage: can_replay [-r rate] [-x] [-d driver,...] [-p param,...] [-i interval_ms] [name=value ...] logfile
+ * e.g.   can_replay -d LeafINV,ISA -p speed,udc,idc drive.log
+ * rate 0 replays as fast as possible (default), 1 at the recorded rate, 10 ten times faster
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+#include <thread>
+#include "simhw.h"
+#include "params.h"
+#include "param_save.h"
+#include "stm32_can.h"
+#include "isa_shunt.h"
+#include "bmw_sbox.h"
+#include "vag_sbox.h"
+#include "leafinv.h"
+#include "Can_OI.h"
+#include "outlanderinverter.h"
+#include "rearoutlanderinverter.h"
+#include "BMW_E31.h"
+#include "BMW_E39.h"
+#include "BMW_E65.h"
+#include "i3LIM.h"
+#include "chademo.h"
+#include "CPC.h"
+#include "bms.h"
+#include "simpbms.h"
+#include "daisychainbms.h"
+#include "F30_Lever.h"
+#include "JLR_G1.h"
+#include "JLR_G2.h"
+#include "outlanderCharger.h"
+#include "NissanPDM.h"
+#include "teslaCharger.h"
+#include "ElconCharger.h"
+#include "TeslaDCDC.h"
+#include "Can_OBD2.h"
+#include "candispatch.h"
+
+#define MAX_PARAMS 16
+
+typedef std::chrono::steady_clock Clock;
+
+struct LogFrame
+{
+   double time; //seconds
+   int bus;
+   uint32_t id;
+   uint8_t dlc;
+   uint32_t data[2];
+};
+
+struct Driver
+{
+   const char* name;
+   void (*attach)(CanHardware* can);
+   void (*decode)(int id, uint32_t data[2]);
+   Stm32Can* can;
+   uint32_t frames;
+   uint64_t ns;
+   uint32_t maxNs;
+   int can3Ids; //IDs the driver put in the CanDispatch CAN3 table
+};
+
+static LeafINV leafInv;
+static Can_OI openInverter;
+static OutlanderInverter outlanderInverter;
+static RearOutlanderInverter rearOutlanderInverter;
+static BMW_E31 e31;
+static BMW_E39 e39;
+static BMW_E65 e65;
+static i3LIMClass i3Lim;
+static FCChademo chademo;
+static CPCClass cpc;
+static SimpBMS simpBms;
+static DaisychainBMS daisychainBms;
+static F30_Lever f30Lever;
+static JLR_G1 jlrG1;
+static JLR_G2 jlrG2;
+static outlanderCharger outlanderChg;
+static NissanPDM nissanPdm;
+static teslaCharger teslaChg;
+static ElconCharger elconChg;
+static TeslaDCDC teslaDcdc;
+static Can_OBD2 obd2;
+
+#define DRIVER(name, obj) { name, [](CanHardware* c) { obj.SetCanInterface(c); }, \
+                            [](int id, uint32_t* d) { obj.DecodeCAN(id, d); }, 0, 0, 0, 0 }
+//A few drivers take the data as bytes
+#define DRIVER_BYTES(name, obj) { name, [](CanHardware* c) { obj.SetCanInterface(c); }, \
+                                  [](int id, uint32_t* d) { obj.DecodeCAN(id, (uint8_t*)d); }, 0, 0, 0, 0 }
+
+static Driver drivers[] =
+{
+   { "ISA", ISA::RegisterCanMessages, ISA::DecodeCAN, 0, 0, 0, 0 },
+   { "SBOX", SBOX::RegisterCanMessages, SBOX::DecodeCAN, 0, 0, 0, 0 },
+   { "VWBOX", VWBOX::RegisterCanMessages, VWBOX::DecodeCAN, 0, 0, 0, 0 },
+   DRIVER("LeafINV", leafInv),
+   DRIVER("Can_OI", openInverter),
+   DRIVER("OutlanderInverter", outlanderInverter),
+   DRIVER("RearOutlanderInverter", rearOutlanderInverter),
+   DRIVER("BMW_E31", e31),
+   DRIVER("BMW_E39", e39),
+   DRIVER("BMW_E65", e65),
+   DRIVER("i3LIM", i3Lim),
+   DRIVER("Chademo", chademo), //on CAN3, its IDs are looked up in CanDispatch
+   DRIVER("CPC", cpc),
+   DRIVER_BYTES("SimpBMS", simpBms),
+   DRIVER_BYTES("DaisychainBMS", daisychainBms),
+   DRIVER("F30_Lever", f30Lever),
+   DRIVER("JLR_G1", jlrG1),
+   DRIVER("JLR_G2", jlrG2),
+   DRIVER("outlanderCharger", outlanderChg),
+   DRIVER("NissanPDM", nissanPdm),
+   DRIVER("teslaCharger", teslaChg),
+   DRIVER("ElconCharger", elconChg),
+   DRIVER_BYTES("TeslaDCDC", teslaDcdc),
+   DRIVER("OBD2", obd2),
+};
+
+static const int NUM_DRIVERS = sizeof(drivers) / sizeof(drivers[0]);
+
+static Param::PARAM_NUM params[MAX_PARAMS];
+static int numParams = 0;
+static bool decimalIds = false; //ASC "base dec"
+
+static int HexDigit(char c)
+{
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+//Reads up to maxBytes hex pairs, separated by blanks or not, returns how many were found
+static int ParseBytes(const char* s, uint32_t data[2], int maxBytes)
+{
+   uint8_t* bytes = (uint8_t*)data;
+   int n = 0;
+
+   data[0] = data[1] = 0;
+
+   while (n < maxBytes && n < 8)
+   {
+      while (*s == ' ') s++;
+      if (HexDigit(s[0]) < 0 || HexDigit(s[1]) < 0) break;
+
+      bytes[n++] = HexDigit(s[0]) * 16 + HexDigit(s[1]);
+      s += 2;
+   }
+   return n;
+}
+
+//Returns false for lines that aren't a received data frame
+static bool ParseLine(const char* line, LogFrame& f)
+{
+   char iface[32], tok[64], dir[8];
+   int pos = 0;
+
+   if (line[0] == '(')
+   {
+      if (sscanf(line, "(%lf) %31s %63s %n", &f.time, iface, tok, &pos) < 3) return false;
+
+      size_t len = strlen(iface);
+      f.bus = len > 0 && iface[len - 1] >= '0' && iface[len - 1] <= '9' ? iface[len - 1] - '0' : 0;
+
+      char* hash = strchr(tok, '#');
+      char* end;
+
+      if (hash != 0) //candump -L: 1DA#0102030405060708
+      {
+         if (hash[1] == 'R' || hash[1] == '#') return false; //remote or CAN FD frame
+         if (line[pos] == 'T') return false; //sent by the VCU, marked by the trace command
+         f.id = strtoul(tok, &end, 16);
+         if (end != hash) return false;
+         f.dlc = ParseBytes(hash + 1, f.data, 8);
+         return true;
+      }
+
+      //candump -ta: 1DA   [8]  01 02 03 04 05 06 07 08
+      int dlc, pos2 = 0;
+      f.id = strtoul(tok, &end, 16);
+      if (*end != 0 || sscanf(line + pos, "[%d] %n", &dlc, &pos2) < 1) return false;
+      if (strncmp(line + pos + pos2, "remote", 6) == 0) return false;
+      f.dlc = ParseBytes(line + pos + pos2, f.data, dlc);
+      return f.dlc == (dlc > 8 ? 8 : dlc);
+   }
+
+   //Vector ASC: 0.001250 1  1DAx       Rx   d 8 01 02 03 04 05 06 07 08
+   if (strncmp(line, "base dec", 8) == 0) decimalIds = true;
+   if (strncmp(line, "base hex", 8) == 0) decimalIds = false;
+
+   int channel, dlc;
+   char type;
+
+   if (sscanf(line, "%lf %d %63s %7s %n", &f.time, &channel, tok, dir, &pos) < 4) return false;
+   if (strcmp(dir, "Rx") != 0 && strcmp(dir, "Tx") != 0) return false;
+
+   int pos2 = 0;
+   char* end;
+
+   if (sscanf(line + pos, "%c %d %n", &type, &dlc, &pos2) < 2 || type != 'd') return false;
+
+   f.bus = channel - 1;
+   f.id = strtoul(tok, &end, decimalIds ? 10 : 16);
+   if (*end != 0 && *end != 'x') return false;
+   f.dlc = ParseBytes(line + pos + pos2, f.data, dlc);
+   return f.dlc == (dlc > 8 ? 8 : dlc);
+}
+
+static bool Selected(const char* list, const char* name)
+{
+   if (list == 0) return true;
+
+   for (const char* p = list; *p;)
+   {
+      const char* comma = strchr(p, ',');
+      size_t len = comma ? (size_t)(comma - p) : strlen(p);
+
+      if (len == strlen(name) && strncasecmp(p, name, len) == 0) return true;
+      p += len + (comma ? 1 : 0);
+   }
+   return false;
+}
+
+static bool AddParams(char* list)
+{
+   for (char* name = strtok(list, ","); name != 0; name = strtok(0, ","))
+   {
+      Param::PARAM_NUM idx = Param::NumFromString(name);
+
+      if (idx == Param::PARAM_INVALID || numParams >= MAX_PARAMS)
+      {
+         fprintf(stderr, "Unknown parameter or too many parameters '%s'\n", name);
+         return false;
+      }
+      params[numParams++] = idx;
+   }
+   return true;
+}
+
+static void PrintParams(uint32_t ms)
+{
+   printf("%u", ms);
+   for (int i = 0; i < numParams; i++)
+      printf(",%g", Param::GetFloat(params[i]));
+   printf("\n");
+}
+
+static void Decode(const LogFrame& f, uint32_t& unclaimed)
+{
+   bool claimed = false;
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      Driver& d = drivers[i];
+
+      if (d.can == 0) continue;
+      if (!d.can->IsUserMessage(f.id) && !(d.can3Ids > 0 && CanDispatch::GetOwners(f.id, CanDispatch::BUS_CAN3))) continue;
+
+      //Decoders may modify the data, each one gets a fresh copy
+      uint32_t data[2] = { f.data[0], f.data[1] };
+      Clock::time_point start = Clock::now();
+      d.decode(f.id, data);
+      uint32_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+      d.frames++;
+      d.ns += ns;
+      if (ns > d.maxNs) d.maxNs = ns;
+      claimed = true;
+   }
+
+   if (!claimed) unclaimed++;
+}
+
+static void Report(uint32_t frames, uint32_t unclaimed, double wall)
+{
+   fprintf(stderr, "Replayed %u frames, %.1f s of log in %.2f s, %u frames not registered by any driver\n",
+           frames, SimHw::GetMs() / 1000.0, wall, unclaimed);
+   fprintf(stderr, "\nDriver                  IDs     frames   mean ns   max ns   total ms\n");
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      const Driver& d = drivers[i];
+
+      if (d.can == 0) continue;
+
+      fprintf(stderr, "%-21s %5d %10u %9.0f %8u %10.2f\n", d.name, d.can->GetNumUserMessages() + d.can3Ids, d.frames,
+              d.frames ? (double)d.ns / d.frames : 0.0, d.maxNs, d.ns / 1e6);
+   }
+}
+
+int main(int argc, char** argv)
+{
+   double rate = 0;
+   uint32_t interval = 100;
+   const char* selection = 0;
+   const char* logName = 0;
+   char* paramList = 0;
+   bool usage = false;
+   bool check = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+         rate = atof(argv[++i]);
+      else if (strcmp(argv[i], "-x") == 0)
+         check = true;
+      else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+         selection = argv[++i];
+      else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+         paramList = argv[++i];
+      else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+         interval = atoi(argv[++i]);
+      else if (strchr(argv[i], '=') != 0)
+         SimHw::AddParamOverride(argv[i]);
+      else if (argv[i][0] != '-' && logName == 0)
+         logName = argv[i];
+      else
+         usage = true;
+   }
+
+   if (usage || logName == 0)
+   {
+      fprintf(stderr, "Usage: %s [-r rate] [-x] [-d driver,...] [-p param,...] [-i interval_ms] [name=value ...] logfile\n", argv[0]);
+      return 1;
+   }
+
+   FILE* log = fopen(logName, "r");
+
+   if (log == 0)
+   {
+      perror(logName);
+      return 1;
+   }
+
+   parm_load();
+   if (paramList != 0 && !AddParams(paramList)) return 1;
+   if (interval == 0) interval = 100;
+
+   CanDispatch::Clear();
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      if (!Selected(selection, drivers[i].name)) continue;
+
+      int can3Ids = CanDispatch::GetNumIds(CanDispatch::BUS_CAN3);
+      drivers[i].can = new Stm32Can(CAN1, CanHardware::Baud500);
+      drivers[i].attach(drivers[i].can);
+      drivers[i].can3Ids = CanDispatch::GetNumIds(CanDispatch::BUS_CAN3) - can3Ids;
+   }
+
+   if (numParams > 0)
+   {
+      printf("ms");
+      for (int i = 0; i < numParams; i++)
+         printf(",%s", Param::GetAttrib(params[i])->name);
+      printf("\n");
+   }
+
+   char line[256];
+   LogFrame f;
+   double firstTime = -1;
+   uint32_t frames = 0, unclaimed = 0, nextSample = 0;
+   Clock::time_point wallStart = Clock::now();
+
+   while (fgets(line, sizeof(line), log) != 0)
+   {
+      if (!ParseLine(line, f)) continue;
+      if (firstTime < 0) firstTime = f.time;
+
+      uint32_t ms = f.time > firstTime ? (uint32_t)((f.time - firstTime) * 1000) : 0;
+
+      if (rate > 0)
+         std::this_thread::sleep_until(wallStart + std::chrono::microseconds((int64_t)((f.time - firstTime) * 1e6 / rate)));
+
+      //One row per interval with the values before the first frame past it
+      if (numParams > 0 && ms >= nextSample)
+      {
+         PrintParams(nextSample);
+         nextSample = ms - ms % interval + interval;
+      }
+
+      SimHw::SetMs(ms);
+      Decode(f, unclaimed);
+      frames++;
+   }
+
+   fclose(log);
+   if (numParams > 0) PrintParams(SimHw::GetMs());
+
+   Report(frames, unclaimed, std::chrono::duration<double>(Clock::now() - wallStart).count());
+
+   if (check)
+   {
+      bool ok = unclaimed == 0;
+
+      for (int i = 0; i < NUM_DRIVERS; i++)
+      {
+         if (drivers[i].can != 0 && drivers[i].frames == 0)
+         {
+            fprintf(stderr, "%s decoded no frame\n", drivers[i].name);
+            ok = false;
+         }
+      }
+      return ok ? 0 : 2;
+   }
+   return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ANAIN_H_INCLUDED
+#define ANAIN_H_INCLUDED
+
+//Host simulation of the libopeninv AnaIn class, the scenario sets the
+//converted values directly
+
+#include <stdint.h>
+#include "anain_prj.h"
+
+class AnaIn
+{
+public:
+   #define ANA_IN_ENTRY(name, port, pin) static AnaIn name;
+   ANA_IN_LIST
+   #undef ANA_IN_ENTRY
+
+   AnaIn() : value(0), port(0), pin(0) {}
+
+   static void Start() {}
+
+   void Configure(uint32_t port, uint8_t pin)
+   {
+      this->port = port;
+      this->pin = pin;
+   }
+
+   uint16_t Get() const { return value; }
+   void SetSimValue(uint16_t v) { value = v; }
+
+private:
+   uint16_t value;
+   uint32_t port;
+   uint8_t pin;
+};
+
+//Configure all inputs of the list, e.g. ANA_IN_CONFIGURE(ANA_IN_LIST);
+#define ANA_IN_ENTRY(name, port, pin) AnaIn::name.Configure(port, pin);
+#define ANA_IN_CONFIGURE(l) l
+
+#endif // ANAIN_H_INCLUDED
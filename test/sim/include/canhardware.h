@@ -0,0 +1,78 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANHARDWARE_H
+#define CANHARDWARE_H
+
+//Host simulation of the libopeninv CanHardware interface. Same user message
+//and callback handling as the original, the bus side is in Stm32Can.
+
+#include <stdint.h>
+
+#ifndef MAX_USER_MESSAGES
+#define MAX_USER_MESSAGES 10
+#endif
+#define MAX_RECV_CALLBACKS 5
+
+class CanCallback
+{
+public:
+   virtual bool HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) = 0;
+   virtual void HandleClear() = 0;
+};
+
+class FunctionPointerCallback : public CanCallback
+{
+public:
+   FunctionPointerCallback(bool (*r)(uint32_t, uint32_t*, uint8_t), void (*c)()) : rx(r), clear(c) {}
+   bool HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) { return rx(canId, data, dlc); }
+   void HandleClear() { clear(); }
+
+private:
+   bool (*rx)(uint32_t, uint32_t*, uint8_t);
+   void (*clear)();
+};
+
+class CanHardware
+{
+public:
+   enum baudrates
+   {
+      Baud125, Baud250, Baud500, Baud800, Baud1000, BaudLast
+   };
+
+   CanHardware();
+   virtual void SetBaudrate(enum baudrates baudrate) = 0;
+   virtual void Send(uint32_t canId, uint32_t data[2], uint8_t len) = 0;
+   void Send(uint32_t canId, uint8_t data[8], uint8_t len) { Send(canId, (uint32_t*)data, len); }
+   void Send(uint32_t canId, uint32_t data[2]) { Send(canId, data, 8); }
+   bool AddCallback(CanCallback* cb);
+   bool RegisterUserMessage(uint32_t canId);
+   void ClearUserMessages();
+   uint32_t GetLastRxTimestamp() { return lastRxTimestamp; }
+
+protected:
+   void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc);
+   virtual void ConfigureFilters() = 0;
+
+   uint32_t lastRxTimestamp;
+   uint32_t userIds[MAX_USER_MESSAGES];
+   int nextUserMessageIndex;
+   CanCallback* recvCallback[MAX_RECV_CALLBACKS];
+   int nextCallbackIndex;
+};
+
+#endif // CANHARDWARE_H
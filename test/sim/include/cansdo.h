@@ -0,0 +1,39 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANSDO_H
+#define CANSDO_H
+
+//Host simulation: SDO requests are not simulated
+
+#include <stdint.h>
+#include "canhardware.h"
+#include "canmap.h"
+
+class CanSdo
+{
+public:
+   CanSdo(CanHardware* hw, CanMap* cm = 0) : canHardware(hw), canMap(cm), nodeId(1) {}
+   void SetNodeId(uint8_t id) { nodeId = id; }
+   int GetPrintRequest() { return -1; }
+
+private:
+   CanHardware* canHardware;
+   CanMap* canMap;
+   uint8_t nodeId;
+};
+
+#endif // CANSDO_H
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DIGIO_H_INCLUDED
+#define DIGIO_H_INCLUDED
+
+//Host simulation of the libopeninv DigIo class: a pin is just a stored level
+//that the firmware writes for outputs and the scenario writes for inputs
+
+#include <stdint.h>
+#include "digio_prj.h"
+
+namespace PinMode {
+   enum PinMode
+   {
+      INPUT_PD,
+      INPUT_PU,
+      INPUT_FLT,
+      INPUT_AIN,
+      OUTPUT,
+      OUTPUT_OD,
+      LAST
+   };
+}
+
+class DigIo
+{
+public:
+   #define DIG_IO_ENTRY(name, port, pin, mode) static DigIo name;
+   DIG_IO_LIST
+   #undef DIG_IO_ENTRY
+
+   DigIo() : state(false), isOutput(false), port(0), pin(0), rises(0) {}
+
+   void Configure(uint32_t port, uint16_t pin, PinMode::PinMode pinMode)
+   {
+      this->port = port;
+      this->pin = pin;
+      isOutput = pinMode == PinMode::OUTPUT || pinMode == PinMode::OUTPUT_OD;
+      state = pinMode == PinMode::INPUT_PU;
+   }
+
+   bool Get() const { return state; }
+   void Set() { rises += !state; state = true; }
+   void Clear() { state = false; }
+   void Toggle() { rises += !state; state = !state; }
+   bool IsOutput() const { return isOutput; }
+   //Low to high transitions, a device model uses it to tell where a chip select transaction ends
+   uint32_t GetRises() const { return rises; }
+
+private:
+   bool state;
+   bool isOutput;
+   uint32_t port;
+   uint16_t pin;
+   uint32_t rises;
+};
+
+//Configure all pins of the list, e.g. DIG_IO_CONFIGURE(DIG_IO_LIST);
+#define DIG_IO_ENTRY(name, port, pin, mode) DigIo::name.Configure(port, pin, mode);
+#define DIG_IO_CONFIGURE(l) l
+
+#endif // DIGIO_H_INCLUDED
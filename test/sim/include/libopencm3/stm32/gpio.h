@@ -0,0 +1,2 @@
+//Host simulation, see sim_opencm3.h
+#include "sim_opencm3.h"
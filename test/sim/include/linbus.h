@@ -0,0 +1,36 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LINBUS_H
+#define LINBUS_H
+
+//Host simulation of the libopeninv LIN master, no slave ever answers
+
+#include <stdint.h>
+
+class LinBus
+{
+public:
+   LinBus(uint32_t usart, int baudrate);
+   void Request(uint8_t id, uint8_t* data, uint8_t len);
+   bool HasReceived(uint8_t pid, uint8_t requiredLength);
+   uint8_t* GetReceivedBytes() { return recvBuffer; }
+
+private:
+   uint8_t recvBuffer[11];
+};
+
+#endif // LINBUS_H
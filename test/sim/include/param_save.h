@@ -0,0 +1,36 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PARAM_SAVE_H_INCLUDED
+#define PARAM_SAVE_H_INCLUDED
+
+//Host simulation: loading applies the defaults and the command line overrides
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+uint32_t parm_save(void);
+int parm_load(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PARAM_SAVE_H_INCLUDED
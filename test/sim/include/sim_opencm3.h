@@ -0,0 +1,150 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIM_OPENCM3_H
+#define SIM_OPENCM3_H
+
+/* Host stand-in for the parts of libopencm3 the VCU sources use outside of
+ * hwinit.cpp. Every libopencm3/... header of the simulation includes this
+ * file. Peripherals are plain numbers, the functions live in simhw.cpp and
+ * either do nothing or talk to the virtual clock.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIM1   1
+#define TIM2   2
+#define TIM3   3
+#define TIM4   4
+#define SPI2   2
+#define SPI3   3
+#define USART1 1
+#define USART2 2
+#define USART3 3
+#define CAN1   1
+#define CAN2   2
+#define DMA1   1
+
+#define GPIOA 0
+#define GPIOB 1
+#define GPIOC 2
+#define GPIOD 3
+#define GPIOE 4
+#define GPIO0  (1 << 0)
+#define GPIO1  (1 << 1)
+#define GPIO2  (1 << 2)
+#define GPIO3  (1 << 3)
+#define GPIO4  (1 << 4)
+#define GPIO5  (1 << 5)
+#define GPIO6  (1 << 6)
+#define GPIO7  (1 << 7)
+#define GPIO8  (1 << 8)
+#define GPIO9  (1 << 9)
+#define GPIO10 (1 << 10)
+#define GPIO11 (1 << 11)
+#define GPIO12 (1 << 12)
+#define GPIO13 (1 << 13)
+#define GPIO14 (1 << 14)
+#define GPIO15 (1 << 15)
+#define GPIO_MODE_INPUT                0
+#define GPIO_MODE_OUTPUT_50_MHZ        3
+#define GPIO_CNF_INPUT_FLOAT           1
+#define GPIO_CNF_OUTPUT_PUSHPULL       0
+#define GPIO_CNF_OUTPUT_ALTFN_PUSHPULL 2
+
+#define AFIO_MAPR_SWJ_CFG_JTAG_OFF_SW_ON 0
+#define AFIO_MAPR_CAN2_REMAP             0
+#define AFIO_MAPR_TIM1_REMAP_FULL_REMAP  0
+
+#define DMA_CHANNEL1 1
+#define DMA_CHANNEL2 2
+#define DMA_CHANNEL3 3
+#define DMA_CHANNEL4 4
+#define DMA_CHANNEL5 5
+#define DMA_CHANNEL6 6
+#define DMA_CHANNEL7 7
+#define DMA_TCIF  (1 << 1)
+#define DMA_HTIF  (1 << 2)
+#define DMA_CCR_PSIZE_8BIT  0
+#define DMA_CCR_MSIZE_8BIT  0
+#define DMA_CCR_PL_LOW      0
+#define DMA_CCR_PL_MEDIUM   1
+#define DMA_CCR_PL_HIGH     2
+
+#define EXTI15  (1 << 15)
+#define RTC_SEC 0
+
+enum tim_oc_id { TIM_OC1, TIM_OC1N, TIM_OC2, TIM_OC2N, TIM_OC3, TIM_OC3N, TIM_OC4 };
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+uint32_t rtc_get_counter_val(void);
+void rtc_clear_flag(int flag);
+
+void spi_enable(uint32_t spi);
+uint16_t spi_xfer(uint32_t spi, uint16_t data);
+
+void timer_set_period(uint32_t timer, uint32_t period);
+void timer_set_oc_value(uint32_t timer, enum tim_oc_id oc, uint32_t value);
+void timer_enable_counter(uint32_t timer);
+void timer_disable_counter(uint32_t timer);
+
+void gpio_set_mode(uint32_t port, uint8_t mode, uint8_t cnf, uint16_t gpios);
+void gpio_primary_remap(uint32_t swjdisable, uint32_t maps);
+
+void crc_reset(void);
+uint32_t crc_calculate_block(uint32_t* data, int size);
+
+void dma_channel_reset(uint32_t dma, uint8_t channel);
+void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number);
+void dma_set_read_from_memory(uint32_t dma, uint8_t channel);
+void dma_set_read_from_peripheral(uint32_t dma, uint8_t channel);
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel);
+void dma_set_peripheral_size(uint32_t dma, uint8_t channel, uint32_t size);
+void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t size);
+void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio);
+void dma_enable_channel(uint32_t dma, uint8_t channel);
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t channel);
+void dma_disable_channel(uint32_t dma, uint8_t channel);
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t channel, uint32_t flags);
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel, uint32_t flags);
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t channel);
+void sim_dma_set_memory(uint8_t channel, const void* address);
+
+void usart_enable_tx_dma(uint32_t usart);
+void usart_enable_rx_dma(uint32_t usart);
+void usart_disable_tx_dma(uint32_t usart);
+void usart_disable_rx_dma(uint32_t usart);
+
+void iwdg_reset(void);
+void exti_reset_request(uint32_t extis);
+
+#ifdef __cplusplus
+}
+#endif
+
+//Addresses are 32 bit on target but not on the host. Peripheral addresses are
+//never dereferenced. Memory addresses are always passed as "(uint32_t)pointer",
+//SIM_DROP_CAST swallows the cast so that simulated devices get the pointer
+#define SIM_DROP_CAST(type)
+#define dma_set_peripheral_address(dma, channel, address) ((void)0)
+#define dma_set_memory_address(dma, channel, address) sim_dma_set_memory(channel, SIM_DROP_CAST address)
+
+#endif // SIM_OPENCM3_H
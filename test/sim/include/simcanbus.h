@@ -0,0 +1,95 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIMCANBUS_H
+#define SIMCANBUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define SIM_NUM_BUSES 2
+
+//Anything attached to a simulated bus: the firmware's Stm32Can or a model of another ECU
+class SimCanNode
+{
+public:
+   virtual void SimCanReceive(uint32_t id, const uint32_t data[2], uint8_t dlc) = 0;
+};
+
+/* In-memory CAN bus connecting the firmware's interfaces with simulated ECUs.
+ * Frames are queued with the current simulation time and go on the wire one
+ * at a time at the configured bit rate. Whenever the bus becomes idle the
+ * queued frame with the lowest arbitration field wins (a standard frame beats
+ * an extended one with the same 11 bit base ID), so a busy bus delays the
+ * low priority traffic like the real one. A frame is delivered to every node
+ * but its sender once its last bit is sent.
+ *
+ * SimHw::Step() runs the buses up to the start of each millisecond, so
+ * frames sent during a task arrive in the next tick at the earliest.
+ */
+class SimCanBus
+{
+public:
+   static const int MAX_PENDING = 64; //a node that floods the bus loses frames beyond this
+
+   struct Stats
+   {
+      uint32_t frames;
+      uint32_t dropped;
+      uint64_t busyUs;       //time the bus was transmitting
+      uint64_t latencySumUs; //queueing plus transmission time of all frames
+      uint32_t latencyMaxUs;
+      uint32_t maxPending;
+   };
+
+   SimCanBus() : bitrate(500000), idleFromUs(0), transmitting(false), stats() {}
+
+   void SetBitrate(uint32_t bps) { bitrate = bps; }
+   uint32_t GetBitrate() { return bitrate; }
+   void Attach(SimCanNode* node) { nodes.push_back(node); }
+   bool Transmit(SimCanNode* sender, uint32_t id, const uint32_t data[2], uint8_t dlc);
+   void Run(uint64_t nowUs);
+   uint32_t FrameUs(uint32_t id, uint8_t dlc);
+   const Stats& GetStats() { return stats; }
+
+   static SimCanBus& Get(int bus) { return buses[bus]; }
+
+private:
+   struct Frame
+   {
+      uint32_t id;
+      uint32_t data[2];
+      uint8_t dlc;
+      SimCanNode* sender;
+      uint64_t queuedUs;
+   };
+
+   int Arbitrate(uint64_t& startUs);
+
+   uint32_t bitrate;
+   uint64_t idleFromUs;
+   bool transmitting;
+   Frame current;
+   uint64_t currentEndUs;
+   std::vector<Frame> pending;
+   std::vector<SimCanNode*> nodes;
+   Stats stats;
+
+   static SimCanBus buses[SIM_NUM_BUSES];
+};
+
+#endif // SIMCANBUS_H
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIMHW_H
+#define SIMHW_H
+
+#include <stdint.h>
+#include <map>
+#include "simcanbus.h"
+
+struct SimCanCounter
+{
+   uint32_t frames;
+   uint32_t bytes;
+   uint32_t bits; //frame length on the wire without stuff bits
+};
+
+/* Virtual hardware of the host simulation. Time only advances when the
+ * firmware's main loop calls Terminal::Run(): every call is one millisecond.
+ * Before the scheduler runs the scenario gets to set inputs and put frames
+ * on the buses, after the configured run time the report function is called
+ * and the process exits.
+ */
+class SimHw
+{
+public:
+   typedef void (*StepFunction)(uint32_t ms);
+   typedef void (*ReportFunction)();
+   //Called when the firmware starts a transfer on a DMA channel that has a device
+   typedef void (*DmaStartFunction)(uint8_t channel, uint8_t* memory, uint16_t count);
+
+   static void Setup(uint32_t durationMs, StepFunction step, ReportFunction report);
+   static void AddParamOverride(const char* assignment);
+   static bool ApplyParamOverrides();
+   static void Step();
+   static uint32_t GetMs() { return ms; }
+   static void SetMs(uint32_t t) { ms = t; } //for can_replay, which follows the log time instead
+
+   static void CountTx(int bus, uint32_t id, const uint32_t data[2], uint8_t len);
+   static void CountRx(int bus, uint32_t id, uint8_t len, bool accepted);
+   static void CountLinRequest() { linRequests++; }
+   static void CountParamRead() { paramReads++; }
+   static const SimCanCounter& GetTx(int bus) { return tx[bus]; }
+   static const SimCanCounter& GetRxOffered(int bus) { return rxOffered[bus]; }
+   static const SimCanCounter& GetRxAccepted(int bus) { return rxAccepted[bus]; }
+   static const std::map<uint32_t, SimCanCounter>& GetTxIds(int bus) { return txIds[bus]; }
+   static uint32_t GetTxDigest() { return txDigest; }
+   static uint32_t GetLinRequests() { return linRequests; }
+   static double GetMeanTickParamReads() { return ms ? (double)tickParamReads / ms : 0; }
+   static uint32_t GetMaxTickParamReads() { return maxTickParamReads; }
+   static uint32_t FrameBits(uint32_t id, uint8_t len);
+
+   /* Without a device a DMA transfer completes as soon as it is started. With
+    * one, the device completes it later through CompleteDma(), passing the
+    * GetDmaStarts() count it saw at the start. A transfer that was reset or
+    * restarted in the mean time is not completed any more.
+    */
+   static void SetDmaDevice(uint8_t channel, DmaStartFunction device);
+   static uint32_t GetDmaStarts(uint8_t channel);
+   static bool CompleteDma(uint8_t channel, uint32_t start);
+
+private:
+   static uint32_t ms;
+   static uint32_t durationMs;
+   static StepFunction step;
+   static ReportFunction report;
+   static SimCanCounter tx[SIM_NUM_BUSES];
+   static SimCanCounter rxOffered[SIM_NUM_BUSES];
+   static SimCanCounter rxAccepted[SIM_NUM_BUSES];
+   static std::map<uint32_t, SimCanCounter> txIds[SIM_NUM_BUSES];
+   static uint32_t txDigest;
+   static uint32_t linRequests;
+   static uint32_t paramReads;
+   static uint64_t tickParamReads;
+   static uint32_t maxTickParamReads;
+};
+
+#endif // SIMHW_H
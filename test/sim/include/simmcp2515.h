@@ -0,0 +1,73 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIMMCP2515_H
+#define SIMMCP2515_H
+
+#include <stdint.h>
+
+/* Register model of the MCP25625 on SPI2 (CAN3) for the host simulation and
+ * the unit tests. Every byte the firmware clocks out with spi_xfer() goes
+ * through Xfer(), which decodes the SPI instructions on a 128 byte register
+ * file. A transaction ends when mcp_cs rises, that is also when READ RX
+ * BUFFER clears the RXnIF flag of the buffer it read, like the chip does.
+ *
+ * Transmit() puts the next frame on the bus: of the buffers with TXREQ set
+ * the one with the highest TXP goes first, the higher buffer number wins a
+ * tie. Receive() fills RXB0, then RXB1 and sets RX1OVR in EFLG when both
+ * still hold a frame. IrqPending() is the (inverted) level of the INT pin.
+ *
+ * Bytes clocked with CS high, unknown instructions and loading a buffer
+ * whose TXREQ is still set are counted as errors.
+ */
+class SimMcp2515
+{
+public:
+   struct Frame
+   {
+      uint32_t id;
+      bool ext;
+      uint8_t dlc;
+      uint8_t data[8];
+      int buffer; //TX buffer the frame was sent from
+   };
+
+   static void Reset();
+   static uint8_t Xfer(uint8_t mosi);
+   static bool Transmit(Frame& frame);
+   static bool Receive(uint32_t id, bool ext, uint8_t dlc, const uint8_t data[8]);
+   static bool IrqPending();
+   static uint8_t GetRegister(uint8_t addr);
+   static void SetRegister(uint8_t addr, uint8_t value) { Sync(); reg[addr & 0x7F] = value; }
+   static uint32_t GetErrors() { return errors; }
+
+private:
+   static void Sync();
+   static void Write(uint8_t addr, uint8_t value, uint8_t mask);
+   static uint8_t Status();
+   static uint8_t RxStatus();
+   static void Instruction(uint8_t inst);
+
+   static uint8_t reg[128];
+   static uint32_t csRises;
+   static uint8_t inst;     //instruction of the running transaction, 0 before its first byte
+   static uint8_t pos;      //bytes clocked since the instruction
+   static uint8_t addr;
+   static uint8_t mask;     //of BIT MODIFY
+   static uint32_t errors;
+};
+
+#endif // SIMMCP2515_H
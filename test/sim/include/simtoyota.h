@@ -0,0 +1,110 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIMTOYOTA_H
+#define SIMTOYOTA_H
+
+#include <stdint.h>
+
+/* The transaxle side of the Toyota hybrid sync serial link (GS450H, Prius
+ * Gen3 and GS300H) for the host simulation. It sits behind the USART2 DMA
+ * channels: every HTM frame the firmware sends is taken as the sync of an
+ * exchange and answered with an MTH frame of the matching layout. The reply
+ * starts with the HTM frame, takes 20us per byte at 500kbaud and completes
+ * the receive DMA when its last byte is in. A receive transfer that was
+ * restarted before that loses the reply.
+ *
+ * The variant is told by the HTM frame length. Start up frames are checked
+ * against the tables in htmframe.h, the GS450H is reported ready after a few
+ * setup frames. Once running, the MG2 torque command spins a simple motor
+ * model whose speeds go back in the MTH frames along with the DC bus voltage
+ * and the temperatures.
+ *
+ * Faults are injected in bursts: every faultPeriodMs the next faultFrames
+ * replies have a bad checksum, come late or not at all. Recovery is timed
+ * from the end of a burst to the first running HTM frame that follows a good
+ * reply, and to InvStat reporting the inverter ok again.
+ */
+class SimToyota
+{
+public:
+   enum Fault { FAULT_NONE, FAULT_CHECKSUM, FAULT_LATE, FAULT_LOST };
+
+   struct Stats
+   {
+      uint32_t htmFrames;
+      uint32_t htmBadChecksum;
+      uint32_t initFrames;    //start up frames that matched the table
+      uint32_t earlyFrames;   //running frames before the start up was done
+      uint32_t mthFrames;     //replies delivered into the receive buffer
+      uint32_t mthLost;       //replies whose transfer was restarted before they completed
+      uint32_t faults;
+      uint32_t bursts;
+      uint32_t minRate, maxRate; //running exchanges per second, over whole seconds
+      uint32_t recoveries;
+      uint32_t recoverySumMs, recoveryMaxMs;
+      uint32_t statusRecoveries;
+      uint32_t statusRecoverySumMs, statusRecoveryMaxMs;
+   };
+
+   static void Attach();
+   static void SetFaults(Fault fault, uint32_t periodMs, uint16_t frames, uint32_t lateUs);
+   static void SetDcVoltage(int volts) { dcVoltage = volts; }
+   static void Run(uint32_t ms);
+   static bool IsAttached() { return attached; }
+   static const Stats& GetStats() { return stats; }
+   static const char* GetVariantName();
+
+private:
+   enum Variant { NONE, GS450H, PRIUS, GS300H };
+
+   static void DmaStarted(uint8_t channel, uint8_t* memory, uint16_t count);
+   static void HtmReceived(const uint8_t* frame, uint16_t len);
+   static void BuildMth(uint8_t* frame, uint16_t len);
+   static void MotorModel();
+   static void CountExchange(uint32_t nowUs);
+
+   static bool attached;
+   static Variant variant;
+   static int dcVoltage;
+   static uint8_t htm[105];
+   static uint8_t* rxMemory;
+   static uint16_t rxCount;
+   static uint32_t rxStart;
+   static uint32_t replyStart; //receive transfer the reply on the wire goes into
+   static uint32_t txStart;
+   static uint64_t txDoneUs;  //0 while no HTM frame is on the wire
+   static uint64_t rxDoneUs;  //0 while no MTH reply is on the wire
+   static uint8_t mth[140];
+   static uint16_t mthLen;
+   static uint16_t setupFrames;
+   static bool running;
+   static int16_t mg2Torque;
+   static int32_t mg1Speed, mg2Speed;
+   static int32_t waterTemp, inductorTemp; //°C * 256
+   static Fault fault;
+   static uint32_t faultPeriodMs, lateUs;
+   static uint16_t faultFrames, faultsLeft;
+   static uint32_t nextFaultMs;
+   static bool replyFaulty;  //of the reply on the wire or last delivered
+   static bool lastReplyOk;
+   static uint64_t burstEndUs;
+   static bool awaitLink, awaitStatus, statusDown;
+   static uint32_t secondFrames;
+   static Stats stats;
+};
+
+#endif // SIMTOYOTA_H
@@ -0,0 +1,50 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STM32_CAN_H
+#define STM32_CAN_H
+
+//Host simulation of the libopeninv bxCAN driver. Each interface is a node on
+//the SimCanBus of its index, transmitted frames are also counted by SimHw.
+//Received frames pass the same user message filter as on target.
+
+#include <stdint.h>
+#include "canhardware.h"
+#include "simcanbus.h"
+
+class Stm32Can : public CanHardware, public SimCanNode
+{
+public:
+   Stm32Can(uint32_t baseAddr, enum baudrates baudrate, bool remap = false);
+   void SetBaudrate(enum baudrates baudrate);
+   void Send(uint32_t canId, uint32_t data[2], uint8_t len);
+   using CanHardware::Send;
+   static Stm32Can* GetInterface(int index);
+
+   bool SimReceive(uint32_t canId, uint32_t data[2], uint8_t dlc);
+   bool IsUserMessage(uint32_t canId);
+   int GetNumUserMessages() { return nextUserMessageIndex; }
+   uint32_t GetUserMessage(int idx) { return userIds[idx]; }
+   void SimCanReceive(uint32_t canId, const uint32_t data[2], uint8_t dlc);
+
+private:
+   void ConfigureFilters();
+
+   int bus;
+   static Stm32Can* interfaces[2];
+};
+
+#endif // STM32_CAN_H
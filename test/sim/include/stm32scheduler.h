@@ -0,0 +1,42 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STM32SCHEDULER_H
+#define STM32SCHEDULER_H
+
+//Host simulation of the libopeninv scheduler. Run() is called from tim4_isr()
+//once per millisecond of virtual time.
+
+#include <stdint.h>
+
+class Stm32Scheduler
+{
+public:
+   const static int MAX_TASKS = 4;
+
+   Stm32Scheduler(uint32_t timer);
+   void AddTask(void (*function)(void), uint16_t period);
+   void Run();
+   int GetCpuLoad() { return 0; }
+
+private:
+   void (*functions[MAX_TASKS])(void);
+   uint16_t periods[MAX_TASKS];
+   int nextTask;
+   uint32_t ticks;
+};
+
+#endif // STM32SCHEDULER_H
@@ -0,0 +1,43 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+//Host simulation of the libopeninv terminal. main() calls Run() in its
+//endless loop, the simulation uses that call to advance the virtual clock.
+
+#include <stdint.h>
+
+class Terminal;
+
+typedef struct
+{
+   char const* cmd;
+   void (*CmdFunc)(Terminal*, char*);
+} TERM_CMD;
+
+class Terminal
+{
+public:
+   Terminal(uint32_t usart, const TERM_CMD* commands, bool remap = false);
+   void Run();
+
+private:
+   const TERM_CMD* termCmds;
+};
+
+#endif // TERMINAL_H
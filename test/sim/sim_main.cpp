@@ -0,0 +1,443 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Runs the complete VCU firmware on the host against the simulated hardware
+ * in simhw.cpp. The scenario below repeats an hour long cycle of driving,
+ * parking and charging, an ISA shunt model closes the precharge loop and
+ * every other CAN ID the selected drivers listen to is fed with pseudo random
+ * frames. Both are sent by a node standing in for the rest of the car on the
+ * simulated buses, so they compete with the firmware's own frames for the
+ * bus. The Toyota inverters are answered on USART2 by the emulator in
+ * simtoyota.cpp. At the end the task times and the CAN traffic are printed.
+ *
+ * Usage: vcu_sim [-t minutes] [-r rxperiod_ms] [-f fault:period_s:frames[:late_ms]] [name=value ...]
+ * e.g.   vcu_sim -t 240 Inverter=1 Vehicle=0 BMS_Mode=1
+ *        vcu_sim -t 10 -f checksum:5:3 Inverter=7
+ *
+ * -f corrupts the checksum of, delays (late) or drops (lost) the given number
+ * of Toyota MTH replies every period.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "simhw.h"
+#include "simtoyota.h"
+#include "params.h"
+#include "digio.h"
+#include "anain.h"
+#include "iomatrix.h"
+#include "stm32_can.h"
+#include "taskprofiler.h"
+
+extern "C" int vcu_main(void);
+
+#define CYCLE_MS         3600000 //one hour
+#define DRIVE_END_MS     2400000 //40 minutes of driving
+#define CHARGE_START_MS  2700000 //5 minutes parked, then charging
+#define PACK_MV          400000
+#define PEDAL_RELEASED   20      //a released pedal reads slightly below potmin
+#define TOP_IDS          8
+
+//Pedal and voltage window of a typical installation, applied before the command line overrides
+static const char* const defaults[] = { "potmin=500", "potmax=3500", "pot2min=500", "pot2max=3500", "udcmin=300" };
+
+static uint32_t rxPeriod = 10;
+static uint32_t rng = 12345;
+static uint32_t opmodeMs[MOD_LAST];
+static std::chrono::steady_clock::time_point wallStart;
+
+//Shunt state, same units as the ISA sensor sends them
+static int32_t shuntMv = 0;
+static int32_t shuntMa = 0;
+static int64_t shuntMas = 0; //milliampere-seconds
+static int64_t shuntMws = 0; //milliwatt-seconds
+
+//The other ECUs of the car. They don't react to the firmware's frames yet
+class CarNode : public SimCanNode
+{
+public:
+   void SimCanReceive(uint32_t, const uint32_t*, uint8_t) {}
+};
+
+static CarNode car[SIM_NUM_BUSES];
+
+static uint32_t Random()
+{
+   rng = rng * 1664525 + 1013904223;
+   return rng;
+}
+
+static void PutInt32(uint32_t data[2], int32_t value)
+{
+   uint8_t* bytes = (uint8_t*)data;
+   bytes[2] = value;
+   bytes[3] = value >> 8;
+   bytes[4] = value >> 16;
+   bytes[5] = value >> 24;
+}
+
+static void SendShuntFrame(int bus, uint32_t id, int32_t value)
+{
+   uint32_t data[2] = { 0, 0 };
+   PutInt32(data, value);
+   SimCanBus::Get(bus).Transmit(&car[bus], id, data, 8);
+}
+
+//Pack voltage follows the contactors with a first order lag, current follows the torque request
+static void ShuntModel(uint32_t ms)
+{
+   int bus = Param::GetInt(Param::ShuntCan);
+   int opmode = Param::GetInt(Param::opmode);
+   int32_t target = DigIo::dcsw_out.Get() || DigIo::prec_out.Get() ? PACK_MV : 0;
+   int32_t tau = DigIo::dcsw_out.Get() ? 20 : DigIo::prec_out.Get() ? 300 : 2000;
+
+   shuntMv += (target - shuntMv) / tau;
+
+   if (opmode == MOD_RUN)
+      shuntMa = (int32_t)(Param::GetFloat(Param::potnom) * 2000);
+   else if (opmode == MOD_CHARGE)
+      shuntMa = -16000;
+   else
+      shuntMa = 0;
+
+   shuntMas += shuntMa;
+   shuntMws += (int64_t)shuntMa * shuntMv / 1000;
+
+   if (Param::GetInt(Param::Type) != 0 || bus < 0 || bus >= SIM_NUM_BUSES) return;
+
+   if ((ms % 10) == 0)
+   {
+      SendShuntFrame(bus, 0x521, shuntMa);
+      SendShuntFrame(bus, 0x522, shuntMv);
+      SendShuntFrame(bus, 0x523, shuntMv);
+      SendShuntFrame(bus, 0x524, shuntMv);
+   }
+
+   if ((ms % 100) == 0)
+   {
+      SendShuntFrame(bus, 0x525, 250); //25.0°C
+      SendShuntFrame(bus, 0x526, (int32_t)((int64_t)shuntMa * shuntMv / 1000000));
+      SendShuntFrame(bus, 0x527, (int32_t)(shuntMas / 3600000));
+      SendShuntFrame(bus, 0x528, (int32_t)(shuntMws / 3600000000LL));
+   }
+}
+
+//Every ID the drivers registered on a bus gets a frame each rxPeriod, except the ones modelled above
+static void BusTraffic(uint32_t ms)
+{
+   if ((ms % rxPeriod) != 0) return;
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+   {
+      Stm32Can* can = Stm32Can::GetInterface(bus);
+      int shunt = Param::GetInt(Param::Type) == 0 && Param::GetInt(Param::ShuntCan) == bus;
+
+      if (can == 0) continue;
+
+      for (int i = 0; i < can->GetNumUserMessages(); i++)
+      {
+         uint32_t id = can->GetUserMessage(i);
+
+         if (id == 0x601) continue; //SDO requests only come from the user
+         if (id == 0x7DF) continue; //OBD2 answers can contain the host dependent task times
+         if (shunt && id >= 0x521 && id <= 0x528) continue;
+
+         uint32_t data[2] = { Random(), Random() };
+         SimCanBus::Get(bus).Transmit(&car[bus], id, data, 8);
+      }
+   }
+}
+
+//Throttle in percent over a one minute pattern: pull away, cruise, coast, brake, stand still
+static int DriveThrottle(uint32_t t)
+{
+   uint32_t s = (t / 1000) % 60;
+
+   if (s < 15) return 10 + s * 4;
+   if (s < 35) return 30;
+   return 0;
+}
+
+static void Scenario(uint32_t ms)
+{
+   uint32_t t = ms % CYCLE_MS;
+   bool drive = t >= 1000 && t < DRIVE_END_MS;
+   bool charge = t >= CHARGE_START_MS;
+   int throttle = 0;
+   DigIo* hvReq = IOMatrix::GetPin(IOMatrix::HVREQ);
+
+   if (drive)
+   {
+      DigIo::t15_digi.Set();
+      DigIo::fwd_in.Set();
+
+      if (t >= 2000 && t < 2500)
+         DigIo::start_in.Set();
+      else
+         DigIo::start_in.Clear();
+
+      if (t > 10000)
+      {
+         uint32_t s = (t / 1000) % 60;
+         throttle = DriveThrottle(t);
+
+         if (s >= 45 && s < 55)
+            DigIo::brake_in.Set();
+         else
+            DigIo::brake_in.Clear();
+      }
+   }
+   else
+   {
+      DigIo::t15_digi.Clear();
+      DigIo::fwd_in.Clear();
+      DigIo::start_in.Clear();
+      DigIo::brake_in.Clear();
+   }
+
+   if (charge)
+   {
+      DigIo::HV_req.Set();
+      if (hvReq != &DigIo::dummypin) hvReq->Set();
+   }
+   else
+   {
+      DigIo::HV_req.Clear();
+      if (hvReq != &DigIo::dummypin) hvReq->Clear();
+   }
+
+   int pot = Param::GetInt(Param::potmin) - PEDAL_RELEASED;
+   int pot2 = Param::GetInt(Param::pot2min) - PEDAL_RELEASED;
+
+   if (throttle > 0)
+   {
+      pot = Param::GetInt(Param::potmin) + (Param::GetInt(Param::potmax) - Param::GetInt(Param::potmin)) * throttle / 100;
+      pot2 = Param::GetInt(Param::pot2min) + (Param::GetInt(Param::pot2max) - Param::GetInt(Param::pot2min)) * throttle / 100;
+   }
+   AnaIn::throttle1.SetSimValue(pot);
+   AnaIn::throttle2.SetSimValue(pot2);
+   AnaIn::uaux.SetSimValue(13 * 210); //13V
+
+   ShuntModel(ms);
+   BusTraffic(ms);
+   SimToyota::SetDcVoltage(shuntMv / 1000);
+   SimToyota::Run(ms);
+
+   int opmode = Param::GetInt(Param::opmode);
+   if (opmode >= 0 && opmode < MOD_LAST) opmodeMs[opmode]++;
+}
+
+static void PrintCanReport()
+{
+   double seconds = SimHw::GetMs() / 1000.0;
+
+   printf("\nBus   TX frames   TX fr/s  RX offered  RX accepted  RX fr/s  Load %%\n");
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+   {
+      const SimCanCounter& tx = SimHw::GetTx(bus);
+      const SimCanCounter& rxo = SimHw::GetRxOffered(bus);
+      const SimCanCounter& rxa = SimHw::GetRxAccepted(bus);
+      double load = SimCanBus::Get(bus).GetStats().busyUs / 1e4 / seconds;
+
+      printf("CAN%d  %9u  %8.1f  %10u  %11u  %7.1f  %6.2f\n", bus + 1, tx.frames, tx.frames / seconds,
+             rxo.frames, rxa.frames, rxa.frames / seconds, load);
+   }
+
+   //Latency is from queueing a frame to its last bit, so it includes the time lost in arbitration
+   printf("\nBus   kbit/s   frames  lat mean us  lat max us  max queued  dropped\n");
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+   {
+      SimCanBus& b = SimCanBus::Get(bus);
+      const SimCanBus::Stats& st = b.GetStats();
+
+      printf("CAN%d  %6u %8u  %11.1f  %10u  %10u  %7u\n", bus + 1, b.GetBitrate() / 1000, st.frames,
+             st.frames ? (double)st.latencySumUs / st.frames : 0.0, st.latencyMaxUs, st.maxPending, st.dropped);
+   }
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+   {
+      const std::map<uint32_t, SimCanCounter>& ids = SimHw::GetTxIds(bus);
+      uint32_t shown = 0, printed[TOP_IDS];
+
+      printf("\nCAN%d busiest TX IDs:", bus + 1);
+      if (ids.empty()) printf(" none");
+      printf("\n");
+
+      //Small tables, a repeated linear search for the largest is good enough
+      while (shown < TOP_IDS && shown < ids.size())
+      {
+         uint32_t bestId = 0, bestFrames = 0;
+
+         for (std::map<uint32_t, SimCanCounter>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+         {
+            bool done = false;
+            for (uint32_t i = 0; i < shown; i++) done |= printed[i] == it->first;
+
+            if (!done && it->second.frames >= bestFrames)
+            {
+               bestId = it->first;
+               bestFrames = it->second.frames;
+            }
+         }
+         printed[shown++] = bestId;
+         printf("  0x%03X  %8.1f fr/s\n", bestId, bestFrames / seconds);
+      }
+   }
+}
+
+static void PrintTaskReport()
+{
+   uint64_t totalNs = 0;
+
+   printf("\nSection           count   mean us   max us   total ms  overruns\n");
+
+   for (int i = 0; i < TaskProfiler::LAST; i++)
+   {
+      TaskProfiler::sections s = (TaskProfiler::sections)i;
+      const TaskProfiler::Stats& st = TaskProfiler::GetStats(s);
+
+      if (st.count == 0) continue;
+
+      //Scaled by 1000 first so that sub-microsecond means survive the conversion
+      double meanUs = TaskProfiler::ToMicroseconds((uint32_t)(st.sum * 1000 / st.count)) / 1000.0;
+
+      printf("%-13s %9u %9.2f %8u %10u %9u\n", TaskProfiler::GetName(s), st.count,
+             meanUs, TaskProfiler::ToMicroseconds(st.max),
+             (uint32_t)(st.sum / 1000000), st.overruns);
+
+      if (s <= TaskProfiler::MS200) totalNs += st.sum;
+   }
+
+   printf("Host CPU time in tasks: %.1f ms per simulated second\n", totalNs / 1e6 / (SimHw::GetMs() / 1000.0));
+   printf("Param reads per 1ms tick: mean %.1f, max %u\n", SimHw::GetMeanTickParamReads(), SimHw::GetMaxTickParamReads());
+}
+
+static void PrintToyotaReport()
+{
+   const SimToyota::Stats& st = SimToyota::GetStats();
+   double seconds = SimHw::GetMs() / 1000.0;
+
+   if (st.htmFrames == 0) return;
+
+   printf("\nToyota link (%s): %u HTM frames, %u bad checksum, %u start up, %u before start up was done\n",
+          SimToyota::GetVariantName(), st.htmFrames, st.htmBadChecksum, st.initFrames, st.earlyFrames);
+   printf("MTH replies: %u delivered, %u lost\n", st.mthFrames, st.mthLost);
+   printf("Exchanges per second: mean %.1f, min %u, max %u, firmware htmrate %d, mthcserr %d%%\n",
+          (st.htmFrames - st.htmBadChecksum) / seconds, st.minRate == 0xFFFFFFFF ? 0 : st.minRate, st.maxRate,
+          Param::GetInt(Param::htmrate), Param::GetInt(Param::mthcserr));
+
+   if (st.bursts == 0) return;
+
+   printf("Faults: %u replies in %u bursts\n", st.faults, st.bursts);
+   printf("Recovery to running exchanges: %u times, mean %.1f ms, max %u ms\n", st.recoveries,
+          st.recoveries ? (double)st.recoverySumMs / st.recoveries : 0.0, st.recoveryMaxMs);
+   printf("Recovery of InvStat (updated every 100 ms): %u times, mean %.1f ms, max %u ms\n", st.statusRecoveries,
+          st.statusRecoveries ? (double)st.statusRecoverySumMs / st.statusRecoveries : 0.0, st.statusRecoveryMaxMs);
+}
+
+static void Report()
+{
+   double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+   double simulated = SimHw::GetMs() / 1000.0;
+   static const char* opmodes[MOD_LAST] = { "Off", "Run", "Precharge", "PchFail", "Charge" };
+
+   printf("Simulated %.0f s in %.2f s (%.0fx real time)\n", simulated, wall, simulated / wall);
+   printf("Inverter=%d Vehicle=%d chargemodes=%d interface=%d BMS_Mode=%d DCdc_Type=%d GearLvr=%d Heater=%d Type=%d\n",
+          Param::GetInt(Param::Inverter), Param::GetInt(Param::Vehicle), Param::GetInt(Param::chargemodes),
+          Param::GetInt(Param::interface), Param::GetInt(Param::BMS_Mode), Param::GetInt(Param::DCdc_Type),
+          Param::GetInt(Param::GearLvr), Param::GetInt(Param::Heater), Param::GetInt(Param::Type));
+
+   printf("Opmode time:");
+   for (int i = 0; i < MOD_LAST; i++)
+      printf(" %s %.0f s", opmodes[i], opmodeMs[i] / 1000.0);
+   printf("\n");
+
+   PrintTaskReport();
+   PrintCanReport();
+   PrintToyotaReport();
+
+   printf("\nLIN requests: %u\n", SimHw::GetLinRequests());
+   printf("TX digest: %08X\n", SimHw::GetTxDigest());
+}
+
+static int Usage(const char* name)
+{
+   fprintf(stderr, "Usage: %s [-t minutes] [-r rxperiod_ms] [-f fault:period_s:frames[:late_ms]] [name=value ...]\n", name);
+   fprintf(stderr, "       fault is checksum, late or lost\n");
+   return 1;
+}
+
+//e.g. "late:10:2:3" delays two replies every 10 seconds by 3ms
+static bool ParseFault(char* arg)
+{
+   static const char* const names[] = { "none", "checksum", "late", "lost" };
+   char* period = strchr(arg, ':');
+   char* frames = period ? strchr(period + 1, ':') : 0;
+   char* late = frames ? strchr(frames + 1, ':') : 0;
+
+   if (frames == 0) return false;
+   *period = 0;
+
+   for (int i = SimToyota::FAULT_CHECKSUM; i <= SimToyota::FAULT_LOST; i++)
+   {
+      if (strcmp(arg, names[i]) == 0)
+      {
+         SimToyota::SetFaults((SimToyota::Fault)i, atoi(period + 1) * 1000, atoi(frames + 1), late ? atoi(late + 1) * 1000 : 2000);
+         return true;
+      }
+   }
+   return false;
+}
+
+int main(int argc, char** argv)
+{
+   uint32_t minutes = 60;
+
+   for (unsigned i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+      SimHw::AddParamOverride(defaults[i]);
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+         minutes = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+         rxPeriod = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+      {
+         if (!ParseFault(argv[++i])) return Usage(argv[0]);
+      }
+      else if (strchr(argv[i], '=') != 0)
+         SimHw::AddParamOverride(argv[i]);
+      else
+         return Usage(argv[0]);
+   }
+
+   if (rxPeriod == 0) rxPeriod = 10;
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+      SimCanBus::Get(bus).Attach(&car[bus]);
+   SimToyota::Attach();
+
+   SimHw::Setup(minutes * 60000, Scenario, Report);
+   wallStart = std::chrono::steady_clock::now();
+
+   return vcu_main(); //never returns, SimHw::Step() exits after the report
+}
@@ -0,0 +1,113 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "simcanbus.h"
+#include "simhw.h"
+
+SimCanBus SimCanBus::buses[SIM_NUM_BUSES];
+
+//Queues a frame at the current simulation time, false when the queue is full
+bool SimCanBus::Transmit(SimCanNode* sender, uint32_t id, const uint32_t data[2], uint8_t dlc)
+{
+   if (pending.size() >= (size_t)MAX_PENDING)
+   {
+      stats.dropped++;
+      return false;
+   }
+
+   Frame f = { id, { data[0], data[1] }, dlc > 8 ? (uint8_t)8 : dlc, sender, (uint64_t)SimHw::GetMs() * 1000 };
+   pending.push_back(f);
+
+   if (pending.size() > stats.maxPending) stats.maxPending = pending.size();
+   return true;
+}
+
+uint32_t SimCanBus::FrameUs(uint32_t id, uint8_t dlc)
+{
+   return (SimHw::FrameBits(id, dlc) * 1000000 + bitrate - 1) / bitrate;
+}
+
+/* Arbitration field of a frame, the lower one wins. IDs above 0x7FF are sent
+ * as extended frames, like Stm32Can does. Their base ID is followed by SRR and
+ * IDE, both recessive, and the ID extension. A standard frame has RTR and IDE
+ * dominant there, so it beats an extended frame with the same base ID.
+ */
+static uint32_t ArbitrationField(uint32_t id)
+{
+   if (id > 0x7FF)
+      return (((id >> 18) & 0x7FF) << 20) | (3 << 18) | (id & 0x3FFFF);
+   return id << 20;
+}
+
+//Returns the index of the frame that wins the next arbitration and when it starts, -1 if none is queued
+int SimCanBus::Arbitrate(uint64_t& startUs)
+{
+   int winner = -1;
+
+   if (pending.empty()) return -1;
+
+   //An idle bus waits for the first frame to be queued
+   startUs = pending[0].queuedUs;
+   for (size_t i = 1; i < pending.size(); i++)
+      if (pending[i].queuedUs < startUs) startUs = pending[i].queuedUs;
+   if (startUs < idleFromUs) startUs = idleFromUs;
+
+   //Lowest arbitration field of everything queued by then, equal IDs go in queue order
+   for (size_t i = 0; i < pending.size(); i++)
+   {
+      if (pending[i].queuedUs <= startUs &&
+          (winner < 0 || ArbitrationField(pending[i].id) < ArbitrationField(pending[winner].id)))
+         winner = i;
+   }
+   return winner;
+}
+
+//Transmits everything that finishes before nowUs, a frame that started earlier but finishes later stays on the wire
+void SimCanBus::Run(uint64_t nowUs)
+{
+   for (;;)
+   {
+      if (!transmitting)
+      {
+         uint64_t startUs;
+         int winner = Arbitrate(startUs);
+
+         if (winner < 0 || startUs >= nowUs) return;
+
+         current = pending[winner];
+         pending.erase(pending.begin() + winner);
+         currentEndUs = startUs + FrameUs(current.id, current.dlc);
+         stats.busyUs += currentEndUs - startUs;
+         transmitting = true;
+      }
+
+      if (currentEndUs > nowUs) return;
+
+      uint32_t latency = currentEndUs - current.queuedUs;
+
+      stats.frames++;
+      stats.latencySumUs += latency;
+      if (latency > stats.latencyMaxUs) stats.latencyMaxUs = latency;
+      idleFromUs = currentEndUs;
+      transmitting = false;
+
+      for (size_t i = 0; i < nodes.size(); i++)
+      {
+         if (nodes[i] != current.sender)
+            nodes[i]->SimCanReceive(current.id, current.data, current.dlc);
+      }
+   }
+}
@@ -0,0 +1,480 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "simhw.h"
+#include "simmcp2515.h"
+#include "sim_opencm3.h"
+#include "hwinit.h"
+#include "digio.h"
+#include "anain.h"
+#include "stm32_can.h"
+#include "stm32scheduler.h"
+#include "terminal.h"
+#include "terminalcommands.h"
+#include "param_save.h"
+#include "linbus.h"
+#include "params.h"
+
+#define MAX_OVERRIDES 32
+#define CAN3_FRAMES_PER_MS 4 //about what fits into a millisecond at 500kbps
+
+extern "C" void tim4_isr(void);
+extern "C" void rtc_isr(void);
+extern "C" void dma1_channel6_isr(void);
+extern "C" void dma1_channel7_isr(void);
+extern "C" void exti15_10_isr(void);
+
+uint32_t SimHw::ms = 0;
+uint32_t SimHw::durationMs = 0;
+SimHw::StepFunction SimHw::step = 0;
+SimHw::ReportFunction SimHw::report = 0;
+SimCanCounter SimHw::tx[SIM_NUM_BUSES];
+SimCanCounter SimHw::rxOffered[SIM_NUM_BUSES];
+SimCanCounter SimHw::rxAccepted[SIM_NUM_BUSES];
+std::map<uint32_t, SimCanCounter> SimHw::txIds[SIM_NUM_BUSES];
+uint32_t SimHw::txDigest = 2166136261u; //FNV-1a offset basis
+uint32_t SimHw::linRequests = 0;
+uint32_t SimHw::paramReads = 0;
+uint64_t SimHw::tickParamReads = 0;
+uint32_t SimHw::maxTickParamReads = 0;
+
+static const char* overrides[MAX_OVERRIDES];
+static int numOverrides = 0;
+static bool mcpIrq = false;
+
+void SimHw::Setup(uint32_t duration, StepFunction s, ReportFunction r)
+{
+   durationMs = duration;
+   step = s;
+   report = r;
+   SimMcp2515::Reset();
+}
+
+void SimHw::AddParamOverride(const char* assignment)
+{
+   if (numOverrides < MAX_OVERRIDES)
+      overrides[numOverrides++] = assignment;
+}
+
+//Applies the name=value pairs given on the command line, called instead of loading from flash
+bool SimHw::ApplyParamOverrides()
+{
+   bool ok = true;
+
+   for (int i = 0; i < numOverrides; i++)
+   {
+      char name[32];
+      const char* eq = strchr(overrides[i], '=');
+      size_t len = eq ? (size_t)(eq - overrides[i]) : 0;
+
+      if (len == 0 || len >= sizeof(name))
+      {
+         fprintf(stderr, "Invalid parameter override '%s'\n", overrides[i]);
+         ok = false;
+         continue;
+      }
+
+      memcpy(name, overrides[i], len);
+      name[len] = 0;
+      Param::PARAM_NUM idx = Param::NumFromString(name);
+
+      if (idx == Param::PARAM_INVALID || Param::Set(idx, FP_FROMFLT(atof(eq + 1))) != 0)
+      {
+         fprintf(stderr, "Unknown parameter or value out of range '%s'\n", overrides[i]);
+         ok = false;
+      }
+   }
+   return ok;
+}
+
+//One millisecond of virtual time: CAN buses, seconds interrupt, scenario, then the scheduler tick
+void SimHw::Step()
+{
+   SimMcp2515::Frame frame;
+
+   ms++;
+
+   for (int bus = 0; bus < SIM_NUM_BUSES; bus++)
+      SimCanBus::Get(bus).Run((uint64_t)ms * 1000);
+
+   //Nobody listens on CAN3, the MCP25625 sends what is loaded and interrupts on the falling edge of INT
+   for (int i = 0; i < CAN3_FRAMES_PER_MS && SimMcp2515::Transmit(frame); i++) {}
+   if (SimMcp2515::IrqPending() && !mcpIrq) exti15_10_isr();
+   mcpIrq = SimMcp2515::IrqPending();
+
+   if ((ms % 1000) == 0) rtc_isr();
+
+   step(ms);
+
+   uint32_t readsBefore = paramReads;
+   tim4_isr();
+   uint32_t reads = paramReads - readsBefore;
+   tickParamReads += reads;
+   if (reads > maxTickParamReads) maxTickParamReads = reads;
+
+   if (ms >= durationMs)
+   {
+      report();
+      exit(0);
+   }
+}
+
+//Param reads of the firmware are counted by wrapping the libopeninv getters
+//at link time, see LDFLAGS in the Makefile
+#define COUNT_PARAM_READS(type, symbol) \
+   extern "C" type __real_##symbol(Param::PARAM_NUM); \
+   extern "C" type __wrap_##symbol(Param::PARAM_NUM p) { SimHw::CountParamRead(); return __real_##symbol(p); }
+
+COUNT_PARAM_READS(s32fp, _ZN5Param3GetENS_9PARAM_NUME)
+COUNT_PARAM_READS(int, _ZN5Param6GetIntENS_9PARAM_NUME)
+COUNT_PARAM_READS(float, _ZN5Param8GetFloatENS_9PARAM_NUME)
+COUNT_PARAM_READS(bool, _ZN5Param7GetBoolENS_9PARAM_NUME)
+
+uint32_t SimHw::FrameBits(uint32_t id, uint8_t len)
+{
+   //SOF, arbitration, control, CRC, ACK, EOF and interframe space
+   return (id > 0x7FF ? 67 : 47) + 8 * len;
+}
+
+void SimHw::CountTx(int bus, uint32_t id, const uint32_t data[2], uint8_t len)
+{
+   const uint8_t* bytes = (const uint8_t*)data;
+   uint32_t bits = FrameBits(id, len);
+   SimCanCounter& c = txIds[bus][id];
+
+   tx[bus].frames++;
+   tx[bus].bytes += len;
+   tx[bus].bits += bits;
+   c.frames++;
+   c.bytes += len;
+   c.bits += bits;
+
+   //The digest only depends on what was sent when, so it's identical across runs
+   uint32_t words[4] = { ms, (uint32_t)bus, id, len };
+   const uint8_t* w = (const uint8_t*)words;
+
+   for (unsigned i = 0; i < sizeof(words); i++)
+      txDigest = (txDigest ^ w[i]) * 16777619u;
+   for (int i = 0; i < len && i < 8; i++)
+      txDigest = (txDigest ^ bytes[i]) * 16777619u;
+}
+
+void SimHw::CountRx(int bus, uint32_t id, uint8_t len, bool accepted)
+{
+   uint32_t bits = FrameBits(id, len);
+
+   rxOffered[bus].frames++;
+   rxOffered[bus].bytes += len;
+   rxOffered[bus].bits += bits;
+
+   if (accepted)
+   {
+      rxAccepted[bus].frames++;
+      rxAccepted[bus].bytes += len;
+      rxAccepted[bus].bits += bits;
+   }
+}
+
+/******** libopencm3 *********/
+
+static uint32_t crcValue;
+static uint32_t dmaFlags[8];
+static bool dmaCompleteIrq[8];
+static uint8_t* dmaMemory[8];
+static uint16_t dmaCount[8];
+static uint32_t dmaStarts[8];
+static SimHw::DmaStartFunction dmaDevice[8];
+
+extern "C" uint32_t rtc_get_counter_val(void) { return SimHw::GetMs() / 1000; }
+extern "C" void rtc_clear_flag(int) {}
+extern "C" void spi_enable(uint32_t) {}
+extern "C" uint16_t spi_xfer(uint32_t spi, uint16_t data) { return spi == SPI2 ? SimMcp2515::Xfer(data) : 0; }
+extern "C" void timer_set_period(uint32_t, uint32_t) {}
+extern "C" void timer_set_oc_value(uint32_t, enum tim_oc_id, uint32_t) {}
+extern "C" void timer_enable_counter(uint32_t) {}
+extern "C" void timer_disable_counter(uint32_t) {}
+extern "C" void gpio_set_mode(uint32_t, uint8_t, uint8_t, uint16_t) {}
+extern "C" void gpio_primary_remap(uint32_t, uint32_t) {}
+extern "C" void crc_reset(void) { crcValue = 0xFFFFFFFF; }
+
+//Same algorithm as the STM32 CRC unit: CRC-32 polynomial, 32 bit words MSB first, no reflection
+extern "C" uint32_t crc_calculate_block(uint32_t* data, int size)
+{
+   for (int i = 0; i < size; i++)
+   {
+      crcValue ^= data[i];
+
+      for (int bit = 0; bit < 32; bit++)
+         crcValue = (crcValue & 0x80000000) ? (crcValue << 1) ^ 0x04C11DB7 : crcValue << 1;
+   }
+   return crcValue;
+}
+
+//Transfers without a device complete immediately and raise their interrupt if enabled
+extern "C" void dma_channel_reset(uint32_t, uint8_t channel)
+{
+   dmaFlags[channel] = 0;
+   dmaCompleteIrq[channel] = false;
+   dmaStarts[channel]++;
+}
+extern "C" void sim_dma_set_memory(uint8_t channel, const void* address) { dmaMemory[channel] = (uint8_t*)address; }
+extern "C" void dma_set_number_of_data(uint32_t, uint8_t channel, uint16_t count) { dmaCount[channel] = count; }
+extern "C" void dma_set_read_from_memory(uint32_t, uint8_t) {}
+extern "C" void dma_set_read_from_peripheral(uint32_t, uint8_t) {}
+extern "C" void dma_enable_memory_increment_mode(uint32_t, uint8_t) {}
+extern "C" void dma_set_peripheral_size(uint32_t, uint8_t, uint32_t) {}
+extern "C" void dma_set_memory_size(uint32_t, uint8_t, uint32_t) {}
+extern "C" void dma_set_priority(uint32_t, uint8_t, uint32_t) {}
+extern "C" void dma_enable_transfer_complete_interrupt(uint32_t, uint8_t channel) { dmaCompleteIrq[channel] = true; }
+
+extern "C" void dma_enable_channel(uint32_t, uint8_t channel)
+{
+   uint32_t start = ++dmaStarts[channel];
+
+   if (dmaDevice[channel])
+      dmaDevice[channel](channel, dmaMemory[channel], dmaCount[channel]);
+   else
+      SimHw::CompleteDma(channel, start);
+}
+extern "C" void dma_disable_channel(uint32_t, uint8_t) {}
+extern "C" bool dma_get_interrupt_flag(uint32_t, uint8_t channel, uint32_t flags) { return (dmaFlags[channel] & flags) != 0; }
+extern "C" void dma_clear_interrupt_flags(uint32_t, uint8_t channel, uint32_t flags) { dmaFlags[channel] &= ~flags; }
+extern "C" uint16_t dma_get_number_of_data(uint32_t, uint8_t) { return 0; }
+extern "C" void usart_enable_tx_dma(uint32_t) {}
+extern "C" void usart_enable_rx_dma(uint32_t) {}
+extern "C" void usart_disable_tx_dma(uint32_t) {}
+extern "C" void usart_disable_rx_dma(uint32_t) {}
+extern "C" void iwdg_reset(void) {}
+extern "C" void exti_reset_request(uint32_t) {}
+
+void SimHw::SetDmaDevice(uint8_t channel, DmaStartFunction device)
+{
+   dmaDevice[channel] = device;
+}
+
+uint32_t SimHw::GetDmaStarts(uint8_t channel)
+{
+   return dmaStarts[channel];
+}
+
+bool SimHw::CompleteDma(uint8_t channel, uint32_t start)
+{
+   if (start != dmaStarts[channel]) return false;
+
+   dmaFlags[channel] |= DMA_TCIF;
+
+   if (dmaCompleteIrq[channel])
+   {
+      if (channel == DMA_CHANNEL6) dma1_channel6_isr();
+      if (channel == DMA_CHANNEL7) dma1_channel7_isr();
+   }
+   return true;
+}
+
+/******** hwinit.cpp *********/
+
+extern "C" void clock_setup(void) {}
+extern "C" void usart_setup(void) {}
+extern "C" void usart2_setup(void) {}
+extern "C" void nvic_setup(void) {}
+extern "C" void rtc_setup(void) {}
+extern "C" void tim_setup(void) {}
+extern "C" void tim2_setup(void) {}
+extern "C" void tim3_setup(void) {}
+extern "C" void spi2_setup(void) {}
+extern "C" void spi3_setup(void) {}
+
+/******** libopeninv *********/
+
+#undef DIG_IO_ENTRY
+#define DIG_IO_ENTRY(name, port, pin, mode) DigIo DigIo::name;
+DIG_IO_LIST
+#undef DIG_IO_ENTRY
+
+#undef ANA_IN_ENTRY
+#define ANA_IN_ENTRY(name, port, pin) AnaIn AnaIn::name;
+ANA_IN_LIST
+#undef ANA_IN_ENTRY
+
+CanMap* TerminalCommands::canMap;
+
+//Terminal commands are not simulated, terminal_prj.cpp isn't part of the build
+extern const TERM_CMD TermCmds[] = { { 0, 0 } };
+
+extern "C" int parm_load(void)
+{
+   Param::LoadDefaults();
+
+   if (!SimHw::ApplyParamOverrides()) exit(1);
+   return 0;
+}
+
+extern "C" uint32_t parm_save(void) { return 0; }
+
+Terminal::Terminal(uint32_t, const TERM_CMD* commands, bool) : termCmds(commands) {}
+
+void Terminal::Run()
+{
+   SimHw::Step();
+}
+
+Stm32Scheduler::Stm32Scheduler(uint32_t) : nextTask(0), ticks(0) {}
+
+void Stm32Scheduler::AddTask(void (*function)(void), uint16_t period)
+{
+   if (nextTask < MAX_TASKS)
+   {
+      functions[nextTask] = function;
+      periods[nextTask] = period;
+      nextTask++;
+   }
+}
+
+void Stm32Scheduler::Run()
+{
+   for (int i = 0; i < nextTask; i++)
+   {
+      if ((ticks % periods[i]) == 0)
+         functions[i]();
+   }
+   ticks++;
+}
+
+LinBus::LinBus(uint32_t, int)
+{
+   memset(recvBuffer, 0, sizeof(recvBuffer));
+}
+
+void LinBus::Request(uint8_t, uint8_t*, uint8_t)
+{
+   SimHw::CountLinRequest();
+}
+
+bool LinBus::HasReceived(uint8_t, uint8_t)
+{
+   return false;
+}
+
+CanHardware::CanHardware()
+   : lastRxTimestamp(0), nextUserMessageIndex(0), nextCallbackIndex(0)
+{
+}
+
+bool CanHardware::AddCallback(CanCallback* cb)
+{
+   if (nextCallbackIndex < MAX_RECV_CALLBACKS)
+   {
+      recvCallback[nextCallbackIndex++] = cb;
+      return true;
+   }
+   return false;
+}
+
+bool CanHardware::RegisterUserMessage(uint32_t canId)
+{
+   for (int i = 0; i < nextUserMessageIndex; i++)
+   {
+      if (userIds[i] == canId) return true;
+   }
+
+   if (nextUserMessageIndex < MAX_USER_MESSAGES)
+   {
+      userIds[nextUserMessageIndex++] = canId;
+      ConfigureFilters();
+      return true;
+   }
+   return false;
+}
+
+void CanHardware::ClearUserMessages()
+{
+   nextUserMessageIndex = 0;
+
+   for (int i = 0; i < nextCallbackIndex; i++)
+      recvCallback[i]->HandleClear();
+
+   ConfigureFilters();
+}
+
+void CanHardware::HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc)
+{
+   lastRxTimestamp = rtc_get_counter_val();
+
+   for (int i = 0; i < nextCallbackIndex; i++)
+   {
+      if (recvCallback[i]->HandleRx(canId, data, dlc)) break;
+   }
+}
+
+Stm32Can* Stm32Can::interfaces[2];
+
+Stm32Can::Stm32Can(uint32_t baseAddr, enum baudrates baudrate, bool)
+{
+   bus = baseAddr == CAN1 ? 0 : 1;
+   interfaces[bus] = this;
+   SimCanBus::Get(bus).Attach(this);
+   SetBaudrate(baudrate);
+}
+
+void Stm32Can::SetBaudrate(enum baudrates baudrate)
+{
+   static const uint32_t bitrates[BaudLast] = { 125000, 250000, 500000, 800000, 1000000 };
+
+   if (baudrate < BaudLast) SimCanBus::Get(bus).SetBitrate(bitrates[baudrate]);
+}
+
+void Stm32Can::ConfigureFilters() {}
+
+void Stm32Can::Send(uint32_t canId, uint32_t data[2], uint8_t len)
+{
+   SimHw::CountTx(bus, canId, data, len);
+   SimCanBus::Get(bus).Transmit(this, canId, data, len);
+}
+
+Stm32Can* Stm32Can::GetInterface(int index)
+{
+   return index < 2 ? interfaces[index] : 0;
+}
+
+bool Stm32Can::IsUserMessage(uint32_t canId)
+{
+   for (int i = 0; i < nextUserMessageIndex; i++)
+   {
+      if (userIds[i] == canId) return true;
+   }
+   return false;
+}
+
+//Frames that don't match a user message are dropped like the hardware filters would
+bool Stm32Can::SimReceive(uint32_t canId, uint32_t data[2], uint8_t dlc)
+{
+   bool accepted = IsUserMessage(canId);
+
+   SimHw::CountRx(bus, canId, dlc, accepted);
+   if (accepted) HandleRx(canId, data, dlc);
+
+   return accepted;
+}
+
+void Stm32Can::SimCanReceive(uint32_t canId, const uint32_t data[2], uint8_t dlc)
+{
+   //The drivers get a copy they may modify, like the receive FIFO on target
+   uint32_t copy[2] = { data[0], data[1] };
+   SimReceive(canId, copy, dlc);
+}
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "simmcp2515.h"
+#include "MCP2515.h"
+
+#define TXREQ     0x08
+#define RX0IF     0x01
+#define RX1IF     0x02
+#define RX0OVR    0x40
+#define RX1OVR    0x80
+#define MODE_MASK 0xE0
+#define MODE_NORMAL 0x00
+#define MODE_CONFIG 0x80
+#define INST_NONE 0x00
+#define INST_SKIP 0xFF //unknown instruction, the rest of the transaction is ignored
+
+uint8_t SimMcp2515::reg[128];
+uint32_t SimMcp2515::csRises = 0;
+uint8_t SimMcp2515::inst = INST_NONE;
+uint8_t SimMcp2515::pos = 0;
+uint8_t SimMcp2515::addr = 0;
+uint8_t SimMcp2515::mask = 0;
+uint32_t SimMcp2515::errors = 0;
+
+static const uint8_t txCtrl[3] = { MCP2515_TXB0CTRL, MCP2515_TXB1CTRL, MCP2515_TXB2CTRL };
+
+//Power on state, the controller starts in configuration mode
+void SimMcp2515::Reset()
+{
+   memset(reg, 0, sizeof(reg));
+   reg[MCP2515_CANSTAT] = MODE_CONFIG;
+   reg[MCP2515_CANCTRL] = MODE_CONFIG | 0x07;
+   csRises = DigIo::mcp_cs.GetRises();
+   inst = INST_NONE;
+   errors = 0;
+}
+
+//Ends the transaction if CS went high since the last byte
+void SimMcp2515::Sync()
+{
+   uint32_t rises = DigIo::mcp_cs.GetRises();
+
+   if (rises == csRises) return;
+   csRises = rises;
+
+   if (inst == MCP2515_READ_RXB0SIDH || inst == MCP2515_READ_RXB0D0)
+      reg[MCP2515_CANINTF] &= ~RX0IF;
+   else if (inst == MCP2515_READ_RXB1SIDH || inst == MCP2515_READ_RXB1D0)
+      reg[MCP2515_CANINTF] &= ~RX1IF;
+   inst = INST_NONE;
+}
+
+uint8_t SimMcp2515::Xfer(uint8_t mosi)
+{
+   Sync();
+
+   if (DigIo::mcp_cs.Get())
+   {
+      errors++;
+      return 0xFF;
+   }
+
+   if (inst == INST_NONE)
+   {
+      Instruction(mosi);
+      return 0xFF;
+   }
+
+   uint8_t p = pos++;
+
+   switch (inst)
+   {
+   case MCP2515_READ:
+      if (p == 0)
+      {
+         addr = mosi;
+         return 0xFF;
+      }
+      return reg[addr++ & 0x7F];
+   case MCP2515_WRITE:
+      if (p == 0)
+         addr = mosi;
+      else
+         Write(addr++ & 0x7F, mosi, 0xFF);
+      return 0xFF;
+   case MCP2515_BIT_MOD:
+      if (p == 0) addr = mosi;
+      else if (p == 1) mask = mosi;
+      else if (p == 2) Write(addr & 0x7F, mosi, mask);
+      return 0xFF;
+   case MCP2515_READ_STATUS:
+      return Status();
+   case MCP2515_RX_STATUS:
+      return RxStatus();
+   case MCP2515_READ_RXB0SIDH:
+   case MCP2515_READ_RXB0D0:
+   case MCP2515_READ_RXB1SIDH:
+   case MCP2515_READ_RXB1D0:
+      return reg[addr++ & 0x7F];
+   case MCP2515_LOAD_TXB0SIDH:
+   case MCP2515_LOAD_TXB0D0:
+   case MCP2515_LOAD_TXB1SIDH:
+   case MCP2515_LOAD_TXB1D0:
+   case MCP2515_LOAD_TXB2SIDH:
+   case MCP2515_LOAD_TXB2D0:
+      //TXBnSIDH..TXBnD7 are 13 bytes starting one after TXBnCTRL
+      if ((addr & 0x0F) <= 0x0D) reg[addr & 0x7F] = mosi;
+      addr++;
+      return 0xFF;
+   default:
+      return 0xFF;
+   }
+}
+
+void SimMcp2515::Instruction(uint8_t i)
+{
+   inst = i;
+   pos = 0;
+
+   if (i == MCP2515_RESET)
+   {
+      uint32_t e = errors;
+      Reset();
+      errors = e;
+      inst = INST_SKIP;
+   }
+   else if ((i & 0xF8) == 0x80) //RTS, one bit per buffer
+   {
+      for (int n = 0; n < 3; n++)
+      {
+         if (i & (1 << n)) reg[txCtrl[n]] |= TXREQ;
+      }
+      inst = INST_SKIP;
+   }
+   else if ((i & 0xF9) == 0x90) //READ RX BUFFER, bit 2 selects RXB1, bit 1 starts at D0
+   {
+      addr = ((i & 0x04) ? MCP2515_RXB1CTRL : MCP2515_RXB0CTRL) + ((i & 0x02) ? 6 : 1);
+   }
+   else if ((i & 0xF8) == 0x40 && (i & 0x07) <= 5) //LOAD TX BUFFER, bits 2:1 buffer, bit 0 starts at D0
+   {
+      uint8_t n = (i >> 1) & 3;
+
+      if (reg[txCtrl[n]] & TXREQ) errors++;
+      addr = txCtrl[n] + ((i & 1) ? 6 : 1);
+   }
+   else if (i != MCP2515_READ && i != MCP2515_WRITE && i != MCP2515_BIT_MOD &&
+            i != MCP2515_READ_STATUS && i != MCP2515_RX_STATUS)
+   {
+      errors++;
+      inst = INST_SKIP;
+   }
+}
+
+//Applies a write or BIT MODIFY with the side effects and read only bits of the chip
+void SimMcp2515::Write(uint8_t a, uint8_t value, uint8_t m)
+{
+   if (a == txCtrl[0] || a == txCtrl[1] || a == txCtrl[2])
+      m &= 0x0B; //TXREQ and TXP
+   else if (a == MCP2515_EFLG)
+      m &= RX0OVR | RX1OVR;
+   else if (a == MCP2515_CANSTAT || a == MCP2515_TEC || a == MCP2515_REC)
+      m = 0;
+
+   reg[a] = (reg[a] & ~m) | (value & m);
+
+   //The mode change takes effect right away
+   if (a == MCP2515_CANCTRL)
+      reg[MCP2515_CANSTAT] = (reg[MCP2515_CANSTAT] & ~MODE_MASK) | (reg[a] & MODE_MASK);
+}
+
+uint8_t SimMcp2515::Status()
+{
+   uint8_t intf = reg[MCP2515_CANINTF];
+   uint8_t status = intf & (RX0IF | RX1IF);
+
+   if (reg[MCP2515_TXB0CTRL] & TXREQ) status |= MCP2515_STAT_TXB0REQ;
+   if (intf & 0x04) status |= MCP2515_STAT_TX0IF;
+   if (reg[MCP2515_TXB1CTRL] & TXREQ) status |= MCP2515_STAT_TXB1REQ;
+   if (intf & 0x08) status |= MCP2515_STAT_TX1IF;
+   if (reg[MCP2515_TXB2CTRL] & TXREQ) status |= MCP2515_STAT_TXB2REQ;
+   if (intf & 0x10) status |= MCP2515_STAT_TX2IF;
+   return status;
+}
+
+//Bits 7:6 the full buffers, bit 4 extended ID of the frame in RXB0, or RXB1 when only that is full
+uint8_t SimMcp2515::RxStatus()
+{
+   uint8_t full = reg[MCP2515_CANINTF] & (RX0IF | RX1IF);
+   uint8_t sidl = (full & RX0IF) ? reg[MCP2515_RXB0CTRL + 2] : reg[MCP2515_RXB1CTRL + 2];
+   uint8_t status = full << 6;
+
+   if (full && (sidl & 0x08)) status |= 0x10;
+   return status;
+}
+
+//Sends the pending frame that wins inside the controller, sets its TXnIF
+bool SimMcp2515::Transmit(Frame& frame)
+{
+   int best = -1;
+
+   Sync();
+   if ((reg[MCP2515_CANSTAT] & MODE_MASK) != MODE_NORMAL) return false;
+
+   for (int n = 0; n < 3; n++)
+   {
+      uint8_t ctrl = reg[txCtrl[n]];
+
+      if ((ctrl & TXREQ) && (best < 0 || (ctrl & 3) >= (reg[txCtrl[best]] & 3)))
+         best = n;
+   }
+
+   if (best < 0) return false;
+
+   const uint8_t* b = &reg[txCtrl[best] + 1];
+
+   frame.ext = (b[1] & 0x08) != 0;
+   if (frame.ext)
+      frame.id = ((uint32_t)b[0] << 21) | ((uint32_t)(b[1] >> 5) << 18) | ((uint32_t)(b[1] & 3) << 16) | (b[2] << 8) | b[3];
+   else
+      frame.id = ((uint32_t)b[0] << 3) | (b[1] >> 5);
+   frame.dlc = b[4] & 0x0F;
+   memcpy(frame.data, &b[5], 8);
+   frame.buffer = best;
+
+   reg[txCtrl[best]] &= ~TXREQ;
+   reg[MCP2515_CANINTF] |= 0x04 << best;
+   return true;
+}
+
+//A frame from the bus, lost with an overflow flag when both buffers are full
+bool SimMcp2515::Receive(uint32_t id, bool ext, uint8_t dlc, const uint8_t data[8])
+{
+   Sync();
+   if ((reg[MCP2515_CANSTAT] & MODE_MASK) != MODE_NORMAL) return false;
+
+   uint8_t* b;
+
+   if (!(reg[MCP2515_CANINTF] & RX0IF))
+   {
+      b = &reg[MCP2515_RXB0CTRL + 1];
+      reg[MCP2515_CANINTF] |= RX0IF;
+   }
+   else if (!(reg[MCP2515_CANINTF] & RX1IF))
+   {
+      b = &reg[MCP2515_RXB1CTRL + 1];
+      reg[MCP2515_CANINTF] |= RX1IF;
+   }
+   else
+   {
+      reg[MCP2515_EFLG] |= RX1OVR;
+      return false;
+   }
+
+   if (ext)
+   {
+      b[0] = id >> 21;
+      b[1] = (((id >> 18) & 7) << 5) | 0x08 | ((id >> 16) & 3);
+      b[2] = id >> 8;
+      b[3] = id;
+   }
+   else
+   {
+      b[0] = id >> 3;
+      b[1] = (id & 7) << 5;
+      b[2] = 0;
+      b[3] = 0;
+   }
+   b[4] = dlc & 0x0F;
+   memcpy(&b[5], data, 8);
+   return true;
+}
+
+bool SimMcp2515::IrqPending()
+{
+   Sync();
+   return (reg[MCP2515_CANINTF] & reg[MCP2515_CANINTE]) != 0;
+}
+
+uint8_t SimMcp2515::GetRegister(uint8_t a)
+{
+   Sync();
+   return reg[a & 0x7F];
+}
@@ -0,0 +1,355 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "simtoyota.h"
+#include "simhw.h"
+#include "htmframe.h"
+#include "params.h"
+#include <libopencm3/stm32/dma.h>
+
+#define BYTE_US          20 //start, 8 data and stop bit at 500kbaud
+#define REPLY_OFFSET     8  //bytes between the sync and the first MTH byte
+#define GS450H_SETUP     3  //setup frames before the GS450H reports ready
+#define AMBIENT          (25 * 256)
+
+bool SimToyota::attached = false;
+SimToyota::Variant SimToyota::variant = NONE;
+int SimToyota::dcVoltage = 0;
+uint8_t SimToyota::htm[105];
+uint8_t* SimToyota::rxMemory = 0;
+uint16_t SimToyota::rxCount = 0;
+uint32_t SimToyota::rxStart = 0;
+uint32_t SimToyota::txStart = 0;
+uint32_t SimToyota::replyStart = 0;
+uint64_t SimToyota::txDoneUs = 0;
+uint64_t SimToyota::rxDoneUs = 0;
+uint8_t SimToyota::mth[140];
+uint16_t SimToyota::mthLen = 0;
+uint16_t SimToyota::setupFrames = 0;
+bool SimToyota::running = false;
+int16_t SimToyota::mg2Torque = 0;
+int32_t SimToyota::mg1Speed = 0;
+int32_t SimToyota::mg2Speed = 0;
+int32_t SimToyota::waterTemp = AMBIENT;
+int32_t SimToyota::inductorTemp = AMBIENT;
+SimToyota::Fault SimToyota::fault = FAULT_NONE;
+uint32_t SimToyota::faultPeriodMs = 0;
+uint32_t SimToyota::lateUs = 2000;
+uint16_t SimToyota::faultFrames = 0;
+uint16_t SimToyota::faultsLeft = 0;
+uint32_t SimToyota::nextFaultMs = 0;
+bool SimToyota::replyFaulty = false;
+bool SimToyota::lastReplyOk = false;
+uint64_t SimToyota::burstEndUs = 0;
+bool SimToyota::awaitLink = false;
+bool SimToyota::awaitStatus = false;
+bool SimToyota::statusDown = false;
+uint32_t SimToyota::secondFrames = 0;
+SimToyota::Stats SimToyota::stats;
+
+void SimToyota::Attach()
+{
+   SimHw::SetDmaDevice(DMA_CHANNEL6, DmaStarted);
+   SimHw::SetDmaDevice(DMA_CHANNEL7, DmaStarted);
+   stats.minRate = 0xFFFFFFFF;
+   attached = true;
+}
+
+void SimToyota::SetFaults(Fault f, uint32_t periodMs, uint16_t frames, uint32_t late)
+{
+   fault = f;
+   faultPeriodMs = periodMs;
+   faultFrames = frames;
+   lateUs = late;
+   nextFaultMs = periodMs;
+}
+
+const char* SimToyota::GetVariantName()
+{
+   static const char* const names[] = { "none", "GS450H", "Prius", "GS300H" };
+   return names[variant];
+}
+
+//Channel 6 is the MTH receive buffer being armed, channel 7 an HTM frame going out
+void SimToyota::DmaStarted(uint8_t channel, uint8_t* memory, uint16_t count)
+{
+   uint64_t nowUs = (uint64_t)SimHw::GetMs() * 1000;
+
+   if (channel == DMA_CHANNEL6)
+   {
+      rxMemory = memory;
+      rxCount = count;
+      rxStart = SimHw::GetDmaStarts(channel);
+      return;
+   }
+
+   txStart = SimHw::GetDmaStarts(channel);
+   txDoneUs = nowUs + count * BYTE_US;
+
+   switch (count)
+   {
+   case 80: variant = GS450H; mthLen = 100; break;
+   case 100: variant = PRIUS; mthLen = 120; break;
+   case 105: variant = GS300H; mthLen = 140; break;
+   default: return; //not a frame of any known layout, no reply
+   }
+
+   //A reply still on the wire is cut off by the next sync
+   if (rxDoneUs > 0)
+   {
+      stats.mthLost++;
+      lastReplyOk = false;
+      rxDoneUs = 0;
+   }
+
+   //The reply is sent while the frame comes in, so it still reflects the previous one
+   BuildMth(mth, mthLen);
+   HtmReceived(memory, count);
+
+   if (faultPeriodMs > 0 && fault != FAULT_NONE && nowUs >= (uint64_t)nextFaultMs * 1000)
+   {
+      nextFaultMs += faultPeriodMs;
+      faultsLeft = faultFrames;
+      stats.bursts++;
+      burstEndUs = UINT64_MAX;
+      awaitStatus = true;
+      statusDown = false;
+   }
+
+   uint64_t doneUs = nowUs + (REPLY_OFFSET + mthLen) * BYTE_US;
+   replyFaulty = faultsLeft > 0;
+
+   if (replyFaulty)
+   {
+      stats.faults++;
+      faultsLeft--;
+
+      if (fault == FAULT_CHECKSUM) mth[mthLen - 1] ^= 0x55;
+      if (fault == FAULT_LATE) doneUs += lateUs;
+
+      if (faultsLeft == 0)
+      {
+         burstEndUs = doneUs;
+         awaitLink = true;
+      }
+   }
+
+   //Nothing is received without an armed transfer
+   if (rxMemory != 0 && rxStart == SimHw::GetDmaStarts(DMA_CHANNEL6) && !(replyFaulty && fault == FAULT_LOST))
+   {
+      rxDoneUs = doneUs;
+      replyStart = rxStart;
+   }
+   else
+      lastReplyOk = false;
+}
+
+void SimToyota::HtmReceived(const uint8_t* frame, uint16_t len)
+{
+   bool init = false;
+   uint64_t nowUs = (uint64_t)SimHw::GetMs() * 1000;
+
+   memcpy(htm, frame, len);
+   stats.htmFrames++;
+
+   if (HtmFrame::Checksum(htm, len) != (htm[len - 2] | (htm[len - 1] << 8)))
+   {
+      stats.htmBadChecksum++; //ignored like the inverter would
+      return;
+   }
+
+   secondFrames++;
+
+   if (variant == GS450H)
+   {
+      if (memcmp(htm, htm_data_setup, len) == 0)
+      {
+         init = true;
+         setupFrames++;
+      }
+   }
+   else if (variant == PRIUS)
+   {
+      for (int row = 0; row < 7 && !init; row++)
+         init = memcmp(htm, htm_data_init[row], len) == 0;
+      running |= memcmp(htm, htm_data_init[5], len) == 0;
+   }
+   else
+   {
+      for (int row = 0; row < 6 && !init; row++)
+         init = memcmp(htm, htm_data_Init_GS300H[row], len) == 0;
+      running |= memcmp(htm, htm_data_Init_GS300H[5], len) == 0;
+   }
+
+   if (init)
+   {
+      stats.initFrames++;
+      if (variant != GS450H && memcmp(htm, variant == PRIUS ? htm_data_init[0] : htm_data_Init_GS300H[0], len) == 0)
+         running = false; //start up from the beginning
+      return;
+   }
+
+   if (variant == GS450H) running = setupFrames >= GS450H_SETUP;
+
+   if (!running)
+   {
+      stats.earlyFrames++; //torque isn't taken before the start up is done
+      return;
+   }
+
+   if (awaitLink && lastReplyOk && nowUs >= burstEndUs)
+   {
+      uint32_t recoveryMs = (nowUs - burstEndUs) / 1000;
+
+      stats.recoveries++;
+      stats.recoverySumMs += recoveryMs;
+      if (recoveryMs > stats.recoveryMaxMs) stats.recoveryMaxMs = recoveryMs;
+      awaitLink = false;
+   }
+
+   if (variant == GS450H)
+      mg2Torque = htm[26] | (htm[27] << 8);
+   else if (variant == PRIUS)
+      mg2Torque = htm[30] | (htm[31] << 8);
+   else
+      mg2Torque = htm[31] | (htm[32] << 8);
+
+   MotorModel();
+}
+
+//Once per exchange: MG2 follows the torque against a speed proportional drag,
+//MG1 turns the other way as with the engine stopped
+void SimToyota::MotorModel()
+{
+   mg2Speed += mg2Torque / 16 - mg2Speed / 256;
+   if (mg2Speed > 10000) mg2Speed = 10000;
+   if (mg2Speed < -10000) mg2Speed = -10000;
+   mg1Speed = -mg2Speed * 13 / 5;
+   if (mg1Speed > 32767) mg1Speed = 32767;
+   if (mg1Speed < -32767) mg1Speed = -32767;
+
+   inductorTemp += (abs(mg2Torque) * 4 - (inductorTemp - waterTemp)) / 256;
+   waterTemp += ((inductorTemp - waterTemp) - (waterTemp - AMBIENT)) / 2048;
+}
+
+static void PutWord(uint8_t* frame, int idx, int value)
+{
+   frame[idx] = value & 0xFF;
+   frame[idx + 1] = (value >> 8) & 0xFF;
+}
+
+//Same offsets that GS450HClass::ParseMth() reads
+void SimToyota::BuildMth(uint8_t* frame, uint16_t len)
+{
+   int water = waterTemp / 256;
+   int inductor = inductorTemp / 256;
+
+   memset(frame, 0, len);
+
+   if (variant == GS300H)
+   {
+      PutWord(frame, 117, dcVoltage * 2);
+      frame[20] = water;
+      PutWord(frame, 25, inductor);
+      PutWord(frame, 10, mg1Speed);
+      PutWord(frame, 43, mg2Speed);
+   }
+   else if (variant == PRIUS)
+   {
+      PutWord(frame, 100, dcVoltage * 2 + 5);
+      frame[20] = water;
+      PutWord(frame, 86, inductor);
+      PutWord(frame, 6, mg1Speed);
+      PutWord(frame, 38, mg2Speed);
+   }
+   else
+   {
+      frame[1] = setupFrames >= GS450H_SETUP; //ready
+      PutWord(frame, 82, dcVoltage * 2 + 5);
+      PutWord(frame, 42, water);
+      PutWord(frame, 86, inductor);
+      PutWord(frame, 6, mg1Speed);
+      PutWord(frame, 31, mg2Speed);
+   }
+
+   PutWord(frame, len - 2, HtmFrame::Checksum(frame, len));
+}
+
+void SimToyota::Run(uint32_t ms)
+{
+   uint64_t nowUs = (uint64_t)ms * 1000;
+
+   if (!attached) return;
+
+   if (txDoneUs > 0 && nowUs >= txDoneUs)
+   {
+      txDoneUs = 0;
+      SimHw::CompleteDma(DMA_CHANNEL7, txStart);
+   }
+
+   if (rxDoneUs > 0 && nowUs >= rxDoneUs)
+   {
+      rxDoneUs = 0;
+
+      //The firmware may have restarted the transfer for the next exchange already
+      if (replyStart == SimHw::GetDmaStarts(DMA_CHANNEL6))
+      {
+         memcpy(rxMemory, mth, mthLen < rxCount ? mthLen : rxCount);
+         SimHw::CompleteDma(DMA_CHANNEL6, replyStart);
+         stats.mthFrames++;
+         lastReplyOk = !replyFaulty;
+      }
+      else
+      {
+         stats.mthLost++;
+         lastReplyOk = false;
+      }
+   }
+
+   //Only counted when the burst took InvStat down at all
+   if (awaitStatus)
+   {
+      if (Param::GetInt(Param::InvStat) == 0)
+      {
+         statusDown = true;
+      }
+      else if (nowUs >= burstEndUs)
+      {
+         if (statusDown)
+         {
+            uint32_t recoveryMs = (nowUs - burstEndUs) / 1000;
+
+            stats.statusRecoveries++;
+            stats.statusRecoverySumMs += recoveryMs;
+            if (recoveryMs > stats.statusRecoveryMaxMs) stats.statusRecoveryMaxMs = recoveryMs;
+         }
+         awaitStatus = false;
+      }
+   }
+
+   //Exchanges of each whole second, the first one is still starting up
+   if ((ms % 1000) == 0)
+   {
+      if (ms > 1000)
+      {
+         if (secondFrames < stats.minRate) stats.minRate = secondFrames;
+         if (secondFrames > stats.maxRate) stats.maxRate = secondFrames;
+      }
+      secondFrames = 0;
+   }
+}
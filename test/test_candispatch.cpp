@@ -0,0 +1,311 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include "test_list.h"
+#include "candispatch.h"
+#include "outlanderinverter.h"
+
+using namespace std;
+
+#define FRAMES_PER_SEC 2000
+#define SIM_SECONDS    60
+
+//ID sets of a typical setup: ISA shunt, Leaf inverter, E65, PDM, i3 LIM, SimpBMS, Tesla DCDC, F30 lever, OBD2
+static const uint32_t shuntIds[] = { 0x521, 0x522, 0x523, 0x524, 0x525, 0x526, 0x527, 0x528 };
+static const uint32_t inverterIds[] = { 0x1DA, 0x55A, 0x679, 0x390 };
+static const uint32_t vehicleIds[] = { 0x130, 0x192, 0x480 };
+static const uint32_t chargerIds[] = { 0x679, 0x390 };
+static const uint32_t chargeIntIds[] = { 0x3B4, 0x272, 0x29E, 0x2B2, 0x2EF };
+static const uint32_t bmsIds[] = { 0x373, 0x351 };
+static const uint32_t dcdcIds[] = { 0x210 };
+static const uint32_t shifterIds[] = { 0x55E, 0x65E, 0x197 };
+static const uint32_t obd2Ids[] = { 0x7DF };
+
+struct Driver
+{
+   CanDispatch::owners owner;
+   const uint32_t* ids;
+   int numIds;
+};
+
+#define DRIVER(o, list) { CanDispatch::o, list, sizeof(list) / sizeof(list[0]) }
+
+static const Driver drivers[] =
+{
+   DRIVER(OWN_SHUNT, shuntIds), DRIVER(OWN_INVERTER, inverterIds), DRIVER(OWN_VEHICLE, vehicleIds),
+   DRIVER(OWN_CHARGER, chargerIds), DRIVER(OWN_CHARGEINT, chargeIntIds), DRIVER(OWN_BMS, bmsIds),
+   DRIVER(OWN_DCDC, dcdcIds), DRIVER(OWN_SHIFTER, shifterIds), DRIVER(OWN_OBD2, obd2Ids)
+};
+
+#define NUM_DRIVERS (int)(sizeof(drivers) / sizeof(drivers[0]))
+
+class DispatchCan : public CanHardware
+{
+public:
+   void SetBaudrate(enum baudrates) {}
+   void Send(uint32_t, uint32_t*, uint8_t) {}
+   void ConfigureFilters() {}
+};
+
+static volatile uint32_t sink;
+static uint32_t decoded[CanDispatch::OWN_LAST];
+//The inverter category is a real driver, one instance per receive path
+static OutlanderInverter broadcastInverter, dispatchInverter;
+static DispatchCan can;
+static const uint32_t outlanderIds[] = { 0x289, 0x299, 0x733 };
+
+//Stand-in for the other drivers' DecodeCAN(): compares against every ID it knows, like the switch statements do
+static void Decode(const Driver& d, uint32_t id, uint32_t data[2])
+{
+   for (int i = 0; i < d.numIds; i++)
+   {
+      if (d.ids[i] == id)
+      {
+         sink += data[0];
+         decoded[d.owner]++;
+         return;
+      }
+   }
+}
+
+static void BroadcastCallback(uint32_t id, uint32_t data[2])
+{
+   broadcastInverter.DecodeCAN(id, data);
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+      Decode(drivers[i], id, data);
+}
+
+static void DispatchCallback(uint32_t id, uint32_t data[2])
+{
+   uint16_t owners = CanDispatch::GetOwners(id);
+
+   if (DISPATCH_TO(owners, OWN_INVERTER))
+      dispatchInverter.DecodeCAN(id, data);
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      if (owners & (1 << drivers[i].owner))
+         Decode(drivers[i], id, data);
+   }
+}
+
+//What the VCU publishes from the inverter
+static bool SameInverterValues()
+{
+   return broadcastInverter.GetMotorSpeed() == dispatchInverter.GetMotorSpeed() &&
+          broadcastInverter.GetInverterVoltage() == dispatchInverter.GetInverterVoltage() &&
+          broadcastInverter.GetInverterTemperature() == dispatchInverter.GetInverterTemperature() &&
+          broadcastInverter.GetMotorTemperature() == dispatchInverter.GetMotorTemperature();
+}
+
+static void RegisterAll()
+{
+   CanDispatch::Clear();
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      CanDispatch::SetOwner(drivers[i].owner);
+
+      for (int j = 0; j < drivers[i].numIds; j++)
+         CanDispatch::AddId(drivers[i].ids[j]);
+   }
+}
+
+static void RegisterWithOutlander()
+{
+   RegisterAll();
+   CanDispatch::SetOwner(CanDispatch::OWN_INVERTER);
+   dispatchInverter.SetCanInterface(&can);
+}
+
+//Replays the registered IDs round robin, i.e. the mix that passes the hardware filters
+//plus the ones of the Outlander every tenth frame
+static uint32_t ReplayId(int frame, int& driver, int& idx)
+{
+   if (frame % 10 == 9)
+      return outlanderIds[(frame / 10) % 3];
+
+   uint32_t id = drivers[driver].ids[idx];
+
+   idx++;
+   if (idx >= drivers[driver].numIds)
+   {
+      idx = 0;
+      driver = (driver + 1) % NUM_DRIVERS;
+   }
+   return id;
+}
+
+static double Replay(void (*callback)(uint32_t, uint32_t*))
+{
+   uint32_t data[2] = { 0x12345678, 0x9abcdef0 };
+   int numFrames = FRAMES_PER_SEC * SIM_SECONDS;
+   int driver = 0, idx = 0;
+
+   auto start = chrono::steady_clock::now();
+
+   for (int frame = 0; frame < numFrames; frame++)
+   {
+      callback(ReplayId(frame, driver, idx), data);
+      data[0] = data[0] * 1103515245 + 12345;
+      data[1] ^= data[0];
+   }
+
+   auto end = chrono::steady_clock::now();
+   return chrono::duration<double, nano>(end - start).count() / numFrames;
+}
+
+static void TestSharedIdsAreStoredOnce()
+{
+   RegisterAll();
+   //0x679 and 0x390 are registered by inverter and charger
+   ASSERT(CanDispatch::GetNumIds() == 27);
+}
+
+static void TestSharedIdHasBothOwners()
+{
+   RegisterAll();
+   uint16_t owners = CanDispatch::GetOwners(0x679);
+   ASSERT(DISPATCH_TO(owners, OWN_INVERTER) && DISPATCH_TO(owners, OWN_CHARGER) && !DISPATCH_TO(owners, OWN_VEHICLE));
+}
+
+static void TestUnknownIdHasNoOwner()
+{
+   RegisterAll();
+   ASSERT(CanDispatch::GetOwners(0x123) == 0 && CanDispatch::GetOwners(0) == 0 && CanDispatch::GetOwners(0xFFFFFFFF) == 0);
+}
+
+static void TestClearEmptiesTable()
+{
+   RegisterAll();
+   CanDispatch::Clear();
+   ASSERT(CanDispatch::GetNumIds() == 0 && CanDispatch::GetOwners(0x521) == 0);
+}
+
+static void TestDispatchDecodesSameFramesAsBroadcast()
+{
+   uint32_t broadcastDecoded[CanDispatch::OWN_LAST];
+   bool same = true;
+
+   RegisterWithOutlander();
+
+   for (int i = 0; i < CanDispatch::OWN_LAST; i++) decoded[i] = 0;
+   double broadcastNs = Replay(BroadcastCallback);
+   for (int i = 0; i < CanDispatch::OWN_LAST; i++) broadcastDecoded[i] = decoded[i];
+
+   for (int i = 0; i < CanDispatch::OWN_LAST; i++) decoded[i] = 0;
+   double dispatchNs = Replay(DispatchCallback);
+   for (int i = 0; i < CanDispatch::OWN_LAST; i++) same = same && broadcastDecoded[i] == decoded[i];
+
+   cout << "CAN receive, " << FRAMES_PER_SEC << " frames/s for " << SIM_SECONDS << "s: broadcast "
+        << broadcastNs << " ns/frame, dispatch table " << dispatchNs << " ns/frame" << endl;
+
+   ASSERT(same);
+}
+
+//The real driver must end up with the same values after every frame
+static void TestRealDriverDecodesSameAsBroadcast()
+{
+   uint32_t data[2] = { 0x4E200000, 0x01900000 };
+   int driver = 0, idx = 0;
+   int differing = 0;
+
+   RegisterWithOutlander();
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x289), OWN_INVERTER));
+
+   for (int frame = 0; frame < 20000; frame++)
+   {
+      uint32_t id = ReplayId(frame, driver, idx);
+
+      BroadcastCallback(id, data);
+      DispatchCallback(id, data);
+      if (!SameInverterValues()) differing++;
+
+      data[0] = data[0] * 1103515245 + 12345;
+      data[1] ^= data[0];
+   }
+
+   ASSERT(differing == 0);
+   ASSERT(dispatchInverter.GetMotorSpeed() != 0 || dispatchInverter.GetInverterVoltage() != 0);
+}
+
+//A table that is rebuilt stays complete for the receive path until the new one is published
+//Every table the receive path can see during a rebuild holds all IDs added so far
+static void TestEachAddPublishesCompleteTable()
+{
+   CanDispatch::Clear();
+
+   for (int i = 0; i < NUM_DRIVERS; i++)
+   {
+      CanDispatch::SetOwner(drivers[i].owner);
+
+      for (int j = 0; j < drivers[i].numIds; j++)
+      {
+         CanDispatch::AddId(drivers[i].ids[j]);
+
+         for (int k = 0; k <= i; k++)
+         {
+            for (int l = 0; l < (k < i ? drivers[k].numIds : j + 1); l++)
+               ASSERT(CanDispatch::GetOwners(drivers[k].ids[l]) & (1 << drivers[k].owner));
+         }
+      }
+   }
+
+   int numIds = CanDispatch::GetNumIds();
+
+   CanDispatch::SetOwner(CanDispatch::OWN_VEHICLE);
+   CanDispatch::AddId(0x100);
+   ASSERT(CanDispatch::GetNumIds() == numIds + 1);
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x100), OWN_VEHICLE));
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x521), OWN_SHUNT));
+
+   //Adding an owner to a known ID keeps the others
+   CanDispatch::SetOwner(CanDispatch::OWN_BMS);
+   CanDispatch::AddId(0x100);
+   ASSERT(CanDispatch::GetNumIds() == numIds + 1);
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x100), OWN_VEHICLE) && DISPATCH_TO(CanDispatch::GetOwners(0x100), OWN_BMS));
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x679), OWN_CHARGER));
+}
+
+static void TestCan3TableIsSeparate()
+{
+   RegisterAll();
+   CanDispatch::SetOwner(CanDispatch::OWN_CHARGEINT);
+   CanDispatch::RegisterCan3Message(0x109);
+   CanDispatch::RegisterCan3Message(0x108);
+
+   ASSERT(CanDispatch::GetNumIds(CanDispatch::BUS_CAN3) == 2 && CanDispatch::GetNumIds() == 27);
+   ASSERT(DISPATCH_TO(CanDispatch::GetOwners(0x108, CanDispatch::BUS_CAN3), OWN_CHARGEINT));
+   ASSERT(CanDispatch::GetOwners(0x108) == 0 && CanDispatch::GetOwners(0x521, CanDispatch::BUS_CAN3) == 0);
+
+   CanDispatch::Clear();
+   ASSERT(CanDispatch::GetNumIds(CanDispatch::BUS_CAN3) == 0);
+}
+
+void CanDispatchTest::RunTest()
+{
+   TestSharedIdsAreStoredOnce();
+   TestSharedIdHasBothOwners();
+   TestUnknownIdHasNoOwner();
+   TestClearEmptiesTable();
+   TestDispatchDecodesSameFramesAsBroadcast();
+   TestRealDriverDecodesSameAsBroadcast();
+   TestEachAddPublishesCompleteTable();
+   TestCan3TableIsSeparate();
+}
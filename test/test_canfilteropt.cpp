@@ -0,0 +1,105 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "canfilteropt.h"
+
+using namespace std;
+
+//ISA shunt, SimpBMS, i3 LIM, daisy chain BMS and an extended charger ID
+static const uint32_t ids[] = { 0x521, 0x522, 0x523, 0x524, 0x525, 0x526, 0x527, 0x528,
+                                0x373, 0x351, 0x3B4, 0x29E, 0x2B2, 0x2EF, 0x272, 0x4F1, 0x4F5,
+                                0x18FF50E5 };
+
+static bool Accepts(const CanFilterOpt::Result& r, uint32_t id)
+{
+   for (int i = 0; i < r.numBanks; i++)
+   {
+      const CanFilterOpt::Bank& b = r.banks[i];
+      uint32_t v16 = id << 5, v32 = (id << 3) | 0x4;
+
+      switch (b.type)
+      {
+      case CanFilterOpt::LIST16:
+         for (int j = 0; j < 4; j++) if (id <= 0x7FF && b.value[j] == v16) return true;
+         break;
+      case CanFilterOpt::MASK16:
+         for (int j = 0; j < 2; j++) if (id <= 0x7FF && (v16 & b.value[2 * j + 1]) == b.value[2 * j]) return true;
+         break;
+      case CanFilterOpt::LIST32:
+         for (int j = 0; j < 2; j++) if (id > 0x7FF && b.value[j] == v32) return true;
+         break;
+      case CanFilterOpt::MASK32:
+         if (id > 0x7FF && (v32 & b.value[1]) == b.value[0]) return true;
+         break;
+      }
+   }
+   return false;
+}
+
+static void TestExactListsWithinBudget()
+{
+   CanFilterOpt::Result r;
+   ASSERT(CanFilterOpt::Optimise(ids, 18, 14, r));
+   //17 standard IDs in 5 list banks, 1 extended ID in 1 bank
+   ASSERT(r.numBanks == 6);
+   ASSERT(r.registered == 18 && r.accepted == 18);
+   ASSERT(CanFilterOpt::FalseAcceptPercent(r) == 0);
+   ASSERT(Accepts(r, 0x4F5) && Accepts(r, 0x18FF50E5) && !Accepts(r, 0x4F2) && !Accepts(r, 0x100));
+}
+
+static void TestMergesWhenOverBudget()
+{
+   CanFilterOpt::Result r;
+   ASSERT(CanFilterOpt::Optimise(ids, 18, 3, r));
+   ASSERT(r.numBanks <= 3);
+
+   for (int i = 0; i < 18; i++)
+      ASSERT(Accepts(r, ids[i]));
+
+   //Unregistered IDs that pass are counted
+   ASSERT(r.accepted > r.registered);
+   ASSERT(CanFilterOpt::FalseAcceptPercent(r) == (r.accepted - 18) * 100 / r.accepted);
+}
+
+static void TestContiguousRangeMergesForFree()
+{
+   static const uint32_t range[] = { 0x520, 0x521, 0x522, 0x523, 0x524, 0x525, 0x526, 0x527 };
+   CanFilterOpt::Result r;
+
+   ASSERT(CanFilterOpt::Optimise(range, 8, 1, r));
+   ASSERT(r.numBanks == 1 && r.banks[0].type == CanFilterOpt::MASK16);
+   ASSERT(r.accepted == 8 && !Accepts(r, 0x528) && !Accepts(r, 0x51F));
+}
+
+static void TestDuplicatesAndNoBudget()
+{
+   static const uint32_t dup[] = { 0x601, 0x601, 0x7DF };
+   CanFilterOpt::Result r;
+
+   ASSERT(CanFilterOpt::Optimise(dup, 3, 14, r));
+   ASSERT(r.registered == 2 && r.numBanks == 1);
+   ASSERT(!CanFilterOpt::Optimise(ids, 18, 1, r)); //standard and extended need a bank each
+}
+
+void CanFilterOptTest::RunTest()
+{
+   TestExactListsWithinBudget();
+   TestMergesWhenOverBudget();
+   TestContiguousRangeMergesForFree();
+   TestDuplicatesAndNoBudget();
+}
@@ -0,0 +1,179 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "canfreshness.h"
+#include "candispatch.h"
+
+using namespace std;
+
+static void TestJitterAndMissed()
+{
+   CanFreshness::Clear(1000);
+   CanDispatch::SetOwner(CanDispatch::OWN_INVERTER);
+   CanFreshness::Expect(0x1DA, 10);
+   CanFreshness::Expect(0x55A, 100);
+   CanFreshness::Expect(0x1DA, 20); //declared twice, the first one counts
+   ASSERT(CanFreshness::GetNumIds() == 2);
+   ASSERT(CanFreshness::Get(0).id == 0x1DA && CanFreshness::Get(0).periodMs == 10);
+   ASSERT(CanFreshness::Get(0).owner == CanDispatch::OWN_INVERTER);
+
+   //On time, 2ms late (20%), then three frames lost
+   CanFreshness::Stamp(0x1DA, 1000);
+   CanFreshness::Stamp(0x1DA, 1010);
+   CanFreshness::Stamp(0x1DA, 1022);
+   CanFreshness::Stamp(0x1DA, 1062);
+   CanFreshness::Stamp(0x123, 1062); //not expected, ignored
+
+   const CanFreshness::Entry& e = CanFreshness::Get(0);
+   ASSERT(e.frames == 4);
+   ASSERT(e.jitter[0] == 1 && e.jitter[1] == 1 && e.jitter[4] == 1);
+   ASSERT(e.missed == 3);
+   ASSERT(e.maxGapMs == 40);
+   ASSERT(CanFreshness::GetTotalMissed() == 3);
+}
+
+static void TestWorstOffender()
+{
+   CanFreshness::Clear(0);
+   CanFreshness::Expect(0x1DA, 10);
+   CanFreshness::Expect(0x4F1, 100);
+
+   CanFreshness::Stamp(0x1DA, 480);
+   CanFreshness::Stamp(0x4F1, 300);
+   CanFreshness::Update(500);
+
+   //2 periods overdue beats 2ms
+   ASSERT(CanFreshness::GetWorst() == 0);
+   ASSERT(CanFreshness::GetAge(0) == 20);
+
+   CanFreshness::Stamp(0x1DA, 500);
+   ASSERT(CanFreshness::GetWorst() == 1);
+   ASSERT(CanFreshness::GetAge(1) == 200);
+
+   //Arrived after the last update
+   CanFreshness::Stamp(0x1DA, 505);
+   ASSERT(CanFreshness::GetAge(0) == 0);
+}
+
+static void TestCommandLatency()
+{
+   CanFreshness::Clear(0);
+   CanFreshness::Expect(0x289, 10);
+   CanFreshness::LinkCommand(0x289, 0x287);
+   CanFreshness::LinkCommand(0x555, 0x287); //not expected, ignored
+
+   //Only the first command starts a measurement until the feedback arrives
+   CanFreshness::CommandSent(0x287, 100);
+   CanFreshness::CommandSent(0x287, 103);
+   CanFreshness::CommandSent(0x288, 101);
+   CanFreshness::Stamp(0x289, 107);
+   ASSERT(CanFreshness::Get(0).latencyMs == 7);
+
+   CanFreshness::CommandSent(0x287, 110);
+   CanFreshness::Stamp(0x289, 112);
+   ASSERT(CanFreshness::Get(0).latencyMs == 2);
+   ASSERT(CanFreshness::GetMaxLatency() == 7);
+
+   CanFreshness::ResetStats();
+   ASSERT(CanFreshness::GetMaxLatency() == 0 && CanFreshness::Get(0).frames == 2);
+}
+
+static void TestResponse()
+{
+   CanFreshness::Clear(0);
+   CanFreshness::Expect(0x289, 10);
+   CanFreshness::Expect(0x299, 10);
+   CanFreshness::LinkCommand(0x289, 0x287);
+   ASSERT(!CanFreshness::ExpectResponse(0x299, 0)); //no command linked
+
+   //Measured from the change, which waited 10ms for the command sent last,
+   //up to the feedback that showed it
+   CanFreshness::CommandSent(0x287, 100);
+   CanFreshness::CommandSent(0x287, 110);
+   ASSERT(CanFreshness::ExpectResponse(0x289, 10));
+   CanFreshness::CommandSent(0x287, 120);
+   ASSERT(!CanFreshness::ExpectResponse(0x289, 0)); //still waiting
+   CanFreshness::Stamp(0x289, 135);
+   CanFreshness::Responded(0x289);
+   ASSERT(CanFreshness::Get(0).responseMs == 35);
+   CanFreshness::Responded(0x289); //nothing pending
+   ASSERT(CanFreshness::Get(0).responseMs == 35);
+
+   //A response that never comes is dropped after the timeout
+   CanFreshness::CommandSent(0x287, 200);
+   ASSERT(CanFreshness::ExpectResponse(0x289, 0));
+   CanFreshness::CommandSent(0x287, 200 + CanFreshness::RESPONSE_TIMEOUT_MS);
+   ASSERT(CanFreshness::ExpectResponse(0x289, 0));
+   CanFreshness::Stamp(0x289, 1220);
+   CanFreshness::Responded(0x289);
+   ASSERT(CanFreshness::Get(0).responseMs == 20);
+   ASSERT(CanFreshness::GetMaxResponse() == 35);
+
+   CanFreshness::ResetStats();
+   ASSERT(CanFreshness::GetMaxResponse() == 0);
+}
+
+static void TestCanResponse()
+{
+   CanResponse response(0x289, 10000, 40, 10);
+
+   CanFreshness::Clear(0);
+   CanFreshness::Expect(0x289, 10);
+   CanFreshness::LinkCommand(0x289, 0x287);
+
+   //Too small a step isn't measured
+   response.Step(10020);
+   CanFreshness::CommandSent(0x287, 10);
+   response.Sent(10020, 500);
+   CanFreshness::Stamp(0x289, 20);
+   response.Feedback(600);
+   ASSERT(CanFreshness::GetMaxResponse() == 0);
+
+   //The step waits two ticks for the frame, the speed has to rise by 10rpm
+   response.Step(10100);
+   response.Tick();
+   response.Tick();
+   CanFreshness::CommandSent(0x287, 100);
+   response.Sent(10100, 500);
+   CanFreshness::Stamp(0x289, 130);
+   response.Feedback(509);
+   ASSERT(CanFreshness::Get(0).responseMs == 0);
+   CanFreshness::Stamp(0x289, 140);
+   response.Feedback(510);
+   ASSERT(CanFreshness::Get(0).responseMs == 60);
+
+   //Stepping down needs the speed to fall, also across zero
+   response.Step(9900);
+   CanFreshness::CommandSent(0x287, 200);
+   response.Sent(9900, 5);
+   CanFreshness::Stamp(0x289, 210);
+   response.Feedback(20);
+   CanFreshness::Stamp(0x289, 225);
+   response.Feedback(-5);
+   ASSERT(CanFreshness::Get(0).responseMs == 25);
+   ASSERT(CanFreshness::GetMaxResponse() == 60);
+}
+
+void CanFreshnessTest::RunTest()
+{
+   TestJitterAndMissed();
+   TestWorstOffender();
+   TestCommandLatency();
+   TestResponse();
+   TestCanResponse();
+}
@@ -0,0 +1,266 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "CANSPI.h"
+#include "MCP2515.h"
+#include "simmcp2515.h"
+
+using namespace std;
+
+//The CAN3 controller on SPI2 is the register model of the host simulation
+DigIo DigIo::mcp_cs;
+extern "C" void spi_enable(uint32_t) {}
+extern "C" uint16_t spi_xfer(uint32_t, uint16_t data) { return SimMcp2515::Xfer(data); }
+
+static uCAN_MSG rxFrames[4];
+static int rxCount;
+
+static void RxHandler(uCAN_MSG* msg)
+{
+   if (rxCount < 4) rxFrames[rxCount] = *msg;
+   rxCount++;
+}
+
+static void Setup()
+{
+   SimMcp2515::Reset();
+   CANSPI_Initialize();
+   CANSPI_SetRxHandler(RxHandler);
+   CANSPI_ENRx_IRQ();
+   rxCount = 0;
+}
+
+static bool Send(uint32_t id, bool ext = false, uint8_t data0 = 0)
+{
+   uCAN_MSG msg = {};
+
+   msg.frame.idType = ext ? dEXTENDED_CAN_MSG_ID_2_0B : dSTANDARD_CAN_MSG_ID_2_0B;
+   msg.frame.id = id;
+   msg.frame.dlc = 8;
+   msg.frame.data0 = data0;
+   return CANSPI_Transmit(&msg) != 0;
+}
+
+//What exti15_10_isr does on the falling edge of INT
+static void ServiceIrq()
+{
+   if (SimMcp2515::IrqPending()) CANSPI_StartReceive();
+}
+
+//Lets the controller send everything it gets, servicing the interrupt after each frame
+static int SendAll(uint32_t* ids, uint8_t* data0, int max)
+{
+   SimMcp2515::Frame frame;
+   int sent = 0;
+
+   while (SimMcp2515::Transmit(frame))
+   {
+      if (sent < max)
+      {
+         ids[sent] = frame.id;
+         data0[sent] = frame.data[0];
+      }
+      sent++;
+      ServiceIrq();
+   }
+   return sent;
+}
+
+static uint8_t Txp(uint8_t ctrlReg)
+{
+   return SimMcp2515::GetRegister(ctrlReg) & 3;
+}
+
+static void TestPriorityOrder()
+{
+   uint32_t ids[8];
+   uint8_t data0[8];
+
+   Setup();
+   //Three go straight into the TX buffers, the last two wait in the queue
+   Send(0x300);
+   Send(0x100);
+   Send(0x200);
+   Send(0x050);
+   Send(0x400);
+   ASSERT(CANSPI_Get_TxQueued() == 2);
+
+   ASSERT(SendAll(ids, data0, 8) == 5);
+   ASSERT(ids[0] == 0x100 && ids[1] == 0x050 && ids[2] == 0x200 && ids[3] == 0x300 && ids[4] == 0x400);
+
+   //Standard before extended with the same base ID, equal IDs in the order they were sent
+   Send(0x124);
+   Send((0x123 << 18) | 5, true);
+   Send(0x123, false, 1);
+   Send(0x123, false, 2);
+   ASSERT(SendAll(ids, data0, 8) == 4);
+   ASSERT(ids[0] == 0x123 && data0[0] == 1);
+   ASSERT(ids[1] == 0x123 && data0[1] == 2);
+   ASSERT(ids[2] == ((0x123 << 18) | 5));
+   ASSERT(ids[3] == 0x124);
+   ASSERT(CANSPI_Get_TxQueued() == 0 && SimMcp2515::GetErrors() == 0);
+}
+
+static void TestTxpAssignment()
+{
+   SimMcp2515::Frame frame;
+   uint32_t ids[8];
+   uint8_t data0[8];
+
+   Setup();
+   Send(0x300);
+   Send(0x100);
+   Send(0x200);
+   ASSERT(Txp(MCP2515_TXB0CTRL) == 1 && Txp(MCP2515_TXB1CTRL) == 3 && Txp(MCP2515_TXB2CTRL) == 2);
+   ASSERT((SimMcp2515::GetRegister(MCP2515_TXB0CTRL) & 0x08) && (SimMcp2515::GetRegister(MCP2515_TXB1CTRL) & 0x08) &&
+          (SimMcp2515::GetRegister(MCP2515_TXB2CTRL) & 0x08));
+
+   //The freed buffer takes the queued frame, which outranks the two that are still loaded
+   Send(0x050);
+   ASSERT(SimMcp2515::Transmit(frame) && frame.id == 0x100 && frame.buffer == 1);
+   ServiceIrq();
+   ASSERT(Txp(MCP2515_TXB0CTRL) == 1 && Txp(MCP2515_TXB1CTRL) == 3 && Txp(MCP2515_TXB2CTRL) == 2);
+   ASSERT(SimMcp2515::Transmit(frame) && frame.id == 0x050 && frame.buffer == 1);
+   ServiceIrq();
+
+   //Buffer 1 now holds the lowest ID, the other two move up
+   Send(0x400);
+   ASSERT(Txp(MCP2515_TXB0CTRL) == 2 && Txp(MCP2515_TXB1CTRL) == 1 && Txp(MCP2515_TXB2CTRL) == 3);
+   ASSERT(SendAll(ids, data0, 8) == 3);
+   ASSERT(ids[0] == 0x200 && ids[1] == 0x300 && ids[2] == 0x400);
+   ASSERT(SimMcp2515::GetErrors() == 0);
+}
+
+static void TestDropLowestOnOverflow()
+{
+   uint32_t ids[24];
+   uint8_t data0[24];
+   uint32_t drops = CANSPI_Get_TxDrops();
+
+   Setup();
+   Send(0x010);
+   Send(0x011);
+   Send(0x012);
+   for (uint32_t i = 0; i < 16; i++)
+      ASSERT(Send(0x100 + i));
+   ASSERT(CANSPI_Get_TxQueued() == 16 && CANSPI_Get_TxHighWater() >= 16);
+
+   //A frame below everything queued is the one that is dropped
+   ASSERT(!Send(0x7FF));
+   ASSERT(CANSPI_Get_TxDrops() == drops + 1);
+   //A higher priority one takes the place of 0x10F
+   ASSERT(Send(0x080));
+   ASSERT(CANSPI_Get_TxDrops() == drops + 2 && CANSPI_Get_TxQueued() == 16);
+
+   ASSERT(SendAll(ids, data0, 24) == 19);
+   ASSERT(ids[0] == 0x010 && ids[1] == 0x011 && ids[2] == 0x012 && ids[3] == 0x080);
+   for (uint32_t i = 0; i < 15; i++)
+      ASSERT(ids[4 + i] == 0x100 + i);
+   ASSERT(SimMcp2515::GetErrors() == 0);
+}
+
+static void TestIrqDrain()
+{
+   static const uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   SimMcp2515::Frame frame;
+   uint32_t overflows = CANSPI_Get_RxOverflows();
+
+   Setup();
+   ASSERT(SimMcp2515::Receive(0x1DA, false, 8, data));
+   ASSERT(SimMcp2515::Receive(0x18FF50E5, true, 4, data));
+   //Both buffers are full, this one is lost and flagged in EFLG
+   ASSERT(!SimMcp2515::Receive(0x555, false, 8, data));
+   ASSERT(SimMcp2515::GetRegister(MCP2515_EFLG) & 0x80);
+   ASSERT(SimMcp2515::IrqPending());
+
+   ServiceIrq();
+   ASSERT(rxCount == 2);
+   ASSERT(rxFrames[0].frame.id == 0x1DA && rxFrames[0].frame.idType == dSTANDARD_CAN_MSG_ID_2_0B);
+   ASSERT(rxFrames[0].frame.dlc == 8 && rxFrames[0].frame.data0 == 1 && rxFrames[0].frame.data7 == 8);
+   ASSERT(rxFrames[1].frame.id == 0x18FF50E5 && rxFrames[1].frame.idType == dEXTENDED_CAN_MSG_ID_2_0B);
+   ASSERT(rxFrames[1].frame.dlc == 4);
+   //Once drained the overflow is counted and cleared and INT goes high again
+   ASSERT(CANSPI_Get_RxOverflows() == overflows + 1);
+   ASSERT((SimMcp2515::GetRegister(MCP2515_EFLG) & 0xC0) == 0);
+   ASSERT(SimMcp2515::GetRegister(MCP2515_CANINTF) == 0 && !SimMcp2515::IrqPending());
+
+   //A sent frame and a received one in the same interrupt, the freed buffer is loaded again
+   Send(0x100);
+   Send(0x101);
+   Send(0x102);
+   Send(0x103);
+   ASSERT(SimMcp2515::Transmit(frame) && frame.id == 0x100);
+   ASSERT(SimMcp2515::Receive(0x1DB, false, 8, data));
+   ServiceIrq();
+   ASSERT(rxCount == 3 && rxFrames[2].frame.id == 0x1DB);
+   ASSERT(CANSPI_Get_TxQueued() == 0 && (SimMcp2515::GetRegister(MCP2515_TXB0CTRL) & 0x08));
+   ASSERT(!SimMcp2515::IrqPending());
+
+   //Only the wake up flag, it is cleared without touching anything else
+   SimMcp2515::SetRegister(MCP2515_CANINTF, 0x40);
+   ServiceIrq();
+   ASSERT(!SimMcp2515::IrqPending() && rxCount == 3);
+
+   uint32_t ids[4];
+   uint8_t data0[4];
+   ASSERT(SendAll(ids, data0, 4) == 3);
+   ASSERT(SimMcp2515::GetErrors() == 0);
+}
+
+static int lateFrames;
+
+//Frames that come in while the drain is running, each lands in the buffer just read
+static void LateRxHandler(uCAN_MSG* msg)
+{
+   static const uint8_t data[8] = { 9 };
+
+   RxHandler(msg);
+   if (lateFrames > 0 && SimMcp2515::Receive(0x300 + lateFrames, false, 8, data)) lateFrames--;
+}
+
+static void TestDrainRereadsStatus()
+{
+   static const uint8_t data[8] = { 1 };
+
+   Setup();
+   CANSPI_SetRxHandler(LateRxHandler);
+   lateFrames = 3;
+   ASSERT(SimMcp2515::Receive(0x1DA, false, 8, data));
+   ASSERT(SimMcp2515::Receive(0x1DB, false, 8, data));
+
+   //One falling edge, the status read after each pass finds the late frames
+   ServiceIrq();
+   ASSERT(rxCount == 5 && lateFrames == 0);
+   ASSERT(rxFrames[0].frame.id == 0x1DA && rxFrames[1].frame.id == 0x1DB);
+   ASSERT(rxFrames[2].frame.id == 0x303 && rxFrames[2].frame.data0 == 9);
+   ASSERT(SimMcp2515::GetRegister(MCP2515_CANINTF) == 0 && !SimMcp2515::IrqPending());
+
+   //Nothing left for Ms1Task to restart
+   CANSPI_ServiceReceive();
+   ASSERT(rxCount == 5 && SimMcp2515::GetErrors() == 0);
+   CANSPI_SetRxHandler(RxHandler);
+}
+
+void CanSpiTest::RunTest()
+{
+   TestPriorityOrder();
+   TestTxpAssignment();
+   TestDropLowestOnOverflow();
+   TestIrqDrain();
+   TestDrainRereadsStatus();
+}
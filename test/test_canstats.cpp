@@ -0,0 +1,86 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "canstats.h"
+
+using namespace std;
+
+static void TestFrameBits()
+{
+   //Worst case stuffing: 8 byte standard frame 135 bits, 8 byte extended frame 160 bits
+   ASSERT(CanStats::FrameBits(0x123, 8) == 135);
+   ASSERT(CanStats::FrameBits(0x18FF50E5, 8) == 160);
+   ASSERT(CanStats::FrameBits(0x123, 0) == 55);
+   ASSERT(CanStats::FrameBits(0x123, 15) == CanStats::FrameBits(0x123, 8));
+}
+
+static void TestRatesAndLoad()
+{
+   CanStats::Reset();
+   CanStats::SetBitrate(CanStats::BUS_CAN1, 500000);
+
+   //100 frames in 100ms is 1000 frames/s, 13500 bits of 50000 available
+   for (int i = 0; i < 60; i++) CanStats::CountRx(CanStats::BUS_CAN1, 0x123, 8);
+   for (int i = 0; i < 40; i++) CanStats::CountTx(CanStats::BUS_CAN1, 0x321, 8);
+   CanStats::Update(100);
+
+   const CanStats::Bus& s = CanStats::Get(CanStats::BUS_CAN1);
+   ASSERT(s.rxRate == 600 && s.txRate == 400);
+   ASSERT(s.byteRate == 8000);
+   ASSERT(s.load == 27);
+
+   //Only the new frames count in the next interval
+   CanStats::CountRx(CanStats::BUS_CAN1, 0x123, 8);
+   CanStats::Update(100);
+   ASSERT(s.rxRate == 10 && s.txRate == 0 && s.load == 0);
+   ASSERT(CanStats::Get(CanStats::BUS_CAN2).rxRate == 0);
+}
+
+static void TestSlowBusLoad()
+{
+   CanStats::Reset();
+   CanStats::SetBitrate(CanStats::BUS_CAN3, 33333);
+
+   //12 frames of 135 bits in 100ms use 1620 of 3333 bits
+   for (int i = 0; i < 12; i++) CanStats::CountTx(CanStats::BUS_CAN3, 0x100, 8);
+   CanStats::Update(100);
+   ASSERT(CanStats::Get(CanStats::BUS_CAN3).load == 48);
+}
+
+static void TestBusOffEventsCountedOnce()
+{
+   CanStats::Reset();
+
+   CanStats::SetErrors(CanStats::BUS_CAN2, 255, 0, true, true);
+   CanStats::SetErrors(CanStats::BUS_CAN2, 255, 0, true, true);
+   ASSERT(CanStats::Get(CanStats::BUS_CAN2).busOffEvents == 1);
+
+   //Recovered before we looked, only the latched flag tells
+   CanStats::SetErrors(CanStats::BUS_CAN2, 0, 0, false, false);
+   CanStats::SetErrors(CanStats::BUS_CAN2, 0, 0, false, true);
+   ASSERT(CanStats::Get(CanStats::BUS_CAN2).busOffEvents == 2);
+   ASSERT(CanStats::Get(CanStats::BUS_CAN2).tec == 0);
+}
+
+void CanStatsTest::RunTest()
+{
+   TestFrameBits();
+   TestRatesAndLoad();
+   TestSlowBusLoad();
+   TestBusOffEventsCountedOnce();
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "cantrace.h"
+
+using namespace std;
+
+static const uint32_t payload[2] = { 0x04030201, 0x08070605 };
+
+static void TestRecordAndWrap()
+{
+   CanTrace::ClearFilters();
+   CanTrace::Start(false);
+
+   for (uint32_t i = 0; i < CanTrace::SIZE + 10; i++)
+      CanTrace::Record(1, (i & 1) != 0, 0x100 + i, payload, 8);
+
+   //Oldest frames were overwritten, Get(0) is the oldest remaining
+   ASSERT(CanTrace::GetCount() == CanTrace::SIZE);
+   ASSERT((CanTrace::Get(0).id & 0x1FFFFFFF) == 0x10A);
+   ASSERT((CanTrace::Get(CanTrace::SIZE - 1).id & 0x1FFFFFFF) == 0x100 + CanTrace::SIZE + 9);
+   ASSERT(((CanTrace::Get(0).id >> CanTrace::BUS_SHIFT) & 3) == 1);
+   ASSERT((CanTrace::Get(1).id & CanTrace::SENT) != 0);
+   ASSERT(CanTrace::Get(0).data[1] == 0x08070605 && CanTrace::Get(0).dlc == 8);
+   ASSERT(sizeof(CanTrace::Frame) == 16);
+
+   CanTrace::Stop();
+   CanTrace::Record(0, false, 0x7FF, payload, 8);
+   ASSERT((CanTrace::Get(CanTrace::SIZE - 1).id & 0x1FFFFFFF) != 0x7FF);
+}
+
+static void TestFilters()
+{
+   CanTrace::ClearFilters();
+   ASSERT(CanTrace::AddFilter(0x1DA, 0x7FF));
+   ASSERT(CanTrace::AddFilter(0x500, 0x700));
+   CanTrace::Start(false);
+
+   CanTrace::Record(0, false, 0x1DA, payload, 8);
+   CanTrace::Record(0, false, 0x1DB, payload, 8);
+   CanTrace::Record(0, false, 0x5BC, payload, 8);
+   ASSERT(CanTrace::GetCount() == 2);
+   ASSERT((CanTrace::Get(1).id & 0x1FFFFFFF) == 0x5BC);
+
+   ASSERT(CanTrace::AddFilter(1, 1) && CanTrace::AddFilter(1, 1));
+   ASSERT(!CanTrace::AddFilter(1, 1));
+   CanTrace::ClearFilters();
+}
+
+static void TestTriggerOnError()
+{
+   CanTrace::CheckError(0);
+   CanTrace::Start(true);
+
+   for (int i = 0; i < 10; i++)
+      CanTrace::Record(0, false, i, payload, 8);
+
+   //Unchanged error doesn't trigger, a new one does
+   CanTrace::CheckError(0);
+   ASSERT(CanTrace::GetMode() == CanTrace::ARMED);
+   CanTrace::CheckError(3);
+   ASSERT(CanTrace::GetMode() == CanTrace::TRIGGERED);
+
+   for (int i = 0; i < CanTrace::SIZE; i++)
+      CanTrace::Record(0, false, 100 + i, payload, 8);
+
+   //Stopped POST_TRIGGER frames after the error, the frames before it are kept
+   ASSERT(CanTrace::GetMode() == CanTrace::STOPPED);
+   ASSERT(CanTrace::GetCount() == 10 + CanTrace::POST_TRIGGER);
+   ASSERT(CanTrace::Get(9).id == 9);
+   ASSERT(CanTrace::Get(10).id == 100);
+}
+
+void CanTraceTest::RunTest()
+{
+   TestRecordAndWrap();
+   TestFilters();
+   TestTriggerOnError();
+}
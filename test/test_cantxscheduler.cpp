@@ -0,0 +1,171 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "cantxscheduler.h"
+#include "candispatch.h"
+#include "leafinv.h"
+#include "params.h"
+
+using namespace std;
+
+class FakeCan : public CanHardware
+{
+public:
+   FakeCan() : frames(0), lastId(0), lastLen(0) {}
+   void SetBaudrate(enum baudrates) {}
+   void Send(uint32_t canId, uint32_t data[2], uint8_t len) { frames++; lastId = canId; lastLen = len; lastData[0] = data[0]; }
+   void ConfigureFilters() {}
+
+   int frames;
+   uint32_t lastId;
+   uint8_t lastLen;
+   uint32_t lastData[1];
+};
+
+static int fillCalls;
+
+static bool FillCounter(void*, uint8_t* data)
+{
+   data[0] = ++fillCalls;
+   return true;
+}
+
+static bool FillNever(void*, uint8_t*)
+{
+   return false;
+}
+
+static void RunTicks(int n)
+{
+   for (int i = 0; i < n; i++)
+      CanTxScheduler::Run();
+}
+
+static void TestPhasesAreSpread()
+{
+   FakeCan can;
+   int owner;
+   CanTxScheduler::Clear();
+
+   //Ten 10ms frames fit one per ms
+   for (uint32_t id = 0x100; id < 0x10A; id++)
+      ASSERT(CanTxScheduler::Register(&can, id, 8, 10, FillCounter, &owner));
+
+   ASSERT(CanTxScheduler::GetWorstSlot(&can) == 1);
+
+   //The 100ms frame goes next to a 10ms frame but not on top of another 100ms frame
+   CanTxScheduler::Register(&can, 0x200, 8, 100, FillCounter, &owner);
+   CanTxScheduler::Register(&can, 0x201, 8, 100, FillCounter, &owner);
+   ASSERT(CanTxScheduler::GetWorstSlot(&can) == 2);
+   ASSERT(CanTxScheduler::GetPhase(0x200, &owner) != CanTxScheduler::GetPhase(0x201, &owner));
+}
+
+static void TestBusesAreIndependent()
+{
+   FakeCan can1, can2;
+   int owner;
+   CanTxScheduler::Clear();
+
+   CanTxScheduler::Register(&can1, 0x100, 8, 10, FillCounter, &owner);
+   CanTxScheduler::Register(&can2, 0x101, 8, 10, FillCounter, &owner);
+   ASSERT(CanTxScheduler::GetPhase(0x100, &owner) == CanTxScheduler::GetPhase(0x101, &owner));
+}
+
+static void TestFramesSentAtPeriod()
+{
+   FakeCan can;
+   int owner;
+   CanTxScheduler::Clear();
+   fillCalls = 0;
+
+   CanTxScheduler::Register(&can, 0x50B, 7, 10, FillCounter, &owner);
+   CanTxScheduler::Register(&can, 0x55B, 8, 100, FillNever, &owner);
+   RunTicks(100);
+   ASSERT(can.frames == 10 && fillCalls == 10);
+   ASSERT(can.lastId == 0x50B && can.lastLen == 7 && (can.lastData[0] & 0xFF) == 10);
+}
+
+static void TestRemoveAndBadPeriod()
+{
+   FakeCan can;
+   int a, b;
+   CanTxScheduler::Clear();
+
+   ASSERT(!CanTxScheduler::Register(&can, 0x100, 8, 30, FillCounter, &a));
+   ASSERT(!CanTxScheduler::Register(&can, 0x100, 8, 150, FillCounter, &a));
+   ASSERT(CanTxScheduler::Register(&can, 0x100, 8, 200, FillCounter, &a));
+   CanTxScheduler::Register(&can, 0x101, 8, 10, FillCounter, &b);
+   CanTxScheduler::Remove(&a);
+   ASSERT(CanTxScheduler::GetPhase(0x100, &a) < 0 && CanTxScheduler::GetPhase(0x101, &b) >= 0);
+   RunTicks(200);
+   ASSERT(can.frames == 20);
+}
+
+//Counts the Leaf frames that used to be sent from Task10Ms(), i.e. only in run mode
+class LeafCan : public CanHardware
+{
+public:
+   LeafCan() : fastFrames(0), slowFrames(0) {}
+   void SetBaudrate(enum baudrates) {}
+   void Send(uint32_t canId, uint32_t*, uint8_t)
+   {
+      if (canId == 0x11A || canId == 0x1D4 || canId == 0x1DB || canId == 0x50B || canId == 0x1DC || canId == 0x1F2)
+         fastFrames++;
+      else
+         slowFrames++;
+   }
+   void ConfigureFilters() {}
+
+   int fastFrames;
+   int slowFrames;
+};
+
+static void TestLeafFastFramesOnlyInRun()
+{
+   static const int notRunning[] = { MOD_OFF, MOD_PRECHARGE, MOD_CHARGE, MOD_PCHFAIL };
+   LeafCan can;
+   LeafINV inv;
+   CanTxScheduler::Clear();
+   CanDispatch::Clear();
+   inv.SetCanInterface(&can);
+
+   for (unsigned i = 0; i < sizeof(notRunning) / sizeof(notRunning[0]); i++)
+   {
+      Param::SetInt(Param::opmode, notRunning[i]);
+      RunTicks(100);
+   }
+
+   //The PDM frames keep going while charging
+   ASSERT(can.fastFrames == 0 && can.slowFrames == 12);
+
+   Param::SetInt(Param::opmode, MOD_RUN);
+   RunTicks(100);
+   ASSERT(can.fastFrames == 60);
+
+   Param::SetInt(Param::opmode, MOD_OFF);
+   CanTxScheduler::Clear();
+}
+
+void CanTxSchedulerTest::RunTest()
+{
+   TestPhasesAreSpread();
+   TestBusesAreIndependent();
+   TestFramesSentAtPeriod();
+   TestRemoveAndBadPeriod();
+   TestLeafFastFramesOnlyInRun();
+}
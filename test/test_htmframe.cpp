@@ -0,0 +1,120 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "htmframe.h"
+
+using namespace std;
+
+//The checksum as it used to be computed, over the whole frame every time
+static uint16_t FullSum(const uint8_t* frame, int len)
+{
+   uint16_t checksum = 0;
+
+   for (int i = 0; i < len - 2; i++)
+      checksum += frame[i];
+
+   return checksum;
+}
+
+static uint16_t Stored(const uint8_t* frame, int len)
+{
+   return frame[len - 2] | (frame[len - 1] << 8);
+}
+
+static void TestInitTables()
+{
+   HtmFrame frame;
+
+   //The start up frames are sent as they are, so they carry a valid checksum
+   for (int row = 0; row < 7; row++)
+   {
+      frame.Load(htm_data_init[row], 100);
+      ASSERT(frame.GetChecksum() == FullSum(htm_data_init[row], 100));
+      ASSERT(frame.GetChecksum() == Stored(htm_data_init[row], 100));
+   }
+
+   for (int row = 0; row < 6; row++)
+   {
+      frame.Load(htm_data_Init_GS300H[row], 105);
+      ASSERT(frame.GetChecksum() == FullSum(htm_data_Init_GS300H[row], 105));
+      ASSERT(frame.GetChecksum() == Stored(htm_data_Init_GS300H[row], 105));
+   }
+
+   frame.Load(htm_data_setup, 80);
+   ASSERT(frame.GetChecksum() == Stored(htm_data_setup, 80));
+}
+
+//Writes the fields the driver changes with pseudo random torques and
+//compares the finished frame to a full sum after every exchange
+static void TestFieldWrites(const uint8_t* init, int len)
+{
+   static const uint8_t fields[] = { 0, 5, 11, 26, 28, 30, 31, 63, 65, 75, 79, 81, 85, 87, 94 };
+   HtmFrame frame;
+   uint32_t seed = 12345;
+
+   frame.Load(init, len);
+
+   for (int exchange = 0; exchange < 500; exchange++)
+   {
+      for (unsigned i = 0; i < sizeof(fields); i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int16_t value = seed >> 16;
+         int idx = fields[i];
+
+         if (idx + 1 >= len - 2) continue;
+
+         if (idx == 0 || idx == 94)
+            frame.Set(idx, frame.Get(idx) + value);
+         else if (idx == 75)
+            frame.SetWordSwapped(idx, value);
+         else
+            frame.SetWord(idx, value);
+      }
+
+      const uint8_t* data = frame.Finish();
+      ASSERT(Stored(data, len) == FullSum(data, len));
+   }
+
+   //Writing a byte back to its old value leaves the sum alone
+   uint16_t before = frame.GetChecksum();
+   frame.Set(40, frame.Get(40));
+   ASSERT(frame.GetChecksum() == before);
+   ASSERT(frame.GetLength() == len);
+}
+
+static void TestSetWord()
+{
+   HtmFrame frame;
+
+   frame.Load(htm_data_default, 80);
+   frame.SetWord(63, -5000);
+   frame.SetWordSwapped(75, 0x1234);
+   ASSERT(frame.Get(63) == 0x78 && frame.Get(64) == 0xEC);
+   ASSERT(frame.Get(75) == 0x12 && frame.Get(76) == 0x34);
+   ASSERT(frame.GetChecksum() == 255 + 0x78 + 0xEC + 0x12 + 0x34);
+}
+
+void HtmFrameTest::RunTest()
+{
+   TestInitTables();
+   TestFieldWrites(htm_data_default, 80);
+   TestFieldWrites(htm_data_default, 100);
+   TestFieldWrites(htm_data_GS300H, 105);
+   TestSetWord();
+}
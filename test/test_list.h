@@ -29,10 +29,80 @@ class ThrottleTest: public IUnitTest
       virtual void RunTest();
 };
 
+class CanDispatchTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class SequencerTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanStatsTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanTxSchedulerTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanFilterOptTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanTraceTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanFreshnessTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class HtmFrameTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class ShiftMapTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
+class CanSpiTest: public IUnitTest
+{
+   public:
+      virtual void RunTest();
+};
+
 #ifdef EXPORT_TESTLIST
 IUnitTest* testList[] =
 {
    new ThrottleTest(),
+   new CanDispatchTest(),
+   new SequencerTest(),
+   new CanStatsTest(),
+   new CanTxSchedulerTest(),
+   new CanFilterOptTest(),
+   new CanTraceTest(),
+   new CanFreshnessTest(),
+   new HtmFrameTest(),
+   new ShiftMapTest(),
+   new CanSpiTest(),
    NULL
 };
 #endif
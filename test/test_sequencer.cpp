@@ -0,0 +1,138 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "sequencer.h"
+#include "taskprofiler.h"
+
+using namespace std;
+
+struct Recorder
+{
+   int calls[8]; //tick on which each step ran
+   int numCalls;
+   int doneCalls;
+   int wait;
+};
+
+static int tick;
+
+static int RecordStep(void* context, int step)
+{
+   Recorder* r = (Recorder*)context;
+   r->calls[r->numCalls++] = tick;
+   return step < 2 ? r->wait : Sequencer::DONE;
+}
+
+static void RecordDone(void* context)
+{
+   ((Recorder*)context)->doneCalls++;
+}
+
+static void RunTicks(int n)
+{
+   for (int i = 0; i < n; i++, tick++)
+      Sequencer::Run();
+}
+
+static void TestStepsAreSpacedByWait()
+{
+   Recorder r = { {0}, 0, 0, 5 };
+   tick = 0;
+
+   ASSERT(Sequencer::Start(RecordStep, &r, RecordDone));
+   RunTicks(20);
+   ASSERT(r.numCalls == 3 && r.calls[0] == 0 && r.calls[1] == 5 && r.calls[2] == 10);
+   ASSERT(r.doneCalls == 1);
+   ASSERT(!Sequencer::IsRunning(RecordStep, &r));
+}
+
+static void TestZeroWaitRunsOneStepPerTick()
+{
+   Recorder r = { {0}, 0, 0, 0 };
+   tick = 0;
+
+   Sequencer::Start(RecordStep, &r);
+   RunTicks(1);
+   ASSERT(r.numCalls == 1); //never more than one step per Run()
+   RunTicks(5);
+   ASSERT(r.numCalls == 3 && r.calls[1] == 1 && r.calls[2] == 2);
+}
+
+static void TestRestartWhileRunningIsRejected()
+{
+   Recorder r = { {0}, 0, 0, 10 };
+   tick = 0;
+
+   ASSERT(Sequencer::Start(RecordStep, &r));
+   ASSERT(!Sequencer::Start(RecordStep, &r));
+   RunTicks(30);
+   ASSERT(r.numCalls == 3);
+}
+
+static void TestCancelSkipsCallback()
+{
+   Recorder r = { {0}, 0, 0, 10 };
+   tick = 0;
+
+   Sequencer::Start(RecordStep, &r, RecordDone);
+   RunTicks(3);
+   Sequencer::Cancel(RecordStep, &r);
+   RunTicks(30);
+   ASSERT(r.numCalls == 1 && r.doneCalls == 0);
+}
+
+static void TestSlotsRunIndependently()
+{
+   Recorder r[Sequencer::MAX_SEQUENCES + 1];
+   tick = 0;
+
+   for (int i = 0; i <= Sequencer::MAX_SEQUENCES; i++)
+   {
+      Recorder init = { {0}, 0, 0, i + 1 };
+      r[i] = init;
+   }
+
+   for (int i = 0; i < Sequencer::MAX_SEQUENCES; i++)
+      ASSERT(Sequencer::Start(RecordStep, &r[i], RecordDone));
+   ASSERT(!Sequencer::Start(RecordStep, &r[Sequencer::MAX_SEQUENCES])); //all slots taken
+
+   RunTicks(20);
+   for (int i = 0; i < Sequencer::MAX_SEQUENCES; i++)
+      ASSERT(r[i].doneCalls == 1 && r[i].calls[2] == 2 * (i + 1));
+}
+
+static void TestLongestStepIsRecorded()
+{
+   Recorder r = { {0}, 0, 0, 1 };
+   TaskProfiler::Reset();
+
+   Sequencer::Start(RecordStep, &r);
+   RunTicks(5);
+   ASSERT(TaskProfiler::GetStats(TaskProfiler::SEQ_STEP).count == 3);
+   ASSERT(TaskProfiler::GetStats(TaskProfiler::SEQ_STEP).max > 0);
+}
+
+void SequencerTest::RunTest()
+{
+   TestStepsAreSpacedByWait();
+   TestZeroWaitRunsOneStepPerTick();
+   TestRestartWhileRunningIsRejected();
+   TestCancelSkipsCallback();
+   TestSlotsRunIndependently();
+   TestLongestStepIsRecorded();
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the ZombieVerter project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_list.h"
+#include "shiftmap.h"
+
+using namespace std;
+
+static void TestDefaultMap()
+{
+   //The defaults shift like the fixed speeds did before
+   ShiftMap::Configure(7000, 7000, 5000);
+
+   for (int load = 0; load <= 100; load += 25)
+   {
+      ASSERT(ShiftMap::Select(ShiftMap::LOW, 7000, load) == ShiftMap::LOW);
+      ASSERT(ShiftMap::Select(ShiftMap::LOW, 7001, load) == ShiftMap::HIGH);
+      ASSERT(ShiftMap::Select(ShiftMap::HIGH, 2000, load) == ShiftMap::HIGH);
+      ASSERT(ShiftMap::Select(ShiftMap::HIGH, 1999, load) == ShiftMap::LOW);
+   }
+}
+
+static void TestLoadInterpolation()
+{
+   ShiftMap::Configure(4000, 9000, 1500);
+
+   ASSERT(ShiftMap::GetUpshift(0) == 4000 && ShiftMap::GetUpshift(10) == 9000);
+   ASSERT(ShiftMap::GetUpshift(5) == 6500 && ShiftMap::GetDownshift(5) == 5000);
+
+   //Light pedal shifts up early, full pedal holds low gear longer
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 5000, 0) == ShiftMap::HIGH);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 5000, 100) == ShiftMap::LOW);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 9001, 100) == ShiftMap::HIGH);
+
+   //Load is rounded to the nearest step and clamped, regen counts as no load
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 6600, 54) == ShiftMap::HIGH);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 6600, 56) == ShiftMap::LOW);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 9001, 250) == ShiftMap::HIGH);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 4001, -80) == ShiftMap::HIGH);
+}
+
+static void TestHysteresis()
+{
+   ShiftMap::Configure(3000, 3000, 5000);
+
+   //Downshift speed can't go below standstill
+   ASSERT(ShiftMap::GetDownshift(0) == 0);
+   ASSERT(ShiftMap::Select(ShiftMap::HIGH, 0, 0) == ShiftMap::HIGH);
+
+   //Between the two speeds the current gear stays
+   ShiftMap::Configure(6000, 6000, 2000);
+   ASSERT(ShiftMap::Select(ShiftMap::LOW, 5000, 50) == ShiftMap::LOW);
+   ASSERT(ShiftMap::Select(ShiftMap::HIGH, 5000, 50) == ShiftMap::HIGH);
+   ASSERT(ShiftMap::Select(ShiftMap::HIGH, -1500, 50) == ShiftMap::LOW);
+}
+
+void ShiftMapTest::RunTest()
+{
+   TestDefaultMap();
+   TestLoadInterpolation();
+   TestHysteresis();
+}
@@ -19,10 +19,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
 #include "my_fp.h"
 #include "my_math.h"
+#include "params.h"
 #include "test_list.h"
 #include "throttle.h"
+#include "throttlefp.h"
 
 using namespace std;
 
@@ -32,6 +35,105 @@ static void TestSetup()
    Throttle::throtdead = 5;
    Throttle::potmin[0] = 100;
    Throttle::potmax[0] = 4000;
+   Throttle::throtmax = 100;
+   Param::SetInt(Param::dir, 1);
+}
+
+//Same parameters for both pipelines, like Param::Change sets them
+static void PipelineSetup()
+{
+   Throttle::regenRpm = 1500;
+   Throttle::regenendRpm = 100;
+   Throttle::ThrotRpmFilt = 15;
+   Throttle::regenmax = -10;
+   Throttle::regenBrake = -10;
+   Throttle::throtmax = 100;
+   Throttle::throtmaxRev = 30;
+   Throttle::throtmin = -100;
+   Throttle::throtdead = 5;
+   Throttle::regenRamp = 0.7f;
+   Throttle::throttleRamp = 0.3f;
+   Throttle::udcmin = 250;
+   Throttle::udcmax = 400;
+   Throttle::idcmin = -200;
+   Throttle::idcmax = 400;
+   Throttle::speedLimit = 6000;
+
+   ThrottleFP::regenRpm = THR_FROMFLT(Throttle::regenRpm);
+   ThrottleFP::regenendRpm = THR_FROMFLT(Throttle::regenendRpm);
+   ThrottleFP::ThrotRpmFilt = THR_FROMFLT(Throttle::ThrotRpmFilt);
+   ThrottleFP::regenmax = THR_FROMFLT(Throttle::regenmax);
+   ThrottleFP::regenBrake = THR_FROMFLT(Throttle::regenBrake);
+   ThrottleFP::throtmax = THR_FROMFLT(Throttle::throtmax);
+   ThrottleFP::throtmaxRev = THR_FROMFLT(Throttle::throtmaxRev);
+   ThrottleFP::throtmin = THR_FROMFLT(Throttle::throtmin);
+   ThrottleFP::throtdead = THR_FROMFLT(Throttle::throtdead);
+   ThrottleFP::regenRamp = THR_FROMFLT(Throttle::regenRamp);
+   ThrottleFP::throttleRamp = THR_FROMFLT(Throttle::throttleRamp);
+   ThrottleFP::udcmin = THR_FROMFLT(Throttle::udcmin);
+   ThrottleFP::udcmax = THR_FROMFLT(Throttle::udcmax);
+   ThrottleFP::idcmin = THR_FROMFLT(Throttle::idcmin);
+   ThrottleFP::idcmax = THR_FROMFLT(Throttle::idcmax);
+   ThrottleFP::speedLimit = Throttle::speedLimit;
+}
+
+//10ms steps of a drive cycle: pedal sweeps with jitter, braking phases, speed follows the command
+struct DriveStep
+{
+   int pot;
+   bool brake;
+   int speed;
+   float udc;
+   float idc;
+};
+
+#define DRIVE_STEPS 60000
+
+static DriveStep drive[DRIVE_STEPS];
+
+static void GenerateDrive()
+{
+   uint32_t rnd = 12345;
+   int speed = 0;
+
+   for (int i = 0; i < DRIVE_STEPS; i++)
+   {
+      rnd = rnd * 1103515245 + 12345;
+      int phase = i % 3000;
+      int pedal = phase < 1500 ? phase * 4000 / 1500 : (3000 - phase) * 4000 / 1500;
+
+      drive[i].pot = 100 + pedal * 39 / 40 + (int)((rnd >> 16) % 31) - 15;
+      drive[i].brake = (i / 3000) % 4 == 3 && phase > 2000;
+      speed += drive[i].brake ? -20 : (pedal - 1000) / 200;
+      speed = MAX(0, MIN(speed, 7000));
+      drive[i].speed = speed;
+      drive[i].udc = 360 - pedal / 40.0f + (rnd >> 28);
+      drive[i].idc = pedal / 12.0f;
+   }
+}
+
+static float RunFloatStep(const DriveStep& step)
+{
+   int pot = step.pot;
+   Throttle::CheckAndLimitRange(&pot, 0);
+   float spnt = Throttle::CalcThrottle(pot, 0, step.brake);
+   spnt = Throttle::RampThrottle(spnt);
+   Throttle::UdcLimitCommand(spnt, step.udc);
+   Throttle::IdcLimitCommand(spnt, step.idc);
+   Throttle::SpeedLimitCommand(spnt, step.speed);
+   return spnt;
+}
+
+static thrfp RunFixedStep(const DriveStep& step, thrfp udc, thrfp idc)
+{
+   int pot = step.pot;
+   ThrottleFP::CheckAndLimitRange(&pot, 0);
+   thrfp spnt = ThrottleFP::CalcThrottle(pot, 0, step.brake);
+   spnt = ThrottleFP::RampThrottle(spnt);
+   ThrottleFP::UdcLimitCommand(spnt, udc);
+   ThrottleFP::IdcLimitCommand(spnt, idc);
+   ThrottleFP::SpeedLimitCommand(spnt, step.speed);
+   return spnt;
 }
 
 // TEMPERATURE DERATING
@@ -98,6 +200,106 @@ static void TestCalcThrottleIs100WhenOverMax() {
 }
 
 
+// FIXED POINT PIPELINE
+static void TestFixedNormalizeMatchesFloat() {
+   float maxDiff = 0;
+
+   for (int pot = 100; pot <= 4000; pot++)
+      maxDiff = MAX(maxDiff, ABS(Throttle::NormalizeThrottle(pot, 0) - THR_TOFLOAT(ThrottleFP::NormalizeThrottle(pot, 0))));
+
+   ASSERT(maxDiff < 0.0001f);
+}
+
+static void TestFixedTemperatureDerateMatchesFloat() {
+   bool same = true;
+
+   for (int temp = 40; temp < 70; temp++)
+   {
+      float spnt = 80;
+      thrfp spntFP = THR_FROMINT(80);
+      bool derate = Throttle::TemperatureDerate(temp, 60, spnt);
+      bool derateFP = ThrottleFP::TemperatureDerate(THR_FROMINT(temp), THR_FROMINT(60), spntFP);
+      same = same && derate == derateFP && spnt == THR_TOFLOAT(spntFP);
+   }
+   ASSERT(same);
+}
+
+/* The float version truncates the averaged pedal position to whole percent
+ * before mapping it to [regenmax, throtmax] in 0.1% steps. When the float and
+ * fixed point averages sit on different sides of a whole percent the results
+ * differ by one such step, (throtmax - regenmax) / 100. Everywhere else they
+ * agree to the ramp's accumulated rounding.
+ */
+#define PIPELINE_STEP_TOLERANCE  ((100 - -10) / 100.0f + 0.01f)
+#define PIPELINE_MEAN_TOLERANCE  0.01f
+
+static void TestFixedPipelineMatchesFloat() {
+   float maxDiff = 0, sumDiff = 0;
+
+   PipelineSetup();
+   GenerateDrive();
+   Param::SetInt(Param::dir, 1);
+
+   //Settle the filters of both versions on pedal released at standstill
+   for (int i = 0; i < 500; i++)
+   {
+      DriveStep idle = { 100, false, 0, 360, 0 };
+      Param::SetInt(Param::speed, 0);
+      RunFloatStep(idle);
+      RunFixedStep(idle, THR_FROMINT(360), 0);
+   }
+
+   for (int i = 0; i < DRIVE_STEPS; i++)
+   {
+      Param::SetInt(Param::speed, drive[i].speed);
+      float spnt = RunFloatStep(drive[i]);
+      float spntFP = THR_TOFLOAT(RunFixedStep(drive[i], THR_FROMFLT(drive[i].udc), THR_FROMFLT(drive[i].idc)));
+      float diff = ABS(spnt - spntFP);
+      maxDiff = MAX(maxDiff, diff);
+      sumDiff += diff;
+   }
+
+   cout << "Fixed point throttle, " << DRIVE_STEPS << " steps: max deviation " << maxDiff
+        << "%, mean deviation " << sumDiff / DRIVE_STEPS << "%" << endl;
+
+   ASSERT(maxDiff <= PIPELINE_STEP_TOLERANCE && sumDiff / DRIVE_STEPS < PIPELINE_MEAN_TOLERANCE);
+}
+
+/* On the host both run in hardware, so only the relative cost means
+ * something. On the target the THROTTLE slot of the task profiler gives
+ * the cycle count of the whole pipeline. The timed runs get the same
+ * inputs, so their results must agree like in the test above.
+ */
+static void TestFixedPipelineBenchmark() {
+   static float floatSpnt[DRIVE_STEPS / 10], fixedSpnt[DRIVE_STEPS / 10];
+   thrfp udc[DRIVE_STEPS / 10], idc[DRIVE_STEPS / 10];
+   float maxDiff = 0;
+
+   for (int i = 0; i < DRIVE_STEPS / 10; i++)
+   {
+      udc[i] = THR_FROMFLT(drive[i].udc);
+      idc[i] = THR_FROMFLT(drive[i].idc);
+   }
+
+   auto start = chrono::steady_clock::now();
+   for (int i = 0; i < DRIVE_STEPS / 10; i++)
+      floatSpnt[i] = RunFloatStep(drive[i]);
+   auto mid = chrono::steady_clock::now();
+   for (int i = 0; i < DRIVE_STEPS / 10; i++)
+      fixedSpnt[i] = THR_TOFLOAT(RunFixedStep(drive[i], udc[i], idc[i]));
+   auto end = chrono::steady_clock::now();
+
+   for (int i = 0; i < DRIVE_STEPS / 10; i++)
+      maxDiff = MAX(maxDiff, ABS(floatSpnt[i] - fixedSpnt[i]));
+
+   double floatNs = chrono::duration<double, nano>(mid - start).count() / (DRIVE_STEPS / 10);
+   double fixedNs = chrono::duration<double, nano>(end - mid).count() / (DRIVE_STEPS / 10);
+
+   cout << "Throttle pipeline: float " << floatNs << " ns/step, fixed point " << fixedNs << " ns/step" << endl;
+
+   ASSERT(maxDiff <= PIPELINE_STEP_TOLERANCE);
+}
+
 void ThrottleTest::RunTest()
 {
    TestSetup();
@@ -111,4 +313,8 @@ void ThrottleTest::RunTest()
    TestCalcThrottleIsAbove0WhenJustOutOfDeadZone();
    TestCalcThrottleIs100WhenMax();
    TestCalcThrottleIs100WhenOverMax();
+   TestFixedNormalizeMatchesFloat();
+   TestFixedTemperatureDerateMatchesFloat();
+   TestFixedPipelineMatchesFloat();
+   TestFixedPipelineBenchmark();
 }